@@ -0,0 +1,55 @@
+"""
+Static RAM audit for BitMap16 DX.
+
+Lists every global and function-static variable in .data/.bss larger than
+a threshold (256 bytes by default), largest first, with a total. Anything
+big that only one view or feature needs belongs in a scoped buffer (see
+SCOPED BUFFERS in src/main.cpp) instead.
+
+  pio run -e ram-audit                          # runs after linking
+  python scripts/ram_audit.py firmware.elf [--min 256] [--nm xtensa-esp32s3-elf-nm]
+"""
+
+import argparse
+import subprocess
+
+DEFAULT_MIN_BYTES = 256
+DATA_TYPES = "bBdD"  # nm symbol types for .bss and .data
+
+
+def audit(elf, nm="nm", min_bytes=DEFAULT_MIN_BYTES):
+    output = subprocess.run([nm, "-C", "-S", "--size-sort", elf],
+                            capture_output=True, text=True, check=True).stdout
+    symbols = []
+    for line in output.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4 or parts[2] not in DATA_TYPES:
+            continue
+        size = int(parts[1], 16)
+        if size > min_bytes:
+            section = ".bss" if parts[2] in "bB" else ".data"
+            symbols.append((size, section, parts[3]))
+
+    symbols.sort(reverse=True)
+    print("Static RAM over %d bytes (%s):" % (min_bytes, elf))
+    for size, section, name in symbols:
+        print("  %8d  %-5s  %s" % (size, section, name))
+    print("  %8d  total in %d symbols" % (sum(s[0] for s in symbols), len(symbols)))
+
+
+def audit_after_link(target, source, env):
+    nm = env.subst("$CC").replace("gcc", "nm")
+    audit(str(target[0]), nm)
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs this as an extra script
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", audit_after_link)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+        parser.add_argument("elf")
+        parser.add_argument("--min", type=int, default=DEFAULT_MIN_BYTES, help="smallest size to list (bytes)")
+        parser.add_argument("--nm", default="nm", help="nm for the target (xtensa-esp32s3-elf-nm)")
+        args = parser.parse_args()
+        audit(args.elf, args.nm, args.min)
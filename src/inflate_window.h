@@ -0,0 +1,89 @@
+/**
+ * inflate_window.h
+ *
+ * Streaming zlib inflate with the ESP32 ROM tinfl decoder
+ * tinfl keeps its LZ history in the output buffer itself, so output goes into
+ * a TINFL_LZ_DICT_SIZE window that wraps around. tinfl only accepts a wrapping
+ * window when it is asked to fill the whole rest of it (start to end must be a
+ * power of two), so each call may produce more than the caller wants; the
+ * surplus stays in the window and is copied out by the next read.
+ * Used by the sprite sheet importer to decode PNG scanlines.
+ */
+
+#ifndef INFLATE_WINDOW_H
+#define INFLATE_WINDOW_H
+
+#include <stdint.h>
+#include <string.h>
+#include <rom/miniz.h>
+
+struct InflateWindow {
+  tinfl_decompressor* inflator;
+  uint8_t* window;              // TINFL_LZ_DICT_SIZE bytes of inflate history
+  size_t writePos;              // Where tinfl writes next
+  size_t readPos;               // First inflated byte not yet copied out
+  size_t pending;               // Inflated bytes from readPos not yet copied out
+  tinfl_status status;          // Result of the last tinfl call
+};
+
+/**
+ * Start a new zlib stream (inflator and window must already be allocated)
+ */
+inline void inflateWindowBegin(InflateWindow& w) {
+  tinfl_init(w.inflator);
+  w.writePos = 0;
+  w.readPos = 0;
+  w.pending = 0;
+  w.status = TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+/**
+ * Copy up to outBytes inflated bytes to out, inflating from in as needed.
+ * Stops early when the input runs out (feed more and call again) or the
+ * stream ends.
+ *
+ * @param inBytes Compressed bytes available; set to the number consumed
+ * @param outBytes Bytes wanted; set to the number copied
+ * @param moreInput Whether more compressed data follows this input
+ * @return tinfl status of the last call (negative on corrupt or truncated data)
+ */
+inline tinfl_status inflateWindowRead(InflateWindow& w, const uint8_t* in, size_t& inBytes,
+                                      uint8_t* out, size_t& outBytes, bool moreInput) {
+  const size_t inAvail = inBytes;
+  const size_t wanted = outBytes;
+  inBytes = 0;
+  outBytes = 0;
+  while (outBytes < wanted) {
+    if (w.pending == 0) {
+      if (w.status == TINFL_STATUS_DONE) {
+        break;
+      }
+      size_t n = inAvail - inBytes;
+      if (n == 0 && moreInput && w.status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+        break;  // Caller has to refill
+      }
+      // Always the whole rest of the window, as tinfl requires when it wraps
+      size_t space = TINFL_LZ_DICT_SIZE - w.writePos;
+      mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (moreInput ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+      w.status = tinfl_decompress(w.inflator, in + inBytes, &n, w.window, w.window + w.writePos, &space, flags);
+      inBytes += n;
+      w.readPos = w.writePos;
+      w.pending = space;
+      w.writePos = (w.writePos + space) & (TINFL_LZ_DICT_SIZE - 1);
+      if (w.status < 0) {
+        return w.status;
+      }
+      if (space == 0 && n == 0) {
+        break;  // No progress without more input
+      }
+    }
+    size_t copy = w.pending < wanted - outBytes ? w.pending : wanted - outBytes;
+    memcpy(out + outBytes, w.window + w.readPos, copy);
+    outBytes += copy;
+    w.readPos += copy;
+    w.pending -= copy;
+  }
+  return w.status;
+}
+
+#endif // INFLATE_WINDOW_H
@@ -0,0 +1,96 @@
+/**
+ * led_power.h
+ *
+ * WS2812 current model for the LED matrix
+ * Every frame's current draw is estimated from the LED buffer before it is sent.
+ * If it would exceed the budget, the whole frame is dimmed just enough to fit.
+ * Sparse sketches can run near full brightness; dense ones are scaled down.
+ * Plain C++ with no Arduino dependencies, so it also builds in the native tests.
+ */
+
+#ifndef LED_POWER_H
+#define LED_POWER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef LED_POWER_BUDGET_MA
+#define LED_POWER_BUDGET_MA 500       // Max current for the matrix (Port A 5V rail)
+#endif
+#define LED_MA_PER_CHANNEL 12         // WS2812E draw per channel at full duty (mA)
+#define LED_IDLE_UA_PER_LED 600       // WS2812E quiescent draw per LED (µA), even when black
+
+/**
+ * Sum every color channel in the LED buffer.
+ * Works on 32-bit words, adding two byte lanes at a time into 16-bit
+ * accumulators (SWAR), so the 768-byte buffer is summed in ~190 steps.
+ *
+ * @param buf LED buffer (CRGB array, 3 bytes per LED)
+ * @param count Number of LEDs to include
+ * @return Sum of all R, G and B values (0-255 each)
+ */
+inline uint32_t sumLEDChannels(const void* buf, uint16_t count) {
+    const uint8_t* bytes = (const uint8_t*)buf;
+    uint32_t length = (uint32_t)count * 3;
+    uint32_t total = 0;
+    uint32_t i = 0;
+
+    while (i + 4 <= length) {
+        // Each 16-bit lane gains at most 510 per word, so flush every 128 words
+        uint32_t lanes = 0;
+        uint32_t blockEnd = i + 128 * 4;
+        if (blockEnd > length) blockEnd = length;
+        for (; i + 4 <= blockEnd; i += 4) {
+            uint32_t word;
+            memcpy(&word, bytes + i, 4);  // CRGB arrays are byte-aligned
+            lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        }
+        total += (lanes & 0xFFFF) + (lanes >> 16);
+    }
+
+    // Leftover bytes (count * 3 is not always a multiple of 4)
+    for (; i < length; i++) {
+        total += bytes[i];
+    }
+    return total;
+}
+
+/**
+ * Estimate WS2812 current for a frame.
+ *
+ * @param channelSum Sum of all channel values (from sumLEDChannels)
+ * @param count Number of physical LEDs on the chain
+ * @param brightness FastLED brightness (0-255) applied to the frame
+ * @return Estimated current in mA
+ */
+inline uint32_t estimateLEDCurrentMA(uint32_t channelSum, uint16_t count, uint8_t brightness) {
+    uint64_t activeUA = (uint64_t)channelSum * brightness * (LED_MA_PER_CHANNEL * 1000UL) / (255UL * 255UL);
+    uint32_t idleUA = (uint32_t)count * LED_IDLE_UA_PER_LED;
+    return (uint32_t)((activeUA + idleUA) / 1000);
+}
+
+/**
+ * Find the highest brightness (up to the requested one) that keeps the
+ * frame under LED_POWER_BUDGET_MA.
+ *
+ * @param channelSum Sum of all channel values (from sumLEDChannels)
+ * @param count Number of physical LEDs on the chain
+ * @param brightness Requested FastLED brightness (0-255)
+ * @return Brightness to send the frame with (0-255)
+ */
+inline uint8_t budgetLEDBrightness(uint32_t channelSum, uint16_t count, uint8_t brightness) {
+    if (channelSum == 0) return brightness;
+
+    // Current available for lighting LEDs once the idle draw is paid for
+    uint32_t idleUA = (uint32_t)count * LED_IDLE_UA_PER_LED;
+    uint32_t budgetUA = LED_POWER_BUDGET_MA * 1000UL;
+    if (idleUA >= budgetUA) return 0;
+
+    // Draw of this frame at full brightness, then scale into the headroom
+    uint64_t fullUA = (uint64_t)channelSum * (LED_MA_PER_CHANNEL * 1000UL) / 255UL;
+    uint64_t maxBrightness = (uint64_t)(budgetUA - idleUA) * 255UL / fullUA;
+    if (maxBrightness < brightness) return (uint8_t)maxBrightness;
+    return brightness;
+}
+
+#endif // LED_POWER_H
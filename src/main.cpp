@@ -61,8 +61,13 @@
 #endif
 
 #include <PNGENC.h>
+#include <zlib.h>       // Deflate from the zlib that PNGENC builds, used by the PNG export stripes
+#include <rom/miniz.h>  // ROM inflate, used by the sprite sheet importer
+#include "inflate_window.h"
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <new>
 #include "boot_image.h"
 
 // Preferences for persistent storage across reboots
@@ -86,6 +91,26 @@ Preferences preferences;
   #define LED_CANVAS_UPDATED() ((void)0)
 #endif
 
+// Enable main-loop stall watchdog and flight recorder
+// Loop iterations busy for longer than STALL_THRESHOLD_MS are logged to
+// /bitmap16dx/logs/stalls.txt (debounce and pacing waits in loopDelay() don't count)
+#define ENABLE_FLIGHT_RECORDER 1  // Set to 0 to disable
+
+// Enable hidden library scaling benchmark (Fn+G in memory view)
+// Generates synthetic sketches under /bitmap16dx/bench/ and writes CSV results there
+#define ENABLE_LIBRARY_BENCH 1  // Set to 0 to disable
+
+// Enable hidden on-device benchmark suite (Fn+B in settings)
+// Times drawing, SD, PNG export and LED refresh and writes a JSON report to /bitmap16dx/bench/
+#define ENABLE_DEVICE_BENCH 1  // Set to 0 to disable
+
+// Enable SD I/O tracing per call site (Fn+I on canvas writes /bitmap16dx/logs/sdtrace.txt)
+// Adds a few µs and ~3KB RAM to SD access - debug builds only
+#define ENABLE_SD_TRACE 0  // Set to 1 to enable
+
+// Output folder shared by both benchmarks
+#define BENCH_DIR "/bitmap16dx/bench"
+
 // Note: ENABLE_BLUETOOTH is defined near top of file (before PNGENC include)
 // to avoid macro conflicts. Set to 0 there to disable BT features.
 
@@ -100,9 +125,36 @@ const char* FIRMWARE_VERSION = "v0.7.0";
 // File format version for sketch files
 // Version 1: gridSize (1B) + paletteSize (1B) + palette (32B) + pixels (256B) = 290 bytes
 // Version 2: formatVersion (1B) + gridSize (1B) + paletteSize (1B) + palette (32B) + pixels (256B) = 291 bytes
-const uint8_t SKETCH_FORMAT_VERSION = 2;
+// Version 3: chunked container, so new data can be added without breaking readers
+//   Header (8B): magic "B16S", version, chunk count, 2 reserved bytes
+//   TOC (12B per chunk): 4-char tag, offset (u32 BE), length (u32 BE)
+//   Chunks (unknown tags are skipped):
+//     INFO - gridSize, paletteSize, 2 reserved bytes, palette fingerprint (u64 BE)
+//            (read when building the sketch list; files written before the
+//            fingerprint was added have a 4-byte INFO)
+//     PALT - palette (32B BE), written just before PIXL so a thumbnail (palette
+//            + visible rows) or an open (palette + all rows) is one read
+//     PIXL - full 16×16 pixel data
+//     PREV - palette (32B BE) + visible pixels (gridSize²): only in files
+//            written before PALT, which duplicated PIXL; read, never written
+const uint8_t SKETCH_FORMAT_VERSION = 3;
 const int SKETCH_FILE_SIZE_V1 = 290;  // Legacy format without version byte
-const int SKETCH_FILE_SIZE_V2 = 291;  // Current format with version byte
+const int SKETCH_FILE_SIZE_V2 = 291;  // Legacy format with version byte
+const char SKETCH_MAGIC[4] = {'B', '1', '6', 'S'};
+const int SKETCH_HEADER_SIZE = 8;
+const int SKETCH_TOC_ENTRY_SIZE = 12;
+const int SKETCH_MAX_CHUNKS = 16;     // Sanity limit when reading the TOC
+
+// Sketch storage
+// FAT directory lookups are linear in entry count, so sketches are sharded into
+// subfolders by ID (the number in sketch_N.dat), SKETCHES_PER_SHARD per folder:
+//   /bitmap16dx/sketches/000/sketch_1.dat ... sketch_255.dat
+//   /bitmap16dx/sketches/001/sketch_256.dat ... sketch_511.dat
+const char* SKETCH_DIR = "/bitmap16dx/sketches";
+const unsigned long SKETCHES_PER_SHARD = 256;
+const char* sketchRoot = SKETCH_DIR;  // Library in use (pointed elsewhere only while benchmarking)
+const char* COLLECTION_DIR = "/bitmap16dx/collections";  // Named subsets of the library (see COLLECTIONS)
+const char* BACKUP_DIR = "/bitmap16dx/backups";  // Library archives (see LIBRARY ARCHIVE)
 
 // Canvas size in logical pixels
 // The canvas is always 16×16 to support both modes
@@ -172,6 +224,12 @@ bool paletteFilterUser = false;         // true=show only user palettes
 // Filtered palette indices (which palettes match current filter)
 uint8_t filteredPaletteIndices[32];
 uint8_t filteredPaletteCount = 0;
+int8_t paletteFilterPosition[32];       // Catalog index → position in filtered list (-1 = hidden)
+
+// Palette fingerprints (see paletteFingerprint) and their lookup index
+#define PALETTE_INDEX_SLOTS 64          // Power of two, at least twice the catalog size
+uint64_t allPaletteFingerprints[32];
+uint8_t paletteIndexSlots[PALETTE_INDEX_SLOTS];  // Catalog index + 1 (0 = empty slot)
 
 // ============================================================================
 // THEME SYSTEM
@@ -244,6 +302,22 @@ unsigned long keyRepeatRate = 100;    // Time between repeats (ms)
 bool keyRepeating = false;            // Whether we're in repeat mode
 char lastKey = 0;                     // Track which arrow key is held
 
+#if ENABLE_FLIGHT_RECORDER
+uint32_t loopWaitMs = 0;              // Time this loop() iteration has spent in loopDelay()
+#endif
+
+/**
+ * Wait on purpose inside a loop() iteration: key debounce, polling for a key
+ * release, or frame pacing. The stall watchdog leaves this time out, so a key
+ * press doesn't count as a stall.
+ */
+void loopDelay(uint32_t ms) {
+  delay(ms);
+#if ENABLE_FLIGHT_RECORDER
+  loopWaitMs += ms;
+#endif
+}
+
 // Canvas data - stores color indices for each pixel
 // 0 = empty/transparent (show checkerboard)
 // 1-16 = color indices into the PALETTE array
@@ -267,20 +341,62 @@ uint8_t displayBrightness = 80;  // Start at 80% brightness
 
 #include <FastLED.h>
 
-// WS2812E RGB LED matrix (8×8 or 16×16)
-// Supports 1 Puzzle Unit (64 LEDs) or 4 Units (256 LEDs)
+// WS2812E RGB LED matrix built from 8×8 Puzzle Units
+// Built-in layouts: 1 unit (8×8) or 4 units (2×2, 16×16)
+// Any other wall (up to 8×8 units) is described in LED_LAYOUT_PATH on the SD card
 // Mirrors the canvas in real-time when enabled
 // Connected to Port A: Yellow wire (G2) = GPIO2
 #define LED_PIN 2                     // GPIO2 (Port A - Yellow wire)
-#define NUM_LEDS 256                  // Max size: 16×16 matrix (4 units)
+#define LED_UNIT_SIZE 8               // Each Puzzle Unit is 8×8 LEDs
+#define MAX_LED_WALL_UNITS 8          // Layout files may use up to 8×8 units
+#define LED_LAYOUT_CUSTOM 0           // rgbMatrixUnits value meaning "layout from SD"
+#define LED_LAYOUT_PATH "/bitmap16dx/led_layout.txt"
+#define LED_NO_INDEX 0xFFFF           // Wall position with no unit behind it
 #define DEFAULT_LED_BRIGHTNESS 5      // 5% brightness default
 #define MIN_LED_BRIGHTNESS 1          // Minimum 1% (very dim)
-#define MAX_LED_BRIGHTNESS 20         // Maximum 20% (for battery safety)
-
-CRGB leds[256];                       // LED array for FastLED (max 4 units)
+#define MAX_LED_BRIGHTNESS 100        // Maximum 100% (current is limited by the power budget)
+
+// LED power budget (LED_POWER_BUDGET_MA and the per-LED draw model)
+#include "led_power.h"
+
+// Units the budget can power: their idle draw may take at most half of it,
+// leaving the rest for light. That's 6 units on the 500 mA Port A rail; a full
+// 8×8 wall needs an external supply and a 5000 mA budget (env:led-wall).
+#define LED_BUDGET_CHAIN_UNITS (LED_POWER_BUDGET_MA * 1000UL / 2 / (LED_IDLE_UA_PER_LED * LED_UNIT_SIZE * LED_UNIT_SIZE))
+#define LED_MAX_CHAIN_UNITS (LED_BUDGET_CHAIN_UNITS < MAX_LED_WALL_UNITS * MAX_LED_WALL_UNITS \
+                             ? LED_BUDGET_CHAIN_UNITS : MAX_LED_WALL_UNITS * MAX_LED_WALL_UNITS)
+
+// One Puzzle Unit's place in the wall, listed in data chain order
+struct LEDUnitPlacement {
+  uint8_t col;       // Unit column in the wall grid
+  uint8_t row;       // Unit row in the wall grid
+  uint8_t rotation;  // Quarter turns clockwise (0-3)
+  uint8_t mirror;    // LED_MIRROR_NONE, LED_MIRROR_H or LED_MIRROR_V (applied before rotation)
+};
+#define LED_MIRROR_NONE 0
+#define LED_MIRROR_H 1
+#define LED_MIRROR_V 2
+
+// Active layout, compiled into a flat lookup table by compileLEDLayout()
+CRGB* leds = nullptr;                 // LED array for FastLED (sized to the layout)
+uint16_t ledCount = 0;                // Physical LEDs on the chain (units × 64)
+uint16_t* ledIndexLUT = nullptr;      // Wall pixel (y * ledWallWidth + x) → chain index
+uint16_t ledWallWidth = 0;            // Wall size in LEDs
+uint16_t ledWallHeight = 0;
+CLEDController* ledController = nullptr;
 bool ledMatrixEnabled = false;        // User must explicitly enable
-uint8_t ledBrightness = DEFAULT_LED_BRIGHTNESS;  // 1-20%
+uint8_t ledBrightness = DEFAULT_LED_BRIGHTNESS;  // 1-100%
 bool canvasNeedsUpdate = false;       // Flag to trigger LED update
+uint16_t ledEstimatedMA = 0;          // Estimated current of the last frame sent (mA)
+uint8_t ledAppliedBrightness = 0;     // Brightness actually used for the last frame (0-255)
+
+// LED playlist (L in the memory view): sketches compiled into frames that are
+// ready to send, so playback is a copy into the LED buffer and a transmit
+#define LED_PLAYLIST_MAX_FRAMES 32
+#define LED_PLAYLIST_BUDGET 32768     // Max bytes of compiled frames (fewer frames on big walls)
+#define LED_GAMMA 2.2f
+const uint8_t LED_PLAYLIST_FPS[] = {4, 8, 15, 30, 60};
+uint8_t ledPlaylistRate = 1;          // Index into LED_PLAYLIST_FPS
 #endif // ENABLE_LED_MATRIX
 
 #if ENABLE_BLUETOOTH
@@ -289,18 +405,81 @@ bool canvasNeedsUpdate = false;       // Flag to trigger LED update
 // ============================================================================
 // Connects to external BLE HID keyboards for wireless input
 // Uses NimBLE library for low-memory BLE stack
+//
+// Scanning and connecting run as a state machine stepped from loop() by
+// btUpdate(), so the UI never waits on the radio. NimBLE callbacks only push
+// events into a single-producer ring (btEvents); every state change and all
+// HID report handling happen on the main loop. The stack is brought up when a
+// scan or reconnect starts and deinitialized, with its memory, whenever
+// Bluetooth goes idle again.
+
+#define BT_SIM_HID 0  // Replace the radio with a scripted keyboard (see BT SIMULATED KEYBOARD)
+
+enum BtState {
+  BT_OFF,           // Stack down, nothing held
+  BT_SCANNING,      // Looking for a keyboard
+  BT_CONNECTING,    // Connect, pair and subscribe in progress
+  BT_CONNECTED,     // Receiving HID reports
+  BT_WAIT_RETRY     // Connect failed or link lost; retrying after a backoff
+};
 
 // Connection state
 bool btEnabled = false;               // User preference (persistent)
-bool btConnected = false;             // Currently connected to a keyboard
-bool btScanning = false;              // Scan in progress
-NimBLEClient* btClient = nullptr;
-NimBLEAdvertisedDevice* btAdvDevice = nullptr;
+BtState btState = BT_OFF;
+unsigned long btStateTime = 0;        // millis() when btState last changed
+uint8_t btStateVersion = 0;           // Bumped when the settings row should redraw
+uint8_t btRetryCount = 0;             // Consecutive failed connects / lost links
+bool btStopRequested = false;         // Stop once the connect in progress finishes
+bool btDroppedWhileConnecting = false;  // Link lost before the connect outcome was taken
+
+// Keyboard to connect to (from a scan, or the bonded one)
+uint8_t btTargetAddr[6] = {0};
+uint8_t btTargetType = 0;
 
 // Bonded device for auto-reconnect
 uint8_t btBondedAddr[6] = {0};        // Stored MAC address
+uint8_t btBondedType = 0;             // Address type (public / random)
 bool btHasBondedDevice = false;
 
+#define BT_SCAN_SECONDS 15
+#define BT_CONNECT_TIMEOUT_S 10
+#define BT_RETRY_MIN_MS 1000          // First retry; doubles per consecutive failure
+#define BT_RETRY_MAX_MS 16000
+#define BT_MAX_RETRIES 6              // Then give up and take the stack down
+#define BT_STABLE_LINK_MS 10000       // A link up this long clears the retry count
+
+// Events from NimBLE callbacks (host task) to the main loop
+enum BtEventType : uint8_t {
+  BT_EV_FOUND,          // Keyboard advertisement (data = address, data[6] = type)
+  BT_EV_SCAN_END,       // Scan duration elapsed
+  BT_EV_DISCONNECTED,   // Link dropped
+  BT_EV_REPORT          // HID input report (len bytes of data)
+};
+
+struct BtEvent {
+  uint8_t type;
+  uint8_t len;
+  uint8_t data[8];
+};
+
+#define BT_EVENT_RING_SIZE 32         // Power of two
+BtEvent btEvents[BT_EVENT_RING_SIZE];
+std::atomic<uint8_t> btEventHead(0); // Written by the producer only
+std::atomic<uint8_t> btEventTail(0); // Written by the main loop only
+std::atomic<bool> btEventsResync(false);  // An event was dropped; the main loop starts over
+std::atomic<uint16_t> btAdvertsSeen(0);  // Advertisements during the current scan
+
+// Result of the connect in progress (set by the connect worker / simulator)
+enum BtConnectOutcome : int8_t {
+  BT_CONNECT_PENDING = -1,
+  BT_CONNECT_OK,
+  BT_FAIL_CONNECT,
+  BT_FAIL_PAIRING,
+  BT_FAIL_NO_HID,
+  BT_FAIL_SUBSCRIBE
+};
+std::atomic<int8_t> btConnectOutcome(BT_CONNECT_PENDING);
+
 // Input state (updated from HID reports)
 bool btArrowUp = false;
 bool btArrowDown = false;
@@ -321,10 +500,6 @@ uint8_t btQueueTail = 0;
 // HID report tracking
 uint8_t btPrevReport[8] = {0};
 
-// Last scan results (for debugging)
-int btLastScanCount = 0;
-int btScanCountdown = 0;  // Countdown timer during scan
-
 // HID keycodes
 #define HID_KEY_ENTER       0x28
 #define HID_KEY_ESCAPE      0x29
@@ -336,11 +511,6 @@ int btScanCountdown = 0;  // Countdown timer during scan
 #define HID_KEY_UP_ARROW    0x52
 #define HID_KEY_LEFT_ALT    0xE2
 #define HID_KEY_RIGHT_ALT   0xE6
-
-// Notification message timing
-unsigned long btNotifyTime = 0;
-const unsigned long BT_NOTIFY_DURATION = 1500;  // 1.5 seconds
-char btNotifyMsg[32] = "";
 #endif // ENABLE_BLUETOOTH
 
 // Undo state - stores a single previous canvas state
@@ -371,7 +541,7 @@ const unsigned long SHAKE_COOLDOWN = 500;  // Debounce time in milliseconds
 // Index 0 is always Transparent. Indices 1..paletteSize map to drawable colors.
 // Palette changes are explicit and never rewrite pixel indices.
 
-// Sketch data structure (unchanged format - 290 bytes on disk)
+// Sketch data structure (on-disk layout: see SKETCH_FORMAT_VERSION)
 struct Sketch {
   uint8_t pixels[16][16];        // Indexed bitmap (values are palette indices)
   uint8_t gridSize;              // 8 or 16
@@ -386,23 +556,48 @@ Sketch activeSketch;
 bool activeSketchIsNew = true;           // True if never saved
 String activeSketchFilename = "";        // e.g., "sketch_1737849600.dat"
 
+// Where each part of a sketch file lives (from the header/TOC, or implied by legacy file size)
+struct SketchFileIndex {
+  uint8_t version;                       // 1, 2 or 3
+  uint8_t gridSize;                      // From INFO chunk (v3 only, 0 until read for legacy files)
+  uint8_t paletteSize;
+  uint32_t paletteOffset;                // 32-byte palette (PALT, or the start of PREV)
+  uint32_t previewOffset;                // PREV chunk (older v3 files only, else length 0)
+  uint32_t previewLength;
+  uint32_t pixelsOffset;                 // Full 16×16 pixel data
+  uint64_t paletteFingerprint;           // From INFO (0 if the file predates it)
+};
+
 // Dynamic sketch list for memory view
 struct SketchInfo {
   String filename;                       // e.g., "sketch_1737849600.dat"
   unsigned long timestamp;               // Unix timestamp from filename
-  Sketch sketchData;                     // Cached sketch data (loaded once when entering memory view)
+  SketchFileIndex fileIndex;             // Chunk locations (read while building the list)
+  Sketch sketchData;                     // Cached preview data (visible pixels + palette, loaded on demand)
   bool dataLoaded;                       // Whether sketchData is valid
 };
 
+// Bytes read from sketch files, per kind of read (shown with I in the memory view)
+enum SketchReadKind { SKETCH_READ_INDEX, SKETCH_READ_PREVIEW, SKETCH_READ_FULL, SKETCH_READ_KINDS };
+struct SketchReadStats {
+  uint32_t reads;                        // Operations (list entry, thumbnail, open), not read calls
+  uint32_t bytes;
+};
+SketchReadStats sketchReadStats[SKETCH_READ_KINDS];
+
 std::vector<SketchInfo> sketchList;      // Populated when entering memory view
 
 // Memory View state
 bool inMemoryView = false;
 int memoryViewCursor = 0;  // Which item is selected (0 = "+", 1+ = sketches)
+unsigned long memoryViewCursorId = 0;  // Sketch ID under the cursor (0 = "+"), kept while the list rescans
+int memoryViewCursorIndex = 0;         // Cursor position to hold until that sketch is listed
 int memoryViewScrollOffset = 0;  // Target scroll position (pixels scrolled left)
 float memoryViewScrollPos = 0.0f;  // Actual animated scroll position for smooth transitions
 const float MEMORY_SCROLL_SPEED = 0.35f;  // Animation speed (0.0-1.0, higher = faster)
 unsigned long lastMemoryAnimTime = 0;  // For frame rate limiting
+const int MEMORY_PREVIEW_LOADS_PER_FRAME = 4;  // Thumbnails read from SD per frame (others show placeholders)
+int memoryPreviewLoadsLeft = 0;
 const int MEMORY_ANIM_FRAME_MS = 16;  // Milliseconds between animation frames (16ms = 60fps - now we can afford it with caching!)
 
 // Memory View cursor animation (diagonal breathing effect)
@@ -427,6 +622,14 @@ unsigned long galleryLastAdvanceTime = 0;   // Timer for auto-advance
 bool galleryAutoAdvance = false;            // Slideshow auto-advance active
 const unsigned long GALLERY_ADVANCE_INTERVAL = 3000;  // Auto-advance every 3 seconds
 
+// Tiled preview state (T/O in preview, Fn+V live strip in canvas view)
+bool previewTiled = false;        // Fill the preview with repeats of the sketch
+bool previewTileOffset = false;   // Shift every other row of repeats by half a tile
+bool canvasTileStrip = false;     // Live repeat strip in place of the tool icons
+M5Canvas tileSprite(&M5Cardputer.Display);  // One rendered repeat, block-copied to each position
+bool tileSpriteAvailable = false;
+int tileSpriteSize = 0;
+
 // Palette menu state
 bool inPaletteView = false;
 bool paletteCanvasAvailable = false;  // Track if canvas allocation succeeded
@@ -484,8 +687,9 @@ bool chargeCanvasAvailable = false;
 
 // Settings preferences (loaded from NVS)
 uint8_t defaultGridSize = 8;        // 8 or 16 (default grid size on boot/new sketch)
-uint8_t rgbMatrixUnits = 1;         // 1 or 4 (64 or 256 LEDs)
+uint8_t rgbMatrixUnits = 1;         // 1 or 4 (64 or 256 LEDs), or LED_LAYOUT_CUSTOM (SD layout)
 bool exportRGB565 = false;           // false=RGB888, true=RGB565
+uint8_t exportFormat = 0;           // ImageFormat of exports and screenshots (0 = PNG)
 bool shakeUndoEnabled = false;       // true=enabled, false=disabled
 
 // Settings canvas for tear-free rendering
@@ -536,6 +740,42 @@ namespace StatusMsg {
   const char* PNG_INIT_ERR_FMT = "PNG init err:%d";   // Format string
   const char* ADDLINE_ERR_FMT = "addLine err:%d";     // Format string
 
+  // Background Jobs
+  const char* JOB_BUSY = "Busy...";
+  const char* JOB_CANCELLED = "Cancelled";
+  const char* JOB_STATS_FMT = "%lufr max%lu avg%lums";  // Format string
+
+  // Memory View
+  const char* SCAN_STATS_FMT = "Open %lu/%lums N%lu";  // Format string
+  const char* GROUP_BY_PALETTE = "By palette";
+  const char* GROUP_BY_DATE = "Newest first";
+  const char* MOVED = "Moved";
+  const char* COPIED = "Copied";
+  const char* TOO_MANY_COLLECTIONS = "Too many collections";
+  const char* NO_SHEETS = "No sheets in import/";
+  const char* IMPORTED_FMT = "Imported %lu (%lu dup)";  // Format string
+  const char* ARCHIVED_FMT = "Archived %lu (%lu.%lux)";  // Format string
+  const char* RESTORED_FMT = "Restored %lu (%lu kept)";  // Format string
+  const char* NO_BACKUPS = "No backups";
+  const char* SHARED_PROMPT = "Colors: 4 8 1(6)";
+  const char* SHARED_SAVED_FMT = "Shared %u of %u colors";  // Format string
+  const char* SHARED_REMAPPED_FMT = "Remapped %lu to %u";  // Format string
+  const char* NO_SKETCHES = "No sketches";
+  const char* NO_COLORS = "No colors to share";
+  const char* STILL_LISTING = "Still listing...";
+
+  // Mural
+  const char* MURAL_STATS_FMT = "Hit %lu%% pan %lu/%lums";  // Format string
+
+#if ENABLE_LIBRARY_BENCH || ENABLE_DEVICE_BENCH
+  const char* BENCH_DONE = "Bench saved";
+  const char* BENCH_FAIL = "Bench failed";
+#endif
+
+#if ENABLE_SD_TRACE
+  const char* TRACE_SAVED = "SD trace saved";
+#endif
+
   // Export & Screenshot
   const char* EXPORTED = "Exported!";
   const char* TOO_MANY_EXPORTS = "Too many exports";
@@ -555,6 +795,17 @@ namespace StatusMsg {
   const char* COLOR_FMT = "Color: %d";     // Format string
   const char* FILL = "Fill";
   const char* RESTORED_SKETCH = "Restored sketch";
+
+#if ENABLE_LED_MATRIX
+  // LED Matrix
+  const char* NO_LED_LAYOUT = "No LED layout";
+  const char* BAD_LED_LAYOUT = "Bad LED layout";
+  const char* LED_TOO_MANY_UNITS_FMT = "LED: max %u units";  // Format string
+  const char* LED_OFF = "LED: OFF";
+  const char* LED_PLAYING_FMT = "LED: %u frames";
+  const char* LED_STOPPED = "LED: Stopped";
+  const char* LED_FPS_FMT = "LED: %u fps";
+#endif
 }
 
 // Debug status message
@@ -577,6 +828,244 @@ const char* detectedBoardName = "Unknown";
 #define SD_SPI_MOSI_PIN 14
 #define SD_SPI_CS_PIN   12
 
+#if ENABLE_SD_TRACE
+// ============================================================================
+// SD I/O TRACING
+// ============================================================================
+// SD and File are redefined at the end of this block as thin wrappers that
+// count calls, bytes and time per call site. The caller's line and function
+// come from __builtin_LINE()/__builtin_FUNCTION() default arguments, so the
+// rest of the file needs no changes. Sites are (line, operation) pairs kept
+// in a small open-addressed table. Fn+I on the canvas writes the table,
+// slowest first, to SD_TRACE_PATH (the report itself isn't traced).
+
+#define SD_TRACE_SITES 128  // Distinct (line, operation) pairs tracked
+#define SD_TRACE_PATH "/bitmap16dx/logs/sdtrace.txt"
+
+enum SDTraceOp : uint8_t {
+  SDT_OPEN, SDT_READ, SDT_WRITE, SDT_FLUSH, SDT_EXISTS, SDT_REMOVE, SDT_MKDIR, SDT_RMDIR, SDT_RENAME,
+  SDT_NEXT, SDT_OPS
+};
+const char* SD_TRACE_OP_NAMES[SDT_OPS] = {
+  "open", "read", "write", "flush", "exists", "remove", "mkdir", "rmdir", "rename", "next"
+};
+
+struct SDTraceSite {
+  uint16_t line;
+  uint8_t op;
+  const char* function;
+  uint32_t calls;      // 0 = free slot
+  uint32_t bytes;
+  uint32_t totalUs;
+  uint32_t maxUs;
+};
+
+SDTraceSite sdTraceSites[SD_TRACE_SITES];
+uint32_t sdTraceDropped = 0;  // Calls not recorded because the table was full
+unsigned long sdTraceSinceMs = 0;
+
+auto& realSD = SD;  // Untraced card, for the report
+
+/**
+ * Add one call to its site's totals
+ */
+void sdTraceRecord(SDTraceOp op, uint16_t line, const char* function, uint32_t bytes, unsigned long startUs) {
+  uint32_t elapsed = micros() - startUs;
+  uint16_t slot = (line * SDT_OPS + op) % SD_TRACE_SITES;
+  for (uint16_t probe = 0; probe < SD_TRACE_SITES; probe++) {
+    SDTraceSite& site = sdTraceSites[slot];
+    if (site.calls == 0) {
+      site.line = line;
+      site.op = op;
+      site.function = function;
+    }
+    if (site.line == line && site.op == op) {
+      site.calls++;
+      site.bytes += bytes;
+      site.totalUs += elapsed;
+      if (elapsed > site.maxUs) {
+        site.maxUs = elapsed;
+      }
+      return;
+    }
+    slot = (slot + 1) % SD_TRACE_SITES;
+  }
+  sdTraceDropped++;
+}
+
+#define SD_TRACE_SITE uint16_t line = __builtin_LINE(), const char* function = __builtin_FUNCTION()
+
+class TracedFile {
+public:
+  fs::File file;
+
+  TracedFile() {}
+  TracedFile(fs::File f) : file(f) {}
+  operator bool() const { return (bool)file; }
+
+  int read(SD_TRACE_SITE) {
+    unsigned long start = micros();
+    int c = file.read();
+    sdTraceRecord(SDT_READ, line, function, c >= 0 ? 1 : 0, start);
+    return c;
+  }
+  size_t read(uint8_t* buf, size_t size, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    size_t got = file.read(buf, size);
+    sdTraceRecord(SDT_READ, line, function, got, start);
+    return got;
+  }
+  String readStringUntil(char terminator, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    String text = file.readStringUntil(terminator);
+    sdTraceRecord(SDT_READ, line, function, text.length() + 1, start);
+    return text;
+  }
+  size_t write(uint8_t c, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    size_t written = file.write(c);
+    sdTraceRecord(SDT_WRITE, line, function, written, start);
+    return written;
+  }
+  size_t write(const uint8_t* buf, size_t size, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    size_t written = file.write(buf, size);
+    sdTraceRecord(SDT_WRITE, line, function, written, start);
+    return written;
+  }
+  template <typename T>
+  size_t print(T value, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    size_t written = file.print(value);
+    sdTraceRecord(SDT_WRITE, line, function, written, start);
+    return written;
+  }
+  // print(value, HEX) - without this the base would bind to line
+  template <typename T>
+  size_t print(T value, int base, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    size_t written = file.print(value, base);
+    sdTraceRecord(SDT_WRITE, line, function, written, start);
+    return written;
+  }
+  void flush(SD_TRACE_SITE) {
+    unsigned long start = micros();
+    file.flush();
+    sdTraceRecord(SDT_FLUSH, line, function, 0, start);
+  }
+  TracedFile openNextFile(SD_TRACE_SITE) {
+    unsigned long start = micros();
+    TracedFile next(file.openNextFile());
+    sdTraceRecord(SDT_NEXT, line, function, 0, start);
+    return next;
+  }
+
+  // Not traced
+  int available() { return file.available(); }
+  bool seek(uint32_t pos) { return file.seek(pos); }
+  size_t size() const { return file.size(); }
+  size_t position() const { return file.position(); }
+  const char* name() const { return file.name(); }
+  bool isDirectory() { return file.isDirectory(); }
+  void close() { file.close(); }
+};
+
+class TracedSDFS {
+public:
+  template <typename... Args>
+  bool begin(Args&&... args) { return realSD.begin(std::forward<Args>(args)...); }
+  sdcard_type_t cardType() { return realSD.cardType(); }
+  uint64_t cardSize() { return realSD.cardSize(); }
+
+  TracedFile open(const char* path, const char* mode = FILE_READ, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    TracedFile file(realSD.open(path, mode));
+    sdTraceRecord(SDT_OPEN, line, function, 0, start);
+    return file;
+  }
+  bool exists(const char* path, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    bool found = realSD.exists(path);
+    sdTraceRecord(SDT_EXISTS, line, function, 0, start);
+    return found;
+  }
+  bool remove(const char* path, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    bool ok = realSD.remove(path);
+    sdTraceRecord(SDT_REMOVE, line, function, 0, start);
+    return ok;
+  }
+  bool mkdir(const char* path, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    bool ok = realSD.mkdir(path);
+    sdTraceRecord(SDT_MKDIR, line, function, 0, start);
+    return ok;
+  }
+  bool rmdir(const char* path, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    bool ok = realSD.rmdir(path);
+    sdTraceRecord(SDT_RMDIR, line, function, 0, start);
+    return ok;
+  }
+  bool rename(const char* from, const char* to, SD_TRACE_SITE) {
+    unsigned long start = micros();
+    bool ok = realSD.rename(from, to);
+    sdTraceRecord(SDT_RENAME, line, function, 0, start);
+    return ok;
+  }
+};
+
+TracedSDFS tracedSD;
+
+/**
+ * Write all call sites, most total time first, then reset the counters
+ * @return true if the report was written
+ */
+bool writeSDTraceReport() {
+  std::vector<uint16_t> order;
+  for (uint16_t i = 0; i < SD_TRACE_SITES; i++) {
+    if (sdTraceSites[i].calls > 0) {
+      order.push_back(i);
+    }
+  }
+  std::sort(order.begin(), order.end(), [](uint16_t a, uint16_t b) {
+    return sdTraceSites[a].totalUs > sdTraceSites[b].totalUs;
+  });
+
+  if (!realSD.exists("/bitmap16dx/logs")) {
+    realSD.mkdir("/bitmap16dx/logs");
+  }
+  fs::File report = realSD.open(SD_TRACE_PATH, FILE_WRITE);
+  if (!report) {
+    return false;
+  }
+
+  char line[112];
+  snprintf(line, sizeof(line), "SD trace over %lu ms, %u sites, %lu dropped\n",
+           millis() - sdTraceSinceMs, (unsigned)order.size(), (unsigned long)sdTraceDropped);
+  report.print(line);
+  report.print("line  function                  op      calls    bytes   total_ms  avg_us  max_us\n");
+  for (uint16_t i : order) {
+    SDTraceSite& site = sdTraceSites[i];
+    snprintf(line, sizeof(line), "%-5u %-25.25s %-7s %-8lu %-8lu %-9lu %-7lu %lu\n",
+             site.line, site.function, SD_TRACE_OP_NAMES[site.op], (unsigned long)site.calls,
+             (unsigned long)site.bytes, (unsigned long)(site.totalUs / 1000),
+             (unsigned long)(site.totalUs / site.calls), (unsigned long)site.maxUs);
+    report.print(line);
+  }
+  report.close();
+
+  memset(sdTraceSites, 0, sizeof(sdTraceSites));
+  sdTraceDropped = 0;
+  sdTraceSinceMs = millis();
+  return true;
+}
+
+// From here on, every SD/File use in this file goes through the wrappers
+#define SD tracedSD
+#define File TracedFile
+#endif // ENABLE_SD_TRACE
+
 // ============================================================================
 // ICON DRAWING FUNCTIONS
 // ============================================================================
@@ -682,6 +1171,55 @@ float easeInOutCubic(float t) {
   }
 }
 
+// ============================================================================
+// SCOPED BUFFERS
+// ============================================================================
+// Large buffers that only one view or feature needs are allocated when it
+// becomes active and freed when it ends, instead of sitting in static RAM.
+// scopedBufferBytes counts what they hold right now; the device benchmark
+// reports it with the peak, and scripts/ram_audit.py lists what's still static.
+
+uint32_t scopedBufferBytes = 0;   // Bytes held by scoped buffers right now
+uint32_t scopedBufferPeak = 0;    // Most ever held at once
+
+/**
+ * Allocate a scoped buffer
+ * @return the buffer, or nullptr if the heap couldn't supply it
+ */
+void* scopedAlloc(size_t bytes) {
+  void* buffer = malloc(bytes);
+  if (buffer) {
+    scopedBufferBytes += bytes;
+    scopedBufferPeak = max(scopedBufferPeak, scopedBufferBytes);
+  }
+  return buffer;
+}
+
+/**
+ * Free a scoped buffer (no-op for nullptr) and clear the pointer
+ */
+template <typename T>
+void scopedFree(T*& buffer, size_t bytes) {
+  if (buffer) {
+    free(buffer);
+    scopedBufferBytes -= bytes;
+    buffer = nullptr;
+  }
+}
+
+// Dark-mode cartridge for the palette view (80×92 RGB565, ~14.7KB),
+// converted once per theme and held while the palette view is open
+uint16_t* cartridgeBuffer = nullptr;
+const ThemeColors* cartridgeBufferTheme = nullptr;
+
+/**
+ * Free the palette view's cartridge buffer
+ */
+void releaseCartridgeBuffer() {
+  scopedFree(cartridgeBuffer, CARTRIDGE_WIDTH * CARTRIDGE_HEIGHT * sizeof(uint16_t));
+  cartridgeBufferTheme = nullptr;
+}
+
 // ============================================================================
 // SKETCH HELPER FUNCTIONS
 // ============================================================================
@@ -748,6 +1286,123 @@ uint16_t getActiveSketchPixelColor(uint8_t pixelIndex) {
 // SD CARD FUNCTIONS
 // ============================================================================
 
+/**
+ * Get the sketch ID from a filename ("sketch_42.dat" → 42)
+ * @return ID, or 0 if the name isn't a sketch file
+ */
+unsigned long sketchIdFromFilename(const String& filename) {
+  if (!filename.startsWith("sketch_") || !filename.endsWith(".dat")) {
+    return 0;
+  }
+  int underscorePos = filename.indexOf('_');
+  int dotPos = filename.lastIndexOf('.');
+  if (underscorePos < 0 || dotPos <= underscorePos) {
+    return 0;
+  }
+  return filename.substring(underscorePos + 1, dotPos).toInt();
+}
+
+/**
+ * Folder holding a sketch ID, e.g. 300 → "/bitmap16dx/sketches/001"
+ */
+String sketchShardPath(unsigned long id) {
+  char shard[12];
+  snprintf(shard, sizeof(shard), "/%03lu", id / SKETCHES_PER_SHARD);
+  return String(sketchRoot) + shard;
+}
+
+/**
+ * Full path of a sketch file, e.g. "sketch_300.dat" → "/bitmap16dx/sketches/001/sketch_300.dat"
+ */
+String sketchPath(const String& filename) {
+  return sketchShardPath(sketchIdFromFilename(filename)) + "/" + filename;
+}
+
+/**
+ * Create the shard folder for a sketch ID if it doesn't exist yet
+ */
+bool ensureSketchShard(unsigned long id) {
+  String shard = sketchShardPath(id);
+  return SD.exists(shard.c_str()) || SD.mkdir(shard.c_str());
+}
+
+/**
+ * Strip any directory part from a File's name
+ * (the ESP32 SD library may return a full path or just the name)
+ */
+String fileBaseName(File& file) {
+  String name = String(file.name());
+  int lastSlash = name.lastIndexOf('/');
+  if (lastSlash >= 0) {
+    name = name.substring(lastSlash + 1);
+  }
+  return name;
+}
+
+/**
+ * Call fn(file, filename, id) for every sketch file in every shard folder
+ */
+template <typename Fn>
+void forEachSketchFile(Fn fn) {
+  File root = SD.open(sketchRoot);
+  if (!root || !root.isDirectory()) {
+    return;
+  }
+
+  File shard = root.openNextFile();
+  while (shard) {
+    if (shard.isDirectory()) {
+      File file = shard.openNextFile();
+      while (file) {
+        if (!file.isDirectory()) {
+          String filename = fileBaseName(file);
+          unsigned long id = sketchIdFromFilename(filename);
+          if (id > 0) {
+            fn(file, filename, id);
+          }
+        }
+        file = shard.openNextFile();
+      }
+    }
+    shard = root.openNextFile();
+  }
+  root.close();
+}
+
+/**
+ * Move sketches sitting directly in /bitmap16dx/sketches (older firmware,
+ * or copied over from a computer) into their shard folders.
+ * Only the top-level folder is listed, so this is cheap once migrated.
+ */
+void migrateSketchesToShards() {
+  File root = SD.open(SKETCH_DIR);
+  if (!root || !root.isDirectory()) {
+    return;
+  }
+
+  // Collect names first - renaming while iterating a directory is unreliable
+  std::vector<String> looseFiles;
+  File file = root.openNextFile();
+  while (file) {
+    if (!file.isDirectory()) {
+      String filename = fileBaseName(file);
+      if (sketchIdFromFilename(filename) > 0) {
+        looseFiles.push_back(filename);
+      }
+    }
+    file = root.openNextFile();
+  }
+  root.close();
+
+  for (const String& filename : looseFiles) {
+    String from = String(SKETCH_DIR) + "/" + filename;
+    String to = sketchPath(filename);
+    if (ensureSketchShard(sketchIdFromFilename(filename)) && !SD.exists(to.c_str())) {
+      SD.rename(from.c_str(), to.c_str());
+    }
+  }
+}
+
 /**
  * Initialize SD card - set up SPI and mount the SD card
  * This function initializes the SD card with retry logic for reliability
@@ -788,8 +1443,8 @@ bool initSDCard() {
         if (!SD.exists("/bitmap16dx")) {
           SD.mkdir("/bitmap16dx");
         }
-        if (!SD.exists("/bitmap16dx/sketches")) {
-          SD.mkdir("/bitmap16dx/sketches");
+        if (!SD.exists(SKETCH_DIR)) {
+          SD.mkdir(SKETCH_DIR);
         }
         if (!SD.exists("/bitmap16dx/exports")) {
           SD.mkdir("/bitmap16dx/exports");
@@ -802,6 +1457,12 @@ bool initSDCard() {
         if (!SD.exists("/bitmap16dx/palettes")) {
           SD.mkdir("/bitmap16dx/palettes");
         }
+        if (!SD.exists(COLLECTION_DIR)) {
+          SD.mkdir(COLLECTION_DIR);
+        }
+
+        // Move any unsharded sketches into their ID folders
+        migrateSketchesToShards();
 
         // SD card is ready
         sdCardAvailable = true;
@@ -821,3835 +1482,10770 @@ bool initSDCard() {
 }
 
 /**
- * Save a sketch to SD card
- * Path: /bitmap16dx/sketches/sketch_TIMESTAMP.dat
- *
- * File format:
- * - 1 byte: format version
- * - 1 byte: gridSize (8 or 16)
- * - 1 byte: paletteSize (8 or 16)
- * - 32 bytes: palette colors (16 colors × 2 bytes RGB565)
- * - 256 bytes: pixel data (16×16 indexed bitmap)
- * Total: 291 bytes
- *
- * Returns true if successful, false if failed
- */
-/**
- * Load list of all saved sketches from SD card
- * Populates sketchList vector with sketch filenames and timestamps
- * Sorted by timestamp (newest first)
+ * Read a block of a sketch file and count its bytes in sketchReadStats
+ * (the operation reading it counts itself once in reads)
+ * @return true if all requested bytes were read
  */
-void loadSketchListFromSD() {
-  sketchList.clear();
-
-  if (!sdCardAvailable && !initSDCard()) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
-    return;
+bool readSketchBytes(File& file, uint32_t offset, uint8_t* buf, uint32_t length, SketchReadKind kind) {
+  if (!file.seek(offset)) {
+    return false;
   }
+  size_t got = file.read(buf, length);
+  sketchReadStats[kind].bytes += got;
+  return got == length;
+}
 
-  // Quick card check
-  if (SD.cardType() == CARD_NONE) {
-    sdCardAvailable = false;
-    setStatusMessage(StatusMsg::SD_NOT_READY);
-    return;
-  }
+uint32_t readBE32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
 
-  // Open /bitmap16dx/sketches directory
-  File root = SD.open("/bitmap16dx/sketches");
-  if (!root || !root.isDirectory()) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
-    return;
+void writeBE32(uint8_t* p, uint32_t value) {
+  p[0] = (value >> 24) & 0xFF;
+  p[1] = (value >> 16) & 0xFF;
+  p[2] = (value >> 8) & 0xFF;
+  p[3] = value & 0xFF;
+}
+
+// ============================================================================
+// PALETTE FINGERPRINTS
+// ============================================================================
+// A palette's fingerprint is a 64-bit FNV-1a hash of its 16 colors. Catalog
+// fingerprints are computed when the catalog is built and kept in a small
+// open-addressed index, so finding the catalog entry for a sketch's palette
+// is a hash and a probe or two instead of a 16-color compare per entry.
+// Sketch files store the fingerprint in INFO, so the memory view can group
+// sketches by palette without reading their palettes.
+
+/**
+ * 64-bit FNV-1a over the 16 palette colors (high byte first)
+ */
+uint64_t paletteFingerprint(const uint16_t* colors) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (int i = 0; i < 16; i++) {
+    uint16_t color = pgm_read_word(&colors[i]);
+    hash = (hash ^ (color >> 8)) * 0x100000001B3ULL;
+    hash = (hash ^ (color & 0xFF)) * 0x100000001B3ULL;
   }
+  return hash;
+}
 
-  // Iterate through all files
-  File file = root.openNextFile();
-  while (file) {
-    if (!file.isDirectory()) {
-      String filename = String(file.name());
-
-      // ESP32 SD library might return full path or just filename
-      // Extract just the filename if it contains a path
-      int lastSlash = filename.lastIndexOf('/');
-      if (lastSlash >= 0) {
-        filename = filename.substring(lastSlash + 1);
-      }
-
-      // Check if it matches "sketch_XXXXXXXXXX.dat" pattern
-      if (filename.startsWith("sketch_") && filename.endsWith(".dat")) {
-        // Extract timestamp from filename
-        // Format: sketch_1234567890.dat
-        //         0123456789...
-        int underscorePos = filename.indexOf('_');
-        int dotPos = filename.lastIndexOf('.');
-
-        if (underscorePos >= 0 && dotPos > underscorePos) {
-          String timestampStr = filename.substring(underscorePos + 1, dotPos);
-          unsigned long timestamp = timestampStr.toInt();
-
-          // Verify file size is correct (290 or 291 bytes) and timestamp is valid
-          if ((file.size() == SKETCH_FILE_SIZE_V1 || file.size() == SKETCH_FILE_SIZE_V2) && timestamp > 0) {
-            SketchInfo info;
-            info.filename = filename;
-            info.timestamp = timestamp;
-            info.dataLoaded = false;  // Will load data on demand
-            sketchList.push_back(info);
-          }
-        }
-      }
+/**
+ * Recompute catalog fingerprints and the lookup index (after the catalog changes)
+ */
+void rebuildPaletteIndex() {
+  memset(paletteIndexSlots, 0, sizeof(paletteIndexSlots));
+  for (uint8_t p = 0; p < totalPaletteCount; p++) {
+    allPaletteFingerprints[p] = paletteFingerprint(allPalettes[p]);
+    uint8_t slot = allPaletteFingerprints[p] & (PALETTE_INDEX_SLOTS - 1);
+    while (paletteIndexSlots[slot] != 0) {
+      slot = (slot + 1) & (PALETTE_INDEX_SLOTS - 1);
     }
-
-    file = root.openNextFile();
+    paletteIndexSlots[slot] = p + 1;
   }
+}
 
-  root.close();
+/**
+ * Find the catalog entry with a given fingerprint
+ * @return catalog index (first match), or -1 if the palette isn't in the catalog
+ */
+int findPaletteByFingerprint(uint64_t fingerprint) {
+  uint8_t slot = fingerprint & (PALETTE_INDEX_SLOTS - 1);
+  while (paletteIndexSlots[slot] != 0) {
+    uint8_t p = paletteIndexSlots[slot] - 1;
+    if (allPaletteFingerprints[p] == fingerprint) {
+      return p;
+    }
+    slot = (slot + 1) & (PALETTE_INDEX_SLOTS - 1);
+  }
+  return -1;
+}
 
-  // Sort by timestamp (newest first)
-  std::sort(sketchList.begin(), sketchList.end(),
-            [](const SketchInfo& a, const SketchInfo& b) {
-              return a.timestamp > b.timestamp;
-            });
+/**
+ * Decode a big-endian RGB565 palette (32 bytes) into sketch.paletteColors
+ */
+void decodeSketchPalette(const uint8_t* data, Sketch& sketch) {
+  for (int i = 0; i < 16; i++) {
+    sketch.paletteColors[i] = (data[i * 2] << 8) | data[i * 2 + 1];
+  }
 }
 
 /**
- * Save active sketch to SD card
- * Saves to existing file if already saved, or creates new timestamped file
+ * Work out where each part of a sketch file lives.
+ * Legacy files (v1/v2) are recognised by size alone and cost no reads.
+ * Chunked files (v3, always larger than 291 bytes) read the header, TOC and INFO chunk.
  *
- * File format (290 bytes):
- * - 1 byte: gridSize (8 or 16)
- * - 1 byte: paletteSize (8 or 16)
- * - 32 bytes: palette colors (16 × 2 bytes RGB565, big endian)
- * - 256 bytes: pixel data (16×16 indexed bitmap)
- *
- * Returns true if successful, false if failed
+ * @param file Open sketch file
+ * @param index Filled with chunk locations and the INFO fields
+ * @return true if the file is a valid sketch
  */
-bool saveActiveSketchToSD() {
-  if (!sdCardAvailable && !initSDCard()) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
+bool readSketchFileIndex(File& file, SketchFileIndex& index) {
+  uint32_t fileSize = file.size();
+  sketchReadStats[SKETCH_READ_INDEX].reads++;
+
+  if (fileSize == SKETCH_FILE_SIZE_V1 || fileSize == SKETCH_FILE_SIZE_V2) {
+    // gridSize, paletteSize, palette and pixels are one contiguous block
+    uint32_t base = (fileSize == SKETCH_FILE_SIZE_V2) ? 1 : 0;
+    index.version = base ? 2 : 1;
+    index.gridSize = 0;
+    index.paletteSize = 0;
+    index.paletteOffset = base + 2;
+    index.previewOffset = base;
+    index.previewLength = SKETCH_FILE_SIZE_V1;
+    index.pixelsOffset = base;
+    index.paletteFingerprint = 0;
+    return true;
+  }
+
+  uint8_t header[SKETCH_HEADER_SIZE];
+  if (fileSize < SKETCH_HEADER_SIZE || !readSketchBytes(file, 0, header, SKETCH_HEADER_SIZE, SKETCH_READ_INDEX)) {
+    return false;
+  }
+  uint8_t chunkCount = header[5];
+  if (memcmp(header, SKETCH_MAGIC, 4) != 0 || header[4] != SKETCH_FORMAT_VERSION ||
+      chunkCount == 0 || chunkCount > SKETCH_MAX_CHUNKS) {
     return false;
   }
 
-  // Quick card check
-  if (SD.cardType() == CARD_NONE) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
-    sdCardAvailable = false;
+  uint8_t toc[SKETCH_MAX_CHUNKS * SKETCH_TOC_ENTRY_SIZE];
+  if (!readSketchBytes(file, SKETCH_HEADER_SIZE, toc, chunkCount * SKETCH_TOC_ENTRY_SIZE, SKETCH_READ_INDEX)) {
     return false;
   }
 
-  // Create directories if needed
-  if (!SD.exists("/bitmap16dx/sketches")) {
-    if (!SD.mkdir("/bitmap16dx/sketches")) {
-      setStatusMessage(StatusMsg::SD_NOT_READY);
-      sdCardAvailable = false;
+  uint32_t infoOffset = 0, infoLength = 0, paletteLength = 0, pixelsLength = 0;
+  index.previewLength = 0;
+  for (uint8_t i = 0; i < chunkCount; i++) {
+    const uint8_t* entry = toc + i * SKETCH_TOC_ENTRY_SIZE;
+    uint32_t offset = readBE32(entry + 4);
+    uint32_t length = readBE32(entry + 8);
+    if (offset > fileSize || length > fileSize - offset) {
       return false;
     }
-  }
-
-  // Generate filename (use existing if saving in place, or new timestamp if new)
-  String fullPath;
-  if (activeSketchFilename.length() > 0 && !activeSketchIsNew) {
-    // Save to existing file
-    fullPath = "/bitmap16dx/sketches/" + activeSketchFilename;
-  } else {
-    // Create new file with incrementing counter (persists across reboots)
-    preferences.begin("bitmap16dx", false);
-    unsigned long counter = preferences.getULong("sketchCounter", 0);
-
-    // If counter is 0 (first time or after NVS reset), scan existing files to find highest number
-    if (counter == 0 && SD.exists("/bitmap16dx/sketches")) {
-      File root = SD.open("/bitmap16dx/sketches");
-      if (root && root.isDirectory()) {
-        File file = root.openNextFile();
-        while (file) {
-          if (!file.isDirectory()) {
-            String filename = String(file.name());
-            int lastSlash = filename.lastIndexOf('/');
-            if (lastSlash >= 0) {
-              filename = filename.substring(lastSlash + 1);
-            }
 
-            // Extract number from "sketch_NNNN.dat"
-            if (filename.startsWith("sketch_") && filename.endsWith(".dat")) {
-              int underscorePos = filename.indexOf('_');
-              int dotPos = filename.lastIndexOf('.');
-              if (underscorePos >= 0 && dotPos > underscorePos) {
-                String numStr = filename.substring(underscorePos + 1, dotPos);
-                unsigned long num = numStr.toInt();
-                if (num > counter) {
-                  counter = num;
-                }
-              }
-            }
-          }
-          file = root.openNextFile();
-        }
-        root.close();
-      }
+    if (memcmp(entry, "INFO", 4) == 0) {
+      infoOffset = offset;
+      infoLength = length;
+    } else if (memcmp(entry, "PALT", 4) == 0) {
+      index.paletteOffset = offset;
+      paletteLength = length;
+    } else if (memcmp(entry, "PREV", 4) == 0) {
+      index.previewOffset = offset;
+      index.previewLength = length;
+    } else if (memcmp(entry, "PIXL", 4) == 0) {
+      index.pixelsOffset = offset;
+      pixelsLength = length;
     }
-
-    counter++;
-    preferences.putULong("sketchCounter", counter);
-    preferences.end();
-
-    fullPath = "/bitmap16dx/sketches/sketch_" + String(counter) + ".dat";
-    activeSketchFilename = "sketch_" + String(counter) + ".dat";
-
-    activeSketchIsNew = false;
+    // Other chunk types are ignored
   }
 
-  // Delete existing file if it exists (FILE_WRITE appends, we want to overwrite)
-  if (SD.exists(fullPath.c_str())) {
-    SD.remove(fullPath.c_str());
-  }
-
-  // Open file for writing
-  File file = SD.open(fullPath.c_str(), FILE_WRITE);
-  if (!file) {
-    setStatusMessage(StatusMsg::FAILED_TO_SAVE);
-    sdCardAvailable = false;
+  // 4 bytes, or 12 with the palette fingerprint
+  uint8_t info[12];
+  uint32_t infoRead = min(infoLength, (uint32_t)sizeof(info));
+  if (infoRead < 4 || !readSketchBytes(file, infoOffset, info, infoRead, SKETCH_READ_INDEX)) {
     return false;
   }
+  index.version = header[4];
+  index.gridSize = info[0];
+  index.paletteSize = info[1];
+  index.paletteFingerprint = (infoRead >= 12) ? ((uint64_t)readBE32(info + 4) << 32) | readBE32(info + 8) : 0;
+  if (paletteLength == 0) {
+    index.paletteOffset = index.previewOffset;  // Older file: the palette opens PREV
+  }
 
-  // Write data (291-byte format with version byte)
-  file.write(SKETCH_FORMAT_VERSION);  // Version 2
-  file.write(activeSketch.gridSize);
-  file.write(activeSketch.paletteSize);
+  return (index.gridSize == 8 || index.gridSize == 16) &&
+         index.paletteSize >= 1 && index.paletteSize <= 16 &&
+         (paletteLength >= 32 || index.previewLength >= 32 + (uint32_t)index.gridSize * index.gridSize) &&
+         pixelsLength == 256;
+}
 
-  for (int i = 0; i < 16; i++) {
-    file.write((activeSketch.paletteColors[i] >> 8) & 0xFF);  // High byte
-    file.write(activeSketch.paletteColors[i] & 0xFF);          // Low byte
-  }
-
-  for (int y = 0; y < 16; y++) {
-    for (int x = 0; x < 16; x++) {
-      file.write(activeSketch.pixels[y][x]);
-    }
+/**
+ * Read a whole legacy (v1/v2) sketch - palette and pixels share one block
+ */
+bool readLegacySketch(File& file, SketchFileIndex& index, Sketch& sketch, SketchReadKind kind) {
+  uint8_t data[SKETCH_FILE_SIZE_V1];
+  if (!readSketchBytes(file, index.previewOffset, data, sizeof(data), kind)) {
+    return false;
   }
-
-  file.close();
-  activeSketch.isEmpty = false;
-
-  setStatusMessage(StatusMsg::SAVED);
+  index.gridSize = data[0];
+  index.paletteSize = data[1];
+  sketch.gridSize = data[0];
+  sketch.paletteSize = data[1];
+  decodeSketchPalette(data + 2, sketch);
+  memcpy(sketch.pixels, data + 34, 256);
+  sketch.isEmpty = false;
   return true;
 }
 
 /**
- * Save active sketch as NEW copy (creates new timestamped file)
- * Used for Fn+S to duplicate current work
+ * Read the palette and the first rows of PIXL into data (32 + rows × 16
+ * bytes). One read when the palette sits right before PIXL, as it's written.
  */
-bool saveActiveSketchAsNew() {
-  // Force creation of new file regardless of existing filename
-  activeSketchFilename = "";
-  activeSketchIsNew = true;
-  return saveActiveSketchToSD();
+bool readSketchPaletteRows(File& file, const SketchFileIndex& index, uint8_t* data, uint8_t rows, SketchReadKind kind) {
+  if (index.paletteOffset + 32 == index.pixelsOffset) {
+    return readSketchBytes(file, index.paletteOffset, data, 32 + rows * 16, kind);
+  }
+  return readSketchBytes(file, index.paletteOffset, data, 32, kind) &&
+         readSketchBytes(file, index.pixelsOffset, data + 32, rows * 16, kind);
 }
 
 /**
- * Load a sketch from SD card into activeSketch
- * Filename should be just the filename, not full path
- * Returns true if successful, false if failed
+ * Read what a thumbnail needs: palette and visible pixels.
+ * Pixels outside the visible grid are left empty.
+ *
+ * @param file Open sketch file
+ * @param index Chunk locations from readSketchFileIndex()
+ * @param sketch Destination
+ * @return true if successful
  */
-bool loadSketchFromSD(String filename) {
-  if (!sdCardAvailable && !initSDCard()) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
+bool readSketchPreview(File& file, SketchFileIndex& index, Sketch& sketch) {
+  sketchReadStats[SKETCH_READ_PREVIEW].reads++;
+  if (index.version < 3) {
+    return readLegacySketch(file, index, sketch, SKETCH_READ_PREVIEW);
+  }
+
+  // Older files pack the visible pixels into PREV; current ones read the top rows of PIXL
+  uint8_t gridSize = index.gridSize;
+  uint8_t data[32 + 256];
+  bool packed = index.previewLength > 0;
+  bool ok = packed ? readSketchBytes(file, index.previewOffset, data, 32 + gridSize * gridSize, SKETCH_READ_PREVIEW)
+                   : readSketchPaletteRows(file, index, data, gridSize, SKETCH_READ_PREVIEW);
+  if (!ok) {
     return false;
   }
 
-  // Quick card check
-  if (SD.cardType() == CARD_NONE) {
-    sdCardAvailable = false;
-    setStatusMessage(StatusMsg::SD_NOT_READY);
-    return false;
+  sketch.gridSize = gridSize;
+  sketch.paletteSize = index.paletteSize;
+  decodeSketchPalette(data, sketch);
+  memset(sketch.pixels, 0, sizeof(sketch.pixels));
+  uint8_t stride = packed ? gridSize : 16;
+  for (uint8_t y = 0; y < gridSize; y++) {
+    memcpy(sketch.pixels[y], data + 32 + y * stride, gridSize);
   }
+  sketch.isEmpty = false;
+  return true;
+}
 
-  String fullPath = "/bitmap16dx/sketches/" + filename;
-
-  if (!SD.exists(fullPath.c_str())) {
-    setStatusMessage(StatusMsg::FILE_NOT_FOUND);
-    return false;
+/**
+ * Read a complete sketch for editing: palette and the full 16×16 pixel data.
+ *
+ * @param file Open sketch file
+ * @param index Chunk locations from readSketchFileIndex()
+ * @param sketch Destination
+ * @return true if successful
+ */
+bool readSketchFull(File& file, SketchFileIndex& index, Sketch& sketch) {
+  sketchReadStats[SKETCH_READ_FULL].reads++;
+  if (index.version < 3) {
+    return readLegacySketch(file, index, sketch, SKETCH_READ_FULL);
   }
 
-  File file = SD.open(fullPath.c_str(), FILE_READ);
-  if (!file) {
-    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+  uint8_t data[32 + 256];
+  if (!readSketchPaletteRows(file, index, data, 16, SKETCH_READ_FULL)) {
     return false;
   }
 
-  // Verify file size and detect format version
-  size_t fileSize = file.size();
-  uint8_t formatVersion = 1;  // Default to legacy format
-
-  if (fileSize == SKETCH_FILE_SIZE_V2) {
-    // New format with version byte
-    formatVersion = file.read();
-    if (formatVersion != SKETCH_FORMAT_VERSION) {
-      // Unknown version, try to read anyway but could fail
-      file.close();
-      setStatusMessage(StatusMsg::FILE_CORRUPT);
-      return false;
-    }
-  } else if (fileSize == SKETCH_FILE_SIZE_V1) {
-    // Legacy format without version byte (version 1)
-    formatVersion = 1;
-  } else {
-    // Invalid file size
-    file.close();
-    setStatusMessage(StatusMsg::FILE_CORRUPT);
-    return false;
-  }
+  sketch.gridSize = index.gridSize;
+  sketch.paletteSize = index.paletteSize;
+  decodeSketchPalette(data, sketch);
+  memcpy(sketch.pixels, data + 32, 256);
+  sketch.isEmpty = false;
+  return true;
+}
 
-  // Read data (same for both versions after version byte)
-  activeSketch.gridSize = file.read();
-  activeSketch.paletteSize = file.read();
+// v3 sketch file as written (INFO, PALT, PIXL)
+const size_t SKETCH_FILE_MAX_SIZE = SKETCH_HEADER_SIZE + 3 * SKETCH_TOC_ENTRY_SIZE + 12 + 32 + 256;
 
+/**
+ * Assemble a sketch file in the current (v3 chunked) format
+ *
+ * @param sketch Sketch to encode
+ * @param data Buffer of at least SKETCH_FILE_MAX_SIZE bytes
+ * @return the file size
+ */
+uint32_t buildSketchFile(const Sketch& sketch, uint8_t* data) {
+  const uint8_t chunkCount = 3;
+  const uint32_t infoLength = 12;
+  uint32_t infoOffset = SKETCH_HEADER_SIZE + chunkCount * SKETCH_TOC_ENTRY_SIZE;
+  uint32_t paletteOffset = infoOffset + infoLength;
+  uint32_t pixelsOffset = paletteOffset + 32;  // Right after the palette (see readSketchPaletteRows)
+  uint32_t totalSize = pixelsOffset + 256;
+
+  memset(data, 0, SKETCH_FILE_MAX_SIZE);
+
+  // Header
+  memcpy(data, SKETCH_MAGIC, 4);
+  data[4] = SKETCH_FORMAT_VERSION;
+  data[5] = chunkCount;
+
+  // TOC
+  const char* tags[chunkCount] = {"INFO", "PALT", "PIXL"};
+  const uint32_t offsets[chunkCount] = {infoOffset, paletteOffset, pixelsOffset};
+  const uint32_t lengths[chunkCount] = {infoLength, 32, 256};
+  for (uint8_t i = 0; i < chunkCount; i++) {
+    uint8_t* entry = data + SKETCH_HEADER_SIZE + i * SKETCH_TOC_ENTRY_SIZE;
+    memcpy(entry, tags[i], 4);
+    writeBE32(entry + 4, offsets[i]);
+    writeBE32(entry + 8, lengths[i]);
+  }
+
+  // INFO
+  data[infoOffset] = sketch.gridSize;
+  data[infoOffset + 1] = sketch.paletteSize;
+  uint64_t fingerprint = paletteFingerprint(sketch.paletteColors);
+  writeBE32(data + infoOffset + 4, fingerprint >> 32);
+  writeBE32(data + infoOffset + 8, fingerprint & 0xFFFFFFFF);
+
+  // PALT: palette (big endian)
+  uint8_t* palette = data + paletteOffset;
   for (int i = 0; i < 16; i++) {
-    uint8_t high = file.read();
-    uint8_t low = file.read();
-    activeSketch.paletteColors[i] = (high << 8) | low;
+    palette[i * 2] = (sketch.paletteColors[i] >> 8) & 0xFF;
+    palette[i * 2 + 1] = sketch.paletteColors[i] & 0xFF;
   }
 
-  for (int y = 0; y < 16; y++) {
-    for (int x = 0; x < 16; x++) {
-      activeSketch.pixels[y][x] = file.read();
-    }
+  // PIXL: full canvas (keeps pixels outside an 8×8 grid)
+  memcpy(data + pixelsOffset, sketch.pixels, 256);
+  return totalSize;
+}
+
+/**
+ * Write a sketch file in the current (v3 chunked) format, replacing any existing file.
+ * The file is assembled in RAM and written with a single call.
+ *
+ * @param path Full path on the SD card
+ * @param sketch Sketch to write
+ * @return true if the whole file was written
+ */
+bool writeSketchFile(const char* path, const Sketch& sketch) {
+  uint8_t data[SKETCH_FILE_MAX_SIZE];
+  uint32_t totalSize = buildSketchFile(sketch, data);
+
+  // Delete existing file if it exists (FILE_WRITE appends, we want to overwrite)
+  if (SD.exists(path)) {
+    SD.remove(path);
   }
 
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  size_t written = file.write(data, totalSize);
   file.close();
+  return written == totalSize;
+}
 
-  activeSketch.isEmpty = false;
-  activeSketchFilename = filename;
-  activeSketchIsNew = false;
+/**
+ * Load a list entry's preview (palette + visible pixels) into its cache.
+ * @return true if info.sketchData is valid
+ */
+bool loadSketchPreview(SketchInfo& info) {
+  if (info.dataLoaded) {
+    return true;
+  }
 
-  return true;
+  String fullPath = sketchPath(info.filename);
+  File file = SD.open(fullPath.c_str(), FILE_READ);
+  if (!file) {
+    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+    return false;
+  }
+
+  info.dataLoaded = readSketchPreview(file, info.fileIndex, info.sketchData);
+  file.close();
+  return info.dataLoaded;
 }
 
+// ============================================================================
+// COLLECTIONS
+// ============================================================================
+// A collection is a named subset of the library, stored as a small index of
+// sketch IDs in /bitmap16dx/collections/<name>.idx. Sketch files never move:
+// opening a collection reads only its index (and its members' files), and
+// moving or copying a sketch between collections only rewrites indexes.
+//
+// Index format (big-endian):
+//   4 bytes  magic "B16L"
+//   4 bytes  sketch count
+//   4 bytes  per sketch: ID, newest first (the memory view order, so opening
+//            a collection needs no sort)
+// IDs whose files have been deleted are dropped the next time it's opened.
+
+#define COLLECTION_NAME_MAX 16           // Characters
+#define MAX_COLLECTIONS 32
+
+const char COLLECTION_MAGIC[4] = {'B', '1', '6', 'L'};
+
+// Collection shown in the memory view and joined by new saves ("" = whole library)
+char activeCollection[COLLECTION_NAME_MAX + 1] = "";
 
-// PNG encoding buffer - use smaller buffer to avoid memory issues
-// Start with 16KB, may need to adjust based on actual compression
-#define PNG_BUFFER_SIZE 16384
+/**
+ * Index file path for a collection name
+ */
+String collectionPath(const char* name) {
+  return String(COLLECTION_DIR) + "/" + name + ".idx";
+}
 
 /**
- * Export current canvas as PNG to SD card
- *
- * @param scale If true, exports at 128×128. If false, exports at logical size (8×8 or 16×16)
- * @return true if successful, false if failed
+ * Read a collection's sketch IDs
+ * @return false if the index is missing or corrupt
  */
-bool exportCanvasToPNG(bool scale) {
-  // Ensure SD card is initialized
-  if (!sdCardAvailable && !initSDCard()) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
+bool readCollectionIndex(const char* name, std::vector<uint32_t>& ids) {
+  ids.clear();
+  File file = SD.open(collectionPath(name).c_str(), FILE_READ);
+  if (!file) {
     return false;
   }
+  uint8_t header[8];
+  bool ok = file.read(header, sizeof(header)) == sizeof(header) && memcmp(header, COLLECTION_MAGIC, 4) == 0;
+  uint32_t count = ok ? readBE32(header + 4) : 0;
+  if (ok && count * 4 != file.size() - sizeof(header)) {
+    ok = false;
+  }
+  if (ok) {
+    ids.resize(count);
+    uint8_t bytes[64];
+    for (uint32_t i = 0; i < count && ok; i += sizeof(bytes) / 4) {
+      uint32_t n = min(count - i, (uint32_t)(sizeof(bytes) / 4));
+      ok = file.read(bytes, n * 4) == n * 4;
+      for (uint32_t k = 0; k < n && ok; k++) {
+        ids[i + k] = readBE32(bytes + k * 4);
+      }
+    }
+  }
+  file.close();
+  if (!ok) {
+    ids.clear();
+  }
+  return ok;
+}
 
-  // Check free heap before starting
-  char heapMsg[40];
-  snprintf(heapMsg, sizeof(heapMsg), StatusMsg::FREE_HEAP_FMT, (int)(ESP.getFreeHeap() / 1024));
-  setStatusMessage(heapMsg);
-  delay(500);
-
-  setStatusMessage(StatusMsg::ALLOC_MEMORY);
-  delay(50);
-
-  // Allocate buffer for PNG output
-  uint8_t* pngBuffer = (uint8_t*)malloc(PNG_BUFFER_SIZE);
-  if (!pngBuffer) {
-    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+/**
+ * Write a collection's index (IDs newest first)
+ */
+bool writeCollectionIndex(const char* name, const std::vector<uint32_t>& ids) {
+  if (!SD.exists(COLLECTION_DIR) && !SD.mkdir(COLLECTION_DIR)) {
     return false;
   }
-
-  // Determine output size
-  int outputSize = scale ? 128 : currentGridSize;
-  int pixelScale = scale ? (128 / currentGridSize) : 1;
-
-  // Allocate line buffer (RGB, 3 bytes per pixel)
-  uint8_t* lineBuffer = (uint8_t*)malloc(outputSize * 3);
-  if (!lineBuffer) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+  File file = SD.open(collectionPath(name).c_str(), FILE_WRITE);
+  if (!file) {
     return false;
   }
+  uint8_t bytes[64];
+  memcpy(bytes, COLLECTION_MAGIC, 4);
+  writeBE32(bytes + 4, ids.size());
+  bool ok = file.write(bytes, 8) == 8;
+  for (size_t i = 0; i < ids.size() && ok; i += sizeof(bytes) / 4) {
+    size_t n = min(ids.size() - i, sizeof(bytes) / 4);
+    for (size_t k = 0; k < n; k++) {
+      writeBE32(bytes + k * 4, ids[i + k]);
+    }
+    ok = file.write(bytes, n * 4) == n * 4;
+  }
+  file.close();
+  return ok;
+}
 
-  setStatusMessage(StatusMsg::ENCODING);
-  delay(50);
+/**
+ * Add a sketch to a collection (creates the collection if needed)
+ */
+bool addToCollection(const char* name, uint32_t id) {
+  std::vector<uint32_t> ids;
+  readCollectionIndex(name, ids);
+  auto pos = std::lower_bound(ids.begin(), ids.end(), id, std::greater<uint32_t>());
+  if (pos != ids.end() && *pos == id) {
+    return true;  // Already a member
+  }
+  ids.insert(pos, id);
+  return writeCollectionIndex(name, ids);
+}
 
-  // Allocate PNG encoder on heap (it's ~100KB so can't be on stack)
-  PNGENC* png = new PNGENC();
-  if (!png) {
-    free(lineBuffer);
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::PNG_ALLOC_FAIL);
+/**
+ * Remove a sketch from a collection
+ */
+bool removeFromCollection(const char* name, uint32_t id) {
+  std::vector<uint32_t> ids;
+  if (!readCollectionIndex(name, ids)) {
     return false;
   }
-
-  int rc = png->open(pngBuffer, PNG_BUFFER_SIZE);
-  if (rc != PNG_SUCCESS) {
-    delete png;
-    free(lineBuffer);
-    free(pngBuffer);
-    char msg[40];
-    snprintf(msg, sizeof(msg), StatusMsg::PNG_OPEN_ERR_FMT, rc);
-    setStatusMessage(msg);
-    return false;
+  auto pos = std::lower_bound(ids.begin(), ids.end(), id, std::greater<uint32_t>());
+  if (pos == ids.end() || *pos != id) {
+    return true;
   }
+  ids.erase(pos);
+  return writeCollectionIndex(name, ids);
+}
 
-  // Reallocate line buffer for RGBA (4 bytes per pixel)
-  free(lineBuffer);
-  lineBuffer = (uint8_t*)malloc(outputSize * 4);
-  if (!lineBuffer) {
-    png->close();  // Close PNG before deletion since open() succeeded
-    delete png;
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
-    return false;
+/**
+ * List collection names (alphabetical)
+ * @return number of names written
+ */
+int listCollections(char names[][COLLECTION_NAME_MAX + 1], int maxNames) {
+  int count = 0;
+  File dir = SD.open(COLLECTION_DIR);
+  if (!dir || !dir.isDirectory()) {
+    return 0;
   }
-
-  // Initialize PNG with RGBA format for transparency support (compression level 3 for lower memory usage)
-  rc = png->encodeBegin(outputSize, outputSize, PNG_PIXEL_TRUECOLOR_ALPHA, 32, NULL, 3);
-  if (rc != PNG_SUCCESS) {
-    png->close();
-    delete png;
-    free(lineBuffer);
-    free(pngBuffer);
-    char msg[40];
-    snprintf(msg, sizeof(msg), StatusMsg::PNG_INIT_ERR_FMT, rc);
-    setStatusMessage(msg);
-    return false;
+  File file = dir.openNextFile();
+  while (file && count < maxNames) {
+    String name = fileBaseName(file);
+    if (!file.isDirectory() && name.endsWith(".idx") && name.length() - 4 <= COLLECTION_NAME_MAX) {
+      strcpy(names[count++], name.substring(0, name.length() - 4).c_str());
+    }
+    file.close();
+    file = dir.openNextFile();
   }
+  dir.close();
+  qsort(names, count, sizeof(names[0]), [](const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+  });
+  return count;
+}
+
+/**
+ * Show a collection in the memory view (and join new saves to it)
+ * @param name collection name, or "" for the whole library
+ */
+void setActiveCollection(const char* name) {
+  strncpy(activeCollection, name, COLLECTION_NAME_MAX);
+  activeCollection[COLLECTION_NAME_MAX] = '\0';
+  preferences.begin("bitmap16dx", false);
+  preferences.putString("collection", activeCollection);
+  preferences.end();
+}
 
-  // Write each line of the PNG
-  for (int y = 0; y < outputSize; y++) {
-    int canvasY = y / pixelScale;  // Map to canvas coordinate
+// Collection picker overlay in the memory view (K opens, M moves, Fn+M copies)
+enum CollectionPickAction : uint8_t {
+  PICK_OPEN,   // Browse the chosen collection
+  PICK_MOVE,   // Move the focused sketch there
+  PICK_COPY    // Also add the focused sketch there
+};
 
-    for (int x = 0; x < outputSize; x++) {
-      int canvasX = x / pixelScale;  // Map to canvas coordinate
+struct CollectionPicker {
+  bool open;
+  CollectionPickAction action;
+  char (*names)[COLLECTION_NAME_MAX + 1];  // Scoped while the picker is open
+  int count;
+  int cursor;            // 0 = all sketches, 1..count = names, count + 1 = new
+  bool naming;           // Typing a new collection name
+  char newName[COLLECTION_NAME_MAX + 1];
+};
 
-      // Get color index from canvas
-      uint8_t colorIndex = canvas[canvasY][canvasX];
-      uint8_t r, g, b, a;
+CollectionPicker collectionPicker = {};
 
-      if (colorIndex == 0) {
-        // Transparent pixel
-        r = g = b = 0;
-        a = 0;  // Fully transparent
-      } else {
-        // Get palette color from the active sketch's palette
-        uint16_t color565 = activeSketch.paletteColors[colorIndex - 1];
-
-        if (exportRGB565) {
-          // Export as RGB565 (simple bit shift, faster but less accurate)
-          r = ((color565 >> 11) & 0x1F) << 3;  // 5-bit red → 8-bit
-          g = ((color565 >> 5) & 0x3F) << 2;   // 6-bit green → 8-bit
-          b = (color565 & 0x1F) << 3;          // 5-bit blue → 8-bit
-          a = 255;  // Fully opaque
-        } else {
-          // Export as RGB888 (using proper conversion with bit expansion)
-          r = ((color565 >> 11) & 0x1F);
-          r = (r << 3) | (r >> 2);  // Expand 5 bits to 8 bits
-          g = ((color565 >> 5) & 0x3F);
-          g = (g << 2) | (g >> 4);  // Expand 6 bits to 8 bits
-          b = (color565 & 0x1F);
-          b = (b << 3) | (b >> 2);  // Expand 5 bits to 8 bits
-          a = 255;  // Fully opaque
-        }
-      }
-
-      // Write RGBA to buffer
-      lineBuffer[x * 4 + 0] = r;
-      lineBuffer[x * 4 + 1] = g;
-      lineBuffer[x * 4 + 2] = b;
-      lineBuffer[x * 4 + 3] = a;
-    }
-
-    // Write this line to PNG
-    rc = png->addLine(lineBuffer);
-    if (rc != PNG_SUCCESS) {
-      png->close();
-      delete png;
-      free(lineBuffer);
-      free(pngBuffer);
-      char msg[40];
-      snprintf(msg, sizeof(msg), StatusMsg::ADDLINE_ERR_FMT, rc);
-      setStatusMessage(msg);
-      return false;
+/**
+ * Open the picker with the collections currently on the card
+ * @return false if the name list couldn't be allocated
+ */
+bool openCollectionPicker(CollectionPickAction action) {
+  collectionPicker.names = (char (*)[COLLECTION_NAME_MAX + 1])scopedAlloc(MAX_COLLECTIONS * (COLLECTION_NAME_MAX + 1));
+  if (!collectionPicker.names) {
+    return false;
+  }
+  collectionPicker.count = listCollections(collectionPicker.names, MAX_COLLECTIONS);
+  collectionPicker.action = action;
+  collectionPicker.cursor = 0;
+  for (int i = 0; i < collectionPicker.count; i++) {
+    if (strcmp(collectionPicker.names[i], activeCollection) == 0) {
+      collectionPicker.cursor = i + 1;  // Start on the collection being browsed
     }
   }
+  collectionPicker.naming = false;
+  collectionPicker.newName[0] = '\0';
+  collectionPicker.open = true;
+  return true;
+}
 
-  // Close PNG and get final size
-  int pngSize = png->close();
-  delete png;
-  free(lineBuffer);
+void closeCollectionPicker() {
+  scopedFree(collectionPicker.names, MAX_COLLECTIONS * (COLLECTION_NAME_MAX + 1));
+  collectionPicker.open = false;
+}
 
-  if (pngSize <= 0) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::PNG_ENCODE_FAIL);
-    return false;
+// ============================================================================
+// INCREMENTAL SKETCH LIST SCAN
+// ============================================================================
+// The memory view opens straight away and fills sketchList over the next
+// frames. Each stepSketchScan() call reads directory entries for up to its
+// time budget, then merges that batch into the list (newest first). Entries
+// already in the list only move when newer ones are merged in front of them.
+
+#define SKETCH_SCAN_SLICE_MS 8  // Scan time per memory view frame
+
+struct SketchScanState {
+  File root;                    // Library folder
+  File shard;                   // Shard folder being listed (closed between shards)
+  bool active;
+  unsigned long startMs;
+  char collection[COLLECTION_NAME_MAX + 1];  // Listing this collection's members ("" = whole library)
+  std::vector<uint32_t> ids;    // Collection members, as read when the scan started
+  size_t nextId;
+  std::vector<uint32_t> missing;  // Members whose file no longer exists (newest first)
+};
+
+// Memory view open timing (Fn+I in the memory view)
+struct SketchScanStats {
+  unsigned long firstFrameMs;   // Enter → first frame on screen
+  unsigned long completeMs;     // Enter → every sketch listed
+  uint32_t count;
+};
+
+SketchScanState memoryScan;     // Scan feeding the memory view
+SketchScanStats lastSketchScanStats = {0, 0, 0};
+
+bool memoryGroupByPalette = false;  // G in memory view: group sketches by palette
+
+/**
+ * Palette group of a listed sketch: its catalog index, or past the end of
+ * the catalog for palettes that aren't in it (and files without a fingerprint)
+ */
+int sketchPaletteGroup(const SketchInfo& info) {
+  int palette = info.fileIndex.paletteFingerprint ? findPaletteByFingerprint(info.fileIndex.paletteFingerprint) : -1;
+  return palette >= 0 ? palette : 32;
+}
+
+/**
+ * sketchList ordering: newest first, or newest first within each palette
+ * group (catalog order) when grouping by palette
+ */
+bool sketchNewerThan(const SketchInfo& a, const SketchInfo& b) {
+  if (memoryGroupByPalette) {
+    int groupA = sketchPaletteGroup(a);
+    int groupB = sketchPaletteGroup(b);
+    if (groupA != groupB) {
+      return groupA < groupB;
+    }
   }
+  return a.timestamp > b.timestamp;
+}
 
-  setStatusMessage(StatusMsg::WRITING_FILE);
-  delay(50);
+/**
+ * Binary search sketchList[lo, hi) - newest first - for a sketch ID
+ * @return list index, or -1 if not in the range
+ */
+int findSketchIndexIn(unsigned long id, int lo, int hi) {
+  int end = hi;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (sketchList[mid].timestamp > id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return (lo < end && sketchList[lo].timestamp == id) ? lo : -1;
+}
 
-  // Create exports directory if it doesn't exist
-  if (!SD.exists("/bitmap16dx/exports")) {
-    SD.mkdir("/bitmap16dx/exports");
+/**
+ * Search sketchList for a sketch ID. Grouped by palette, the list is newest
+ * first within each group's run, so each run (at most 33) is binary searched.
+ * @return list index, or -1 if not listed
+ */
+int findSketchIndex(unsigned long id) {
+  int size = sketchList.size();
+  if (!memoryGroupByPalette) {
+    return findSketchIndexIn(id, 0, size);
+  }
+
+  int start = 0;
+  while (start < size) {
+    int group = sketchPaletteGroup(sketchList[start]);
+    // End of this group's run
+    int lo = start + 1;
+    int hi = size;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (sketchPaletteGroup(sketchList[mid]) == group) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    int index = findSketchIndexIn(id, start, lo);
+    if (index >= 0) {
+      return index;
+    }
+    start = lo;
   }
+  return -1;
+}
 
-  // Generate filename with counter
-  int exportNum = 0;
-  char filename[40];
-  do {
-    snprintf(filename, sizeof(filename), "/bitmap16dx/exports/dx_%04d.png", exportNum);
-    exportNum++;
-  } while (SD.exists(filename) && exportNum < 10000);
+/**
+ * Merge a batch of new entries into sketchList, keeping it in order.
+ * Merges from the back, so only entries behind the insertion points move.
+ */
+void mergeSketchBatch(std::vector<SketchInfo>& batch) {
+  if (batch.empty()) {
+    return;
+  }
+  std::sort(batch.begin(), batch.end(), sketchNewerThan);
 
-  if (exportNum >= 10000) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::TOO_MANY_EXPORTS);
-    return false;
+  int read = sketchList.size() - 1;
+  int from = batch.size() - 1;
+  sketchList.resize(sketchList.size() + batch.size());
+  int write = sketchList.size() - 1;
+  while (from >= 0) {
+    if (read >= 0 && sketchNewerThan(batch[from], sketchList[read])) {
+      sketchList[write--] = std::move(sketchList[read--]);
+    } else {
+      sketchList[write--] = std::move(batch[from--]);
+    }
   }
+  batch.clear();
+}
 
-  // Write to SD card
-  File file = SD.open(filename, FILE_WRITE);
+/**
+ * Add one sketch file to sketchList at its sorted position
+ * @return true if the file is a readable sketch
+ */
+bool addSketchToList(const String& filename) {
+  File file = SD.open(sketchPath(filename).c_str(), FILE_READ);
   if (!file) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
     return false;
   }
-
-  size_t written = file.write(pngBuffer, pngSize);
+  SketchInfo info;
+  bool ok = readSketchFileIndex(file, info.fileIndex);
   file.close();
-  free(pngBuffer);
-
-  if (written != (size_t)pngSize) {
-    setStatusMessage(StatusMsg::WRITE_INCOMPLETE);
+  if (!ok) {
     return false;
   }
 
-  setStatusMessage(StatusMsg::EXPORTED);
+  info.filename = filename;
+  info.timestamp = sketchIdFromFilename(filename);
+  info.dataLoaded = false;
+  auto pos = std::upper_bound(sketchList.begin(), sketchList.end(), info, sketchNewerThan);
+  sketchList.insert(pos, info);
   return true;
 }
 
-#if ENABLE_SCREENSHOTS
 /**
- * Take a screenshot of the full display (240×135 pixels)
- * Saves to /bitmap16dx/screenshots/screenshot_XXXX.png
- *
- * This captures the entire display buffer including UI elements,
- * not just the canvas area.
- *
- * @return true if successful, false if failed
+ * Free sketchList and its preview caches (rebuilt by the next scan)
  */
-bool takeScreenshot() {
-  // Ensure SD card is initialized
-  if (!sdCardAvailable && !initSDCard()) {
-    setStatusMessage(StatusMsg::SD_NOT_READY);
-    return false;
-  }
-
-  // Check free heap before starting
-  char heapMsg[40];
-  snprintf(heapMsg, sizeof(heapMsg), StatusMsg::FREE_HEAP_FMT, (int)(ESP.getFreeHeap() / 1024));
-  setStatusMessage(heapMsg);
-  delay(500);
+void releaseSketchList() {
+  std::vector<SketchInfo>().swap(sketchList);
+}
 
-  setStatusMessage(StatusMsg::SCREENSHOT);
-  delay(50);
+/**
+ * Stop a scan and release its directory handles
+ */
+void stopSketchScan(SketchScanState& scan) {
+  scan.shard.close();
+  scan.root.close();
+  std::vector<uint32_t>().swap(scan.ids);
+  std::vector<uint32_t>().swap(scan.missing);
+  scan.active = false;
+}
 
-  // Display dimensions
-  const int displayWidth = 240;
-  const int displayHeight = 135;
+/**
+ * Clear sketchList and start listing the library (or one collection) from the top
+ * @param collection collection to list, or "" for every sketch
+ * @return false if the card or library folder isn't available
+ */
+bool startSketchScan(SketchScanState& scan, const char* collection = "") {
+  stopSketchScan(scan);
+  sketchList.clear();
 
-  // Allocate buffer for PNG output (16KB should be enough for 240×135)
-  uint8_t* pngBuffer = (uint8_t*)malloc(PNG_BUFFER_SIZE);
-  if (!pngBuffer) {
-    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
     return false;
   }
 
-  // Allocate line buffer for RGBA (4 bytes per pixel)
-  uint8_t* lineBuffer = (uint8_t*)malloc(displayWidth * 4);
-  if (!lineBuffer) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+  // Quick card check
+  if (SD.cardType() == CARD_NONE) {
+    sdCardAvailable = false;
+    setStatusMessage(StatusMsg::SD_NOT_READY);
     return false;
   }
 
-  // Allocate temporary buffer for reading RGB565 line from display
-  uint16_t* displayLine = (uint16_t*)malloc(displayWidth * 2);
-  if (!displayLine) {
-    free(lineBuffer);
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
-    return false;
+  strncpy(scan.collection, collection, COLLECTION_NAME_MAX);
+  scan.collection[COLLECTION_NAME_MAX] = '\0';
+  if (scan.collection[0] != '\0') {
+    // Only the collection's index is read up front (a missing index is an empty collection)
+    readCollectionIndex(scan.collection, scan.ids);
+    scan.nextId = 0;
+  } else {
+    scan.root = SD.open(sketchRoot);
+    if (!scan.root || !scan.root.isDirectory()) {
+      scan.root.close();
+      return false;
+    }
   }
+  scan.active = true;
+  scan.startMs = millis();
+  return true;
+}
 
-  setStatusMessage(StatusMsg::ENCODING);
-  delay(50);
-
-  // Allocate PNG encoder on heap
-  PNGENC* png = new PNGENC();
-  if (!png) {
-    free(displayLine);
-    free(lineBuffer);
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::PNG_ALLOC_FAIL);
+/**
+ * Read the next collection member into batch
+ * @return false once every member has been read
+ */
+bool scanNextCollectionMember(SketchScanState& scan, std::vector<SketchInfo>& batch) {
+  if (scan.nextId >= scan.ids.size()) {
     return false;
   }
-
-  int rc = png->open(pngBuffer, PNG_BUFFER_SIZE);
-  if (rc != PNG_SUCCESS) {
-    delete png;
-    free(displayLine);
-    free(lineBuffer);
-    free(pngBuffer);
-    char msg[40];
-    snprintf(msg, sizeof(msg), StatusMsg::PNG_OPEN_ERR_FMT, rc);
-    setStatusMessage(msg);
-    return false;
+  uint32_t id = scan.ids[scan.nextId++];
+  if (findSketchIndex(id) >= 0) {
+    return true;  // Added while the scan was running
   }
-
-  // Initialize PNG with RGBA format (compression level 3 for lower memory)
-  rc = png->encodeBegin(displayWidth, displayHeight, PNG_PIXEL_TRUECOLOR_ALPHA, 32, NULL, 3);
-  if (rc != PNG_SUCCESS) {
-    png->close();
-    delete png;
-    free(displayLine);
-    free(lineBuffer);
-    free(pngBuffer);
-    char msg[40];
-    snprintf(msg, sizeof(msg), StatusMsg::PNG_INIT_ERR_FMT, rc);
-    setStatusMessage(msg);
-    return false;
+  String filename = "sketch_" + String(id) + ".dat";
+  String path = sketchPath(filename);
+  File file = SD.open(path.c_str(), FILE_READ);
+  if (!file) {
+    // Only a sketch that's really gone leaves the collection, not one that failed to open
+    if (!SD.exists(path.c_str())) {
+      scan.missing.push_back(id);
+    }
+    return true;
+  }
+  SketchInfo info;
+  if (readSketchFileIndex(file, info.fileIndex)) {
+    info.filename = filename;
+    info.timestamp = id;
+    info.dataLoaded = false;
+    batch.push_back(info);
   }
+  file.close();
+  return true;
+}
 
-  // Read and encode each line from the display
-  for (int y = 0; y < displayHeight; y++) {
-    // Read one line of RGB565 pixels from the display
-    M5Cardputer.Display.readRect(0, y, displayWidth, 1, displayLine);
-
-    // Convert RGB565 to RGBA
-    for (int x = 0; x < displayWidth; x++) {
-      uint16_t color565 = displayLine[x];
-
-      // M5Stack display returns RGB565 in little-endian format
-      // Need to swap bytes: the data comes as [GGGBBBBB][RRRRRGGG]
-      // Swap to get proper RGB565: [RRRRRGGG][GGGBBBBB]
-      color565 = (color565 >> 8) | (color565 << 8);
-
-      // Convert RGB565 to RGB888
-      uint8_t r = ((color565 >> 11) & 0x1F);
-      r = (r << 3) | (r >> 2);  // Expand 5 bits to 8 bits
-      uint8_t g = ((color565 >> 5) & 0x3F);
-      g = (g << 2) | (g >> 4);  // Expand 6 bits to 8 bits
-      uint8_t b = (color565 & 0x1F);
-      b = (b << 3) | (b >> 2);  // Expand 5 bits to 8 bits
-
-      // Write RGBA to buffer (fully opaque)
-      lineBuffer[x * 4 + 0] = r;
-      lineBuffer[x * 4 + 1] = g;
-      lineBuffer[x * 4 + 2] = b;
-      lineBuffer[x * 4 + 3] = 255;  // Alpha
-    }
-
-    // Write this line to PNG
-    rc = png->addLine(lineBuffer);
-    if (rc != PNG_SUCCESS) {
-      png->close();
-      delete png;
-      free(displayLine);
-      free(lineBuffer);
-      free(pngBuffer);
-      char msg[40];
-      snprintf(msg, sizeof(msg), StatusMsg::ADDLINE_ERR_FMT, rc);
-      setStatusMessage(msg);
+/**
+ * Read the next library directory entry into batch
+ * @return false once every shard has been listed
+ */
+bool scanNextLibraryEntry(SketchScanState& scan, std::vector<SketchInfo>& batch) {
+  if (!scan.shard) {
+    scan.shard = scan.root.openNextFile();
+    if (!scan.shard) {
       return false;
     }
+    if (!scan.shard.isDirectory()) {
+      scan.shard.close();
+    }
+    return true;
   }
 
-  // Close PNG and get final size
-  int pngSize = png->close();
-  delete png;
-  free(displayLine);
-  free(lineBuffer);
+  File file = scan.shard.openNextFile();
+  if (!file) {
+    scan.shard.close();  // Shard done, move on to the next one
+    return true;
+  }
+  if (!file.isDirectory()) {
+    String filename = fileBaseName(file);
+    unsigned long id = sketchIdFromFilename(filename);
+    // Verify the file is a sketch (reads only the header and INFO chunk)
+    // (skipping sketches already added while the scan was running)
+    SketchInfo info;
+    if (id > 0 && findSketchIndex(id) < 0 && readSketchFileIndex(file, info.fileIndex)) {
+      info.filename = filename;
+      info.timestamp = id;
+      info.dataLoaded = false;  // Will load data on demand
+      batch.push_back(info);
+    }
+  }
+  file.close();
+  return true;
+}
 
-  if (pngSize <= 0) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::PNG_ENCODE_FAIL);
+/**
+ * List sketch files for up to budgetMs (at least one entry), then merge
+ * what was found into sketchList
+ * @return true while there is more to scan
+ */
+bool stepSketchScan(SketchScanState& scan, unsigned long budgetMs) {
+  if (!scan.active) {
     return false;
   }
 
-  setStatusMessage(StatusMsg::WRITING);
-  delay(50);
+  std::vector<SketchInfo> batch;
+  unsigned long start = millis();
+  bool finished = false;
+  do {
+    bool more = (scan.collection[0] != '\0') ? scanNextCollectionMember(scan, batch)
+                                             : scanNextLibraryEntry(scan, batch);
+    if (!more) {
+      finished = true;
+      break;
+    }
+  } while (millis() - start < budgetMs);
+
+  mergeSketchBatch(batch);
+
+  if (finished) {
+    if (!scan.missing.empty()) {
+      // Drop deleted sketches from the collection's index. It's read again
+      // rather than rewritten from scan.ids, so members added while the scan
+      // was running stay in.
+      std::vector<uint32_t> ids;
+      if (readCollectionIndex(scan.collection, ids)) {
+        auto gone = [&scan](uint32_t id) {
+          return std::binary_search(scan.missing.begin(), scan.missing.end(), id, std::greater<uint32_t>());
+        };
+        size_t count = ids.size();
+        ids.erase(std::remove_if(ids.begin(), ids.end(), gone), ids.end());
+        if (ids.size() != count) {
+          writeCollectionIndex(scan.collection, ids);
+        }
+      }
+    }
+    stopSketchScan(scan);
+  }
+  return !finished;
+}
+
+/**
+ * Load list of all saved sketches from SD card (blocking)
+ * Populates sketchList vector with sketch filenames and timestamps
+ * Sorted by timestamp (newest first)
+ */
+void loadSketchListFromSD() {
+  SketchScanState scan = {};
+  if (startSketchScan(scan)) {
+    while (stepSketchScan(scan, SKETCH_SCAN_SLICE_MS)) {
+    }
+  }
+}
+
+/**
+ * Highest sketch ID handed out so far (persists across reboots)
+ */
+unsigned long loadSketchCounter() {
+  preferences.begin("bitmap16dx", false);
+  unsigned long counter = preferences.getULong("sketchCounter", 0);
+  preferences.end();
 
-  // Create screenshots directory if it doesn't exist
-  if (!SD.exists("/bitmap16dx/screenshots")) {
-    SD.mkdir("/bitmap16dx/screenshots");
+  // If counter is 0 (first time or after NVS reset), scan existing files to find highest number
+  if (counter == 0) {
+    forEachSketchFile([&counter](File& file, const String& filename, unsigned long id) {
+      if (id > counter) {
+        counter = id;
+      }
+    });
   }
+  return counter;
+}
 
-  // Generate filename with counter
-  int screenshotNum = 0;
-  char filename[48];
-  do {
-    snprintf(filename, sizeof(filename), "/bitmap16dx/screenshots/screenshot_%04d.png", screenshotNum);
-    screenshotNum++;
-  } while (SD.exists(filename) && screenshotNum < 10000);
+/**
+ * Remember the highest sketch ID handed out
+ */
+void storeSketchCounter(unsigned long counter) {
+  preferences.begin("bitmap16dx", false);
+  preferences.putULong("sketchCounter", counter);
+  preferences.end();
+}
 
-  if (screenshotNum >= 10000) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::TOO_MANY_SHOTS);
+/**
+ * Save active sketch to SD card
+ * Saves to existing file if already saved, or creates new timestamped file
+ * Written in the chunked v3 format (see SKETCH_FORMAT_VERSION)
+ *
+ * Returns true if successful, false if failed
+ */
+bool saveActiveSketchToSD() {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
     return false;
   }
 
-  // Write to SD card
-  File file = SD.open(filename, FILE_WRITE);
-  if (!file) {
-    free(pngBuffer);
-    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+  // Quick card check
+  if (SD.cardType() == CARD_NONE) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    sdCardAvailable = false;
     return false;
   }
 
-  size_t written = file.write(pngBuffer, pngSize);
-  file.close();
-  free(pngBuffer);
+  // Create directories if needed
+  if (!SD.exists(sketchRoot)) {
+    if (!SD.mkdir(sketchRoot)) {
+      setStatusMessage(StatusMsg::SD_NOT_READY);
+      sdCardAvailable = false;
+      return false;
+    }
+  }
 
-  if (written != (size_t)pngSize) {
-    setStatusMessage(StatusMsg::WRITE_FAIL);
+  // Generate filename (use existing if saving in place, or new timestamp if new)
+  String fullPath;
+  unsigned long newId = 0;
+  if (activeSketchFilename.length() > 0 && !activeSketchIsNew) {
+    // Save to existing file
+    fullPath = sketchPath(activeSketchFilename);
+  } else {
+    // Create new file with incrementing counter (persists across reboots)
+    unsigned long counter = loadSketchCounter() + 1;
+    storeSketchCounter(counter);
+
+    activeSketchFilename = "sketch_" + String(counter) + ".dat";
+    fullPath = sketchPath(activeSketchFilename);
+    if (!ensureSketchShard(counter)) {
+      setStatusMessage(StatusMsg::FAILED_TO_SAVE);
+      return false;
+    }
+
+    activeSketchIsNew = false;
+    newId = counter;
+  }
+
+  if (!writeSketchFile(fullPath.c_str(), activeSketch)) {
+    setStatusMessage(StatusMsg::FAILED_TO_SAVE);
+    sdCardAvailable = false;
     return false;
   }
 
-  setStatusMessage(StatusMsg::SCREENSHOT_OK);
+  activeSketch.isEmpty = false;
+
+  // New sketches land in the collection being browsed
+  if (newId > 0 && activeCollection[0] != '\0') {
+    addToCollection(activeCollection, newId);
+  }
+
+  setStatusMessage(StatusMsg::SAVED);
   return true;
 }
-#endif // ENABLE_SCREENSHOTS
 
 /**
- * Draw the current status message if it's still active
+ * Save active sketch as NEW copy (creates new timestamped file)
+ * Used for Fn+S to duplicate current work
  */
-void drawStatusMessage() {
-  // Check if we have an active message
-  if (statusMessage[0] != '\0') {
-    if (millis() - statusMessageTime < STATUS_DISPLAY_DURATION) {
-      // Message is still active - check if it changed
-      if (strcmp(statusMessage, lastDrawnMessage) != 0) {
-        // New message - trigger redraw to replace old one
-        statusMessageJustCleared = true;
-        strncpy(lastDrawnMessage, statusMessage, sizeof(lastDrawnMessage) - 1);
-        lastDrawnMessage[sizeof(lastDrawnMessage) - 1] = '\0';
-      }
-    } else {
-      // Message expired - trigger clear
-      if (lastDrawnMessage[0] != '\0') {
-        statusMessageJustCleared = true;
-        lastDrawnMessage[0] = '\0';
-      }
-      statusMessage[0] = '\0';
-    }
-  }
+bool saveActiveSketchAsNew() {
+  // Force creation of new file regardless of existing filename
+  activeSketchFilename = "";
+  activeSketchIsNew = true;
+  return saveActiveSketchToSD();
 }
 
 /**
- * Draw battery icon below fill icon
- * Only redraws when percentage changes
- * Checks battery level every 30 seconds to reduce flashing
+ * Load a sketch from SD card into activeSketch
+ * Filename should be just the filename, not full path
+ * Returns true if successful, false if failed
  */
-void drawBatteryIndicator() {
-  unsigned long currentTime = millis();
-
-  // Check if we need to force a redraw (when lastBatteryPercent is -1)
-  bool forceRedraw = (lastBatteryPercent == -1);
+bool loadSketchFromSD(String filename) {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
+  }
 
-  // Only check battery every 30 seconds (but always check on first call or forced)
-  if (!forceRedraw && !batteryFirstCheck && currentTime - lastBatteryCheckTime < BATTERY_CHECK_INTERVAL) {
-    return;
+  // Quick card check
+  if (SD.cardType() == CARD_NONE) {
+    sdCardAvailable = false;
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
   }
 
-  batteryFirstCheck = false;
-  lastBatteryCheckTime = currentTime;
+  String fullPath = sketchPath(filename);
 
-  // Get current battery percentage
-  int batteryPercent = M5Cardputer.Power.getBatteryLevel();
+  if (!SD.exists(fullPath.c_str())) {
+    setStatusMessage(StatusMsg::FILE_NOT_FOUND);
+    return false;
+  }
 
-  // Redraw if changed or forced
-  if (batteryPercent != lastBatteryPercent || forceRedraw) {
-    // Clear old icon area (24×24 icon below fill icon)
-    M5Cardputer.Display.fillRect(3, 85, 24, 24, currentTheme->background);
+  File file = SD.open(fullPath.c_str(), FILE_READ);
+  if (!file) {
+    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+    return false;
+  }
 
-    // Select icon based on battery level
-    const unsigned char* batteryIcon;
-    if (batteryPercent < 10) {
-      batteryIcon = ICON_BATTERY_0;  // Low (<10%)
-    } else if (batteryPercent < 50) {
-      batteryIcon = ICON_BATTERY_10;  // Medium (10-50%)
-    } else if (batteryPercent < 90) {
-      batteryIcon = ICON_BATTERY_50;  // High (50-90%)
-    } else {
-      batteryIcon = ICON_BATTERY_90;  // Full (>90%)
-    }
+  // Locate the chunks, then read the palette and full pixel data
+  SketchFileIndex index;
+  if (!readSketchFileIndex(file, index) || !readSketchFull(file, index, activeSketch)) {
+    file.close();
+    setStatusMessage(StatusMsg::FILE_CORRUPT);
+    return false;
+  }
 
-    // Draw battery icon at (3, 85) - below fill icon with 4px spacing
-    drawIcon(3, 85, batteryIcon, 24, 24, true);
+  file.close();
 
-    lastBatteryPercent = batteryPercent;
-  }
+  activeSketch.isEmpty = false;
+  activeSketchFilename = filename;
+  activeSketchIsNew = false;
+
+  return true;
 }
 
+
 // ============================================================================
-// FORWARD DECLARATIONS
+// BACKGROUND JOBS
 // ============================================================================
-void drawGrid();
-void drawPalette();
-void drawCursor();
-void drawHelpView();
-void drawMemoryView(bool fullRedraw = true);
-void drawMemorySketchThumbnail(int slotIndex, int x, int y, int thumbSize);
-void drawCreateNewSketchThumbnail(int x, int y, int thumbSize);
-void drawSketchThumbnail(int sketchIndex, int x, int y, int thumbSize);
-void drawMemoryViewCursor(int itemIndex, int x, int y, int thumbSize);
-void updatePaletteFilter();
-void loadGallerySketch(int index);  // Load and display sketch in gallery preview mode
+// Long operations run as resumable jobs instead of blocking loops. A job keeps
+// its progress in a context struct and its step() function does one small piece
+// of work per call. loop() calls runJobSlice() every frame, which steps the
+// active job for at most JOB_SLICE_MS, so drawing and input stay live.
+// Press ESC while a job runs to cancel it.
+
+#define JOB_SLICE_MS 6  // Max time per frame spent in job steps
+
+enum JobState {
+  JOB_RUNNING,
+  JOB_DONE,
+  JOB_FAILED,
+  JOB_CANCELLED
+};
 
-#if ENABLE_LED_MATRIX
-// LED matrix support functions
-void updateLEDMatrix(bool showCursor = true);
-void updateLEDMatrixFromSketch(Sketch& sketch);
-void toggleLEDMatrix();
-#endif
+struct Job {
+  const char* name;                           // Shown with progress, e.g. "Export 40%"
+  JobState (*step)(Job& job);                 // Do one small piece of work
+  void (*finish)(Job& job, JobState state);   // Release resources (called exactly once)
+  void* context;                              // Job-specific state
+  uint8_t progress;                           // 0-100, set by step()
+  bool cancelRequested;
+};
 
-#if ENABLE_BLUETOOTH
-// Bluetooth keyboard support functions
-void btInit();
-void btDeinit();
-void btStartScan();
-bool btConnect();
-bool btReconnect();
-void btDisconnect();
-void btProcessHIDReport(uint8_t* data, size_t len);
-char btHidToChar(uint8_t keycode, bool shift);
-void btQueuePush(char c);
-bool btQueuePop(char& c);
-void btClearInputState();
-void btShowNotify(const char* msg);
-void btUpdateNotify();
-#endif
+// UI frame timing while a job is active (frame = one loop() iteration)
+struct JobFrameStats {
+  uint32_t frames;
+  uint32_t maxFrameUs;
+  uint32_t totalFrameUs;
+  unsigned long durationMs;
+};
 
-// ============================================================================
-// CANVAS OPERATIONS
-// ============================================================================
+Job activeJob;
+bool jobActive = false;
+JobFrameStats lastJobStats = {0, 0, 0, 0};  // Stats of the most recently finished job
+JobFrameStats jobStats;
+unsigned long jobStartMs = 0;
+unsigned long jobLastFrameUs = 0;
+uint8_t jobShownProgress = 255;
 
 /**
- * Save current canvas state to undo buffer
- * Note: This is for regular drawing undo, not sketch deletion operations
+ * Start a background job. Only one job runs at a time.
+ *
+ * @param name Short label for progress messages
+ * @param step Step function (returns JOB_RUNNING until finished)
+ * @param finish Cleanup function, called once when the job ends for any reason
+ * @param context Job state passed to step/finish
+ * @return true if started, false if another job is still running
  */
-void saveUndo() {
-  for (int y = 0; y < currentGridSize; y++) {
-    for (int x = 0; x < currentGridSize; x++) {
-      undoCanvas[y][x] = canvas[y][x];
-    }
+bool startJob(const char* name, JobState (*step)(Job&), void (*finish)(Job&, JobState), void* context) {
+  if (jobActive) {
+    setStatusMessage(StatusMsg::JOB_BUSY);
+    return false;
   }
-  // Clear palette undo info (this is just a regular drawing undo)
-  undoPaletteSize = 0;
-  undoGridSize = 0;
-  undoAvailable = true;
+
+  activeJob.name = name;
+  activeJob.step = step;
+  activeJob.finish = finish;
+  activeJob.context = context;
+  activeJob.progress = 0;
+  activeJob.cancelRequested = false;
+
+  jobStats = {0, 0, 0, 0};
+  jobStartMs = millis();
+  jobLastFrameUs = micros();
+  jobShownProgress = 255;
+  jobActive = true;
+  return true;
 }
 
 /**
- * Restore canvas from undo buffer
+ * Ask the active job to stop. It ends on its next slice.
  */
-void restoreUndo() {
-  if (!undoAvailable) {
-    setStatusMessage(StatusMsg::NO_UNDO);
-    return;
+void cancelJob() {
+  if (jobActive) {
+    activeJob.cancelRequested = true;
   }
+}
 
-  // If we have saved grid size info (from sketch deletion), restore it
-  if (undoGridSize > 0) {
-    currentGridSize = undoGridSize;
-    currentCellSize = (currentGridSize == 8) ? 16 : 8;
+/**
+ * Step the active job for up to JOB_SLICE_MS. Called once per loop() iteration.
+ */
+void runJobSlice() {
+  if (!jobActive) {
+    return;
+  }
 
-    // Keep cursor in bounds
-    if (cursorX >= currentGridSize) cursorX = currentGridSize - 1;
-    if (cursorY >= currentGridSize) cursorY = currentGridSize - 1;
+  // Frame time = time since the previous slice (includes the UI work in between)
+  unsigned long nowUs = micros();
+  uint32_t frameUs = nowUs - jobLastFrameUs;
+  jobStats.frames++;
+  jobStats.totalFrameUs += frameUs;
+  if (frameUs > jobStats.maxFrameUs) {
+    jobStats.maxFrameUs = frameUs;
   }
 
-  // Restore all pixels (always restore full 16x16 to handle grid size changes)
-  for (int y = 0; y < 16; y++) {
-    for (int x = 0; x < 16; x++) {
-      canvas[y][x] = undoCanvas[y][x];
-    }
+  JobState state = JOB_RUNNING;
+  while (state == JOB_RUNNING && micros() - nowUs < JOB_SLICE_MS * 1000UL) {
+    state = activeJob.cancelRequested ? JOB_CANCELLED : activeJob.step(activeJob);
   }
+  jobLastFrameUs = micros();
 
-  // If we have palette info saved (from sketch deletion), restore it to the active sketch
-  if (undoPaletteSize > 0) {
-    activeSketch.paletteSize = undoPaletteSize;
-    activeSketch.gridSize = undoGridSize;
-    for (int i = 0; i < 16; i++) {
-      activeSketch.paletteColors[i] = undoPaletteColors[i];
+  if (state == JOB_RUNNING) {
+    // Show progress when it changes
+    if (activeJob.progress != jobShownProgress) {
+      jobShownProgress = activeJob.progress;
+      char progressMsg[32];
+      snprintf(progressMsg, sizeof(progressMsg), "%s %d%%", activeJob.name, activeJob.progress);
+      setStatusMessage(progressMsg);
     }
+    return;
   }
 
-  undoAvailable = false;
+  jobActive = false;
+  jobStats.durationMs = millis() - jobStartMs;
+  lastJobStats = jobStats;
+  activeJob.finish(activeJob, state);
+  if (state == JOB_CANCELLED) {
+    setStatusMessage(StatusMsg::JOB_CANCELLED);
+  }
+}
 
-  // Update LED matrix with restored canvas
-  LED_CANVAS_UPDATED();
+// ============================================================================
+// IMAGE PIPELINE (exports and screenshots)
+// ============================================================================
+// Images are written by pulling rows through a short chain of stages into a
+// sink:
+//   source (canvas snapshot, display) → transforms (palette expand, upscale,
+//   dither) → sink (PNG, QOI, BMP or GIF file)
+// The sink asks the last stage for each row in turn; a stage asks its input
+// for the row it needs and converts it into its own buffer. Row buffers,
+// encoder state and the output buffer all come from one scratch arena that
+// is allocated when the image starts and freed when it's written.
+// Canvas exports run as a background job; screenshots run to completion at
+// once so the screen can't change under them.
+
+#define IMAGE_OUT_CHUNK 2048    // Small writes are gathered into chunks this size before going to SD
+#define IMAGE_MAX_STAGES 4
+#define EXPORT_ROWS_PER_STEP 8  // Rows encoded per job step
+#define GIF_HASH_SIZE 5003      // LZW string table (prime, a bit over the 4096 codes)
+#define PNG_STRIPE_BYTES 16384  // Filtered rows per deflate stripe (whole rows, at least one)
+#define PNG_DEFLATE_LEVEL 3
+#define PNG_WINDOW_BITS 12      // 4 KB of history: four or more rows back, even on screenshots
+#define PNG_MEM_LEVEL 6
+// Deflate memory per stripe stream (zlib's estimate plus its state struct)
+#define PNG_DEFLATE_MEM ((4u << PNG_WINDOW_BITS) + (1u << (PNG_MEM_LEVEL + 9)) + 8192)
+#define PNG_DEFLATE_CORE 0      // The worker deflates here while the main loop (core 1) does too
+#define EXPORT_DIR "/bitmap16dx/exports"
+#define SCREENSHOT_DIR "/bitmap16dx/screenshots"
+
+enum ImageFormat {
+  IMAGE_PNG,
+  IMAGE_QOI,
+  IMAGE_BMP,
+  IMAGE_GIF,
+  IMAGE_FORMAT_COUNT
+};
+const char* IMAGE_FORMAT_EXT[IMAGE_FORMAT_COUNT] = {"png", "qoi", "bmp", "gif"};
+const char* IMAGE_FORMAT_NAMES[IMAGE_FORMAT_COUNT] = {"PNG", "QOI", "BMP", "GIF"};
+
+// Next free number of a numbered image series (dx_0007.png, ...)
+struct ImageNumbering {
+  const char* dir;
+  const char* prefix;
+  const char* tooManyMsg;
+  int next;                   // -1 until the folder has been scanned
+};
+ImageNumbering exportNumbering = {EXPORT_DIR, "dx_", StatusMsg::TOO_MANY_EXPORTS, -1};
+#if ENABLE_SCREENSHOTS
+ImageNumbering screenshotNumbering = {SCREENSHOT_DIR, "screenshot_", StatusMsg::TOO_MANY_SHOTS, -1};
+#endif
 
-  setStatusMessage(StatusMsg::UNDO);
-}
+struct ImagePipeline;
+
+// One stripe of a PNG: filtered rows and the IDAT chunk they deflate into
+struct PNGStripe {
+  z_stream zs;                // Raw deflate stream
+  uint8_t* raw;               // Rows (filter byte + RGBA each), filtered in place when deflated
+  uint32_t rawUsed;
+  uint32_t stride;            // Bytes per row in raw
+  uint8_t* above;             // Unfiltered row above the stripe (zeros for the first)
+  uint8_t* chunk;             // Length, "IDAT", [zlib header], deflate data, [Adler-32], CRC
+  uint32_t chunkSize;
+  uint32_t chunkUsed;         // Bytes before the CRC
+  uint32_t adler;             // Adler-32 of raw
+  uint32_t crc;               // CRC of the chunk so far
+  bool first;                 // Starts the zlib stream
+  bool last;                  // Ends it
+  bool ok;
+};
+
+// One step of the chain. Rows are either palette indices (1 byte per pixel,
+// 0 = transparent) or RGBA.
+struct ImageStage {
+  int width;
+  int height;
+  bool indexed;
+  bool (*pull)(ImagePipeline& p, ImageStage& stage, int y);  // Fill row with row y
+  ImageStage* input;          // Upstream stage (nullptr for sources)
+  const uint8_t* row;         // Row last produced
+  uint8_t* buffer;            // Row buffer in the arena (sources may point row elsewhere)
+  uint8_t* aux;               // Extra arena buffer (screen source: display pixels)
+  int factor;                 // Upscale: output pixels per input pixel
+  int lastY;                  // Row held in row (-1 = none)
+};
+
+struct ImagePipeline {
+  ImageFormat format;
+  ImageStage stages[IMAGE_MAX_STAGES];  // stages[0] is the source, the last one feeds the sink
+  uint8_t stageCount;
+  uint8_t* arena;
+  uint32_t arenaSize;
+  uint32_t arenaUsed;
+  ImageNumbering* numbering;
+  const char* doneMsg;
+  char path[48];
+  File file;
+  bool begun;
+  int y;                      // Next row for the sink
+
+  // Canvas source
+  uint8_t pixels[16][16];     // Snapshot of the canvas, so edits during export don't tear the image
+  uint16_t palette[16];
+  bool rgb565;
+
+  // Sink state
+  uint8_t* out;               // Output buffer, flushed every IMAGE_OUT_CHUNK
+  uint32_t outSize;
+  uint32_t outUsed;
+  PNGStripe pngStripes[2];    // PNG: [0] deflates on the worker core (if any), [1] here
+  uint32_t pngStride;         // Bytes per filtered row
+  uint8_t* pngCarry;          // Last row of the stripe handed off most recently
+  uint32_t pngStripeBytes;
+  uint8_t pngStripeCount;     // 1 when the whole image fits in one stripe, or memory is short
+  uint32_t pngRowsLeft;       // Rows still to come (the last row never hands a stripe off)
+  uint8_t pngFill;            // Stripe being filled
+  uint16_t pngStripesStarted;
+  uint32_t pngAdler;          // Adler-32 of the stripes written so far
+  TaskHandle_t pngWorker;     // nullptr: every stripe deflates on this core
+  TaskHandle_t pngOwner;      // Task the worker reports back to
+  bool pngWorkerBusy;
+  std::atomic<bool> pngWorkerStop;
+  bool pngSingleCore;         // Don't start a worker (bench)
+  uint8_t qoiIndex[64][4];    // QOI: recently seen pixels
+  uint8_t qoiLast[4];
+  uint8_t qoiRun;
+  int32_t* gifKeys;           // GIF: (prefix << 8 | pixel) + 1 per slot, 0 = empty
+  uint16_t* gifCodes;
+  int gifPrefix;              // Code of the string matched so far (-1 = none)
+  uint16_t gifNextCode;
+  uint8_t gifCodeSize;
+  uint8_t gifMinCodeSize;
+  uint32_t gifBits;
+  uint8_t gifBitCount;
+  uint8_t gifBlock[256];      // Sub-block being filled (length byte first)
+};
 
 /**
- * Clear the entire canvas
- * This saves the current state to undo before clearing
+ * Take bytes from the pipeline's arena (4-byte aligned)
+ * @return nullptr if it doesn't fit
  */
-void clearCanvas() {
-  saveUndo();
+uint8_t* imageArenaTake(ImagePipeline& p, uint32_t bytes) {
+  uint32_t start = (p.arenaUsed + 3) & ~3u;
+  if (start + bytes > p.arenaSize) {
+    return nullptr;
+  }
+  p.arenaUsed = start + bytes;
+  return p.arena + start;
+}
 
-  for (int y = 0; y < currentGridSize; y++) {
-    for (int x = 0; x < currentGridSize; x++) {
-      canvas[y][x] = 0;
+/**
+ * Produce row y of a stage (cached: asking for the same row again is free)
+ */
+const uint8_t* pullImageRow(ImagePipeline& p, ImageStage& stage, int y) {
+  if (stage.lastY != y) {
+    if (!stage.pull(p, stage, y)) {
+      return nullptr;
     }
+    stage.lastY = y;
   }
-
-  setStatusMessage(StatusMsg::CLEAR);
+  return stage.row;
 }
 
 /**
- * Flood fill - fills all connected pixels of the same color with the selected color
- *
- * This is like the paint bucket tool in image editors. Starting from the cursor position,
- * it fills all adjacent pixels that match the original color with the currently selected color.
- *
- * Uses an iterative approach with a simple array-based stack to avoid recursion issues.
- * Only considers 4-way connectivity (up, down, left, right) - not diagonal.
- *
- * @param startX Starting X position (cursor position)
- * @param startY Starting Y position (cursor position)
- * @param fillColor Color to fill with (currently selected color)
+ * Convert one canvas pixel to RGBA for PNG export
  */
-void floodFill(int startX, int startY, uint8_t fillColor) {
-  // Get the original color at the starting position
-  uint8_t originalColor = canvas[startY][startX];
-
-  // If the original color is the same as fill color, nothing to do
-  if (originalColor == fillColor) {
+void exportPixelToRGBA(uint8_t colorIndex, const uint16_t* palette, bool rgb565, uint8_t* out) {
+  if (colorIndex == 0) {
+    // Transparent pixel
+    out[0] = out[1] = out[2] = 0;
+    out[3] = 0;  // Fully transparent
     return;
   }
 
-  // Visited array to track which pixels we've already added to the stack
-  // This prevents duplicates and ensures we process each pixel exactly once
-  bool visited[16][16] = {false};
+  // Get palette color from the sketch's palette
+  uint16_t color565 = palette[colorIndex - 1];
+  uint8_t r = (color565 >> 11) & 0x1F;
+  uint8_t g = (color565 >> 5) & 0x3F;
+  uint8_t b = color565 & 0x1F;
 
-  // Simple stack structure for positions to check
-  // Maximum possible stack size is the entire grid (16×16 = 256 positions)
-  struct Point {
-    int x;
-    int y;
-  };
-  Point stack[256];
-  int stackSize = 0;
+  if (rgb565) {
+    // Export as RGB565 (simple bit shift, faster but less accurate)
+    out[0] = r << 3;
+    out[1] = g << 2;
+    out[2] = b << 3;
+  } else {
+    // Export as RGB888 (using proper conversion with bit expansion)
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+  }
+  out[3] = 255;  // Fully opaque
+}
 
-  // Add starting position to stack and mark as visited
-  stack[stackSize++] = {startX, startY};
-  visited[startY][startX] = true;
+// --- Sources -----------------------------------------------------------------
 
-  // Process stack until empty
-  while (stackSize > 0) {
-    // Pop position from stack
-    Point p = stack[--stackSize];
+/**
+ * Canvas snapshot rows (palette indices, logical size)
+ */
+bool pullCanvasRow(ImagePipeline& p, ImageStage& stage, int y) {
+  stage.row = p.pixels[y];
+  return true;
+}
 
-    // Skip if out of bounds (shouldn't happen, but safety check)
-    if (p.x < 0 || p.x >= currentGridSize || p.y < 0 || p.y >= currentGridSize) {
-      continue;
-    }
+/**
+ * Display rows, read back from the panel (RGBA)
+ */
+bool pullScreenRow(ImagePipeline& p, ImageStage& stage, int y) {
+  uint16_t* line = (uint16_t*)stage.aux;
+  M5Cardputer.Display.readRect(0, y, stage.width, 1, line);
+  for (int x = 0; x < stage.width; x++) {
+    // M5Stack display returns RGB565 in little-endian format
+    // Need to swap bytes: the data comes as [GGGBBBBB][RRRRRGGG]
+    // Swap to get proper RGB565: [RRRRRGGG][GGGBBBBB]
+    uint16_t color565 = (line[x] >> 8) | (line[x] << 8);
+
+    // Convert RGB565 to RGB888
+    uint8_t r = (color565 >> 11) & 0x1F;
+    uint8_t g = (color565 >> 5) & 0x3F;
+    uint8_t b = color565 & 0x1F;
+    uint8_t* out = stage.buffer + x * 4;
+    out[0] = (r << 3) | (r >> 2);  // Expand 5 bits to 8 bits
+    out[1] = (g << 2) | (g >> 4);  // Expand 6 bits to 8 bits
+    out[2] = (b << 3) | (b >> 2);  // Expand 5 bits to 8 bits
+    out[3] = 255;                  // Fully opaque
+  }
+  stage.row = stage.buffer;
+  return true;
+}
 
-    // Skip if this pixel isn't the original color
-    if (canvas[p.y][p.x] != originalColor) {
-      continue;
-    }
+// --- Transforms --------------------------------------------------------------
 
-    // Fill this pixel
-    canvas[p.y][p.x] = fillColor;
+/**
+ * Palette indices → RGBA with the canvas palette
+ */
+bool pullExpandRow(ImagePipeline& p, ImageStage& stage, int y) {
+  const uint8_t* in = pullImageRow(p, *stage.input, y);
+  if (!in) {
+    return false;
+  }
+  for (int x = 0; x < stage.width; x++) {
+    exportPixelToRGBA(in[x], p.palette, p.rgb565, stage.buffer + x * 4);
+  }
+  stage.row = stage.buffer;
+  return true;
+}
 
-    // Add adjacent pixels to stack (4-way connectivity: up, down, left, right)
-    // Only add if not visited and within bounds
-    // Up
-    if (p.y > 0 && !visited[p.y - 1][p.x]) {
-      stack[stackSize++] = {p.x, p.y - 1};
-      visited[p.y - 1][p.x] = true;
-    }
-    // Down
-    if (p.y < currentGridSize - 1 && !visited[p.y + 1][p.x]) {
-      stack[stackSize++] = {p.x, p.y + 1};
-      visited[p.y + 1][p.x] = true;
-    }
-    // Left
-    if (p.x > 0 && !visited[p.y][p.x - 1]) {
-      stack[stackSize++] = {p.x - 1, p.y};
-      visited[p.y][p.x - 1] = true;
-    }
-    // Right
-    if (p.x < currentGridSize - 1 && !visited[p.y][p.x + 1]) {
-      stack[stackSize++] = {p.x + 1, p.y};
-      visited[p.y][p.x + 1] = true;
+/**
+ * Nearest-neighbor upscale by a whole factor. Each input row is widened
+ * once and reused for the factor output rows made from it.
+ */
+bool pullUpscaleRow(ImagePipeline& p, ImageStage& stage, int y) {
+  int inputY = y / stage.factor;
+  if (stage.lastY >= 0 && stage.lastY / stage.factor == inputY) {
+    return true;  // Same input row: the buffer already holds it
+  }
+  const uint8_t* in = pullImageRow(p, *stage.input, inputY);
+  if (!in) {
+    return false;
+  }
+  int bytesPerPixel = stage.indexed ? 1 : 4;
+  uint8_t* out = stage.buffer;
+  for (int x = 0; x < stage.input->width; x++) {
+    for (int i = 0; i < stage.factor; i++) {
+      memcpy(out, in + x * bytesPerPixel, bytesPerPixel);
+      out += bytesPerPixel;
     }
   }
+  stage.row = stage.buffer;
+  return true;
 }
 
 /**
- * Toggle between 8×8 and 16×16 grid modes
- *
- * When switching from 16×16 to 8×8, the top-left 8×8 portion is preserved.
- * When switching from 8×8 to 16×16, the 8×8 art appears in the top-left.
+ * RGBA → RGB332 palette indices, with a 4×4 ordered dither so gradients on
+ * the screen don't band (GIF screenshots)
  */
-void toggleGridSize() {
-  // Toggle between 8 and 16
-  if (currentGridSize == 8) {
-    currentGridSize = 16;
-    currentCellSize = 8;  // Smaller cells for more pixels
-    setStatusMessage(StatusMsg::GRID_16X16);
-  } else {
-    currentGridSize = 8;
-    currentCellSize = 16;  // Larger cells for fewer pixels
-    setStatusMessage(StatusMsg::GRID_8X8);
+bool pullDitherRow(ImagePipeline& p, ImageStage& stage, int y) {
+  static const int8_t BAYER4[4][4] = {
+    {0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}
+  };
+  const uint8_t* in = pullImageRow(p, *stage.input, y);
+  if (!in) {
+    return false;
   }
+  for (int x = 0; x < stage.width; x++) {
+    int t = BAYER4[y & 3][x & 3] * 2 - 15;  // -15..15
+    int r = constrain(in[x * 4 + 0] + t, 0, 255);
+    int g = constrain(in[x * 4 + 1] + t, 0, 255);
+    int b = constrain(in[x * 4 + 2] + t * 2, 0, 255);
+    stage.buffer[x] = ((r * 7 + 127) / 255) << 5 | ((g * 7 + 127) / 255) << 2 | ((b * 3 + 127) / 255);
+  }
+  stage.row = stage.buffer;
+  return true;
+}
 
-  // Keep cursor in bounds
-  if (cursorX >= currentGridSize) cursorX = currentGridSize - 1;
-  if (cursorY >= currentGridSize) cursorY = currentGridSize - 1;
+// --- Sinks -------------------------------------------------------------------
 
-  // Update LED matrix (turn off in 16×16 mode, turn on in 8×8 mode)
-  LED_CANVAS_UPDATED();
+/**
+ * Queue bytes for the output file, writing a chunk whenever the buffer fills
+ */
+bool imageWrite(ImagePipeline& p, const void* data, uint32_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  while (length > 0) {
+    uint32_t n = min(length, p.outSize - p.outUsed);
+    memcpy(p.out + p.outUsed, bytes, n);
+    p.outUsed += n;
+    bytes += n;
+    length -= n;
+    if (p.outUsed == p.outSize) {
+      if (p.file.write(p.out, p.outUsed) != p.outUsed) {
+        setStatusMessage(StatusMsg::WRITE_INCOMPLETE);
+        return false;
+      }
+      p.outUsed = 0;
+    }
+  }
+  return true;
 }
 
 /**
- * Open a sketch from SD card by filename
+ * Write whatever is left in the output buffer
  */
-void openSketch(String filename) {
-  if (!loadSketchFromSD(filename)) {
-    setStatusMessage(StatusMsg::FAILED_TO_LOAD);
-    return;
+bool imageFlush(ImagePipeline& p) {
+  if (p.outUsed > 0 && p.file.write(p.out, p.outUsed) != p.outUsed) {
+    setStatusMessage(StatusMsg::WRITE_INCOMPLETE);
+    return false;
   }
+  p.outUsed = 0;
+  return true;
+}
 
-  // Validate palette
-  if (activeSketch.paletteSize == 0 || activeSketch.paletteSize > 16) {
-    activeSketch.paletteSize = 16;
-  }
+void putBE32(uint8_t* out, uint32_t value) {
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+}
 
-  // Copy to canvas
-  currentGridSize = activeSketch.gridSize;
-  currentCellSize = (currentGridSize == 8) ? 16 : 8;
+void putLE16(uint8_t* out, uint16_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+}
 
-  for (int y = 0; y < 16; y++) {
-    for (int x = 0; x < 16; x++) {
-      canvas[y][x] = activeSketch.pixels[y][x];
-    }
-  }
+void putLE32(uint8_t* out, uint32_t value) {
+  putLE16(out, value);
+  putLE16(out + 2, value >> 16);
+}
 
-  if (cursorX >= currentGridSize) cursorX = currentGridSize - 1;
-  if (cursorY >= currentGridSize) cursorY = currentGridSize - 1;
+// PNG: truecolor + alpha. Rows are cut into stripes that are filtered and
+// deflated independently (like pigz -i), so two stripes can be encoded at
+// once: even stripes on a worker task on the other core, odd ones here.
+// Each stripe ends on a full flush, so they join into one zlib stream; each
+// one becomes an IDAT chunk and their Adler-32s are combined for the trailer.
+// When the heap can't hold two stripes there is just one, deflated here
+// each time it fills; the file comes out the same.
 
-  selectedColor = 1;
+/**
+ * zlib allocator: deflate state comes out of the image arena
+ * (nothing is freed until the arena goes)
+ */
+voidpf pngDeflateAlloc(voidpf opaque, uInt items, uInt size) {
+  return imageArenaTake(*(ImagePipeline*)opaque, items * size);
+}
 
-  // Update LED matrix with newly loaded canvas
-  LED_CANVAS_UPDATED();
+void pngDeflateFree(voidpf opaque, voidpf address) {
+}
 
-  setStatusMessage(StatusMsg::LOADED);
+/**
+ * IDAT chunk size for a stripe of rawBytes: length, type, zlib header,
+ * zlib's worst-case deflate bound for non-default settings
+ * (S + S/8 + S/64 + 5), the full-flush marker, Adler-32 and CRC
+ */
+uint32_t pngStripeChunkSize(uint32_t rawBytes) {
+  return 8 + 2 + rawBytes + ((rawBytes + 7) >> 3) + ((rawBytes + 63) >> 6) + 5 + 8 + 4 + 4;
 }
 
 /**
- * Create a new blank sketch
+ * Filter one RGBA row into out (filter byte first), picking the filter with
+ * the smallest sum of signed bytes like libpng does. Scaled pixel art mostly
+ * comes out as zeros under Sub or Up. out may be line - 1 (in place).
  */
-void createNewSketch() {
-  initializeActiveSketch();
+void pngFilterRow(uint8_t* out, const uint8_t* line, const uint8_t* prev, size_t n) {
+  uint32_t cost[5] = {0, 0, 0, 0, 0};
+  for (size_t i = 0; i < n; i++) {
+    int left = i >= 4 ? line[i - 4] : 0;
+    int up = prev[i];
+    int upLeft = i >= 4 ? prev[i - 4] : 0;
+    int p = left + up - upLeft;
+    int pa = abs(p - left), pb = abs(p - up), pc = abs(p - upLeft);
+    int paeth = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+    cost[0] += abs((int8_t)line[i]);
+    cost[1] += abs((int8_t)(line[i] - left));
+    cost[2] += abs((int8_t)(line[i] - up));
+    cost[3] += abs((int8_t)(line[i] - ((left + up) >> 1)));
+    cost[4] += abs((int8_t)(line[i] - paeth));
+  }
+  uint8_t filter = 0;
+  for (uint8_t f = 1; f < 5; f++) {
+    if (cost[f] < cost[filter]) {
+      filter = f;
+    }
+  }
+
+  for (size_t i = n; i-- > 0;) {
+    int left = i >= 4 ? line[i - 4] : 0;
+    int up = prev[i];
+    int upLeft = i >= 4 ? prev[i - 4] : 0;
+    switch (filter) {
+      case 0: out[i + 1] = line[i]; break;
+      case 1: out[i + 1] = line[i] - left; break;
+      case 2: out[i + 1] = line[i] - up; break;
+      case 3: out[i + 1] = line[i] - ((left + up) >> 1); break;
+      case 4: {
+        int p = left + up - upLeft;
+        int pa = abs(p - left), pb = abs(p - up), pc = abs(p - upLeft);
+        out[i + 1] = line[i] - ((pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft));
+        break;
+      }
+    }
+  }
+  out[0] = filter;
+}
 
-  for (int y = 0; y < 16; y++) {
-    for (int x = 0; x < 16; x++) {
-      canvas[y][x] = 0;
+/**
+ * Filter a stripe's rows, deflate them into its IDAT chunk and checksum it.
+ * Runs on either core; touches nothing but the stripe.
+ */
+void deflatePNGStripe(PNGStripe& stripe) {
+  // Bottom row first, so each row is filtered against the unfiltered one above
+  uint32_t n = stripe.stride - 1;
+  for (uint32_t offset = stripe.rawUsed; offset > 0;) {
+    offset -= stripe.stride;
+    const uint8_t* above = offset > 0 ? stripe.raw + offset - n : stripe.above;
+    pngFilterRow(stripe.raw + offset, stripe.raw + offset + 1, above, n);
+  }
+
+  memcpy(stripe.chunk + 4, "IDAT", 4);
+  uint8_t* data = stripe.chunk + 8;
+  if (stripe.first) {
+    // zlib header: deflate, 4 KB window (CINFO 4), fast compression
+    *data++ = 0x48;
+    *data++ = 0x4B;
+  }
+  stripe.zs.next_in = stripe.raw;
+  stripe.zs.avail_in = stripe.rawUsed;
+  stripe.zs.next_out = data;
+  stripe.zs.avail_out = stripe.chunk + stripe.chunkSize - 8 - data;  // Leave room for Adler-32 and CRC
+  int rc = deflate(&stripe.zs, stripe.last ? Z_FINISH : Z_FULL_FLUSH);
+  // A flush that ends with avail_out == 0 may be unfinished and would need
+  // another call with more room. The chunk is sized for the worst case, so
+  // running out of it is an error rather than something to continue.
+  stripe.ok = stripe.zs.avail_in == 0 && stripe.zs.avail_out > 0 &&
+              rc == (stripe.last ? Z_STREAM_END : Z_OK);
+  stripe.chunkUsed = stripe.zs.next_out - stripe.chunk;
+  stripe.adler = adler32(1, stripe.raw, stripe.rawUsed);
+  stripe.crc = crc32(0, stripe.chunk + 4, stripe.chunkUsed - 4);
+}
+
+/**
+ * Worker task: deflates pngStripes[0] each time it's notified
+ */
+void pngDeflateWorker(void* param) {
+  ImagePipeline* p = (ImagePipeline*)param;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (p->pngWorkerStop.load(std::memory_order_acquire)) {
+      break;
     }
+    deflatePNGStripe(p->pngStripes[0]);
+    xTaskNotifyGive(p->pngOwner);
   }
+  xTaskNotifyGive(p->pngOwner);
+  vTaskDelete(nullptr);
+}
 
-  // Use default grid size from settings instead of hardcoded 16
-  currentGridSize = defaultGridSize;
-  currentCellSize = (currentGridSize == 16) ? 8 : 16;
-  activeSketch.gridSize = currentGridSize;
-  cursorX = 0;
-  cursorY = 0;
-  selectedColor = 1;
+/**
+ * Wait for the worker's stripe (if it has one)
+ */
+void waitPNGWorker(ImagePipeline& p) {
+  if (p.pngWorkerBusy) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    p.pngWorkerBusy = false;
+  }
+}
 
-  // setStatusMessage("New sketch");  // Removed - no message on boot
+/**
+ * Stop the worker task (after its current stripe)
+ */
+void stopPNGWorker(ImagePipeline& p) {
+  if (p.pngWorker) {
+    waitPNGWorker(p);
+    p.pngWorkerStop.store(true, std::memory_order_release);
+    xTaskNotifyGive(p.pngWorker);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // Worker has let go of the pipeline
+    p.pngWorker = nullptr;
+  }
 }
 
 /**
- * Enter Memory View mode
+ * Hand a filled stripe to its core. Its last row is kept first (filtering
+ * changes it): it's the row above the next stripe.
  */
-void enterMemoryView() {
-  loadSketchListFromSD();  // Load sketch list (sketch data will be cached on first draw)
-  inMemoryView = true;
+bool startPNGStripe(ImagePipeline& p, uint8_t index, bool last) {
+  PNGStripe& stripe = p.pngStripes[index];
+  stripe.first = (p.pngStripesStarted++ == 0);
+  stripe.last = last;
+  if (deflateReset(&stripe.zs) != Z_OK) {
+    return false;
+  }
+  if (stripe.rawUsed > 0) {
+    memcpy(p.pngCarry, stripe.raw + stripe.rawUsed - (stripe.stride - 1), stripe.stride - 1);
+  }
+  if (index == 0 && p.pngWorker) {
+    p.pngWorkerBusy = true;
+    xTaskNotifyGive(p.pngWorker);
+  } else {
+    deflatePNGStripe(stripe);
+  }
+  return true;
+}
 
-  // Keep cursor and scroll position persistent between sessions
-  // This remembers where you were browsing in the list
-  // Just clamp cursor to valid range in case list changed (e.g., deleted items)
-  int totalItems = 1 + sketchList.size();
-  if (memoryViewCursor >= totalItems) {
-    memoryViewCursor = max(0, totalItems - 1);
+/**
+ * Write a deflated stripe's chunk (adding the zlib trailer to the last one)
+ */
+bool writePNGStripe(ImagePipeline& p, PNGStripe& stripe) {
+  if (!stripe.ok) {
+    setStatusMessage(StatusMsg::PNG_ENCODE_FAIL);
+    return false;
   }
-  if (memoryViewCursor < 0) {
-    memoryViewCursor = 0;
+  p.pngAdler = adler32_combine(p.pngAdler, stripe.adler, stripe.rawUsed);
+  if (stripe.last) {
+    putBE32(stripe.chunk + stripe.chunkUsed, p.pngAdler);
+    stripe.crc = crc32(stripe.crc, stripe.chunk + stripe.chunkUsed, 4);
+    stripe.chunkUsed += 4;
   }
+  putBE32(stripe.chunk, stripe.chunkUsed - 8);
+  putBE32(stripe.chunk + stripe.chunkUsed, stripe.crc);
 
-  lastMemoryAnimTime = millis();
-  memoryCursorAnimPhase = 0.0f;
-  M5Cardputer.Display.fillScreen(currentTheme->background);
-  drawMemoryView(true);
+  // Straight to the card: chunks are far bigger than the output buffer
+  uint32_t length = stripe.chunkUsed + 4;
+  if (!imageFlush(p)) {
+    return false;
+  }
+  if (p.file.write(stripe.chunk, length) != length) {
+    setStatusMessage(StatusMsg::WRITE_INCOMPLETE);
+    return false;
+  }
+  return true;
 }
 
 /**
- * Exit Memory View and return to canvas
+ * Deflate what's in the stripes and write them out in order.
+ * Stripe 0 is always the older one.
  */
-void exitMemoryView() {
-  inMemoryView = false;
-
-  // Redraw the canvas view
-  M5Cardputer.Display.fillScreen(currentTheme->background);
-  drawGrid();
-  drawPalette();
-  drawCursor();
-
-  // Redraw icons in upper left corner
-  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-  drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-  drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
-  // drawIcon(3, 84, ICON_INFO, ICON_INFO_WIDTH, ICON_INFO_HEIGHT, ICON_INFO_IS_INDEXED);
-
-  // Redraw battery indicator
-  lastBatteryPercent = -1;  // Force redraw
-  batteryFirstCheck = true;  // Force immediate check
-  drawBatteryIndicator();
-
-#if ENABLE_LED_MATRIX
-  // Restore active canvas on LED matrix
-  updateLEDMatrix();
-#endif
-
-}
+bool finishPNGStripes(ImagePipeline& p, bool last) {
+  PNGStripe& older = p.pngStripes[0];
+  PNGStripe& newer = p.pngStripes[1];
+  bool ok = true;
+  if (p.pngFill == 0) {
+    // Only stripe 0 has rows (end of image)
+    ok = startPNGStripe(p, 0, last);
+    waitPNGWorker(p);
+    ok = ok && writePNGStripe(p, older);
+  } else {
+    ok = startPNGStripe(p, 1, last);
+    waitPNGWorker(p);
+    ok = ok && writePNGStripe(p, older) && writePNGStripe(p, newer);
+  }
+  memcpy(older.above, p.pngCarry, p.pngStride - 1);  // Free again: stripe 0 fills next
+  p.pngFill = 0;
+  return ok;
+}
 
 /**
- * Enter Charging Mode - DVD-style bouncing battery screensaver
+ * Write a small chunk (IHDR, IEND)
  */
-void enterChargingMode() {
-  inChargingMode = true;
-  lastChargeFrameTime = millis();
-  chargeBatteryPercent = M5Cardputer.Power.getBatteryLevel();
-  lastChargeBatteryCheck = millis();
+bool writePNGChunk(ImagePipeline& p, const char* type, const uint8_t* data, uint32_t length) {
+  uint8_t head[8];
+  putBE32(head, length);
+  memcpy(head + 4, type, 4);
+  uint32_t crc = crc32(0, head + 4, 4);
+  if (length > 0) {
+    crc = crc32(crc, data, length);  // (zlib's crc32 restarts on a null buffer)
+  }
+  uint8_t tail[4];
+  putBE32(tail, crc);
+  return imageWrite(p, head, 8) && imageWrite(p, data, length) && imageWrite(p, tail, 4);
+}
 
-  // Select battery icon
-  const unsigned char* batIcon;
-  if (chargeBatteryPercent < 10) batIcon = ICON_BATTERY_0;
-  else if (chargeBatteryPercent < 50) batIcon = ICON_BATTERY_10;
-  else if (chargeBatteryPercent < 90) batIcon = ICON_BATTERY_50;
-  else batIcon = ICON_BATTERY_90;
+bool pngSinkBegin(ImagePipeline& p, ImageStage& last) {
+  static const uint8_t SIGNATURE[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  uint8_t header[13];
+  putBE32(header, last.width);
+  putBE32(header + 4, last.height);
+  header[8] = 8;                     // Bits per channel
+  header[9] = 6;                     // Truecolor with alpha
+  header[10] = header[11] = header[12] = 0;  // Deflate, adaptive filters, not interlaced
+  if (!imageWrite(p, SIGNATURE, sizeof(SIGNATURE)) || !writePNGChunk(p, "IHDR", header, sizeof(header))) {
+    return false;
+  }
 
-  // Initialize icons with random positions and velocities (no overlap)
-  randomSeed(millis());
-  const unsigned char* icons[] = {ICON_DRAW, ICON_ERASE, ICON_FILL, batIcon, nullptr};
-  for (int i = 0; i < CHARGE_ICON_COUNT; i++) {
-    float x, y;
-    bool tooClose;
-    int attempts = 0;
-    do {
-      x = random(10, 190);
-      y = random(10, 90);
-      tooClose = false;
-      for (int j = 0; j < i; j++) {
-        if (abs(x - chargeIcons[j].x) < 48 && abs(y - chargeIcons[j].y) < 48) {
-          tooClose = true;
-          break;
-        }
-      }
-    } while (tooClose && ++attempts < 50);
-    float dx = (random(70, 130) / 100.0f) * (random(2) ? 1 : -1);
-    float dy = (random(70, 130) / 100.0f) * (random(2) ? 1 : -1);
-    chargeIcons[i] = {x, y, dx, dy, icons[i]};
+  for (int i = 0; i < p.pngStripeCount; i++) {
+    PNGStripe& stripe = p.pngStripes[i];
+    stripe.zs.zalloc = pngDeflateAlloc;
+    stripe.zs.zfree = pngDeflateFree;
+    stripe.zs.opaque = &p;
+    int rc = deflateInit2(&stripe.zs, PNG_DEFLATE_LEVEL, Z_DEFLATED, -PNG_WINDOW_BITS, PNG_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (rc != Z_OK) {
+      char msg[40];
+      snprintf(msg, sizeof(msg), StatusMsg::PNG_INIT_ERR_FMT, rc);
+      setStatusMessage(msg);
+      return false;
+    }
+    stripe.rawUsed = 0;
+    stripe.stride = p.pngStride;
   }
+  memset(p.pngStripes[0].above, 0, p.pngStride - 1);  // Row 0 is filtered against zeros
+  p.pngAdler = 1;
+  p.pngFill = 0;
+  p.pngStripesStarted = 0;
+  p.pngRowsLeft = last.height;
 
-  // Load a random sketch into the sprite
-  chargeSketchLoaded = false;
-  loadSketchListFromSD();
+  // A second core only pays off with more than one stripe
+  p.pngOwner = xTaskGetCurrentTaskHandle();
+  if (!p.pngSingleCore && p.pngStripeCount > 1 &&
+      xTaskCreatePinnedToCore(pngDeflateWorker, "deflate", 4096, &p, 1, &p.pngWorker, PNG_DEFLATE_CORE) != pdPASS) {
+    p.pngWorker = nullptr;  // Deflate everything here instead
+  }
+  return true;
+}
 
-  if (sketchList.size() > 0) {
-    // Pick a random sketch
-    int randIndex = millis() % sketchList.size();
-    SketchInfo& info = sketchList[randIndex];
+bool pngSinkRow(ImagePipeline& p, const uint8_t* row, int width) {
+  PNGStripe& stripe = p.pngStripes[p.pngFill];
+  memcpy(stripe.raw + stripe.rawUsed + 1, row, width * 4);  // Filtered later, on the stripe's core
+  stripe.rawUsed += p.pngStride;
+  p.pngRowsLeft--;
+  if (stripe.rawUsed + p.pngStride <= p.pngStripeBytes || p.pngRowsLeft == 0) {
+    return true;  // Room for another row, or the image ends here (pngSinkEnd deflates it)
+  }
 
-    // Load sketch data from SD
-    String fullPath = "/bitmap16dx/sketches/" + info.filename;
-    File file = SD.open(fullPath.c_str(), FILE_READ);
-    if (file) {
-      Sketch tempSketch;
-      size_t fileSize = file.size();
+  // Stripe full
+  if (p.pngFill == 0 && p.pngStripeCount > 1) {
+    if (!startPNGStripe(p, 0, false)) {
+      return false;
+    }
+    p.pngFill = 1;
+    p.pngStripes[1].rawUsed = 0;
+    memcpy(p.pngStripes[1].above, p.pngCarry, p.pngStride - 1);
+    return true;
+  }
+  if (!finishPNGStripes(p, false)) {
+    return false;
+  }
+  p.pngStripes[0].rawUsed = 0;
+  return true;
+}
 
-      // Skip version byte if present
-      if (fileSize == SKETCH_FILE_SIZE_V2) {
-        file.read();  // version byte
-      }
+bool pngSinkEnd(ImagePipeline& p) {
+  bool ok = finishPNGStripes(p, true);
+  stopPNGWorker(p);
+  return ok && writePNGChunk(p, "IEND", nullptr, 0) && imageFlush(p);
+}
 
-      tempSketch.gridSize = file.read();
-      tempSketch.paletteSize = file.read();
+// QOI (qoiformat.org): RGBA, one pass, no tables beyond the 64-entry index
+
+bool qoiSinkBegin(ImagePipeline& p, ImageStage& last) {
+  uint8_t header[14] = {'q', 'o', 'i', 'f'};
+  putBE32(header + 4, last.width);
+  putBE32(header + 8, last.height);
+  header[12] = 4;  // RGBA
+  header[13] = 0;  // sRGB with linear alpha
+  memset(p.qoiIndex, 0, sizeof(p.qoiIndex));
+  p.qoiLast[0] = p.qoiLast[1] = p.qoiLast[2] = 0;
+  p.qoiLast[3] = 255;
+  p.qoiRun = 0;
+  return imageWrite(p, header, sizeof(header));
+}
 
-      for (int i = 0; i < 16; i++) {
-        uint8_t high = file.read();
-        uint8_t low = file.read();
-        tempSketch.paletteColors[i] = (high << 8) | low;
+bool qoiSinkRow(ImagePipeline& p, const uint8_t* row, int width) {
+  uint8_t op[5];
+  for (int x = 0; x < width; x++) {
+    const uint8_t* px = row + x * 4;
+    if (memcmp(px, p.qoiLast, 4) == 0) {
+      if (++p.qoiRun == 62) {
+        op[0] = 0xC0 | (p.qoiRun - 1);  // QOI_OP_RUN
+        p.qoiRun = 0;
+        if (!imageWrite(p, op, 1)) return false;
       }
-
-      for (int py = 0; py < 16; py++) {
-        for (int px = 0; px < 16; px++) {
-          tempSketch.pixels[py][px] = file.read();
-        }
+      continue;
+    }
+    if (p.qoiRun > 0) {
+      op[0] = 0xC0 | (p.qoiRun - 1);
+      p.qoiRun = 0;
+      if (!imageWrite(p, op, 1)) return false;
+    }
+
+    uint8_t hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+    uint32_t length;
+    if (memcmp(p.qoiIndex[hash], px, 4) == 0) {
+      op[0] = hash;  // QOI_OP_INDEX
+      length = 1;
+    } else if (px[3] == p.qoiLast[3]) {
+      int8_t dr = px[0] - p.qoiLast[0];
+      int8_t dg = px[1] - p.qoiLast[1];
+      int8_t db = px[2] - p.qoiLast[2];
+      int8_t drg = dr - dg;
+      int8_t dbg = db - dg;
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        op[0] = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);  // QOI_OP_DIFF
+        length = 1;
+      } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+        op[0] = 0x80 | (dg + 32);  // QOI_OP_LUMA
+        op[1] = (drg + 8) << 4 | (dbg + 8);
+        length = 2;
+      } else {
+        op[0] = 0xFE;  // QOI_OP_RGB
+        memcpy(op + 1, px, 3);
+        length = 4;
       }
-      file.close();
+    } else {
+      op[0] = 0xFF;  // QOI_OP_RGBA
+      memcpy(op + 1, px, 4);
+      length = 5;
+    }
+    memcpy(p.qoiIndex[hash], px, 4);
+    memcpy(p.qoiLast, px, 4);
+    if (!imageWrite(p, op, length)) return false;
+  }
+  return true;
+}
 
-      // Render into 48x48 sprite
-      if (chargeSketchSprite.createSprite(48, 48)) {
-        chargeSketchSprite.fillSprite(TFT_BLACK);
-        int pixelSize = (tempSketch.gridSize == 16) ? 3 : 6;
-        int gridSize = tempSketch.gridSize;
+bool qoiSinkEnd(ImagePipeline& p) {
+  static const uint8_t QOI_END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  if (p.qoiRun > 0) {
+    uint8_t op = 0xC0 | (p.qoiRun - 1);
+    if (!imageWrite(p, &op, 1)) return false;
+  }
+  return imageWrite(p, QOI_END, sizeof(QOI_END)) && imageFlush(p);
+}
 
-        for (int py = 0; py < gridSize; py++) {
-          for (int px = 0; px < gridSize; px++) {
-            uint8_t colorIdx = tempSketch.pixels[py][px];
-            if (colorIdx > 0 && colorIdx <= tempSketch.paletteSize) {
-              uint16_t color = tempSketch.paletteColors[colorIdx - 1];
-              chargeSketchSprite.fillRect(px * pixelSize, py * pixelSize, pixelSize, pixelSize, color);
-            }
-          }
-        }
-        chargeSketchLoaded = true;
-      }
+// BMP: 32-bit BGRA with a V4 header (alpha mask), stored top-down
+
+bool bmpSinkBegin(ImagePipeline& p, ImageStage& last) {
+  uint8_t header[14 + 108] = {'B', 'M'};
+  uint32_t pixelBytes = (uint32_t)last.width * last.height * 4;
+  putLE32(header + 2, sizeof(header) + pixelBytes);  // File size
+  putLE32(header + 10, sizeof(header));              // Pixel data offset
+  uint8_t* info = header + 14;
+  putLE32(info + 0, 108);                            // BITMAPV4HEADER
+  putLE32(info + 4, last.width);
+  putLE32(info + 8, (uint32_t)-last.height);         // Negative: first row is the top
+  putLE16(info + 12, 1);                             // Planes
+  putLE16(info + 14, 32);                            // Bits per pixel
+  putLE32(info + 16, 3);                             // BI_BITFIELDS
+  putLE32(info + 20, pixelBytes);
+  putLE32(info + 24, 2835);                          // 72 DPI
+  putLE32(info + 28, 2835);
+  putLE32(info + 40, 0x00FF0000);                    // Red mask
+  putLE32(info + 44, 0x0000FF00);                    // Green mask
+  putLE32(info + 48, 0x000000FF);                    // Blue mask
+  putLE32(info + 52, 0xFF000000);                    // Alpha mask
+  putLE32(info + 56, 0x73524742);                    // 'sRGB'
+  return imageWrite(p, header, sizeof(header));
+}
+
+bool bmpSinkRow(ImagePipeline& p, const uint8_t* row, int width) {
+  uint8_t px[4 * 16];
+  for (int x = 0; x < width; x += 16) {
+    int n = min(16, width - x);
+    for (int i = 0; i < n; i++) {
+      const uint8_t* in = row + (x + i) * 4;
+      px[i * 4 + 0] = in[2];
+      px[i * 4 + 1] = in[1];
+      px[i * 4 + 2] = in[0];
+      px[i * 4 + 3] = in[3];
     }
+    if (!imageWrite(p, px, n * 4)) return false;
   }
+  return true;
+}
 
-  // Allocate full-screen canvas for tear-free rendering
-  chargeCanvasAvailable = chargeCanvas.createSprite(240, 135);
+bool bmpSinkEnd(ImagePipeline& p) {
+  return imageFlush(p);
+}
 
-  // Dim display
-  M5Cardputer.Display.setBrightness(50);
+// GIF: indexed rows, LZW-coded into 255-byte sub-blocks. Canvas exports use
+// the sketch palette with index 0 transparent; screenshots use RGB332.
 
-  // Dark background
-  M5Cardputer.Display.fillScreen(TFT_BLACK);
+/**
+ * Add a code to the LZW bit stream (least significant bit first)
+ */
+bool gifPutCode(ImagePipeline& p, uint16_t code) {
+  p.gifBits |= (uint32_t)code << p.gifBitCount;
+  p.gifBitCount += p.gifCodeSize;
+  while (p.gifBitCount >= 8) {
+    p.gifBlock[++p.gifBlock[0]] = p.gifBits & 0xFF;
+    p.gifBits >>= 8;
+    p.gifBitCount -= 8;
+    if (p.gifBlock[0] == 255) {
+      if (!imageWrite(p, p.gifBlock, 256)) return false;
+      p.gifBlock[0] = 0;
+    }
+  }
+  return true;
 }
 
 /**
- * Exit Charging Mode - restore canvas view
+ * Empty the LZW string table
  */
-void exitChargingMode() {
-  inChargingMode = false;
+void gifResetTable(ImagePipeline& p) {
+  memset(p.gifKeys, 0, GIF_HASH_SIZE * sizeof(int32_t));
+  p.gifNextCode = (1 << p.gifMinCodeSize) + 2;
+  p.gifCodeSize = p.gifMinCodeSize + 1;
+}
 
-  // Free sprites
-  if (chargeSketchLoaded) {
-    chargeSketchSprite.deleteSprite();
-    chargeSketchLoaded = false;
+bool gifSinkBegin(ImagePipeline& p, ImageStage& last) {
+  bool canvasColors = p.stages[0].indexed;  // Sketch palette (else RGB332)
+  uint8_t colorBits = canvasColors ? 5 : 8;  // 17 colors fit in 32
+  uint8_t header[13] = {'G', 'I', 'F', '8', '9', 'a'};
+  putLE16(header + 6, last.width);
+  putLE16(header + 8, last.height);
+  header[10] = 0x80 | (colorBits - 1) << 4 | (colorBits - 1);  // Global color table
+  if (!imageWrite(p, header, sizeof(header))) return false;
+
+  for (int i = 0; i < (1 << colorBits); i++) {
+    uint8_t rgba[4] = {0, 0, 0, 0};
+    if (canvasColors) {
+      if (i <= 16) {
+        exportPixelToRGBA(i, p.palette, p.rgb565, rgba);
+      }
+    } else {
+      rgba[0] = ((i >> 5) & 7) * 255 / 7;
+      rgba[1] = ((i >> 2) & 7) * 255 / 7;
+      rgba[2] = (i & 3) * 255 / 3;
+    }
+    if (!imageWrite(p, rgba, 3)) return false;
+  }
+
+  if (canvasColors) {
+    // Graphic control extension: index 0 is transparent
+    static const uint8_t GCE[8] = {0x21, 0xF9, 4, 0x01, 0, 0, 0, 0};
+    if (!imageWrite(p, GCE, sizeof(GCE))) return false;
+  }
+  uint8_t descriptor[11] = {0x2C, 0, 0, 0, 0};
+  putLE16(descriptor + 5, last.width);
+  putLE16(descriptor + 7, last.height);
+  descriptor[9] = 0;                 // No local color table, not interlaced
+  descriptor[10] = colorBits;        // LZW minimum code size
+  if (!imageWrite(p, descriptor, sizeof(descriptor))) return false;
+
+  p.gifMinCodeSize = colorBits;
+  p.gifPrefix = -1;
+  p.gifBits = 0;
+  p.gifBitCount = 0;
+  p.gifBlock[0] = 0;
+  gifResetTable(p);
+  return gifPutCode(p, 1 << p.gifMinCodeSize);  // Clear code
+}
+
+bool gifSinkRow(ImagePipeline& p, const uint8_t* row, int width) {
+  for (int x = 0; x < width; x++) {
+    uint8_t pixel = row[x];
+    if (p.gifPrefix < 0) {
+      p.gifPrefix = pixel;
+      continue;
+    }
+
+    // Look the string (prefix + pixel) up in the table
+    int32_t key = (p.gifPrefix << 8 | pixel) + 1;
+    uint32_t slot = (uint32_t)key % GIF_HASH_SIZE;
+    while (p.gifKeys[slot] != 0 && p.gifKeys[slot] != key) {
+      slot = (slot + 1) % GIF_HASH_SIZE;
+    }
+    if (p.gifKeys[slot] == key) {
+      p.gifPrefix = p.gifCodes[slot];
+      continue;
+    }
+
+    // New string: send the known part and learn the longer one
+    if (!gifPutCode(p, p.gifPrefix)) return false;
+    if (p.gifNextCode < 4096) {
+      p.gifKeys[slot] = key;
+      p.gifCodes[slot] = p.gifNextCode;
+      if (p.gifNextCode == (1 << p.gifCodeSize)) {
+        p.gifCodeSize++;
+      }
+      p.gifNextCode++;
+    } else {
+      // Table full: start over
+      if (!gifPutCode(p, 1 << p.gifMinCodeSize)) return false;
+      gifResetTable(p);
+    }
+    p.gifPrefix = pixel;
   }
-  if (chargeCanvasAvailable) {
-    chargeCanvas.deleteSprite();
-    chargeCanvasAvailable = false;
+  return true;
+}
+
+bool gifSinkEnd(ImagePipeline& p) {
+  if (p.gifPrefix >= 0 && !gifPutCode(p, p.gifPrefix)) return false;
+  if (!gifPutCode(p, (1 << p.gifMinCodeSize) + 1)) return false;  // End of information
+  if (p.gifBitCount > 0) {
+    p.gifCodeSize = 8 - p.gifBitCount;  // Pad the last byte
+    if (!gifPutCode(p, 0)) return false;
   }
+  if (p.gifBlock[0] > 0 && !imageWrite(p, p.gifBlock, p.gifBlock[0] + 1)) return false;
+  static const uint8_t GIF_END[2] = {0, 0x3B};  // Empty sub-block, trailer
+  return imageWrite(p, GIF_END, sizeof(GIF_END)) && imageFlush(p);
+}
 
-  // Restore brightness
-  uint8_t hardwareBrightness = (displayBrightness * 255) / 100;
-  M5Cardputer.Display.setBrightness(hardwareBrightness);
+struct ImageSink {
+  bool indexed;               // Takes palette indices (else RGBA)
+  bool (*begin)(ImagePipeline& p, ImageStage& last);
+  bool (*row)(ImagePipeline& p, const uint8_t* row, int width);
+  bool (*end)(ImagePipeline& p);
+};
 
-  // Redraw canvas
-  M5Cardputer.Display.fillScreen(currentTheme->background);
-  drawGrid();
-  drawPalette();
-  drawCursor();
+const ImageSink IMAGE_SINKS[IMAGE_FORMAT_COUNT] = {
+  {false, pngSinkBegin, pngSinkRow, pngSinkEnd},
+  {false, qoiSinkBegin, qoiSinkRow, qoiSinkEnd},
+  {false, bmpSinkBegin, bmpSinkRow, bmpSinkEnd},
+  {true, gifSinkBegin, gifSinkRow, gifSinkEnd},
+};
 
-  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-  drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-  drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
+// --- Pipeline ----------------------------------------------------------------
 
-  lastBatteryPercent = -1;
-  batteryFirstCheck = true;
-  drawBatteryIndicator();
+/**
+ * Add a stage fed by the current last one
+ */
+ImageStage& addImageStage(ImagePipeline& p, bool (*pull)(ImagePipeline&, ImageStage&, int), bool indexed) {
+  ImageStage& stage = p.stages[p.stageCount];
+  stage = {};
+  stage.pull = pull;
+  stage.indexed = indexed;
+  stage.lastY = -1;
+  if (p.stageCount > 0) {
+    stage.input = &p.stages[p.stageCount - 1];
+    stage.width = stage.input->width;
+    stage.height = stage.input->height;
+  }
+  p.stageCount++;
+  return stage;
 }
 
 /**
- * Enter Hint Screen mode
+ * Free an image's arena and close its file (removing it unless it was finished)
  */
-void enterHelpView() {
-  // Remember if we're coming from memory view
-  helpViewFromMemoryView = inMemoryView;
-
-  inHelpView = true;
-  helpViewCursor = 0;
-  helpViewScrollOffset = 0;
-  helpCanvasAvailable = helpCanvas.createSprite(240, 135);
-
-  // Draw hint screen
-  drawHelpView();
+void closeImagePipeline(ImagePipeline* p, bool keepFile) {
+  stopPNGWorker(*p);
+  if (p->file) {
+    p->file.close();
+    if (!keepFile) {
+      SD.remove(p->path);  // Don't leave a partial image behind
+    }
+  }
+  scopedFree(p->arena, p->arenaSize);
 }
 
 /**
- * Exit Hint Screen and return to previous view
+ * Pick the next free file name of a numbered series. The folder is listed
+ * once; after that the number is just counted on (and checked).
+ * @return false (status set) if the series is full
  */
-void exitHelpView() {
-  inHelpView = false;
-
-  if (helpCanvasAvailable) {
-    helpCanvas.deleteSprite();
-    helpCanvasAvailable = false;
+bool nextImagePath(ImageNumbering& numbering, ImageFormat format, char* path, size_t pathSize) {
+  if (!SD.exists(numbering.dir)) {
+    SD.mkdir(numbering.dir);
+  }
+  if (numbering.next < 0) {
+    numbering.next = 0;
+    size_t prefixLength = strlen(numbering.prefix);
+    File dir = SD.open(numbering.dir);
+    File entry;
+    while (dir && (entry = dir.openNextFile())) {
+      String name = fileBaseName(entry);
+      if (!entry.isDirectory() && name.startsWith(numbering.prefix)) {
+        int number = atoi(name.c_str() + prefixLength);
+        numbering.next = max(numbering.next, number + 1);
+      }
+      entry.close();
+    }
+    dir.close();
   }
-
-  // Return to the view we came from
-  if (helpViewFromMemoryView) {
-    // Return to memory view
-    drawMemoryView(true);
-    helpViewFromMemoryView = false;
-  } else {
-    // Return to canvas/drawing view
-    M5Cardputer.Display.fillScreen(currentTheme->background);
-    drawGrid();
-    drawPalette();
-    drawCursor();
-
-    // Redraw icons in upper left corner
-    drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-    drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-    drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
-    // drawIcon(3, 84, ICON_INFO, ICON_INFO_WIDTH, ICON_INFO_HEIGHT, ICON_INFO_IS_INDEXED);
-
-    // Redraw battery indicator
-    lastBatteryPercent = -1;  // Force redraw
-    batteryFirstCheck = true;  // Force immediate check
-    drawBatteryIndicator();
+  do {
+    snprintf(path, pathSize, "%s/%s%04d.%s", numbering.dir, numbering.prefix, numbering.next,
+             IMAGE_FORMAT_EXT[format]);
+    numbering.next++;
+  } while (SD.exists(path) && numbering.next < 10000);
+  if (numbering.next >= 10000) {
+    setStatusMessage(numbering.tooManyMsg);
+    return false;
   }
+  return true;
 }
 
 /**
- * Load and display a sketch from the gallery in fullscreen preview
- * Uses lazy loading pattern from drawSketchThumbnail
+ * Finish the chain for the sink, size the arena and hand out the buffers.
+ * stages[0] must already be set up as the source.
  */
-void loadGallerySketch(int index) {
-  if (index < 0 || index >= sketchList.size()) {
-    return;
+bool buildImagePipeline(ImagePipeline& p, int scale) {
+  const ImageSink& sink = IMAGE_SINKS[p.format];
+  if (p.stages[0].indexed && !sink.indexed) {
+    addImageStage(p, pullExpandRow, false);
+  }
+  if (scale > 1) {
+    ImageStage& up = addImageStage(p, pullUpscaleRow, p.stages[p.stageCount - 1].indexed);
+    up.factor = scale;
+    up.width *= scale;
+    up.height *= scale;
+  }
+  if (!p.stages[p.stageCount - 1].indexed && sink.indexed) {
+    addImageStage(p, pullDitherRow, true);
+  }
+
+  // One arena: row buffers, then the sink's state and output buffer
+  uint32_t bytes = 0;
+  for (int i = 0; i < p.stageCount; i++) {
+    const ImageStage& stage = p.stages[i];
+    if (stage.pull != pullCanvasRow) {
+      bytes += (stage.width * (stage.indexed ? 1 : 4) + 3) & ~3;
+    }
+    if (stage.pull == pullScreenRow) {
+      bytes += stage.width * 2;
+    }
+  }
+  p.outSize = IMAGE_OUT_CHUNK;
+  bytes += p.outSize;
+  uint32_t stripeBytes = 0;  // Per PNG stripe: rows, IDAT chunk, row above, deflate state
+  if (p.format == IMAGE_PNG) {
+    const ImageStage& last = p.stages[p.stageCount - 1];
+    p.pngStride = 1 + last.width * 4;
+    p.pngStripeBytes = max(1u, PNG_STRIPE_BYTES / p.pngStride) * p.pngStride;
+    p.pngStripeCount = (uint32_t)last.height * p.pngStride > p.pngStripeBytes ? 2 : 1;
+    uint32_t chunkSize = pngStripeChunkSize(p.pngStripeBytes);
+    p.pngStripes[0].chunkSize = p.pngStripes[1].chunkSize = chunkSize;
+    stripeBytes = ((p.pngStripeBytes + 3) & ~3) + ((chunkSize + 3) & ~3) + ((p.pngStride + 3) & ~3) + PNG_DEFLATE_MEM;
+    bytes += (p.pngStride + 3) & ~3;
+  } else if (p.format == IMAGE_GIF) {
+    bytes += GIF_HASH_SIZE * (sizeof(int32_t) + sizeof(uint16_t)) + 4;
+  }
+  p.arena = (uint8_t*)scopedAlloc(bytes + p.pngStripeCount * stripeBytes);
+  if (!p.arena && p.pngStripeCount > 1) {
+    // No room for both stripes: use one, deflated on this core between fills
+    p.pngStripeCount = 1;
+    p.arena = (uint8_t*)scopedAlloc(bytes + stripeBytes);
+  }
+  if (!p.arena) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
   }
+  bytes += p.pngStripeCount * stripeBytes;
+  p.arenaSize = bytes;
+  p.arenaUsed = 0;
 
-  SketchInfo& info = sketchList[index];
+  for (int i = 0; i < p.stageCount; i++) {
+    ImageStage& stage = p.stages[i];
+    if (stage.pull != pullCanvasRow) {
+      stage.buffer = imageArenaTake(p, stage.width * (stage.indexed ? 1 : 4));
+    }
+    if (stage.pull == pullScreenRow) {
+      stage.aux = imageArenaTake(p, stage.width * 2);
+    }
+  }
+  p.out = imageArenaTake(p, p.outSize);
+  p.outUsed = 0;
+  if (p.format == IMAGE_PNG) {
+    for (int i = 0; i < p.pngStripeCount; i++) {
+      p.pngStripes[i].raw = imageArenaTake(p, p.pngStripeBytes);
+      p.pngStripes[i].chunk = imageArenaTake(p, p.pngStripes[i].chunkSize);
+      p.pngStripes[i].above = imageArenaTake(p, p.pngStride - 1);
+    }
+    p.pngCarry = imageArenaTake(p, p.pngStride - 1);
+  }
+  if (p.format == IMAGE_GIF) {
+    p.gifKeys = (int32_t*)imageArenaTake(p, GIF_HASH_SIZE * sizeof(int32_t));
+    p.gifCodes = (uint16_t*)imageArenaTake(p, GIF_HASH_SIZE * sizeof(uint16_t));
+  }
+  return true;
+}
 
-  // Load data from SD if not already cached
-  if (!info.dataLoaded) {
-    String fullPath = "/bitmap16dx/sketches/" + info.filename;
-    File file = SD.open(fullPath.c_str(), FILE_READ);
-    if (!file) {
+/**
+ * Image job step: open the file and start the sink, push a few rows per
+ * step, then finish the file.
+ */
+JobState imagePipelineStep(Job& job) {
+  ImagePipeline* p = (ImagePipeline*)job.context;
+  const ImageSink& sink = IMAGE_SINKS[p->format];
+  ImageStage& last = p->stages[p->stageCount - 1];
+
+  if (!p->begun) {
+    if (!nextImagePath(*p->numbering, p->format, p->path, sizeof(p->path))) {
+      return JOB_FAILED;
+    }
+    p->file = SD.open(p->path, FILE_WRITE);
+    if (!p->file) {
       setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
-      return;
+      return JOB_FAILED;
     }
+    p->begun = true;
+    return sink.begin(*p, last) ? JOB_RUNNING : JOB_FAILED;
+  }
 
-    // Verify file size and detect format version
-    size_t fileSize = file.size();
-    uint8_t formatVersion = 1;
-
-    if (fileSize == SKETCH_FILE_SIZE_V2) {
-      // New format with version byte
-      formatVersion = file.read();
-      if (formatVersion != SKETCH_FORMAT_VERSION) {
-        file.close();
-        return;
+  // Encode the next batch of rows
+  if (p->y < last.height) {
+    int lastRow = min(p->y + EXPORT_ROWS_PER_STEP, last.height);
+    for (; p->y < lastRow; p->y++) {
+      const uint8_t* row = pullImageRow(*p, last, p->y);
+      if (!row || !sink.row(*p, row, last.width)) {
+        return JOB_FAILED;
       }
-    } else if (fileSize == SKETCH_FILE_SIZE_V1) {
-      // Legacy format without version byte
-      formatVersion = 1;
-    } else {
-      // Invalid file size
-      file.close();
-      return;
     }
+    job.progress = p->y * 90 / last.height;
+    return JOB_RUNNING;
+  }
 
-    // Read sketch data into cache
-    info.sketchData.gridSize = file.read();
-    info.sketchData.paletteSize = file.read();
-
-    for (int i = 0; i < 16; i++) {
-      uint8_t high = file.read();
-      uint8_t low = file.read();
-      info.sketchData.paletteColors[i] = (high << 8) | low;
-    }
+  if (!sink.end(*p)) {
+    return JOB_FAILED;
+  }
+  job.progress = 100;
+  setStatusMessage(p->doneMsg);
+  return JOB_DONE;
+}
 
-    for (int py = 0; py < 16; py++) {
-      for (int px = 0; px < 16; px++) {
-        info.sketchData.pixels[py][px] = file.read();
-      }
-    }
+/**
+ * Image job cleanup: free the arena, drop a partial file
+ */
+void imagePipelineFinish(Job& job, JobState state) {
+  ImagePipeline* p = (ImagePipeline*)job.context;
+  closeImagePipeline(p, state == JOB_DONE);
+  delete p;
+}
 
-    file.close();
-    info.dataLoaded = true;  // Mark as cached
-  }
+/**
+ * Run an image pipeline to the end right away (no job)
+ * @return true if the file was written
+ */
+bool runImagePipeline(ImagePipeline* p) {
+  Job job = {"Image", imagePipelineStep, imagePipelineFinish, p, 0, false};
+  JobState state = JOB_RUNNING;
+  while (state == JOB_RUNNING) {
+    state = imagePipelineStep(job);
+  }
+  imagePipelineFinish(job, state);
+  return state == JOB_DONE;
+}
 
-  // Now render the sketch fullscreen using preview rendering pattern
-  Sketch& sketch = info.sketchData;
+/**
+ * Set up a pipeline exporting the current canvas (snapshotted now)
+ * @param scale Output pixels per canvas pixel
+ * @return nullptr (status set) if there's no memory for it
+ */
+ImagePipeline* newCanvasImagePipeline(ImageFormat format, int scale, ImageNumbering& numbering) {
+  ImagePipeline* p = new ImagePipeline();
+  if (!p) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return nullptr;
+  }
+  p->format = format;
+  p->numbering = &numbering;
+  p->doneMsg = StatusMsg::EXPORTED;
+  memcpy(p->pixels, canvas, sizeof(p->pixels));
+  memcpy(p->palette, activeSketch.paletteColors, sizeof(p->palette));
+  p->rgb565 = exportRGB565;
+
+  ImageStage& source = addImageStage(*p, pullCanvasRow, true);
+  source.width = currentGridSize;
+  source.height = currentGridSize;
+  if (!buildImagePipeline(*p, scale)) {
+    delete p;
+    return nullptr;
+  }
+  return p;
+}
 
-  // Get the background color
-  uint16_t bgColor;
-  switch (previewViewBackground) {
-    case 0: bgColor = VIEW_BG_BLACK; break;
-    case 1: bgColor = VIEW_BG_WHITE; break;
-    case 2: bgColor = VIEW_BG_GRAY; break;
-    case 3: bgColor = VIEW_BG_DARK; break;
-    default: bgColor = VIEW_BG_BLACK; break;
+/**
+ * Export current canvas to SD card in the export format setting.
+ * Runs as a background job: the canvas is snapshotted now and encoded over
+ * the next frames while the UI stays responsive.
+ *
+ * @param scale If true, exports at 128×128. If false, exports at logical size (8×8 or 16×16)
+ * @return true if the export was started, false if it couldn't be
+ */
+bool exportCanvasImage(bool scale) {
+  // Ensure SD card is initialized
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
   }
 
-  // Fill screen with background color
-  M5Cardputer.Display.fillScreen(bgColor);
+  ImagePipeline* p = newCanvasImagePipeline((ImageFormat)exportFormat, scale ? 128 / currentGridSize : 1, exportNumbering);
+  if (!p) {
+    return false;
+  }
+  if (!startJob("Export", imagePipelineStep, imagePipelineFinish, p)) {
+    closeImagePipeline(p, false);
+    delete p;
+    return false;
+  }
+  setStatusMessage(StatusMsg::ENCODING);
+  return true;
+}
 
-  // Calculate position to center 128×128 canvas on 240×135 screen
-  const int viewX = 56;
-  const int viewY = 4;
-  const int viewSize = 128;
-  const int viewCellSize = 128 / sketch.gridSize;  // 16px for 8×8, 8px for 16×16
+#if ENABLE_SCREENSHOTS
+/**
+ * Take a screenshot of the full display (240×135 pixels)
+ * Saves to /bitmap16dx/screenshots/screenshot_XXXX.png
+ *
+ * This captures the entire display buffer including UI elements,
+ * not just the canvas area. Always PNG, whatever the export format.
+ *
+ * @return true if successful, false if failed
+ */
+bool takeScreenshot() {
+  // Ensure SD card is initialized
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
+  }
 
-  // Draw each cell
-  for (int y = 0; y < sketch.gridSize; y++) {
-    for (int x = 0; x < sketch.gridSize; x++) {
-      int screenX = viewX + (x * viewCellSize);
-      int screenY = viewY + (y * viewCellSize);
+  ImagePipeline* p = new ImagePipeline();
+  if (!p) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
+  }
+  p->format = IMAGE_PNG;
+  p->numbering = &screenshotNumbering;
+  p->doneMsg = StatusMsg::SCREENSHOT_OK;
 
-      // Get color for this cell
-      if (sketch.pixels[y][x] != 0) {
-        uint16_t cellColor = sketch.paletteColors[sketch.pixels[y][x] - 1];
-        M5Cardputer.Display.fillRect(screenX, screenY, viewCellSize, viewCellSize, cellColor);
-      }
-      // If empty (pixels[y][x] == 0), it stays the background color
-    }
+  ImageStage& source = addImageStage(*p, pullScreenRow, false);
+  source.width = 240;
+  source.height = 135;
+  if (!buildImagePipeline(*p, 1)) {
+    delete p;
+    return false;
   }
 
-#if ENABLE_LED_MATRIX
-  // Update LED matrix to mirror the sketch (8×8 only)
-  updateLEDMatrixFromSketch(sketch);
-#endif
+  // Read the whole screen before anything else draws on it
+  return runImagePipeline(p);
 }
+#endif // ENABLE_SCREENSHOTS
 
 /**
- * Enter View Mode - display canvas at 128×128 with selected background
- * Context-aware: detects if coming from Memory View for gallery mode
+ * Draw the current status message if it's still active
  */
-void enterPreviewView() {
-  inPreviewView = true;
-
-  // Check if we're coming from Memory View (gallery mode)
-  if (inMemoryView) {
-    galleryMode = true;
-    galleryAutoAdvance = false;  // Start paused
-    inMemoryView = false;  // Clear Memory View flag so preview handler runs
-
-    // Start at selected sketch (memoryViewCursor - 1 because cursor 0 is "+")
-    if (memoryViewCursor > 0 && memoryViewCursor - 1 < sketchList.size()) {
-      galleryCurrentIndex = memoryViewCursor - 1;
+void drawStatusMessage() {
+  // Check if we have an active message
+  if (statusMessage[0] != '\0') {
+    if (millis() - statusMessageTime < STATUS_DISPLAY_DURATION) {
+      // Message is still active - check if it changed
+      if (strcmp(statusMessage, lastDrawnMessage) != 0) {
+        // New message - trigger redraw to replace old one
+        statusMessageJustCleared = true;
+        strncpy(lastDrawnMessage, statusMessage, sizeof(lastDrawnMessage) - 1);
+        lastDrawnMessage[sizeof(lastDrawnMessage) - 1] = '\0';
+      }
     } else {
-      galleryCurrentIndex = 0;  // Fallback to first sketch
+      // Message expired - trigger clear
+      if (lastDrawnMessage[0] != '\0') {
+        statusMessageJustCleared = true;
+        lastDrawnMessage[0] = '\0';
+      }
+      statusMessage[0] = '\0';
     }
+  }
+}
 
-    galleryLastAdvanceTime = millis();
-
-    // Load and display sketch from gallery
-    loadGallerySketch(galleryCurrentIndex);
-    return;  // Exit early - loadGallerySketch handles rendering
+/**
+ * Draw battery icon below fill icon
+ * Only redraws when percentage changes
+ * Checks battery level every 30 seconds to reduce flashing
+ */
+void drawBatteryIndicator() {
+  // The live tile strip covers the battery slot
+  if (canvasTileStrip) {
+    return;
   }
 
-  // Canvas preview mode (not from Memory View)
-  galleryMode = false;
+  unsigned long currentTime = millis();
 
-  // Get the background color based on current selection
-  uint16_t bgColor;
-  switch (previewViewBackground) {
-    case 0: bgColor = VIEW_BG_BLACK; break;
-    case 1: bgColor = VIEW_BG_WHITE; break;
-    case 2: bgColor = VIEW_BG_GRAY; break;
-    case 3: bgColor = VIEW_BG_DARK; break;
-    default: bgColor = VIEW_BG_BLACK; break;
+  // Check if we need to force a redraw (when lastBatteryPercent is -1)
+  bool forceRedraw = (lastBatteryPercent == -1);
+
+  // Only check battery every 30 seconds (but always check on first call or forced)
+  if (!forceRedraw && !batteryFirstCheck && currentTime - lastBatteryCheckTime < BATTERY_CHECK_INTERVAL) {
+    return;
   }
 
-  // Fill screen with selected background color
-  M5Cardputer.Display.fillScreen(bgColor);
+  batteryFirstCheck = false;
+  lastBatteryCheckTime = currentTime;
 
-  // Calculate position to center 128×128 canvas on 240×135 screen
-  // X: (240 - 128) / 2 = 56
-  // Y: (135 - 128) / 2 = 3.5, use 4 for integer alignment
-  const int viewX = 56;
-  const int viewY = 4;
-  const int viewSize = 128;
-  const int viewCellSize = 128 / currentGridSize;  // 16px for 8×8, 8px for 16×16
+  // Get current battery percentage
+  int batteryPercent = M5Cardputer.Power.getBatteryLevel();
 
-  // Draw each cell of the canvas
-  for (int y = 0; y < currentGridSize; y++) {
-    for (int x = 0; x < currentGridSize; x++) {
-      int screenX = viewX + (x * viewCellSize);
-      int screenY = viewY + (y * viewCellSize);
+  // Redraw if changed or forced
+  if (batteryPercent != lastBatteryPercent || forceRedraw) {
+    // Clear old icon area (24×24 icon below fill icon)
+    M5Cardputer.Display.fillRect(3, 85, 24, 24, currentTheme->background);
 
-      // Get color for this cell
-      if (canvas[y][x] != 0) {
-        // There's a pixel here - use its color from the active sketch's palette
-        uint16_t cellColor = activeSketch.paletteColors[canvas[y][x] - 1];
-        M5Cardputer.Display.fillRect(screenX, screenY, viewCellSize, viewCellSize, cellColor);
-      }
-      // If empty (canvas[y][x] == 0), it stays the background color
+    // Select icon based on battery level
+    const unsigned char* batteryIcon;
+    if (batteryPercent < 10) {
+      batteryIcon = ICON_BATTERY_0;  // Low (<10%)
+    } else if (batteryPercent < 50) {
+      batteryIcon = ICON_BATTERY_10;  // Medium (10-50%)
+    } else if (batteryPercent < 90) {
+      batteryIcon = ICON_BATTERY_50;  // High (50-90%)
+    } else {
+      batteryIcon = ICON_BATTERY_90;  // Full (>90%)
     }
-  }
 
-#if ENABLE_LED_MATRIX
-  // Update LED matrix to mirror the live canvas (8×8 only, no cursor)
-  updateLEDMatrix(false);
-#endif
+    // Draw battery icon at (3, 85) - below fill icon with 4px spacing
+    drawIcon(3, 85, batteryIcon, 24, 24, true);
+
+    lastBatteryPercent = batteryPercent;
+  }
 }
 
+// ============================================================================
+// TILED PREVIEW
+// ============================================================================
+// Shows a sketch repeated edge to edge so seams in patterns are easy to spot.
+// One repeat is rendered into tileSprite, then pushed to every position;
+// redrawing after an edit costs one tile render plus the block copies.
+
+const int PREVIEW_TILE_SIZE = 48;  // Full-screen preview: 6px cells at 8×8, 3px at 16×16
+const int STRIP_TILE_SIZE = 32;    // Canvas strip: 4px cells at 8×8, 2px at 16×16
+const int STRIP_X = 3;             // Strip replaces the tool icons and battery
+const int STRIP_Y = 4;
+const int STRIP_W = 48;
+const int STRIP_H = 116;           // Stops above the status message at y=124
+
 /**
- * Exit View Mode and return to canvas or Memory View
- * Context-aware: returns to Memory View if in gallery mode
+ * Fill an area of the display with repeats of a sketch
+ * Repeats are laid out around a tile centered in the area; with offset set,
+ * every other row is shifted by half a tile (brick layout)
  */
-void exitPreviewView() {
-  inPreviewView = false;
+void drawTiledSketch(const uint8_t pixels[16][16], int gridSize, const uint16_t* palette, uint16_t emptyColor,
+                     int areaX, int areaY, int areaW, int areaH, int tileSize, bool offset) {
+  int cellSize = tileSize / gridSize;
 
-  if (galleryMode) {
-    // Return to Memory View at current gallery position
-    memoryViewCursor = galleryCurrentIndex + 1;  // +1 for "+" button offset
-    galleryMode = false;
-    galleryAutoAdvance = false;
-    inMemoryView = true;  // Re-enable Memory View so handler runs
+  // (Re)create the sprite only when the tile size changes
+  if (!tileSpriteAvailable || tileSpriteSize != tileSize) {
+    if (tileSpriteAvailable) {
+      tileSprite.deleteSprite();
+    }
+    tileSpriteAvailable = tileSprite.createSprite(tileSize, tileSize) != nullptr;
+    tileSpriteSize = tileSize;
+  }
 
-    // Redraw Memory View
-    M5Cardputer.Display.fillScreen(currentTheme->background);
-    drawMemoryView(true);
+  if (tileSpriteAvailable) {
+    tileSprite.fillSprite(emptyColor);
+    for (int y = 0; y < gridSize; y++) {
+      for (int x = 0; x < gridSize; x++) {
+        if (pixels[y][x] != 0) {
+          tileSprite.fillRect(x * cellSize, y * cellSize, cellSize, cellSize, palette[pixels[y][x] - 1]);
+        }
+      }
+    }
+  }
 
-#if ENABLE_LED_MATRIX
-    // Keep displaying the currently viewed sketch on LED matrix
-    if (galleryCurrentIndex >= 0 && galleryCurrentIndex < sketchList.size()) {
-      SketchInfo& info = sketchList[galleryCurrentIndex];
-      if (info.dataLoaded) {
-        updateLEDMatrixFromSketch(info.sketchData);
+  // Anchor the grid of repeats on a centered tile
+  int centerX = areaX + (areaW - tileSize) / 2;
+  int centerY = areaY + (areaH - tileSize) / 2;
+  int originX = centerX - ((centerX - areaX + tileSize - 1) / tileSize) * tileSize;
+  int originY = centerY - ((centerY - areaY + tileSize - 1) / tileSize) * tileSize;
+  int centerRow = (centerY - originY) / tileSize;
+
+  M5Cardputer.Display.setClipRect(areaX, areaY, areaW, areaH);
+  M5Cardputer.Display.startWrite();
+  for (int row = 0, ty = originY; ty < areaY + areaH; row++, ty += tileSize) {
+    int shift = (offset && ((row - centerRow) & 1)) ? tileSize / 2 : 0;
+    for (int tx = originX - (shift ? tileSize : 0) + shift; tx < areaX + areaW; tx += tileSize) {
+      if (tileSpriteAvailable) {
+        tileSprite.pushSprite(&M5Cardputer.Display, tx, ty);
       } else {
-        // If data not loaded, clear LED matrix
-        FastLED.clear();
-        FastLED.show();
+        // No memory for the sprite: draw this repeat cell by cell
+        M5Cardputer.Display.fillRect(tx, ty, tileSize, tileSize, emptyColor);
+        for (int y = 0; y < gridSize; y++) {
+          for (int x = 0; x < gridSize; x++) {
+            if (pixels[y][x] != 0) {
+              M5Cardputer.Display.fillRect(tx + x * cellSize, ty + y * cellSize, cellSize, cellSize, palette[pixels[y][x] - 1]);
+            }
+          }
+        }
       }
-    } else {
-      // Invalid index, clear LED matrix
-      FastLED.clear();
-      FastLED.show();
     }
-#endif
+  }
+  M5Cardputer.Display.endWrite();
+  M5Cardputer.Display.clearClipRect();
+}
 
-    return;  // Exit early
+/**
+ * Release the tile sprite (kept while the live strip is showing)
+ */
+void releaseTileSprite() {
+  if (tileSpriteAvailable && !canvasTileStrip) {
+    tileSprite.deleteSprite();
+    tileSpriteAvailable = false;
   }
+}
 
-  // Return to canvas view (existing behavior)
-  M5Cardputer.Display.fillScreen(currentTheme->background);
-  drawGrid();
-  drawPalette();
-  drawCursor();
+/**
+ * Redraw the live tile strip beside the canvas from the current canvas
+ */
+void drawCanvasTileStrip() {
+  drawTiledSketch(canvas, currentGridSize, activeSketch.paletteColors, currentTheme->background,
+                  STRIP_X, STRIP_Y, STRIP_W, STRIP_H, STRIP_TILE_SIZE, previewTileOffset);
+}
 
-  // Redraw icons in upper left corner
-  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
+/**
+ * Draw the tool icons in the upper left corner (or the live tile strip in their place)
+ */
+void drawToolIcons() {
+  if (canvasTileStrip) {
+    drawCanvasTileStrip();
+    return;
+  }
+
+  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
   drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
   drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
   // drawIcon(3, 84, ICON_INFO, ICON_INFO_WIDTH, ICON_INFO_HEIGHT, ICON_INFO_IS_INDEXED);
+}
 
-  // Redraw battery indicator
-  lastBatteryPercent = -1;  // Force redraw
-  batteryFirstCheck = true;  // Force immediate check
-  drawBatteryIndicator();
+/**
+ * Toggle the live tile strip (Fn+V in canvas view)
+ */
+void toggleCanvasTileStrip() {
+  canvasTileStrip = !canvasTileStrip;
+
+  // Clear the left column (icons, battery and strip all live here)
+  M5Cardputer.Display.fillRect(STRIP_X, 3, STRIP_W, STRIP_Y + STRIP_H - 3, currentTheme->background);
+  drawToolIcons();
+
+  if (!canvasTileStrip) {
+    releaseTileSprite();
+    lastBatteryPercent = -1;  // Force redraw
+    drawBatteryIndicator();
+  }
+}
+
+// ============================================================================
+// FORWARD DECLARATIONS
+// ============================================================================
+void drawGrid();
+void drawPalette();
+void drawCursor();
+void drawHelpView();
+void drawMemoryView(bool fullRedraw = true);
+void drawMemorySketchThumbnail(int slotIndex, int x, int y, int thumbSize);
+void drawCreateNewSketchThumbnail(int x, int y, int thumbSize);
+void drawSketchThumbnail(int sketchIndex, int x, int y, int thumbSize);
+void drawMemoryViewCursor(int itemIndex, int x, int y, int thumbSize);
+void drawCollectionPicker();
+void updatePaletteFilter();
+bool loadPaletteFromHex(const char* filepath, uint16_t* colors, uint8_t* size);
+void loadGallerySketch(int index);  // Load and display sketch in gallery preview mode
+void saveUndo();
+bool saveSessionSnapshot();
 
 #if ENABLE_LED_MATRIX
-  // Restore canvas display on LED matrix
-  updateLEDMatrix();
+// LED matrix support functions
+void updateLEDMatrix(bool showCursor = true);
+void updateLEDMatrixFromSketch(Sketch& sketch);
+void toggleLEDMatrix();
+void applyLEDLayout();
+void stopLEDPlaylist();
+void rebakeLEDPlaylist();
+#endif
+
+#if ENABLE_DEVICE_BENCH
+bool startDeviceBench();  // Hidden benchmark suite (settings Fn+B)
+#endif
+
+#if ENABLE_BLUETOOTH
+// Bluetooth keyboard support functions
+void btUpdate();
+void btStartScan();
+void btStartReconnect();
+void btStop(bool forget);
+void btForgetBondedDevice();
+int btScanSecondsLeft();
+bool btProcessHIDReport(const uint8_t* data, size_t len);
+char btHidToChar(uint8_t keycode, bool shift);
+void btQueuePush(char c);
+bool btQueuePop(char& c);
+void btClearInputState();
 #endif
+
+// ============================================================================
+// CANVAS BIT PLANES
+// ============================================================================
+// A second copy of canvas[][] as bit masks: for every palette index, one mask
+// per row (bit x = column x), plus a mask of the occupied cells. Single cells
+// are written through setCanvasCell(), which keeps both in step; code that
+// copies whole sketches into canvas[][] calls syncCanvasPlanes() afterwards.
+// Whole-canvas operations (fill, color select, flips, shifts, outline, finding the
+// cells to redraw) then handle a row per instruction instead of a cell.
+// Everything is templated on the row type, so a wider canvas only needs a
+// wider Row (uint32_t, uint64_t).
+
+template <typename Row, int Height>
+struct BitPlanes {
+  Row color[16][Height];  // color[i - 1][y]: cells holding index i
+  Row occupied[Height];   // Cells holding any index
+  uint16_t used;          // Bit i - 1: index i may have cells (only rebuilds clear bits)
+};
+
+typedef uint16_t CanvasRow;
+typedef BitPlanes<CanvasRow, 16> CanvasPlanes;
+CanvasPlanes canvasPlanes;
+CanvasRow canvasChanged[16] = {0};  // Cells to redraw after a whole-canvas operation
+
+/**
+ * Mask of the first width columns
+ */
+template <typename Row>
+Row planeRowMask(int width) {
+  return width >= (int)(sizeof(Row) * 8) ? (Row)~(Row)0 : (Row)(((Row)1 << width) - 1);
 }
 
 /**
- * Enter Palette Menu - horizontally scrolling palette selector
+ * Rebuild planes from an index bitmap
  */
-void enterPaletteView() {
-  inPaletteView = true;
+template <typename Row, int Height, int Width>
+void buildPlanes(BitPlanes<Row, Height>& planes, const uint8_t (&pixels)[Height][Width]) {
+  static_assert(Width <= (int)(sizeof(Row) * 8), "Row type too narrow");
+  memset(&planes, 0, sizeof(planes));
+  for (int y = 0; y < Height; y++) {
+    for (int x = 0; x < Width; x++) {
+      uint8_t value = pixels[y][x];
+      if (value) {
+        planes.color[value - 1][y] |= (Row)1 << x;
+        planes.occupied[y] |= (Row)1 << x;
+        planes.used |= 1 << (value - 1);
+      }
+    }
+  }
+}
 
-  // Create canvas sprite on-demand (64KB)
-  if (!paletteCanvas.createSprite(240, 135)) {
-    paletteCanvasAvailable = false;
-  } else {
-    paletteCanvasAvailable = true;
+/**
+ * Cells among the first width of row y holding index (0 = empty)
+ */
+template <typename Row, int Height>
+Row planeSelect(const BitPlanes<Row, Height>& planes, uint8_t index, int y, int width) {
+  return (index ? planes.color[index - 1][y] : (Row)~planes.occupied[y]) & planeRowMask<Row>(width);
+}
+
+/**
+ * Set every cell in mask to index, in all planes
+ */
+template <typename Row, int Height>
+void planePaint(BitPlanes<Row, Height>& planes, const Row (&mask)[Height], uint8_t index) {
+  for (int y = 0; y < Height; y++) {
+    if (!mask[y]) {
+      continue;
+    }
+    for (int i = 0; i < 16; i++) {
+      if (planes.used & (1 << i)) {
+        planes.color[i][y] &= ~mask[y];
+      }
+    }
+    if (index) {
+      planes.color[index - 1][y] |= mask[y];
+      planes.occupied[y] |= mask[y];
+      planes.used |= 1 << (index - 1);
+    } else {
+      planes.occupied[y] &= ~mask[y];
+    }
   }
+}
 
-  // Reset filters to "all" when entering palette menu
-  paletteFilterSize = 0;
-  paletteFilterUser = false;
-  updatePaletteFilter();
+/**
+ * Grow seed along a row through the runs of allowed cells it touches
+ * (log2 steps each way: the shifted masks move whole runs at once)
+ */
+template <typename Row>
+Row planeSpreadRow(Row seed, Row allowed) {
+  Row up = seed & allowed;
+  Row down = up;
+  Row upAllowed = allowed;
+  Row downAllowed = allowed;
+  for (int step = 1; step < (int)(sizeof(Row) * 8); step <<= 1) {
+    up |= upAllowed & (Row)(up << step);
+    upAllowed &= (Row)(upAllowed << step);
+    down |= downAllowed & (Row)(down >> step);
+    downAllowed &= (Row)(downAllowed >> step);
+  }
+  return up | down;
+}
 
-  // Set cursor to currently active palette (if we can identify it)
-  paletteViewCursor = 0;  // Default to first palette
-  // Compare active sketch's palette with each catalog palette to find active one
-  for (int p = 0; p < totalPaletteCount; p++) {
-    bool matches = true;
-    for (int c = 0; c < 16; c++) {
-      if (activeSketch.paletteColors[c] != pgm_read_word(&allPalettes[p][c])) {
-        matches = false;
-        break;
+/**
+ * Cells 4-connected to (x, y) that hold the same index, within the grid
+ */
+template <typename Row, int Height>
+void planeFillRegion(const BitPlanes<Row, Height>& planes, int x, int y, uint8_t index,
+                     int width, int height, Row (&region)[Height]) {
+  Row allowed[Height];
+  for (int row = 0; row < Height; row++) {
+    allowed[row] = row < height ? planeSelect(planes, index, row, width) : 0;
+    region[row] = 0;
+  }
+  region[y] = planeSpreadRow<Row>((Row)1 << x, allowed[y]);
+
+  // Sweep down then up, spreading into each row from its neighbours, until nothing grows
+  bool grew = true;
+  while (grew) {
+    grew = false;
+    for (int pass = 0; pass < 2; pass++) {
+      for (int i = 0; i < height; i++) {
+        int row = pass ? height - 1 - i : i;
+        Row seed = region[row];
+        if (row > 0) seed |= region[row - 1];
+        if (row < height - 1) seed |= region[row + 1];
+        Row grown = planeSpreadRow<Row>(seed, allowed[row]);
+        if (grown != region[row]) {
+          region[row] = grown;
+          grew = true;
+        }
       }
     }
-    if (matches) {
-      // Find this palette in the filtered list
-      for (int f = 0; f < filteredPaletteCount; f++) {
-        if (filteredPaletteIndices[f] == p) {
-          paletteViewCursor = f;
-          break;
+  }
+}
+
+/**
+ * Reverse the bits of a row (swapping halves, then quarters, ...)
+ */
+template <typename Row>
+Row planeReverseRow(Row value) {
+  Row mask = (Row)~(Row)0;
+  for (int step = sizeof(Row) * 4; step > 0; step >>= 1) {
+    mask ^= (Row)(mask << step);
+    value = (Row)(((value >> step) & mask) | ((Row)(value << step) & (Row)~mask));
+  }
+  return value;
+}
+
+/**
+ * Mirror the first width columns of the first height rows (vertical = top to bottom)
+ */
+template <typename Row, int Height>
+void planeFlip(BitPlanes<Row, Height>& planes, int width, int height, bool vertical) {
+  Row mask = planeRowMask<Row>(width);
+  int unused = sizeof(Row) * 8 - width;
+  for (int i = 0; i <= 16; i++) {
+    if (i < 16 && !(planes.used & (1 << i))) {
+      continue;  // Most sketches use only a few of the indices
+    }
+    Row* rows = i < 16 ? planes.color[i] : planes.occupied;
+    if (vertical) {
+      for (int y = 0; y < height / 2; y++) {
+        Row top = rows[y];
+        Row bottom = rows[height - 1 - y];
+        rows[y] = (top & ~mask) | (bottom & mask);
+        rows[height - 1 - y] = (bottom & ~mask) | (top & mask);
+      }
+    } else {
+      for (int y = 0; y < height; y++) {
+        if (rows[y] & mask) {
+          rows[y] = (rows[y] & ~mask) | (Row)(planeReverseRow<Row>(rows[y] & mask) >> unused);
         }
       }
-      break;
     }
   }
+}
 
-  // Initialize scroll position to cursor (no animation on first show)
-  paletteViewScrollPos = (float)paletteViewCursor;
+/**
+ * Move the first width × height cells by (dx, dy), wrapping at the edges
+ */
+template <typename Row, int Height>
+void planeShift(BitPlanes<Row, Height>& planes, int dx, int dy, int width, int height) {
+  Row mask = planeRowMask<Row>(width);
+  dx = ((dx % width) + width) % width;
+  dy = ((dy % height) + height) % height;
+  for (int i = 0; i <= 16; i++) {
+    if (i < 16 && !(planes.used & (1 << i))) {
+      continue;
+    }
+    Row* rows = i < 16 ? planes.color[i] : planes.occupied;
+    Row moved[Height];
+    for (int y = 0; y < height; y++) {
+      Row inside = rows[y] & mask;
+      if (dx) {
+        inside = ((Row)(inside << dx) | (Row)(inside >> (width - dx))) & mask;
+      }
+      moved[(y + dy) % height] = (rows[(y + dy) % height] & ~mask) | inside;
+    }
+    memcpy(rows, moved, height * sizeof(Row));
+  }
+}
 
-  // Clear screen and draw palette menu
-  M5Cardputer.Display.fillScreen(currentTheme->background);
+/**
+ * Empty cells next to an occupied one (4-connected), within the grid
+ */
+template <typename Row, int Height>
+void planeOutline(const BitPlanes<Row, Height>& planes, int width, int height, Row (&outline)[Height]) {
+  Row mask = planeRowMask<Row>(width);
+  for (int y = 0; y < Height; y++) {
+    if (y >= height) {
+      outline[y] = 0;
+      continue;
+    }
+    Row occupied = planes.occupied[y] & mask;
+    Row around = (Row)(occupied << 1) | (Row)(occupied >> 1);
+    if (y > 0) around |= planes.occupied[y - 1];
+    if (y < height - 1) around |= planes.occupied[y + 1];
+    outline[y] = around & ~planes.occupied[y] & mask;
+  }
 }
 
 /**
- * Exit Palette Menu and return to canvas
+ * Cells whose index differs between two plane sets
+ * @return true if any cell differs
  */
-void exitPaletteView() {
-  inPaletteView = false;
+template <typename Row, int Height>
+bool planeDiff(const BitPlanes<Row, Height>& a, const BitPlanes<Row, Height>& b, Row (&diff)[Height]) {
+  uint16_t used = a.used | b.used;
+  Row any = 0;
+  for (int y = 0; y < Height; y++) {
+    Row d = a.occupied[y] ^ b.occupied[y];
+    for (int i = 0; i < 16; i++) {
+      if (used & (1 << i)) {
+        d |= a.color[i][y] ^ b.color[i][y];
+      }
+    }
+    diff[y] = d;
+    any |= d;
+  }
+  return any != 0;
+}
 
-  // Free canvas sprite memory (64KB)
-  paletteCanvas.deleteSprite();
-  paletteCanvasAvailable = false;
+/**
+ * Write one canvas cell, keeping the planes in step
+ */
+void setCanvasCell(int x, int y, uint8_t value) {
+  uint8_t old = canvas[y][x];
+  if (old == value) {
+    return;
+  }
+  CanvasRow bit = (CanvasRow)1 << x;
+  if (old) {
+    canvasPlanes.color[old - 1][y] &= ~bit;
+    canvasPlanes.occupied[y] &= ~bit;
+  }
+  if (value) {
+    canvasPlanes.color[value - 1][y] |= bit;
+    canvasPlanes.occupied[y] |= bit;
+    canvasPlanes.used |= 1 << (value - 1);
+  }
+  canvas[y][x] = value;
+}
 
-  // Redraw the canvas view
-  M5Cardputer.Display.fillScreen(currentTheme->background);
-  drawGrid();
-  drawPalette();
-  drawCursor();
+/**
+ * Rebuild the planes after canvas[][] was copied into wholesale
+ */
+void syncCanvasPlanes() {
+  buildPlanes(canvasPlanes, canvas);
+}
 
-  // Redraw icons in upper left corner
-  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-  drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-  drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
-  // drawIcon(3, 84, ICON_INFO, ICON_INFO_WIDTH, ICON_INFO_HEIGHT, ICON_INFO_IS_INDEXED);
+/**
+ * Copy the planes back into canvas[][] and note the cells that changed
+ * since before (a copy of the planes taken at the start of the operation)
+ */
+void applyCanvasPlanes(const CanvasPlanes& before) {
+  CanvasRow diff[16];
+  if (!planeDiff(before, canvasPlanes, diff)) {
+    return;
+  }
+  for (int y = 0; y < 16; y++) {
+    canvasChanged[y] |= diff[y];
+    for (CanvasRow bits = diff[y]; bits; bits &= bits - 1) {
+      canvas[y][__builtin_ctz(bits)] = 0;
+    }
+    for (int i = 0; i < 16; i++) {
+      if (!(canvasPlanes.used & (1 << i))) {
+        continue;
+      }
+      for (CanvasRow bits = diff[y] & canvasPlanes.color[i][y]; bits; bits &= bits - 1) {
+        canvas[y][__builtin_ctz(bits)] = i + 1;
+      }
+    }
+  }
+}
 
-  // Redraw battery indicator
-  lastBatteryPercent = -1;  // Force redraw
-  batteryFirstCheck = true;  // Force immediate check
-  drawBatteryIndicator();
+/**
+ * Set every cell in mask to index (canvas, planes and the redraw mask)
+ */
+void paintCanvasCells(const CanvasRow (&mask)[16], uint8_t index) {
+  CanvasPlanes before = canvasPlanes;
+  planePaint(canvasPlanes, mask, index);
+  applyCanvasPlanes(before);
 }
 
 // ============================================================================
-// SETTINGS VIEW
+// STROKES (drawing with Enter or Delete held)
 // ============================================================================
+// A stroke opens when Enter (draw) or Delete (erase) goes down and closes when
+// it's released. It saves one undo snapshot for all the cells it paints, adds
+// them to canvasChanged for the next redraw, and while it's open the LED
+// matrix is refreshed at most every STROKE_LED_INTERVAL_MS instead of once
+// per cell (the last refresh happens when it closes).
+
+#define STROKE_LED_INTERVAL_MS 33  // ~30 Hz LED refresh while a stroke is open
+
+struct CanvasStroke {
+  bool open;
+  uint8_t value;               // Index being drawn (0 = erasing)
+  uint16_t cells;              // Cells changed so far
+  unsigned long ledFlushMs;    // Last LED refresh while open
+};
+CanvasStroke canvasStroke = {};
 
 /**
- * Enter Settings Menu - vertical list of persistent preferences
+ * Open a stroke painting value, unless one painting it is already open.
+ * A different value closes the open stroke and starts another (new undo).
  */
-void enterSettingsView() {
-  inSettingsView = true;
-  settingsViewCursor = 0;  // Start at top
-
-  // Create canvas sprite on-demand (64KB)
-  if (!settingsCanvas.createSprite(240, 135)) {
-    settingsCanvasAvailable = false;
-  } else {
-    settingsCanvasAvailable = true;
+void beginStroke(uint8_t value) {
+  if (canvasStroke.open && canvasStroke.value == value) {
+    return;
   }
-
-  // Clear screen
-  M5Cardputer.Display.fillScreen(currentTheme->background);
+  saveUndo();  // The only snapshot for the whole stroke
+  canvasStroke.open = true;
+  canvasStroke.value = value;
+  canvasStroke.cells = 0;
+  canvasStroke.ledFlushMs = millis();
 }
 
 /**
- * Exit Settings Menu and return to canvas
+ * Paint the open stroke's value into a cell
+ * @return true if the cell changed
  */
-void exitSettingsView() {
-  inSettingsView = false;
-
-  // Free canvas sprite memory (64KB)
-  settingsCanvas.deleteSprite();
-  settingsCanvasAvailable = false;
-
-  // Redraw the canvas view (same pattern as exitPaletteView)
-  M5Cardputer.Display.fillScreen(currentTheme->background);
-  drawGrid();
-  drawPalette();
-  drawCursor();
-
-  // Redraw icons
-  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-  drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-  drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
-
-  // Redraw battery indicator
-  lastBatteryPercent = -1;
-  batteryFirstCheck = true;
-  drawBatteryIndicator();
+bool strokeCell(int x, int y) {
+  if (!canvasStroke.open || canvas[y][x] == canvasStroke.value) {
+    return false;
+  }
+  setCanvasCell(x, y, canvasStroke.value);
+  canvasChanged[y] |= (CanvasRow)1 << x;
+  canvasStroke.cells++;
+  LED_CANVAS_UPDATED();
+  return true;
 }
 
-
 /**
- * Draw Settings Menu UI to canvas
+ * Close the open stroke (its key was released)
  */
-void drawSettingsView() {
-  // Check if canvas is available
-  if (!settingsCanvasAvailable) {
-    M5Cardputer.Display.fillScreen(currentTheme->background);
-    M5Cardputer.Display.setTextColor(TFT_RED);
-    M5Cardputer.Display.setCursor(10, 50);
-    M5Cardputer.Display.println("WARNING: Low memory!");
-    M5Cardputer.Display.setCursor(10, 65);
-    M5Cardputer.Display.println("Cannot show settings.");
-    M5Cardputer.Display.setCursor(10, 85);
-    M5Cardputer.Display.setTextColor(currentTheme->text);
-    M5Cardputer.Display.println("Press ESC (`) to exit");
+void endStroke() {
+  if (!canvasStroke.open) {
     return;
   }
+  canvasStroke.open = false;
+  LED_CANVAS_UPDATED();  // Catch the LEDs up with the last cells
+}
 
-  // Clear canvas
-  settingsCanvas.fillSprite(currentTheme->background);
+/**
+ * Whether a pending LED refresh should go out now: always outside a
+ * stroke, at most every STROKE_LED_INTERVAL_MS during one
+ */
+bool strokeLEDFlushDue() {
+  if (!canvasStroke.open) {
+    return true;
+  }
+  if (millis() - canvasStroke.ledFlushMs < STROKE_LED_INTERVAL_MS) {
+    return false;
+  }
+  canvasStroke.ledFlushMs = millis();
+  return true;
+}
 
-  // Draw title
-  settingsCanvas.setTextColor(currentTheme->text);
-  settingsCanvas.setTextSize(1);
-  settingsCanvas.setCursor(4, 4);
-  settingsCanvas.print("SETTINGS");
+// ============================================================================
+// CANVAS OPERATIONS
+// ============================================================================
+
+/**
+ * Save current canvas state to undo buffer
+ * Note: This is for regular drawing undo, not sketch deletion operations
+ */
+void saveUndo() {
+  for (int y = 0; y < currentGridSize; y++) {
+    for (int x = 0; x < currentGridSize; x++) {
+      undoCanvas[y][x] = canvas[y][x];
+    }
+  }
+  // Clear palette undo info (this is just a regular drawing undo)
+  undoPaletteSize = 0;
+  undoGridSize = 0;
+  undoAvailable = true;
+  canvasStroke.open = false;  // Any other edit ends the stroke (beginStroke reopens it)
+}
+
+/**
+ * Restore canvas from undo buffer
+ */
+void restoreUndo() {
+  if (!undoAvailable) {
+    setStatusMessage(StatusMsg::NO_UNDO);
+    return;
+  }
+
+  // If we have saved grid size info (from sketch deletion), restore it
+  if (undoGridSize > 0) {
+    currentGridSize = undoGridSize;
+    currentCellSize = (currentGridSize == 8) ? 16 : 8;
+
+    // Keep cursor in bounds
+    if (cursorX >= currentGridSize) cursorX = currentGridSize - 1;
+    if (cursorY >= currentGridSize) cursorY = currentGridSize - 1;
+  }
+
+  // Restore all pixels (always restore full 16x16 to handle grid size changes)
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      canvas[y][x] = undoCanvas[y][x];
+    }
+  }
+  syncCanvasPlanes();
+
+  // If we have palette info saved (from sketch deletion), restore it to the active sketch
+  if (undoPaletteSize > 0) {
+    activeSketch.paletteSize = undoPaletteSize;
+    activeSketch.gridSize = undoGridSize;
+    for (int i = 0; i < 16; i++) {
+      activeSketch.paletteColors[i] = undoPaletteColors[i];
+    }
+  }
+
+  undoAvailable = false;
+  canvasStroke.open = false;  // Cells painted from here on start a new stroke
+
+  // Update LED matrix with restored canvas
+  LED_CANVAS_UPDATED();
+
+  setStatusMessage(StatusMsg::UNDO);
+}
+
+/**
+ * Clear the entire canvas
+ * This saves the current state to undo before clearing
+ */
+void clearCanvas() {
+  saveUndo();
+
+  CanvasRow grid[16] = {0};
+  for (int y = 0; y < currentGridSize; y++) {
+    grid[y] = planeRowMask<CanvasRow>(currentGridSize);
+  }
+  paintCanvasCells(grid, 0);
+
+  setStatusMessage(StatusMsg::CLEAR);
+}
+
+/**
+ * Flood fill - fills all connected pixels of the same color with the selected color
+ *
+ * This is like the paint bucket tool in image editors. Starting from the cursor position,
+ * it fills all adjacent pixels that match the original color with the currently selected color.
+ *
+ * The region is found on the bit planes a row at a time (see planeFillRegion).
+ * Only considers 4-way connectivity (up, down, left, right) - not diagonal.
+ *
+ * @param startX Starting X position (cursor position)
+ * @param startY Starting Y position (cursor position)
+ * @param fillColor Color to fill with (currently selected color)
+ */
+void floodFill(int startX, int startY, uint8_t fillColor) {
+  // Get the original color at the starting position
+  uint8_t originalColor = canvas[startY][startX];
+
+  // If the original color is the same as fill color, nothing to do
+  if (originalColor == fillColor) {
+    return;
+  }
+
+  CanvasRow region[16];
+  planeFillRegion(canvasPlanes, startX, startY, originalColor, currentGridSize, currentGridSize, region);
+  paintCanvasCells(region, fillColor);
+}
+
+/**
+ * Toggle between 8×8 and 16×16 grid modes
+ *
+ * When switching from 16×16 to 8×8, the top-left 8×8 portion is preserved.
+ * When switching from 8×8 to 16×16, the 8×8 art appears in the top-left.
+ */
+void toggleGridSize() {
+  // Toggle between 8 and 16
+  if (currentGridSize == 8) {
+    currentGridSize = 16;
+    currentCellSize = 8;  // Smaller cells for more pixels
+    setStatusMessage(StatusMsg::GRID_16X16);
+  } else {
+    currentGridSize = 8;
+    currentCellSize = 16;  // Larger cells for fewer pixels
+    setStatusMessage(StatusMsg::GRID_8X8);
+  }
+
+  // Keep cursor in bounds
+  if (cursorX >= currentGridSize) cursorX = currentGridSize - 1;
+  if (cursorY >= currentGridSize) cursorY = currentGridSize - 1;
+
+  // Update LED matrix (turn off in 16×16 mode, turn on in 8×8 mode)
+  LED_CANVAS_UPDATED();
+}
+
+/**
+ * Open a sketch from SD card by filename
+ */
+void openSketch(String filename) {
+  if (!loadSketchFromSD(filename)) {
+    setStatusMessage(StatusMsg::FAILED_TO_LOAD);
+    return;
+  }
+
+  // Validate palette
+  if (activeSketch.paletteSize == 0 || activeSketch.paletteSize > 16) {
+    activeSketch.paletteSize = 16;
+  }
+
+  // Copy to canvas
+  currentGridSize = activeSketch.gridSize;
+  currentCellSize = (currentGridSize == 8) ? 16 : 8;
+
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      canvas[y][x] = activeSketch.pixels[y][x];
+    }
+  }
+  syncCanvasPlanes();
+
+  if (cursorX >= currentGridSize) cursorX = currentGridSize - 1;
+  if (cursorY >= currentGridSize) cursorY = currentGridSize - 1;
+
+  selectedColor = 1;
+
+  // Update LED matrix with newly loaded canvas
+  LED_CANVAS_UPDATED();
+
+  setStatusMessage(StatusMsg::LOADED);
+}
+
+/**
+ * Create a new blank sketch
+ */
+void createNewSketch() {
+  initializeActiveSketch();
+
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      canvas[y][x] = 0;
+    }
+  }
+  syncCanvasPlanes();
+
+  // Use default grid size from settings instead of hardcoded 16
+  currentGridSize = defaultGridSize;
+  currentCellSize = (currentGridSize == 16) ? 8 : 16;
+  activeSketch.gridSize = currentGridSize;
+  cursorX = 0;
+  cursorY = 0;
+  selectedColor = 1;
+
+  // setStatusMessage("New sketch");  // Removed - no message on boot
+}
+
+/**
+ * Keep the memory view cursor on the same sketch while entries are
+ * inserted, or on its old position until that sketch has been listed
+ */
+void syncMemoryViewCursor() {
+  int totalItems = 1 + sketchList.size();
+  if (memoryViewCursorId != 0) {
+    int index = findSketchIndex(memoryViewCursorId);
+    if (index >= 0) {
+      memoryViewCursor = index + 1;
+      return;
+    }
+  }
+  memoryViewCursor = memoryViewCursorId != 0 ? memoryViewCursorIndex : memoryViewCursor;
+  if (memoryViewCursor >= totalItems) {
+    memoryViewCursor = max(0, totalItems - 1);
+  }
+  if (memoryViewCursor < 0) {
+    memoryViewCursor = 0;
+  }
+}
+
+/**
+ * Remember which sketch the cursor is on (after the user moves it)
+ */
+void rememberMemoryViewCursor() {
+  memoryViewCursorIndex = memoryViewCursor;
+  memoryViewCursorId = 0;
+  if (memoryViewCursor > 0 && memoryViewCursor - 1 < (int)sketchList.size()) {
+    memoryViewCursorId = sketchList[memoryViewCursor - 1].timestamp;
+  }
+}
+
+/**
+ * Step the memory view's library scan (called each memory view frame)
+ */
+void updateMemoryViewScan() {
+  if (!memoryScan.active) {
+    return;
+  }
+  if (!stepSketchScan(memoryScan, SKETCH_SCAN_SLICE_MS)) {
+    lastSketchScanStats.completeMs = millis() - memoryScan.startMs;
+    lastSketchScanStats.count = sketchList.size();
+  }
+  syncMemoryViewCursor();
+}
+
+/**
+ * List the rest of the library now (before leaving the memory view for
+ * something that indexes sketchList, like the gallery)
+ */
+void finishMemoryViewScan() {
+  while (memoryScan.active) {
+    updateMemoryViewScan();
+  }
+}
+
+/**
+ * Enter Memory View mode
+ */
+void enterMemoryView() {
+  unsigned long enterMs = millis();
+
+  // Keep cursor and scroll position persistent between sessions
+  // exitMemoryView() remembered where you were browsing: the cursor follows
+  // the same sketch as the list is rescanned (see syncMemoryViewCursor)
+
+  // Open with just the "+" tile; the list fills in over the next frames
+  startSketchScan(memoryScan, activeCollection);
+  inMemoryView = true;
+  syncMemoryViewCursor();
+
+  lastMemoryAnimTime = millis();
+  memoryCursorAnimPhase = 0.0f;
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawMemoryView(true);
+
+  lastSketchScanStats.firstFrameMs = millis() - enterMs;
+  lastSketchScanStats.completeMs = 0;
+  memoryScan.startMs = enterMs;
+}
+
+/**
+ * Exit Memory View and return to canvas
+ */
+void exitMemoryView() {
+  inMemoryView = false;
+  stopSketchScan(memoryScan);  // Rescanned on the next visit
+  closeCollectionPicker();
+  rememberMemoryViewCursor();
+  releaseSketchList();         // Drop the list and its preview caches
+
+  // Redraw the canvas view
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawGrid();
+  drawPalette();
+  drawCursor();
+
+  // Redraw icons in upper left corner
+  drawToolIcons();
+
+  // Redraw battery indicator
+  lastBatteryPercent = -1;  // Force redraw
+  batteryFirstCheck = true;  // Force immediate check
+  drawBatteryIndicator();
+
+#if ENABLE_LED_MATRIX
+  // Restore active canvas on LED matrix
+  updateLEDMatrix();
+#endif
+
+}
+
+/**
+ * Enter Charging Mode - DVD-style bouncing battery screensaver
+ */
+void enterChargingMode() {
+  saveSessionSnapshot();  // Likely to be switched off from here
+  inChargingMode = true;
+  lastChargeFrameTime = millis();
+  chargeBatteryPercent = M5Cardputer.Power.getBatteryLevel();
+  lastChargeBatteryCheck = millis();
+
+  // Select battery icon
+  const unsigned char* batIcon;
+  if (chargeBatteryPercent < 10) batIcon = ICON_BATTERY_0;
+  else if (chargeBatteryPercent < 50) batIcon = ICON_BATTERY_10;
+  else if (chargeBatteryPercent < 90) batIcon = ICON_BATTERY_50;
+  else batIcon = ICON_BATTERY_90;
+
+  // Initialize icons with random positions and velocities (no overlap)
+  randomSeed(millis());
+  const unsigned char* icons[] = {ICON_DRAW, ICON_ERASE, ICON_FILL, batIcon, nullptr};
+  for (int i = 0; i < CHARGE_ICON_COUNT; i++) {
+    float x, y;
+    bool tooClose;
+    int attempts = 0;
+    do {
+      x = random(10, 190);
+      y = random(10, 90);
+      tooClose = false;
+      for (int j = 0; j < i; j++) {
+        if (abs(x - chargeIcons[j].x) < 48 && abs(y - chargeIcons[j].y) < 48) {
+          tooClose = true;
+          break;
+        }
+      }
+    } while (tooClose && ++attempts < 50);
+    float dx = (random(70, 130) / 100.0f) * (random(2) ? 1 : -1);
+    float dy = (random(70, 130) / 100.0f) * (random(2) ? 1 : -1);
+    chargeIcons[i] = {x, y, dx, dy, icons[i]};
+  }
+
+  // Load a random sketch into the sprite
+  chargeSketchLoaded = false;
+  loadSketchListFromSD();
+
+  if (sketchList.size() > 0) {
+    // Pick a random sketch
+    int randIndex = millis() % sketchList.size();
+    SketchInfo& info = sketchList[randIndex];
+
+    // Load sketch preview from SD
+    if (loadSketchPreview(info)) {
+      Sketch& tempSketch = info.sketchData;
+
+      // Render into 48x48 sprite
+      if (chargeSketchSprite.createSprite(48, 48)) {
+        chargeSketchSprite.fillSprite(TFT_BLACK);
+        int pixelSize = (tempSketch.gridSize == 16) ? 3 : 6;
+        int gridSize = tempSketch.gridSize;
+
+        for (int py = 0; py < gridSize; py++) {
+          for (int px = 0; px < gridSize; px++) {
+            uint8_t colorIdx = tempSketch.pixels[py][px];
+            if (colorIdx > 0 && colorIdx <= tempSketch.paletteSize) {
+              uint16_t color = tempSketch.paletteColors[colorIdx - 1];
+              chargeSketchSprite.fillRect(px * pixelSize, py * pixelSize, pixelSize, pixelSize, color);
+            }
+          }
+        }
+        chargeSketchLoaded = true;
+      }
+    }
+  }
+  releaseSketchList();  // Only needed to pick the sketch
+
+  // Allocate full-screen canvas for tear-free rendering
+  chargeCanvasAvailable = chargeCanvas.createSprite(240, 135);
+
+  // Dim display
+  M5Cardputer.Display.setBrightness(50);
+
+  // Dark background
+  M5Cardputer.Display.fillScreen(TFT_BLACK);
+}
+
+/**
+ * Exit Charging Mode - restore canvas view
+ */
+void exitChargingMode() {
+  inChargingMode = false;
+
+  // Free sprites
+  if (chargeSketchLoaded) {
+    chargeSketchSprite.deleteSprite();
+    chargeSketchLoaded = false;
+  }
+  if (chargeCanvasAvailable) {
+    chargeCanvas.deleteSprite();
+    chargeCanvasAvailable = false;
+  }
+
+  // Restore brightness
+  uint8_t hardwareBrightness = (displayBrightness * 255) / 100;
+  M5Cardputer.Display.setBrightness(hardwareBrightness);
+
+  // Redraw canvas
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawGrid();
+  drawPalette();
+  drawCursor();
+
+  drawToolIcons();
+
+  lastBatteryPercent = -1;
+  batteryFirstCheck = true;
+  drawBatteryIndicator();
+}
+
+/**
+ * Enter Hint Screen mode
+ */
+void enterHelpView() {
+  // Remember if we're coming from memory view
+  helpViewFromMemoryView = inMemoryView;
+
+  inHelpView = true;
+  helpViewCursor = 0;
+  helpViewScrollOffset = 0;
+  helpCanvasAvailable = helpCanvas.createSprite(240, 135);
+
+  // Draw hint screen
+  drawHelpView();
+}
+
+/**
+ * Exit Hint Screen and return to previous view
+ */
+void exitHelpView() {
+  inHelpView = false;
+
+  if (helpCanvasAvailable) {
+    helpCanvas.deleteSprite();
+    helpCanvasAvailable = false;
+  }
+
+  // Return to the view we came from
+  if (helpViewFromMemoryView) {
+    // Return to memory view
+    drawMemoryView(true);
+    helpViewFromMemoryView = false;
+  } else {
+    // Return to canvas/drawing view
+    M5Cardputer.Display.fillScreen(currentTheme->background);
+    drawGrid();
+    drawPalette();
+    drawCursor();
+
+    // Redraw icons in upper left corner
+    drawToolIcons();
+
+    // Redraw battery indicator
+    lastBatteryPercent = -1;  // Force redraw
+    batteryFirstCheck = true;  // Force immediate check
+    drawBatteryIndicator();
+  }
+}
+
+/**
+ * Load and display a sketch from the gallery in fullscreen preview
+ * Uses lazy loading pattern from drawSketchThumbnail
+ */
+void loadGallerySketch(int index) {
+  if (index < 0 || index >= sketchList.size()) {
+    return;
+  }
+
+  SketchInfo& info = sketchList[index];
+
+  // Load preview from SD if not already cached
+  if (!loadSketchPreview(info)) {
+    return;
+  }
+
+  // Now render the sketch fullscreen using preview rendering pattern
+  Sketch& sketch = info.sketchData;
+
+  // Get the background color
+  uint16_t bgColor;
+  switch (previewViewBackground) {
+    case 0: bgColor = VIEW_BG_BLACK; break;
+    case 1: bgColor = VIEW_BG_WHITE; break;
+    case 2: bgColor = VIEW_BG_GRAY; break;
+    case 3: bgColor = VIEW_BG_DARK; break;
+    default: bgColor = VIEW_BG_BLACK; break;
+  }
+
+  // Tiled preview: the whole screen is repeats of the sketch
+  if (previewTiled) {
+    drawTiledSketch(sketch.pixels, sketch.gridSize, sketch.paletteColors, bgColor,
+                    0, 0, 240, 135, PREVIEW_TILE_SIZE, previewTileOffset);
+#if ENABLE_LED_MATRIX
+    updateLEDMatrixFromSketch(sketch);
+#endif
+    return;
+  }
+
+  // Fill screen with background color
+  M5Cardputer.Display.fillScreen(bgColor);
+
+  // Calculate position to center 128×128 canvas on 240×135 screen
+  const int viewX = 56;
+  const int viewY = 4;
+  const int viewSize = 128;
+  const int viewCellSize = 128 / sketch.gridSize;  // 16px for 8×8, 8px for 16×16
+
+  // Draw each cell
+  for (int y = 0; y < sketch.gridSize; y++) {
+    for (int x = 0; x < sketch.gridSize; x++) {
+      int screenX = viewX + (x * viewCellSize);
+      int screenY = viewY + (y * viewCellSize);
+
+      // Get color for this cell
+      if (sketch.pixels[y][x] != 0) {
+        uint16_t cellColor = sketch.paletteColors[sketch.pixels[y][x] - 1];
+        M5Cardputer.Display.fillRect(screenX, screenY, viewCellSize, viewCellSize, cellColor);
+      }
+      // If empty (pixels[y][x] == 0), it stays the background color
+    }
+  }
+
+#if ENABLE_LED_MATRIX
+  // Update LED matrix to mirror the sketch (8×8 only)
+  updateLEDMatrixFromSketch(sketch);
+#endif
+}
+
+/**
+ * Enter View Mode - display canvas at 128×128 with selected background
+ * Context-aware: detects if coming from Memory View for gallery mode
+ */
+void enterPreviewView() {
+  inPreviewView = true;
+
+  // Check if we're coming from Memory View (gallery mode)
+  if (inMemoryView) {
+    galleryMode = true;
+    galleryAutoAdvance = false;  // Start paused
+    finishMemoryViewScan();  // The gallery steps through the whole list by index
+    inMemoryView = false;  // Clear Memory View flag so preview handler runs
+
+    // Start at selected sketch (memoryViewCursor - 1 because cursor 0 is "+")
+    if (memoryViewCursor > 0 && memoryViewCursor - 1 < sketchList.size()) {
+      galleryCurrentIndex = memoryViewCursor - 1;
+    } else {
+      galleryCurrentIndex = 0;  // Fallback to first sketch
+    }
+
+    galleryLastAdvanceTime = millis();
+
+    // Load and display sketch from gallery
+    loadGallerySketch(galleryCurrentIndex);
+    return;  // Exit early - loadGallerySketch handles rendering
+  }
+
+  // Canvas preview mode (not from Memory View)
+  galleryMode = false;
+
+  // Get the background color based on current selection
+  uint16_t bgColor;
+  switch (previewViewBackground) {
+    case 0: bgColor = VIEW_BG_BLACK; break;
+    case 1: bgColor = VIEW_BG_WHITE; break;
+    case 2: bgColor = VIEW_BG_GRAY; break;
+    case 3: bgColor = VIEW_BG_DARK; break;
+    default: bgColor = VIEW_BG_BLACK; break;
+  }
+
+  // Tiled preview: the whole screen is repeats of the canvas
+  if (previewTiled) {
+    drawTiledSketch(canvas, currentGridSize, activeSketch.paletteColors, bgColor,
+                    0, 0, 240, 135, PREVIEW_TILE_SIZE, previewTileOffset);
+#if ENABLE_LED_MATRIX
+    updateLEDMatrix(false);
+#endif
+    return;
+  }
+
+  // Fill screen with selected background color
+  M5Cardputer.Display.fillScreen(bgColor);
+
+  // Calculate position to center 128×128 canvas on 240×135 screen
+  // X: (240 - 128) / 2 = 56
+  // Y: (135 - 128) / 2 = 3.5, use 4 for integer alignment
+  const int viewX = 56;
+  const int viewY = 4;
+  const int viewSize = 128;
+  const int viewCellSize = 128 / currentGridSize;  // 16px for 8×8, 8px for 16×16
+
+  // Draw each cell of the canvas
+  for (int y = 0; y < currentGridSize; y++) {
+    for (int x = 0; x < currentGridSize; x++) {
+      int screenX = viewX + (x * viewCellSize);
+      int screenY = viewY + (y * viewCellSize);
+
+      // Get color for this cell
+      if (canvas[y][x] != 0) {
+        // There's a pixel here - use its color from the active sketch's palette
+        uint16_t cellColor = activeSketch.paletteColors[canvas[y][x] - 1];
+        M5Cardputer.Display.fillRect(screenX, screenY, viewCellSize, viewCellSize, cellColor);
+      }
+      // If empty (canvas[y][x] == 0), it stays the background color
+    }
+  }
+
+#if ENABLE_LED_MATRIX
+  // Update LED matrix to mirror the live canvas (8×8 only, no cursor)
+  updateLEDMatrix(false);
+#endif
+}
+
+/**
+ * Exit View Mode and return to canvas or Memory View
+ * Context-aware: returns to Memory View if in gallery mode
+ */
+void exitPreviewView() {
+  inPreviewView = false;
+  releaseTileSprite();
+
+  if (galleryMode) {
+    // Return to Memory View at current gallery position
+    memoryViewCursor = galleryCurrentIndex + 1;  // +1 for "+" button offset
+    galleryMode = false;
+    galleryAutoAdvance = false;
+    inMemoryView = true;  // Re-enable Memory View so handler runs
+
+    // Redraw Memory View
+    M5Cardputer.Display.fillScreen(currentTheme->background);
+    drawMemoryView(true);
+
+#if ENABLE_LED_MATRIX
+    // Keep displaying the currently viewed sketch on LED matrix
+    if (galleryCurrentIndex >= 0 && galleryCurrentIndex < sketchList.size()) {
+      SketchInfo& info = sketchList[galleryCurrentIndex];
+      if (info.dataLoaded) {
+        updateLEDMatrixFromSketch(info.sketchData);
+      } else {
+        // If data not loaded, clear LED matrix
+        FastLED.clear();
+        FastLED.show();
+      }
+    } else {
+      // Invalid index, clear LED matrix
+      FastLED.clear();
+      FastLED.show();
+    }
+#endif
+
+    return;  // Exit early
+  }
+
+  // Return to canvas view (existing behavior)
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawGrid();
+  drawPalette();
+  drawCursor();
+
+  // Redraw icons in upper left corner
+  drawToolIcons();
+
+  // Redraw battery indicator
+  lastBatteryPercent = -1;  // Force redraw
+  batteryFirstCheck = true;  // Force immediate check
+  drawBatteryIndicator();
+
+#if ENABLE_LED_MATRIX
+  // Restore canvas display on LED matrix
+  updateLEDMatrix();
+#endif
+}
+
+/**
+ * Enter Palette Menu - horizontally scrolling palette selector
+ */
+void enterPaletteView() {
+  inPaletteView = true;
+
+  // Create canvas sprite on-demand (64KB)
+  if (!paletteCanvas.createSprite(240, 135)) {
+    paletteCanvasAvailable = false;
+  } else {
+    paletteCanvasAvailable = true;
+  }
+
+  // Reset filters to "all" when entering palette menu
+  paletteFilterSize = 0;
+  paletteFilterUser = false;
+  updatePaletteFilter();
+
+  // Set cursor to currently active palette (if we can identify it)
+  paletteViewCursor = 0;  // Default to first palette
+  int activePalette = findPaletteByFingerprint(paletteFingerprint(activeSketch.paletteColors));
+  if (activePalette >= 0 && paletteFilterPosition[activePalette] >= 0) {
+    paletteViewCursor = paletteFilterPosition[activePalette];
+  }
+
+  // Initialize scroll position to cursor (no animation on first show)
+  paletteViewScrollPos = (float)paletteViewCursor;
+
+  // Clear screen and draw palette menu
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+}
+
+/**
+ * Exit Palette Menu and return to canvas
+ */
+void exitPaletteView() {
+  inPaletteView = false;
+
+  // Free canvas sprite memory (64KB) and the cartridge buffer
+  paletteCanvas.deleteSprite();
+  paletteCanvasAvailable = false;
+  releaseCartridgeBuffer();
+
+  // Redraw the canvas view
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawGrid();
+  drawPalette();
+  drawCursor();
+
+  // Redraw icons in upper left corner
+  drawToolIcons();
+
+  // Redraw battery indicator
+  lastBatteryPercent = -1;  // Force redraw
+  batteryFirstCheck = true;  // Force immediate check
+  drawBatteryIndicator();
+}
+
+// ============================================================================
+// SETTINGS VIEW
+// ============================================================================
+
+/**
+ * Enter Settings Menu - vertical list of persistent preferences
+ */
+void enterSettingsView() {
+  inSettingsView = true;
+  settingsViewCursor = 0;  // Start at top
+
+  // Create canvas sprite on-demand (64KB)
+  if (!settingsCanvas.createSprite(240, 135)) {
+    settingsCanvasAvailable = false;
+  } else {
+    settingsCanvasAvailable = true;
+  }
+
+  // Clear screen
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+}
+
+/**
+ * Exit Settings Menu and return to canvas
+ */
+void exitSettingsView() {
+  inSettingsView = false;
+
+  // Free canvas sprite memory (64KB)
+  settingsCanvas.deleteSprite();
+  settingsCanvasAvailable = false;
+
+  // Redraw the canvas view (same pattern as exitPaletteView)
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawGrid();
+  drawPalette();
+  drawCursor();
+
+  // Redraw icons
+  drawToolIcons();
+
+  // Redraw battery indicator
+  lastBatteryPercent = -1;
+  batteryFirstCheck = true;
+  drawBatteryIndicator();
+}
+
+
+/**
+ * Draw Settings Menu UI to canvas
+ */
+void drawSettingsView() {
+  // Check if canvas is available
+  if (!settingsCanvasAvailable) {
+    M5Cardputer.Display.fillScreen(currentTheme->background);
+    M5Cardputer.Display.setTextColor(TFT_RED);
+    M5Cardputer.Display.setCursor(10, 50);
+    M5Cardputer.Display.println("WARNING: Low memory!");
+    M5Cardputer.Display.setCursor(10, 65);
+    M5Cardputer.Display.println("Cannot show settings.");
+    M5Cardputer.Display.setCursor(10, 85);
+    M5Cardputer.Display.setTextColor(currentTheme->text);
+    M5Cardputer.Display.println("Press ESC (`) to exit");
+    return;
+  }
+
+  // Clear canvas
+  settingsCanvas.fillSprite(currentTheme->background);
+
+  // Draw title
+  settingsCanvas.setTextColor(currentTheme->text);
+  settingsCanvas.setTextSize(1);
+  settingsCanvas.setCursor(4, 4);
+  settingsCanvas.print("SETTINGS");
 
   const int startY = 18;
   const int lineHeight = 16;
   const int selectedLineHeight = 28;
   const int labelX = 12;
 
-  const char* menuLabels[SETTINGS_ITEM_COUNT] = {
-    "UI Theme",
-    "Grid default",
-    "RGB matrix",
-    "Export",
-    "Shake undo",
-#if ENABLE_BLUETOOTH
-    "Bluetooth"
+  const char* menuLabels[SETTINGS_ITEM_COUNT] = {
+    "UI Theme",
+    "Grid default",
+    "RGB matrix",
+    "Export",
+    "Shake undo",
+#if ENABLE_BLUETOOTH
+    "Bluetooth"
+#endif
+  };
+
+  int y = startY;
+  for (int i = 0; i < SETTINGS_ITEM_COUNT; i++) {
+    bool isSelected = (i == settingsViewCursor);
+    int rowH = isSelected ? selectedLineHeight : lineHeight;
+    int textY = isSelected ? y + 4 : y;
+    uint16_t color = isSelected ? currentTheme->text : currentTheme->textSecondary;
+
+    // Draw label
+    settingsCanvas.setTextSize(isSelected ? 2 : 1);
+    settingsCanvas.setTextColor(color);
+    settingsCanvas.setCursor(labelX, textY);
+    settingsCanvas.print(menuLabels[i]);
+
+    // Determine current value string
+    const char* valueText;
+    static char btBuf[16];
+
+    switch(i) {
+      case 0:
+        valueText = currentTheme == &THEME_LIGHT ? "Light" : "Dark";
+        break;
+      case 1:
+        valueText = defaultGridSize == 8 ? "8" : "16";
+        break;
+      case 2:
+        valueText = rgbMatrixUnits == 1 ? "1" : rgbMatrixUnits == 4 ? "4" : "SD";
+        break;
+      case 3:
+        static char exportBuf[12];
+        snprintf(exportBuf, sizeof(exportBuf), exportRGB565 ? "%s 565" : "%s", IMAGE_FORMAT_NAMES[exportFormat]);
+        valueText = exportBuf;
+        break;
+      case 4:
+        valueText = shakeUndoEnabled ? "ON" : "OFF";
+        break;
+#if ENABLE_BLUETOOTH
+      case 5:
+        if (btState == BT_CONNECTED) {
+          valueText = "Paired";
+        } else if (btState == BT_SCANNING) {
+          snprintf(btBuf, sizeof(btBuf), "Scan %d", btScanSecondsLeft());
+          valueText = btBuf;
+        } else if (btState == BT_CONNECTING) {
+          valueText = "Pairing";
+        } else if (btState == BT_WAIT_RETRY) {
+          snprintf(btBuf, sizeof(btBuf), "Retry %d", btRetryCount);
+          valueText = btBuf;
+        } else if (btEnabled && btHasBondedDevice) {
+          valueText = "Reconnect";
+        } else if (btEnabled) {
+          valueText = "Scan";
+        } else {
+          valueText = "OFF";
+        }
+        break;
+#endif
+      default:
+        valueText = "";
+        break;
+    }
+
+    // Draw value right-aligned, with < > on selected row
+    settingsCanvas.setTextSize(isSelected ? 2 : 1);
+    settingsCanvas.setTextColor(color);
+    const int valueRight = 228;
+    int charW = isSelected ? 12 : 6;
+    int valueLen;
+    if (isSelected) {
+      valueLen = strlen(valueText) + 2;  // "<" + text + ">"
+    } else {
+      valueLen = strlen(valueText);
+    }
+    settingsCanvas.setCursor(valueRight - (valueLen * charW), textY);
+    if (isSelected) {
+      settingsCanvas.printf("<%s>", valueText);
+    } else {
+      settingsCanvas.print(valueText);
+    }
+
+    y += rowH;
+  }
+
+  // Draw status message if one exists
+  if (statusMessage[0] != '\0' && (millis() - statusMessageTime < STATUS_DISPLAY_DURATION)) {
+    settingsCanvas.setTextColor(currentTheme->text);
+    settingsCanvas.setTextSize(1);
+    settingsCanvas.setCursor(3, 124);
+    settingsCanvas.print(statusMessage);
+  }
+
+  // Push canvas to display
+  settingsCanvas.pushSprite(0, 0);
+}
+
+/**
+ * Handle Settings Menu input and navigation
+ */
+void handleSettingsView(Keyboard_Class::KeysState& status) {
+  // Track if we need to redraw
+  static bool settingsViewNeedsRedraw = true;
+  static int lastSettingsViewCursor = -1;
+  static bool settingsPrevUp = false, settingsPrevDown = false;
+
+#if ENABLE_BLUETOOTH
+  // Redraw when the Bluetooth row changes (scan countdown, connect results)
+  static uint8_t lastBtStateVersion = 0;
+  if (btStateVersion != lastBtStateVersion) {
+    lastBtStateVersion = btStateVersion;
+    settingsViewNeedsRedraw = true;
+  }
+#endif
+
+  // Redraw if cursor changed or first time
+  if (settingsViewNeedsRedraw || lastSettingsViewCursor != settingsViewCursor) {
+    drawSettingsView();
+    settingsViewNeedsRedraw = false;
+    lastSettingsViewCursor = settingsViewCursor;
+  }
+
+  // Check for BT enter (edge-triggered)
+#if ENABLE_BLUETOOTH
+  static bool btPrevEnterSettings = false;
+  bool btEnterPressed = btEnter && !btPrevEnterSettings;
+  btPrevEnterSettings = btEnter;
+#else
+  bool btEnterPressed = false;
+#endif
+
+  if (M5Cardputer.Keyboard.isPressed() || btEnterPressed) {
+    // Check if left/right arrow pressed (treat as toggle)
+    for (auto i : status.word) {
+      if (i == ',' || i == '/') status.enter = true;
+    }
+
+    // Enter key - toggle selected setting
+    if (status.enter || btEnterPressed) {
+      bool needsFullRedraw = false;
+
+      switch(settingsViewCursor) {
+        case 0:  // Theme
+          // Toggle theme
+          if (currentTheme == &THEME_LIGHT) {
+            currentTheme = &THEME_DARK;
+            setStatusMessage("Dark Mode");
+          } else {
+            currentTheme = &THEME_LIGHT;
+            setStatusMessage("Light Mode");
+          }
+
+          // Save preference
+          preferences.begin("bitmap16dx", false);
+          preferences.putBool("darkMode", (currentTheme == &THEME_DARK));
+          preferences.end();
+
+          needsFullRedraw = true;
+          break;
+
+        case 1:  // Default Grid Size
+          // Toggle between 8×8 and 16×16
+          defaultGridSize = (defaultGridSize == 8) ? 16 : 8;
+
+          // Save preference
+          preferences.begin("bitmap16dx", false);
+          preferences.putUChar("defaultGrid", defaultGridSize);
+          preferences.end();
+
+          setStatusMessage(defaultGridSize == 8 ? "Default: 8x8" : "Default: 16x16");
+          break;
+
+        case 2:  // RGB Matrix Units
+#if ENABLE_LED_MATRIX
+          // Cycle 1 unit → 4 units → custom layout from SD (if present) → 1 unit
+          if (rgbMatrixUnits == 1) {
+            rgbMatrixUnits = 4;
+          } else if (rgbMatrixUnits == 4 && sdCardAvailable && SD.exists(LED_LAYOUT_PATH)) {
+            rgbMatrixUnits = LED_LAYOUT_CUSTOM;
+          } else {
+            rgbMatrixUnits = 1;
+          }
+
+          // Clear all LEDs first (the chain length may shrink)
+          FastLED.clear();
+          FastLED.show();
+
+          applyLEDLayout();
+#else
+          // Toggle between 1 and 4 units
+          rgbMatrixUnits = (rgbMatrixUnits == 1) ? 4 : 1;
+#endif
+
+          // Save preference
+          preferences.begin("bitmap16dx", false);
+          preferences.putUChar("puzzleUnits", rgbMatrixUnits);
+          preferences.end();
+
+#if ENABLE_LED_MATRIX
+          // Update LED matrix immediately with current canvas
+          if (ledMatrixEnabled) {
+            updateLEDMatrix(false);  // Show canvas without cursor while in settings
+          }
+
+          if (rgbMatrixUnits == LED_LAYOUT_CUSTOM) {
+            char layoutMsg[24];
+            if (ledCount) {
+              snprintf(layoutMsg, sizeof(layoutMsg), "%dx%d Units", ledWallWidth / LED_UNIT_SIZE, ledWallHeight / LED_UNIT_SIZE);
+            } else {
+              snprintf(layoutMsg, sizeof(layoutMsg), "SD Layout");  // Loaded when the matrix is turned on
+            }
+            setStatusMessage(layoutMsg);
+            break;
+          }
+#endif
+
+          setStatusMessage(rgbMatrixUnits == 1 ? "1 Unit" : "4 Units");
+          break;
+
+        case 3:  // Export Format
+          if (status.fn) {
+            // Fn: toggle between RGB888 and RGB565 colors
+            exportRGB565 = !exportRGB565;
+            setStatusMessage(exportRGB565 ? "Export: RGB565" : "Export: RGB888");
+          } else {
+            // Cycle PNG → QOI → BMP → GIF
+            exportFormat = (exportFormat + 1) % IMAGE_FORMAT_COUNT;
+            char formatMsg[20];
+            snprintf(formatMsg, sizeof(formatMsg), "Export: %s", IMAGE_FORMAT_NAMES[exportFormat]);
+            setStatusMessage(formatMsg);
+          }
+
+          // Save preference
+          preferences.begin("bitmap16dx", false);
+          preferences.putBool("exportRGB565", exportRGB565);
+          preferences.putUChar("exportType", exportFormat);
+          preferences.end();
+          break;
+
+        case 4:  // Shake Undo
+          // Toggle shake-to-undo
+          shakeUndoEnabled = !shakeUndoEnabled;
+
+          // Save preference
+          preferences.begin("bitmap16dx", false);
+          preferences.putBool("shakeUndo", shakeUndoEnabled);
+          preferences.end();
+
+          setStatusMessage(shakeUndoEnabled ? "Shake: ON" : "Shake: OFF");
+          break;
+
+#if ENABLE_BLUETOOTH
+        case 5:  // Bluetooth
+          // Scan and connect run in the background (btUpdate); this only starts or stops them
+          if (btState == BT_CONNECTED) {
+            // Disconnect if connected (Fn+Enter forgets pairing too)
+            btStop(status.fn);
+            setStatusMessage(status.fn ? "BT Forgotten" : "BT Disconnected");
+          } else if (btState != BT_OFF) {
+            // Cancel the scan or connect in progress
+            btStop(false);
+            setStatusMessage("BT Cancelled");
+          } else if (btEnabled && btHasBondedDevice && !status.fn) {
+            // Try to reconnect to bonded device (no scan needed)
+            // Fn bypasses this to force new scan
+            btStartReconnect();
+          } else if (btEnabled) {
+            // Start scanning for keyboard (no bonded device, or Fn held to force scan)
+            if (status.fn && btHasBondedDevice) {
+              btForgetBondedDevice();  // Forget old pairing first
+            }
+            btStartScan();
+          } else {
+            // Enable Bluetooth (stack will init on scan/reconnect)
+            btEnabled = true;
+            preferences.begin("bitmap16dx", false);
+            preferences.putBool("btEnabled", btEnabled);
+            preferences.end();
+            setStatusMessage(btHasBondedDevice ? "BT On - Reconnect" : "BT On - Scan");
+          }
+          break;
+#endif
+      }
+
+      // Force redraw (especially important for theme changes)
+      settingsViewNeedsRedraw = true;
+
+      // Debounce
+      loopDelay(200);
+    }
+
+    // Check for character keys
+    bool upPressed = false, downPressed = false;
+    for (auto i : status.word) {
+      if (i == '`') {
+        exitSettingsView();
+        settingsViewNeedsRedraw = true;
+        lastSettingsViewCursor = -1;
+        loopDelay(200);
+        return;
+      }
+      else if (i == ';') upPressed = true;
+      else if (i == '.') downPressed = true;
+      else if (i == ' ') {
+        status.enter = true;
+      }
+#if ENABLE_SCREENSHOTS
+      else if (i == 'y' || i == 'Y') {
+        takeScreenshot();
+        settingsViewNeedsRedraw = true;
+      }
+#endif
+#if ENABLE_DEVICE_BENCH
+      // Fn+B - Run the device benchmark suite (hidden, report on SD)
+      else if ((i == 'b' || i == 'B') && status.fn) {
+        startDeviceBench();
+        settingsViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+#endif
+    }
+
+    if (upPressed && !settingsPrevUp && settingsViewCursor > 0) {
+      settingsViewCursor--;
+      settingsViewNeedsRedraw = true;
+    }
+    if (downPressed && !settingsPrevDown && settingsViewCursor < SETTINGS_ITEM_COUNT - 1) {
+      settingsViewCursor++;
+      settingsViewNeedsRedraw = true;
+    }
+    settingsPrevUp = upPressed;
+    settingsPrevDown = downPressed;
+  } else {
+    settingsPrevUp = false;
+    settingsPrevDown = false;
+  }
+
+#if ENABLE_BLUETOOTH
+  // BT keyboard navigation (arrows and escape - enter handled above)
+  static bool btPrevUpSettings = false, btPrevDownSettings = false;
+  static bool btPrevEscSettings = false;
+
+  if (btArrowUp && !btPrevUpSettings && settingsViewCursor > 0) {
+    settingsViewCursor--;
+    settingsViewNeedsRedraw = true;
+  }
+  if (btArrowDown && !btPrevDownSettings && settingsViewCursor < SETTINGS_ITEM_COUNT - 1) {
+    settingsViewCursor++;
+    settingsViewNeedsRedraw = true;
+  }
+  if (btEscape && !btPrevEscSettings) {
+    exitSettingsView();
+    settingsViewNeedsRedraw = true;
+    lastSettingsViewCursor = -1;
+  }
+
+  btPrevUpSettings = btArrowUp; btPrevDownSettings = btArrowDown;
+  btPrevEscSettings = btEscape;
+#endif
+}
+
+// ============================================================================
+// DRAWING HELPERS
+// ============================================================================
+
+// Corner flags for cut corner rectangles
+#define CORNER_NONE         0b0000
+#define CORNER_TOP_LEFT     0b0001
+#define CORNER_TOP_RIGHT    0b0010
+#define CORNER_BOTTOM_LEFT  0b0100
+#define CORNER_BOTTOM_RIGHT 0b1000
+#define CORNER_ALL          0b1111
+
+// Forward declaration
+void drawCutCornerRect(int x, int y, int w, int h, int cutSize, uint16_t color, uint8_t corners, M5Canvas* canvas);
+
+/**
+ * Helper function to get theme-appropriate cartridge color
+ * Maps light theme cartridge colors to dark theme equivalents
+ */
+inline uint16_t getCartridgeColor(uint16_t originalColor) {
+  if (currentTheme == &THEME_DARK) {
+    // Map light theme colors to dark theme
+    const uint16_t LIGHT_BG = RGB565(0xD3, 0xD3, 0xDD);    // #d3d3dd
+    const uint16_t LIGHT_SHADOW = RGB565(0xC1, 0xC4, 0xD6); // #c1c4d6
+    const uint16_t DARK_BG = RGB565(0x0e, 0x0e, 0x0e);      // #0e0e0e
+    const uint16_t DARK_SHADOW = TFT_BLACK;                 // #000000
+
+    if (originalColor == LIGHT_BG || originalColor == RGB565(0xD6, 0x9B, 0x00)) { // 0xD69B
+      return DARK_BG;
+    }
+    if (originalColor == LIGHT_SHADOW || originalColor == RGB565(0xC6, 0x3A, 0x00)) { // 0xC63A
+      return DARK_SHADOW;
+    }
+  }
+  return originalColor; // Return unchanged in light mode or if no match
+}
+
+/**
+ * Draw theme-aware cartridge graphic
+ * Transforms colors for dark mode on-the-fly
+ */
+void drawThemedCartridge(int x, int y, M5Canvas* canvas = nullptr) {
+  // For light mode, use original graphic directly
+  if (currentTheme == &THEME_LIGHT) {
+    if (canvas != nullptr) {
+      bool oldSwap = canvas->getSwapBytes();
+      canvas->setSwapBytes(true);
+      canvas->pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, CARTRIDGE_GRAPHIC);
+      canvas->setSwapBytes(oldSwap);
+    } else {
+      bool oldSwap = M5Cardputer.Display.getSwapBytes();
+      M5Cardputer.Display.setSwapBytes(true);
+      M5Cardputer.Display.pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, CARTRIDGE_GRAPHIC);
+      M5Cardputer.Display.setSwapBytes(oldSwap);
+    }
+    return;
+  }
+
+  // For dark mode, transform colors into the palette view's buffer
+  // (once per theme; freed when the palette view closes)
+  if (!cartridgeBuffer) {
+    cartridgeBuffer = (uint16_t*)scopedAlloc(CARTRIDGE_WIDTH * CARTRIDGE_HEIGHT * sizeof(uint16_t));
+    if (!cartridgeBuffer) {
+      return;  // Out of memory - swatches are still drawn
+    }
+    cartridgeBufferTheme = nullptr;
+  }
+  if (cartridgeBufferTheme != currentTheme) {
+    for (int i = 0; i < CARTRIDGE_WIDTH * CARTRIDGE_HEIGHT; i++) {
+      cartridgeBuffer[i] = getCartridgeColor(pgm_read_word(&CARTRIDGE_GRAPHIC[i]));
+    }
+    cartridgeBufferTheme = currentTheme;
+  }
+
+  // Draw the transformed graphic
+  if (canvas != nullptr) {
+    bool oldSwap = canvas->getSwapBytes();
+    canvas->setSwapBytes(true);
+    canvas->pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, cartridgeBuffer);
+    canvas->setSwapBytes(oldSwap);
+  } else {
+    bool oldSwap = M5Cardputer.Display.getSwapBytes();
+    M5Cardputer.Display.setSwapBytes(true);
+    M5Cardputer.Display.pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, cartridgeBuffer);
+    M5Cardputer.Display.setSwapBytes(oldSwap);
+  }
+}
+
+/**
+ * Draw a single palette preview at given position
+ * Shows cartridge graphic with color swatches displayed on it
+ * @param canvas Optional canvas to draw to (defaults to main display)
+ */
+void drawPalettePreview(int x, int y, const uint16_t* palette, bool isCursor, bool isActive, int paletteIndex, M5Canvas* canvas = nullptr) {
+  int numColors = allPaletteSizes[paletteIndex];
+
+  // Draw cartridge background graphic (80×92)
+  // Center it at the given x, y position
+  int cartX = x - (CARTRIDGE_WIDTH / 2);
+  int cartY = y - (CARTRIDGE_HEIGHT / 2);
+
+  // Apply insertion animation if active and this is the cursor
+  if (paletteInsertionAnimating && isCursor) {
+    // Apply quartic ease-in: slow start, accelerates dramatically (gravity/force feel)
+    float t = paletteInsertionProgress;
+    float eased = t * t * t * t;  // Quartic ease-in
+
+    // Animate cartridge moving DOWN with easing
+    cartY = cartY + (int)(PALETTE_INSERT_DISTANCE * eased);
+  }
+
+  // Draw theme-aware cartridge graphic
+  drawThemedCartridge(cartX, cartY, canvas);
+
+  // Draw color swatches: 64×64 area positioned 8px from left, 6px from top of cartridge
+  const int swatchAreaWidth = 64;
+  const int swatchAreaHeight = 64;
+  int swatchX = cartX + 8;   // 8 pixels from left edge of cartridge
+  int swatchY = cartY + 6;   // 6 pixels from top edge of cartridge
+
+  const int cutSize = 2;  // Size of corner cuts
+
+  if (numColors == 4) {
+    // 4-color: 1 column × 4 rows, 64×16 each (single wide column)
+    const int colorWidth = 64;
+    const int colorHeight = 16;
+
+    for (int i = 0; i < 4; i++) {
+      int px = swatchX;
+      int py = swatchY + (i * colorHeight);
+
+      // Determine which corners to cut based on position
+      uint8_t corners = CORNER_NONE;
+      if (i == 0) corners = CORNER_TOP_LEFT | CORNER_TOP_RIGHT;        // Top row: cut both top corners
+      else if (i == 3) corners = CORNER_BOTTOM_LEFT | CORNER_BOTTOM_RIGHT;  // Bottom row: cut both bottom corners
+
+      drawCutCornerRect(px, py, colorWidth, colorHeight, cutSize, pgm_read_word(&palette[i]), corners, canvas);
+    }
+  } else if (numColors == 8) {
+    // 8-color: 2 colors wide × 4 colors tall = 8 colors, 32×16 each (colors go DOWN)
+    const int colorWidth = 32;
+    const int colorHeight = 16;
+
+    for (int i = 0; i < 8; i++) {
+      int col = i / 4;  // Column changes every 4 colors (0-3 in col 0, 4-7 in col 1)
+      int row = i % 4;  // Row cycles 0-3
+      int px = swatchX + (col * colorWidth);
+      int py = swatchY + (row * colorHeight);
+
+      // Determine which corners to cut based on position
+      uint8_t corners = CORNER_NONE;
+      if (col == 0 && row == 0) corners = CORNER_TOP_LEFT;           // Top-left swatch
+      else if (col == 1 && row == 0) corners = CORNER_TOP_RIGHT;     // Top-right swatch
+      else if (col == 0 && row == 3) corners = CORNER_BOTTOM_LEFT;   // Bottom-left swatch
+      else if (col == 1 && row == 3) corners = CORNER_BOTTOM_RIGHT;  // Bottom-right swatch
+
+      drawCutCornerRect(px, py, colorWidth, colorHeight, cutSize, pgm_read_word(&palette[i]), corners, canvas);
+    }
+  } else {
+    // 16-color: 4×4 grid, 16×16 each (colors go DOWN columns - VERTICAL LAYOUT)
+    const int colorSize = 16;
+
+    for (int i = 0; i < 16; i++) {
+      int col = i / 4;  // Column changes every 4 colors
+      int row = i % 4;  // Row cycles 0-3
+      int px = swatchX + (col * colorSize);
+      int py = swatchY + (row * colorSize);
+
+      // Determine which corners to cut based on position in 4×4 grid
+      uint8_t corners = CORNER_NONE;
+      if (col == 0 && row == 0) corners = CORNER_TOP_LEFT;           // Top-left corner
+      else if (col == 3 && row == 0) corners = CORNER_TOP_RIGHT;     // Top-right corner
+      else if (col == 0 && row == 3) corners = CORNER_BOTTOM_LEFT;   // Bottom-left corner
+      else if (col == 3 && row == 3) corners = CORNER_BOTTOM_RIGHT;  // Bottom-right corner
+
+      drawCutCornerRect(px, py, colorSize, colorSize, cutSize, pgm_read_word(&palette[i]), corners, canvas);
+    }
+  }
+
+  // No border around cartridge
+  // Active palette is indicated by ">" before the name
+}
+
+/**
+ * Draw Palette Menu - horizontally scrolling carousel of palettes
+ * Center palette is selected, left/right arrows navigate
+ *
+ * @param fullRedraw If true, clears entire screen. If false, only redraws content area for animation
+ */
+void drawPaletteView(bool fullRedraw = true) {
+  // Check if canvas is available
+  if (!paletteCanvasAvailable) {
+    // Canvas wasn't allocated - show error message
+    M5Cardputer.Display.fillScreen(currentTheme->background);
+    M5Cardputer.Display.setTextColor(TFT_RED);
+    M5Cardputer.Display.setCursor(10, 50);
+    M5Cardputer.Display.println("WARNING: Low memory!");
+    M5Cardputer.Display.setCursor(10, 65);
+    M5Cardputer.Display.println("Cannot show palette menu.");
+    M5Cardputer.Display.setCursor(10, 85);
+    M5Cardputer.Display.setTextColor(currentTheme->text);
+    M5Cardputer.Display.println("Press ESC (`) to exit");
+    M5Cardputer.Display.setCursor(10, 100);
+    M5Cardputer.Display.println("Restart device to recover");
+    return;  // Skip drawing, but allow keyboard handling
+  }
+
+  // Clear the canvas buffer (full screen)
+  paletteCanvas.fillSprite(currentTheme->background);
+
+  // Draw title to canvas
+  paletteCanvas.setTextColor(currentTheme->text);
+  paletteCanvas.setTextSize(1);
+  paletteCanvas.setCursor(4, 4);
+  paletteCanvas.print("PALETTES");
+
+  // Draw filter status in top-right corner (only if filters are active)
+  if (paletteFilterSize > 0 || paletteFilterUser) {
+    String filterText = "";
+    if (paletteFilterSize > 0 && paletteFilterUser) {
+      filterText = "USER+" + String(paletteFilterSize);
+    } else if (paletteFilterSize > 0) {
+      filterText = String(paletteFilterSize) + "-COLOR";
+    } else if (paletteFilterUser) {
+      filterText = "USER";
+    }
+    // Right-align text: calculate position based on text width
+    int16_t textWidth = paletteCanvas.textWidth(filterText);
+    paletteCanvas.setCursor(240 - textWidth - 4, 4);  // 4px padding from right edge
+    paletteCanvas.print(filterText);
+  }
+
+  const int paletteGap = 20;  // Gap between cartridges
+  const int centerX = 120;  // Center of 240px screen (horizontal)
+  // Cartridge top at Y=20 from screen top, cartridge is 92px tall
+  // So center is at Y=20+46=66 (simple screen coordinates now!)
+  const int centerY = 66;  // Browsing position: top of cartridge at Y=20 on screen
+
+  // Determine which palette is currently active on the sketch
+  int activePaletteIndex = findPaletteByFingerprint(paletteFingerprint(activeSketch.paletteColors));
+
+  // Smooth scroll animation - now tear-free thanks to M5Canvas!
+  // Skip scroll interpolation during insertion animation (keeps everything frozen)
+  if (!paletteInsertionAnimating) {
+    // Interpolate scroll position towards cursor position
+    float targetPos = (float)paletteViewCursor;
+    float diff = targetPos - paletteViewScrollPos;
+
+    if (fabs(diff) > 0.01f) {
+      // Smoothly animate towards target
+      paletteViewScrollPos += diff * PALETTE_SCROLL_SPEED;
+    } else {
+      // Close enough - snap to target
+      paletteViewScrollPos = targetPos;
+    }
+  }
+
+  // Draw filtered palettes to canvas - selected one in center, others offset to sides
+  for (int i = 0; i < filteredPaletteCount; i++) {
+    // Get actual palette index from filtered list
+    uint8_t paletteIdx = filteredPaletteIndices[i];
+
+    // During insertion animation, freeze ALL cartridges horizontally using frozen scroll position
+    // This keeps everything stable - only vertical (Y) movement happens during insertion
+    float scrollPosToUse = paletteInsertionAnimating ? paletteInsertionFrozenScrollPos : paletteViewScrollPos;
+
+    float offset = (i - scrollPosToUse) * (CARTRIDGE_WIDTH + paletteGap);
+    int paletteX = centerX + (int)offset;  // X is center point for cartridge
+    int paletteY = centerY;
+
+    // Only draw if on screen (with some margin)
+    if (paletteX > -(CARTRIDGE_WIDTH / 2) && paletteX < 240 + (CARTRIDGE_WIDTH / 2)) {
+      bool isCursor = (i == paletteViewCursor);
+      bool isActive = (paletteIdx == activePaletteIndex);
+
+      // Draw palette name FIRST (but not during insertion animation to prevent text peeking out)
+      if (isCursor && !paletteInsertionAnimating) {
+        paletteCanvas.setTextSize(1);
+        paletteCanvas.setTextColor(currentTheme->text);
+
+        // Add checkmark if this is the active palette, star if user-loaded
+        String displayText = String(allPaletteNames[paletteIdx]);
+        if (paletteIsUserLoaded[paletteIdx]) {
+          displayText = "* " + displayText;  // Star for user palettes
+        }
+        if (isActive) {
+          displayText = "> " + displayText;  // Use ">" as checkmark/indicator
+        }
+
+        int textWidth = displayText.length() * 6;  // Approximate width
+        paletteCanvas.setCursor(centerX - (textWidth / 2), centerY + (CARTRIDGE_HEIGHT / 2) + 6);
+        paletteCanvas.print(displayText);
+      }
+
+      // Draw cartridge AFTER label (so it covers the label during animation)
+      drawPalettePreview(paletteX, paletteY, allPalettes[paletteIdx], isCursor, isActive, paletteIdx, &paletteCanvas);
+    }
+  }
+
+  // Draw status message at bottom if one exists
+  if (statusMessage[0] != '\0' && (millis() - statusMessageTime < STATUS_DISPLAY_DURATION)) {
+    paletteCanvas.setTextColor(currentTheme->text);
+    paletteCanvas.setTextSize(1);
+    paletteCanvas.setCursor(3, 124);
+    paletteCanvas.print(statusMessage);
+  }
+
+  // NOW push the entire frame to display at once - NO TEARING!
+  paletteCanvas.pushSprite(0, 0);  // Push full-screen canvas
+
+  // No instructions at bottom - keeping the interface minimal
+}
+
+// ============================================================================
+// DRAWING FUNCTIONS
+// ============================================================================
+
+/**
+ * Draw a 2px offset shadow behind any rectangle with cut corners
+ *
+ * Shadow is drawn 2px down and 2px right from the specified position.
+ * Draw this BEFORE drawing your main element so the element appears on top.
+ *
+ * For cut corner elements:
+ * - Shadow fills behind element's top-left, top-right, and bottom-left cut corners
+ * - Shadow's own top-right corner is cut (2px)
+ * - Shadow's own bottom-left corner is cut (2px)
+ * - Shadow's bottom-right corner remains filled (visible through element's BR cut)
+ *
+ * @param x X position of the element (shadow will be at x+2)
+ * @param y Y position of the element (shadow will be at y+2)
+ * @param w Width of the shadow
+ * @param h Height of the shadow
+ * @param cutCorners Whether to handle cut corners (default: false)
+ */
+void drawShadow(int x, int y, int w, int h, bool cutCorners = false) {
+  // Draw main shadow rectangle (offset 2px down and right)
+  // This extends under the element and will show through any cut corners
+  M5Cardputer.Display.fillRect(x + 2, y + 2, w, h, currentTheme->shadow);
+
+  if (cutCorners) {
+    // Cut the shadow's own visible corners (the parts that stick out beyond the element)
+    M5Cardputer.Display.fillRect(x + w, y + 2, 2, 2, currentTheme->background);  // Cut shadow's TR
+    M5Cardputer.Display.fillRect(x + 2, y + h, 2, 2, currentTheme->background);  // Cut shadow's BL
+    M5Cardputer.Display.fillRect(x + w, y + h, 2, 2, currentTheme->background);  // Cut shadow's BR
+  }
+}
+
+/**
+ * Draw a filled rectangle with optional cut corners
+ *
+ * @param x X position
+ * @param y Y position
+ * @param w Width
+ * @param h Height
+ * @param cutSize Size of corner cuts in pixels
+ * @param color Fill color
+ * @param corners Bitfield of which corners to cut (use CORNER_* flags)
+ * @param canvas Optional canvas to draw to (defaults to main display)
+ */
+void drawCutCornerRect(int x, int y, int w, int h, int cutSize, uint16_t color, uint8_t corners = CORNER_ALL, M5Canvas* canvas = nullptr) {
+  // Draw main middle section (always full width)
+  if (canvas != nullptr) {
+    canvas->fillRect(x, y + cutSize, w, h - (cutSize * 2), color);
+  } else {
+    M5Cardputer.Display.fillRect(x, y + cutSize, w, h - (cutSize * 2), color);
+  }
+
+  // Top edge
+  int topStart = (corners & CORNER_TOP_LEFT) ? cutSize : 0;
+  int topEnd = (corners & CORNER_TOP_RIGHT) ? w - cutSize : w;
+  if (canvas != nullptr) {
+    canvas->fillRect(x + topStart, y, topEnd - topStart, cutSize, color);
+  } else {
+    M5Cardputer.Display.fillRect(x + topStart, y, topEnd - topStart, cutSize, color);
+  }
+
+  // Bottom edge
+  int bottomStart = (corners & CORNER_BOTTOM_LEFT) ? cutSize : 0;
+  int bottomEnd = (corners & CORNER_BOTTOM_RIGHT) ? w - cutSize : w;
+  if (canvas != nullptr) {
+    canvas->fillRect(x + bottomStart, y + h - cutSize, bottomEnd - bottomStart, cutSize, color);
+  } else {
+    M5Cardputer.Display.fillRect(x + bottomStart, y + h - cutSize, bottomEnd - bottomStart, cutSize, color);
+  }
+}
+
+/**
+ * Draw an outline rectangle with optional cut corners
+ *
+ * @param x X position
+ * @param y Y position
+ * @param w Width
+ * @param h Height
+ * @param cutSize Size of corner cuts in pixels
+ * @param color Line color
+ * @param corners Bitfield of which corners to cut (use CORNER_* flags)
+ */
+void drawCutCornerOutline(int x, int y, int w, int h, int cutSize, uint16_t color, uint8_t corners = CORNER_ALL, M5Canvas* canvas = nullptr) {
+  // Draw the four edges with proper gaps at corners to create clean cutouts
+
+  // Top edge - skip cutSize pixels on each end where corners are cut
+  int topStart = (corners & CORNER_TOP_LEFT) ? cutSize : 0;
+  int topEnd = (corners & CORNER_TOP_RIGHT) ? w - cutSize : w;
+  if (topEnd > topStart) {
+    if (canvas != nullptr) {
+      canvas->fillRect(x + topStart, y, topEnd - topStart, 1, color);
+    } else {
+      M5Cardputer.Display.fillRect(x + topStart, y, topEnd - topStart, 1, color);
+    }
+  }
+
+  // Bottom edge
+  int bottomStart = (corners & CORNER_BOTTOM_LEFT) ? cutSize : 0;
+  int bottomEnd = (corners & CORNER_BOTTOM_RIGHT) ? w - cutSize : w;
+  if (bottomEnd > bottomStart) {
+    if (canvas != nullptr) {
+      canvas->fillRect(x + bottomStart, y + h - 1, bottomEnd - bottomStart, 1, color);
+    } else {
+      M5Cardputer.Display.fillRect(x + bottomStart, y + h - 1, bottomEnd - bottomStart, 1, color);
+    }
+  }
+
+  // Left edge - skip cutSize pixels on each end where corners are cut
+  int leftStart = (corners & CORNER_TOP_LEFT) ? cutSize : 0;
+  int leftEnd = (corners & CORNER_BOTTOM_LEFT) ? h - cutSize : h;
+  if (leftEnd > leftStart) {
+    if (canvas != nullptr) {
+      canvas->fillRect(x, y + leftStart, 1, leftEnd - leftStart, color);
+    } else {
+      M5Cardputer.Display.fillRect(x, y + leftStart, 1, leftEnd - leftStart, color);
+    }
+  }
+
+  // Right edge
+  int rightStart = (corners & CORNER_TOP_RIGHT) ? cutSize : 0;
+  int rightEnd = (corners & CORNER_BOTTOM_RIGHT) ? h - cutSize : h;
+  if (rightEnd > rightStart) {
+    if (canvas != nullptr) {
+      canvas->fillRect(x + w - 1, y + rightStart, 1, rightEnd - rightStart, color);
+    } else {
+      M5Cardputer.Display.fillRect(x + w - 1, y + rightStart, 1, rightEnd - rightStart, color);
+    }
+  }
+
+  // Corners are left as empty cutouts (cutSize × cutSize squares removed from each corner)
+}
+
+/**
+ * Blend two RGB565 colors with alpha (0.0 = bg only, 1.0 = fg only)
+ */
+uint16_t blendRGB565(uint16_t bg, uint16_t fg, float alpha) {
+  // Extract RGB components from RGB565
+  uint8_t bgR = (bg >> 11) & 0x1F;
+  uint8_t bgG = (bg >> 5) & 0x3F;
+  uint8_t bgB = bg & 0x1F;
+
+  uint8_t fgR = (fg >> 11) & 0x1F;
+  uint8_t fgG = (fg >> 5) & 0x3F;
+  uint8_t fgB = fg & 0x1F;
+
+  // Blend
+  uint8_t outR = bgR + (fgR - bgR) * alpha;
+  uint8_t outG = bgG + (fgG - bgG) * alpha;
+  uint8_t outB = bgB + (fgB - bgB) * alpha;
+
+  // Pack back to RGB565
+  return (outR << 11) | (outG << 5) | outB;
+}
+
+/**
+ * Draw a line with alpha transparency by blending a color with existing pixels
+ */
+void drawLineWithAlpha(int x, int y, int w, int h, uint16_t color, float alpha) {
+  for (int py = 0; py < h; py++) {
+    for (int px = 0; px < w; px++) {
+      uint16_t bgColor = M5Cardputer.Display.readPixel(x + px, y + py);
+      uint16_t blended = blendRGB565(bgColor, color, alpha);
+      M5Cardputer.Display.drawPixel(x + px, y + py, blended);
+    }
+  }
+}
+
+/**
+ * Draw a single cell at the given grid coordinates
+ *
+ * This redraws one cell with either:
+ * - The pixel color if a pixel is placed there
+ * - The checkerboard background if empty (pattern based on screen pixels)
+ */
+void drawCell(int x, int y, bool isSelected = false) {
+  int screenX = GRID_X + (x * currentCellSize);
+  int screenY = GRID_Y + (y * currentCellSize);
+
+  // Check if this cell has a color
+  if (canvas[y][x] != 0) {
+    // FILLED CELL: Draw solid color directly (center lines will be underneath/hidden)
+    uint16_t cellColor = activeSketch.paletteColors[canvas[y][x] - 1];
+
+    // Apply tint if this is the selected cell
+    if (isSelected) {
+      // Darken the cell in both themes
+      uint8_t r = ((cellColor >> 11) & 0x1F) * 0.8;
+      uint8_t g = ((cellColor >> 5) & 0x3F) * 0.8;
+      uint8_t b = (cellColor & 0x1F) * 0.8;
+      cellColor = (r << 11) | (g << 5) | b;
+    }
+
+    M5Cardputer.Display.fillRect(screenX, screenY, currentCellSize, currentCellSize, cellColor);
+  } else {
+    // EMPTY CELL: Draw checkerboard pattern, then center lines on top
+    int checkSize = currentCellSize / 2;
+
+    // Draw checkerboard pattern
+    for (int py = 0; py < currentCellSize; py += checkSize) {
+      for (int px = 0; px < currentCellSize; px += checkSize) {
+        int absX = screenX + px;
+        int absY = screenY + py;
+        bool isDark = ((absX / checkSize) + (absY / checkSize)) % 2 == 0;
+        uint16_t color = isDark ? currentTheme->cellDark : currentTheme->cellLight;
+
+        // Apply tint if this is the selected cell
+        if (isSelected) {
+          if (currentTheme == &THEME_DARK) {
+            // In dark mode, darken each square differently to maintain checkerboard visibility
+            // Dark squares: darken less (0.5) - already very dark, don't over-darken
+            // Light squares: darken more (0.3) - bring them closer to dark squares
+            float multiplier = isDark ? 0.4 : 0.2;
+            uint8_t r = ((color >> 11) & 0x1F) * multiplier;
+            uint8_t g = ((color >> 5) & 0x3F) * multiplier;
+            uint8_t b = (color & 0x1F) * multiplier;
+            color = (r << 11) | (g << 5) | b;
+          } else {
+            // In light mode, darken the cell uniformly
+            uint8_t r = ((color >> 11) & 0x1F) * 0.8;
+            uint8_t g = ((color >> 5) & 0x3F) * 0.8;
+            uint8_t b = (color & 0x1F) * 0.8;
+            color = (r << 11) | (g << 5) | b;
+          }
+        }
+
+        int drawWidth = min(checkSize, currentCellSize - px);
+        int drawHeight = min(checkSize, currentCellSize - py);
+        M5Cardputer.Display.fillRect(absX, absY, drawWidth, drawHeight, color);
+      }
+    }
+
+    // Draw center lines (if rulers are visible and they pass through this cell)
+    if (rulersVisible) {
+      int centerX = GRID_X + 64;  // Vertical line at x=120
+      int centerY = GRID_Y + 64;  // Horizontal line at y=68
+
+      if (centerX >= screenX && centerX < screenX + currentCellSize) {
+        // Redraw the vertical line segment for this cell
+        M5Cardputer.Display.fillRect(centerX, screenY, 1, currentCellSize, currentTheme->centerLine);
+      }
+
+      if (centerY >= screenY && centerY < screenY + currentCellSize) {
+        // Redraw the horizontal line segment for this cell
+        M5Cardputer.Display.fillRect(screenX, centerY, currentCellSize, 1, currentTheme->centerLine);
+      }
+    }
+  }
+
+  // LAYER 4: Apply corner masking for corner cells
+  if (x == 0 && y == 0) {
+    M5Cardputer.Display.fillRect(screenX, screenY, 2, 2, currentTheme->background);
+  }
+  else if (x == currentGridSize - 1 && y == 0) {
+    M5Cardputer.Display.fillRect(screenX + currentCellSize - 2, screenY, 2, 2, currentTheme->background);
+  }
+  else if (x == 0 && y == currentGridSize - 1) {
+    M5Cardputer.Display.fillRect(screenX, screenY + currentCellSize - 2, 2, 2, currentTheme->background);
+  }
+  else if (x == currentGridSize - 1 && y == currentGridSize - 1) {
+    M5Cardputer.Display.fillRect(screenX + currentCellSize - 2, screenY + currentCellSize - 2, 2, 2, currentTheme->shadow);
+  }
+}
+
+/**
+ * Redraw the cells a whole-canvas operation changed (canvasChanged), then clear the mask
+ */
+void drawChangedCells() {
+  for (int y = 0; y < currentGridSize; y++) {
+    for (CanvasRow bits = canvasChanged[y] & planeRowMask<CanvasRow>(currentGridSize); bits; bits &= bits - 1) {
+      drawCell(__builtin_ctz(bits), y);
+    }
+  }
+  memset(canvasChanged, 0, sizeof(canvasChanged));
+}
+
+/**
+ * Draw the cursor
+ *
+ * Draws a simple arrow pointer below and to the right of the selected cell
+ */
+void drawCursor() {
+  // Clear the old cursor icon position if it exists
+  if (lastCursorScreenX >= 0 && lastCursorScreenY >= 0) {
+    // Calculate which cells might have been covered by the old cursor icon
+    int oldCursorEndX = lastCursorScreenX + ICON_CANVAS_CURSOR_WIDTH;
+    int oldCursorEndY = lastCursorScreenY + ICON_CANVAS_CURSOR_HEIGHT;
+
+    // Find grid cells that overlap with the old cursor area
+    int startCellX = max(0, (lastCursorScreenX - GRID_X) / currentCellSize);
+    int startCellY = max(0, (lastCursorScreenY - GRID_Y) / currentCellSize);
+    int endCellX = min(currentGridSize - 1, (oldCursorEndX - GRID_X) / currentCellSize);
+    int endCellY = min(currentGridSize - 1, (oldCursorEndY - GRID_Y) / currentCellSize);
+
+    // First, fill the old cursor area with background color
+    M5Cardputer.Display.fillRect(
+      lastCursorScreenX,
+      lastCursorScreenY,
+      ICON_CANVAS_CURSOR_WIDTH,
+      ICON_CANVAS_CURSOR_HEIGHT,
+      currentTheme->background
+    );
+
+    // Then redraw all cells that were covered by the old cursor
+    for (int y = startCellY; y <= endCellY && y < currentGridSize; y++) {
+      for (int x = startCellX; x <= endCellX && x < currentGridSize; x++) {
+        drawCell(x, y);
+      }
+    }
+
+    // Redraw shadow edges if cursor overlapped them (shadow extends 2px beyond grid)
+    // Right edge shadow: from GRID_X+128 to GRID_X+130
+    if (oldCursorEndX > GRID_X + 128) {
+      M5Cardputer.Display.fillRect(GRID_X + 128, GRID_Y + 2, 2, 128, currentTheme->shadow);
+    }
+    // Bottom edge shadow: from GRID_Y+128 to GRID_Y+130
+    if (oldCursorEndY > GRID_Y + 128) {
+      M5Cardputer.Display.fillRect(GRID_X + 2, GRID_Y + 128, 128, 2, currentTheme->shadow);
+    }
+    // Restore corner cuts if we redrew shadow
+    if (oldCursorEndX > GRID_X + 128 || oldCursorEndY > GRID_Y + 128) {
+      M5Cardputer.Display.fillRect(GRID_X + 128, GRID_Y + 2, 2, 2, currentTheme->background);  // Shadow's TR cut
+      M5Cardputer.Display.fillRect(GRID_X + 2, GRID_Y + 128, 2, 2, currentTheme->background);  // Shadow's BL cut
+      M5Cardputer.Display.fillRect(GRID_X + 128, GRID_Y + 128, 2, 2, currentTheme->background); // Shadow's BR cut
+    }
+  }
+
+  // Draw the selected cell with tint
+  drawCell(cursorX, cursorY, true);
+
+  // Convert grid coordinates to screen coordinates (top-left of cell)
+  int cellX = GRID_X + (cursorX * currentCellSize);
+  int cellY = GRID_Y + (cursorY * currentCellSize);
+
+  // Position cursor below and to the right of the cell, with offset for alignment
+  int cursorX_pos = cellX + currentCellSize + CURSOR_OFFSET_X;
+  int cursorY_pos = cellY + currentCellSize + CURSOR_OFFSET_Y;
+
+  // Draw the cursor icon
+  drawIcon(cursorX_pos, cursorY_pos, ICON_CANVAS_CURSOR, ICON_CANVAS_CURSOR_WIDTH, ICON_CANVAS_CURSOR_HEIGHT, ICON_CANVAS_CURSOR_IS_INDEXED);
+
+  // Save this position for next time
+  lastCursorScreenX = cursorX_pos;
+  lastCursorScreenY = cursorY_pos;
+}
+
+/**
+ * Draw the palette column with selection indicator
+ *
+ * Draws color swatches and the selection indicator.
+ * This is a simple, complete redraw - no optimization.
+ * Layout:
+ * - 4-color: single column, right-aligned
+ * - 8-color: single column, right-aligned
+ * - 16-color: two columns
+ */
+void drawPalette() {
+  // Clear the entire palette area (with a bit of margin for the selection border)
+  M5Cardputer.Display.fillRect(
+    PALETTE_X - 4,
+    GRID_Y - 4,
+    PALETTE_WIDTH + 8,
+    (PALETTE_SWATCH_SIZE * 8) + 8,
+    currentTheme->background
+  );
+
+  // Determine layout based on palette size
+  // 4-color and 8-color: one column, right-aligned
+  // 16-color: two columns
+  int numColors = activeSketch.paletteSize;
+  int startX = (numColors <= 8) ? (PALETTE_X + PALETTE_SWATCH_SIZE) : PALETTE_X;  // Right-aligned for 4 and 8-color
+
+  // Draw shadow behind the palette (with cut corners)
+  int paletteWidth = (numColors <= 8) ? PALETTE_SWATCH_SIZE : PALETTE_WIDTH;
+  int paletteHeight = (numColors <= 8) ? (numColors * PALETTE_SWATCH_SIZE) : (8 * PALETTE_SWATCH_SIZE);
+  drawShadow(startX, GRID_Y, paletteWidth, paletteHeight, true);
+
+  // Draw color swatches
+  for (int i = 0; i < numColors; i++) {
+    int col = (numColors <= 8) ? 0 : (i / 8);  // Always column 0 for 4/8-color
+    int row = (numColors <= 8) ? i : (i % 8);   // Row 0-3/0-7 for 4/8-color, 0-7 for 16-color
+
+    int swatchX = startX + (col * PALETTE_SWATCH_SIZE);
+    int swatchY = GRID_Y + (row * PALETTE_SWATCH_SIZE);
+
+    // Draw the 16×16 color swatch using active sketch's palette
+    M5Cardputer.Display.fillRect(
+      swatchX,
+      swatchY,
+      PALETTE_SWATCH_SIZE,
+      PALETTE_SWATCH_SIZE,
+      activeSketch.paletteColors[i]
+    );
+
+    // Apply corner masking for corner swatches (only if NOT currently selected)
+    bool isSelected = (i == selectedColor - 1);
+    if (!isSelected) {
+      if (numColors == 4) {
+        // 4-color: single column, right-aligned
+        if (i == 0) {
+          // Top: mask both top corners
+          M5Cardputer.Display.fillRect(swatchX, swatchY, 2, 2, currentTheme->background);  // Top-left
+          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, 2, currentTheme->background);  // Top-right
+        }
+        else if (i == 3) {
+          // Bottom: mask both bottom corners
+          M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->background);  // Bottom-left
+          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->shadow);  // Bottom-right (shadow!)
+        }
+      }
+      else if (numColors == 8) {
+        // 8-color: single column, right-aligned
+        if (i == 0) {
+          // Top: mask both top corners
+          M5Cardputer.Display.fillRect(swatchX, swatchY, 2, 2, currentTheme->background);  // Top-left
+          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, 2, currentTheme->background);  // Top-right
+        }
+        else if (i == 7) {
+          // Bottom: mask both bottom corners
+          M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->background);  // Bottom-left
+          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->shadow);  // Bottom-right (shadow!)
+        }
+      } else {
+        // 16-color: two columns
+        if (i == 0) {
+          // Color 1 (index 0): top-left of left column - mask top-left corner
+          M5Cardputer.Display.fillRect(swatchX, swatchY, 2, 2, currentTheme->background);
+        }
+        else if (i == 7) {
+          // Color 8 (index 7): bottom-left of left column - mask bottom-left corner
+          M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->background);
+        }
+        else if (i == 8) {
+          // Color 9 (index 8): top-right of right column - mask top-right corner
+          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, 2, currentTheme->background);
+        }
+        else if (i == 15) {
+          // Color 16 (index 15): bottom-right of right column - mask bottom-right corner
+          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->shadow);  // Bottom-right (shadow!)
+        }
+      }
+    }
+  }
+
+  // Draw selection indicator on the selected color
+  int selectedIndex = selectedColor - 1;
+  int col = (numColors <= 8) ? 0 : (selectedIndex / 8);
+  int row = (numColors <= 8) ? selectedIndex : (selectedIndex % 8);
+
+  int swatchX = startX + (col * PALETTE_SWATCH_SIZE);
+  int swatchY = GRID_Y + (row * PALETTE_SWATCH_SIZE);
+
+  // Draw 2px black outline OUTSIDE the swatch
+  M5Cardputer.Display.fillRect(swatchX - 2, swatchY - 2, PALETTE_SWATCH_SIZE + 4, 2, TFT_BLACK);  // Top
+  M5Cardputer.Display.fillRect(swatchX - 2, swatchY + PALETTE_SWATCH_SIZE, PALETTE_SWATCH_SIZE + 4, 2, TFT_BLACK);  // Bottom
+  M5Cardputer.Display.fillRect(swatchX - 2, swatchY - 2, 2, PALETTE_SWATCH_SIZE + 4, TFT_BLACK);  // Left
+  M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE, swatchY - 2, 2, PALETTE_SWATCH_SIZE + 4, TFT_BLACK);  // Right
+
+  // Draw 2px light inset INSIDE the swatch (right against the edge)
+  M5Cardputer.Display.fillRect(swatchX, swatchY, PALETTE_SWATCH_SIZE, 2, currentTheme->iconLight);  // Top
+  M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, PALETTE_SWATCH_SIZE, 2, currentTheme->iconLight);  // Bottom
+  M5Cardputer.Display.fillRect(swatchX, swatchY, 2, PALETTE_SWATCH_SIZE, currentTheme->iconLight);  // Left
+  M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, PALETTE_SWATCH_SIZE, currentTheme->iconLight);  // Right
+}
+
+// ============================================================================
+// DRAW MEMORY VIEW GRID - Vertical scrolling (NEW VERSION)
+// 4 columns, vertical scrolling through rows
+// ============================================================================
+void drawMemoryViewGrid(bool fullRedraw = true) {
+  const int COLS = 4;         // 4 columns across
+  const int thumbSize = 48;   // Each thumbnail is 48×48 pixels
+  const int thumbGap = 8;     // Gap between thumbnails horizontally
+  const int rowGap = 8;       // Gap between rows vertically
+  const int titleHeight = 14; // Height of title area
+  const int titleGap = 5;     // Gap between title and first row
+
+  // Total items = 1 (create new button) + number of sketches
+  int totalItems = 1 + sketchList.size();
+
+  // Calculate which column and row the cursor is in (4 columns)
+  int cursorCol = memoryViewCursor % COLS;
+  int cursorRow = memoryViewCursor / COLS;
+
+  // Vertical scrolling logic: scroll to keep cursor row visible
+  const int topMargin = 5;     // Small margin at screen top
+  const int bottomMargin = 5;  // Space at bottom of screen
+  const int itemHeight = thumbSize + rowGap;
+
+  // Calculate cursor position with current TARGET scroll offset
+  // Grid starts at: titleHeight + topMargin (title at 0, then topMargin gap)
+  int gridStartY = titleHeight + topMargin;
+  int cursorScreenY = gridStartY + (cursorRow * itemHeight) - memoryViewScrollOffset;
+
+  // Define scrolling bounds (area where cursor should stay visible)
+  // When on first row, we want to scroll back to show the title (scroll offset = 0)
+  // So top bound should be where the first row naturally sits when title is visible
+  int topBound = titleHeight + topMargin;  // Allow room for title above
+  int bottomBound = 135 - bottomMargin - thumbSize;
+
+  // Adjust TARGET scroll offset to keep cursor in bounds
+  if (cursorScreenY > bottomBound) {
+    // Cursor is past bottom edge - scroll up (increase offset)
+    memoryViewScrollOffset += (cursorScreenY - bottomBound);
+  } else if (cursorScreenY < topBound) {
+    // Cursor is past top edge - scroll down (decrease offset)
+    memoryViewScrollOffset -= (topBound - cursorScreenY);
+  }
+
+  // Clamp scroll offset to reasonable bounds
+  int totalRows = (totalItems + COLS - 1) / COLS;  // Ceiling division
+  int totalContentHeight = titleHeight + topMargin + (totalRows * thumbSize) + ((totalRows - 1) * rowGap);
+  int visibleHeight = 135 - bottomMargin;  // Can scroll from 0 to bottom
+  int maxScroll = max(0, totalContentHeight - visibleHeight);
+
+  if (memoryViewScrollOffset < 0) memoryViewScrollOffset = 0;
+  if (memoryViewScrollOffset > maxScroll) memoryViewScrollOffset = maxScroll;
+
+  // Smooth animation: interpolate actual scroll position towards target
+  float targetPos = (float)memoryViewScrollOffset;
+  float diff = targetPos - memoryViewScrollPos;
+
+  if (fabs(diff) > 0.5f) {
+    // Smoothly animate towards target
+    memoryViewScrollPos += diff * MEMORY_SCROLL_SPEED;
+  } else {
+    // Close enough - snap to target
+    memoryViewScrollPos = targetPos;
+  }
+
+  // Calculate title Y position (scrolls with content)
+  // Title starts at 0 (to match PALETTES position), not topMargin
+  int titleY = 0 - (int)memoryViewScrollPos;
+
+  // Calculate base Y (where row 0 starts) using animated scroll position
+  // Grid starts after title, with topMargin acting as the gap
+  int baseY = titleHeight + topMargin - (int)memoryViewScrollPos;
+
+  // Calculate column X positions (horizontally centered)
+  // Total width: 4 columns × 48px + 3 gaps × 7px = 213px
+  int totalWidth = (COLS * thumbSize) + ((COLS - 1) * thumbGap);
+  int startX = (240 - totalWidth) / 2;
+
+  // Create canvas for entire screen to eliminate tearing
+  // Memory required: 240×135×2 = 64,800 bytes (~64KB)
+  if (!memoryCanvas.createSprite(240, 135)) {
+    // Memory allocation failed - show warning once to prevent flashing
+    static bool memoryErrorShown = false;
+    if (!memoryErrorShown) {
+      M5Cardputer.Display.fillScreen(currentTheme->background);
+      M5Cardputer.Display.setTextColor(TFT_RED);
+      M5Cardputer.Display.setCursor(10, 50);
+      M5Cardputer.Display.println("WARNING: Low memory!");
+      M5Cardputer.Display.setCursor(10, 65);
+      M5Cardputer.Display.println("Cannot display sketches.");
+      M5Cardputer.Display.setCursor(10, 85);
+      M5Cardputer.Display.setTextColor(currentTheme->text);
+      M5Cardputer.Display.println("Press ESC (`) to exit");
+      M5Cardputer.Display.setCursor(10, 100);
+      M5Cardputer.Display.println("Restart device to recover");
+      memoryErrorShown = true;
+    }
+    return;  // Skip drawing this frame, but allow keyboard handling
+  }
+  memoryCanvas.fillSprite(currentTheme->background);
+
+  // Draw title to canvas (scrollable position)
+  if (titleY > -titleHeight && titleY < 135) {  // Only draw if at least partially visible
+    memoryCanvas.setTextColor(currentTheme->text);
+    memoryCanvas.setTextSize(1);
+    memoryCanvas.setCursor(4, titleY + 4);
+    memoryCanvas.print(memoryGroupByPalette ? "SKETCHES BY PALETTE" : "SKETCHES");
+    if (memoryScan.active) {
+      // Still listing the library
+      char countText[16];
+      snprintf(countText, sizeof(countText), " %u...", (unsigned)sketchList.size());
+      memoryCanvas.setTextColor(currentTheme->textSecondary);
+      memoryCanvas.print(countText);
+    }
+  }
+
+  // Limit SD preview reads per frame; the rest show placeholders until later frames
+  memoryPreviewLoadsLeft = MEMORY_PREVIEW_LOADS_PER_FRAME;
+
+  // Draw all items in grid layout
+  for (int itemIndex = 0; itemIndex < totalItems; itemIndex++) {
+    int col = itemIndex % COLS;
+    int row = itemIndex / COLS;
+
+    int screenX = startX + (col * (thumbSize + thumbGap));
+    int screenY = baseY + (row * (thumbSize + rowGap));
+
+    // Only draw if thumbnail is at least partially visible on screen
+    if (screenY < -thumbSize - 10 || screenY > 135 + 10) {
+      continue;  // Skip off-screen thumbnails
+    }
+
+    if (itemIndex == 0) {
+      // First item is the "create new" button
+      drawCreateNewSketchThumbnail(screenX, screenY, thumbSize);
+    } else {
+      // Subsequent items are sketches (using cached data!)
+      drawSketchThumbnail(itemIndex - 1, screenX, screenY, thumbSize);
+    }
+  }
+
+  // Draw breathing cursor AFTER all thumbnails (ensures cursor is on top)
+  int cursorX = startX + (cursorCol * (thumbSize + thumbGap));
+  int cursorY = baseY + (cursorRow * (thumbSize + rowGap));
+
+  // Only draw cursor if it's visible on screen
+  if (cursorY >= -thumbSize - 10 && cursorY <= 135 + 10) {
+    drawMemoryViewCursor(memoryViewCursor, cursorX, cursorY, thumbSize);
+  }
+
+  // Draw status message at bottom if one exists
+  if (statusMessage[0] != '\0' && (millis() - statusMessageTime < STATUS_DISPLAY_DURATION)) {
+    memoryCanvas.setTextColor(currentTheme->text);
+    memoryCanvas.setTextSize(1);
+    memoryCanvas.setCursor(3, 124);
+    memoryCanvas.print(statusMessage);
+  }
+
+  if (collectionPicker.open) {
+    drawCollectionPicker();
+  }
+
+  // Push entire canvas to display at (0, 0) to eliminate tearing
+  memoryCanvas.pushSprite(0, 0);
+  memoryCanvas.deleteSprite();
+}
+
+/**
+ * Draw the collection picker over the memory view grid
+ */
+void drawCollectionPicker() {
+  const int rowHeight = 11;
+  const int visibleRows = 8;
+  const int boxW = 140;
+  const int boxH = 20 + visibleRows * rowHeight;
+  const int boxX = (240 - boxW) / 2;
+  const int boxY = (135 - boxH) / 2;
+  int rows = collectionPicker.count + 2;  // All sketches + names + new
+  int first = max(0, min(collectionPicker.cursor - visibleRows / 2, rows - visibleRows));
+
+  memoryCanvas.fillRect(boxX, boxY, boxW, boxH, currentTheme->background);
+  memoryCanvas.drawRect(boxX, boxY, boxW, boxH, currentTheme->text);
+  memoryCanvas.setTextSize(1);
+  memoryCanvas.setTextColor(currentTheme->textSecondary);
+  memoryCanvas.setCursor(boxX + 6, boxY + 5);
+  const char* titles[] = {"OPEN COLLECTION", "MOVE TO", "COPY TO"};
+  memoryCanvas.print(titles[collectionPicker.action]);
+
+  for (int row = first; row < rows && row < first + visibleRows; row++) {
+    int y = boxY + 18 + (row - first) * rowHeight;
+    bool focused = (row == collectionPicker.cursor);
+    if (focused) {
+      memoryCanvas.fillRect(boxX + 3, y - 1, boxW - 6, rowHeight, currentTheme->cellDark);
+    }
+    memoryCanvas.setTextColor(focused ? currentTheme->background : currentTheme->text);
+    memoryCanvas.setCursor(boxX + 6, y + 1);
+    if (row == 0) {
+      memoryCanvas.print("All sketches");
+    } else if (row <= collectionPicker.count) {
+      memoryCanvas.print(collectionPicker.names[row - 1]);
+    } else if (collectionPicker.naming) {
+      memoryCanvas.print(collectionPicker.newName);
+      memoryCanvas.print("_");
+    } else {
+      memoryCanvas.print("+ New");
+    }
+  }
+}
+
+// Helper function to draw a single memory sketch thumbnail (OBSOLETE - kept for compatibility)
+// Now replaced by drawCreateNewSketchThumbnail() and drawSketchThumbnail()
+void drawMemorySketchThumbnail(int sketchIndex, int x, int y, int thumbSize) {
+  // OBSOLETE: This function is no longer used in the unlimited sketches system
+  // It's kept as a stub to avoid breaking any remaining references
+  // The memory view now uses drawCreateNewSketchThumbnail() and drawSketchThumbnail()
+}
+
+// Helper function to draw "+" create new sketch button
+void drawCreateNewSketchThumbnail(int x, int y, int thumbSize) {
+  // Draw dashed outline
+  uint16_t outlineColor = currentTheme->cellDark;
+  const int cutSize = 2;
+  const int dashLength = 4;
+  const int gapLength = 4;
+
+  // Draw dotted outline - 2px thick
+  // Top edge (skip corners)
+  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
+    int len = min(dashLength, thumbSize - cutSize - i);
+    memoryCanvas.fillRect(x + i, y, len, 2, outlineColor);
+  }
+  // Bottom edge (skip corners)
+  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
+    int len = min(dashLength, thumbSize - cutSize - i);
+    memoryCanvas.fillRect(x + i, y + thumbSize - 2, len, 2, outlineColor);
+  }
+  // Left edge (skip corners)
+  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
+    int len = min(dashLength, thumbSize - cutSize - i);
+    memoryCanvas.fillRect(x, y + i, 2, len, outlineColor);
+  }
+  // Right edge (skip corners)
+  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
+    int len = min(dashLength, thumbSize - cutSize - i);
+    memoryCanvas.fillRect(x + thumbSize - 2, y + i, 2, len, outlineColor);
+  }
+
+  // Draw "+" symbol in center
+  int centerX = x + thumbSize / 2;
+  int centerY = y + thumbSize / 2;
+  int plusSize = 15;
+  int plusThickness = 3;
+
+  memoryCanvas.fillRect(centerX - plusThickness/2, centerY - plusSize/2,
+                        plusThickness, plusSize, currentTheme->text);
+  memoryCanvas.fillRect(centerX - plusSize/2, centerY - plusThickness/2,
+                        plusSize, plusThickness, currentTheme->text);
+}
+
+// Helper function to draw sketch thumbnail using cached data
+void drawSketchThumbnail(int sketchIndex, int x, int y, int thumbSize) {
+  if (sketchIndex < 0 || sketchIndex >= sketchList.size()) {
+    return;
+  }
+
+  SketchInfo& info = sketchList[sketchIndex];
+
+  // Load preview from SD if not already cached (within this frame's budget)
+  bool previewReady = info.dataLoaded;
+  if (!previewReady && memoryPreviewLoadsLeft > 0) {
+    memoryPreviewLoadsLeft--;
+    previewReady = loadSketchPreview(info);
+  }
+
+  if (!previewReady) {
+    // Placeholder tile until the preview has been read
+    memoryCanvas.fillRect(x, y, thumbSize, thumbSize, currentTheme->shadow);
+  } else {
+    // Use cached data to render thumbnail
+    Sketch& tempSketch = info.sketchData;
+
+    int cellSize = (tempSketch.gridSize == 8) ? 6 : 3;
+    int gridPixelSize = tempSketch.gridSize * cellSize;
+    int offsetX = (thumbSize - gridPixelSize) / 2;
+    int offsetY = (thumbSize - gridPixelSize) / 2;
+
+    for (int py = 0; py < tempSketch.gridSize; py++) {
+      for (int px = 0; px < tempSketch.gridSize; px++) {
+        uint8_t pixelIndex = tempSketch.pixels[py][px];
+        if (pixelIndex == 0) continue;
+
+        uint16_t color = tempSketch.paletteColors[pixelIndex - 1];
+        memoryCanvas.fillRect(x + offsetX + (px * cellSize),
+                             y + offsetY + (py * cellSize),
+                             cellSize, cellSize, color);
+      }
+    }
+  }
+
+  // Cut corners
+  const int cutSize = 2;
+  uint16_t bgColor = currentTheme->background;
+  memoryCanvas.fillRect(x, y, cutSize, cutSize, bgColor);
+  memoryCanvas.fillRect(x + thumbSize - cutSize, y, cutSize, cutSize, bgColor);
+  memoryCanvas.fillRect(x, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
+  memoryCanvas.fillRect(x + thumbSize - cutSize, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
+
+  // Draw yellow border if this is the currently active sketch
+  if (info.filename == activeSketchFilename && !activeSketchIsNew) {
+    memoryCanvas.drawRect(x - 1, y - 1, thumbSize + 2, thumbSize + 2, TFT_YELLOW);
+  }
+}
+
+// Helper function to draw breathing cursor animation on selected item
+void drawMemoryViewCursor(int itemIndex, int x, int y, int thumbSize) {
+  if (memoryViewCursor != itemIndex) {
+    return;  // Not the selected item
+  }
+
+  // Breathing cursor animation using corner icons
+  auto drawCorner = [&](int cornerX, int cornerY, bool flipH, bool flipV) {
+    for (int row = 0; row < ICON_SELECTOR_CORNER_HEIGHT; row++) {
+      for (int col = 0; col < ICON_SELECTOR_CORNER_WIDTH; col++) {
+        int pixelIndex = row * ICON_SELECTOR_CORNER_WIDTH + col;
+        int byteIndex = pixelIndex / 4;
+        int bitShift = (3 - (pixelIndex % 4)) * 2;
+
+        uint8_t byte = pgm_read_byte(&ICON_SELECTOR_CORNER[byteIndex]);
+        uint8_t value = (byte >> bitShift) & 0x03;
+
+        if (value != 0) {
+          int drawX = flipH ? (cornerX + ICON_SELECTOR_CORNER_WIDTH - 1 - col) : (cornerX + col);
+          int drawY = flipV ? (cornerY + ICON_SELECTOR_CORNER_HEIGHT - 1 - row) : (cornerY + row);
+
+          uint16_t color = (value == 1) ? currentTheme->iconDark : currentTheme->iconLight;
+          memoryCanvas.drawPixel(drawX, drawY, color);
+        }
+      }
+    }
+  };
+
+  // Animated breathing effect
+  float sineWave = sin(memoryCursorAnimPhase * 2.0f * PI);
+  float breathCycle = (sineWave + 1.0f) * 0.5f;
+  int offsetX = (int)(breathCycle * 4.0f + 0.5f);
+  int offsetY = (int)(breathCycle * 4.0f + 0.5f);
+
+  // Clear corners for cursor animation
+  const int cutSize = 2;
+  uint16_t bgColor = currentTheme->background;
+  memoryCanvas.fillRect(x, y, cutSize, cutSize, bgColor);
+  memoryCanvas.fillRect(x + thumbSize - cutSize, y, cutSize, cutSize, bgColor);
+  memoryCanvas.fillRect(x, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
+  memoryCanvas.fillRect(x + thumbSize - cutSize, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
+
+  // Draw animated corners (closer to thumbnail - reduced from 14 to 6 pixels away)
+  const int cornerOffset = 6;  // Distance from thumbnail edge
+  drawCorner(x - cornerOffset + offsetX, y - cornerOffset + offsetY, false, false);
+  drawCorner(x + thumbSize + cornerOffset - 16 - offsetX, y - cornerOffset + offsetY, true, false);
+  drawCorner(x - cornerOffset + offsetX, y + thumbSize + cornerOffset - 16 - offsetY, false, true);
+  drawCorner(x + thumbSize + cornerOffset - 16 - offsetX, y + thumbSize + cornerOffset - 16 - offsetY, true, true);
+}
+
+
+
+// ============================================================================
+// DRAW MEMORY VIEW 
+// ============================================================================
+void drawMemoryView(bool fullRedraw) {
+  drawMemoryViewGrid(fullRedraw);
+}
+
+#if ENABLE_LIBRARY_BENCH
+// ============================================================================
+// LIBRARY SCALING BENCHMARK (hidden: Fn+G in memory view)
+// ============================================================================
+// Builds a synthetic library under /bitmap16dx/bench/library and measures the
+// memory view against it at growing sizes. Sketches are generated from a
+// per-ID seed, so the same N always gives the same library, and files left by
+// an earlier run are reused. The user's own library is never touched:
+// sketchRoot points at the bench library only inside a measurement step.
+//
+// Results (one row per size) go to /bitmap16dx/bench/library.csv:
+//   sketches   - library size
+//   list_ms    - loadSketchListFromSD()
+//   list_kb    - heap used by the resulting sketchList
+//   thumb_us   - average cold preview load, first BENCH_THUMBS entries
+//   scroll_avg_us / scroll_max_us - memory view frames scrolling up from the end
+//   free_kb / max_block_kb - heap with the list loaded
+// A size whose list wouldn't fit in the largest free heap block is written as
+// "oom" and ends the sweep. Palette parse timing goes to palettes.csv.
+
+#define BENCH_LIBRARY_DIR "/bitmap16dx/bench/library"
+#define BENCH_PALETTE_DIR "/bitmap16dx/bench/palettes"
+#define BENCH_USER_PALETTES 32       // Synthetic .hex palettes
+#define BENCH_THUMBS 16              // Cold previews timed per size
+#define BENCH_SCROLL_FRAMES 12       // Memory view frames timed per size
+
+const uint16_t BENCH_SIZES[] = {10, 100, 1000, 5000, 10000, 20000};
+const uint8_t BENCH_SIZE_COUNT = sizeof(BENCH_SIZES) / sizeof(BENCH_SIZES[0]);
+
+enum BenchPhase {
+  BENCH_MAKE_PALETTES,
+  BENCH_PARSE_PALETTES,
+  BENCH_GENERATE,
+  BENCH_MEASURE
+};
+
+struct LibraryBenchJob {
+  BenchPhase phase;
+  uint16_t palettesMade;
+  uint8_t sizeIndex;          // Index into BENCH_SIZES
+  uint16_t sketchesMade;      // Library holds sketch_1 .. sketch_<sketchesMade>
+};
+
+/**
+ * xorshift32 - small deterministic generator for synthetic content
+ */
+uint32_t benchRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+/**
+ * Fill a sketch with plausible content for a given ID: 8×8 or 16×16 grid,
+ * a catalog palette, 10-90% coverage drawn as random-walk strokes, and
+ * mirror symmetry on about half of them.
+ */
+void generateBenchSketch(unsigned long id, Sketch& sketch) {
+  uint32_t rng = 0x9E3779B9u ^ (id * 2654435761u);
+  benchRandom(rng);
+
+  memset(sketch.pixels, 0, sizeof(sketch.pixels));
+  sketch.gridSize = (benchRandom(rng) % 10 < 7) ? 16 : 8;
+  uint8_t palette = benchRandom(rng) % totalPaletteCount;
+  sketch.paletteSize = allPaletteSizes[palette];
+  for (int i = 0; i < 16; i++) {
+    sketch.paletteColors[i] = allPalettes[palette][i];
+  }
+  sketch.isEmpty = false;
+
+  uint8_t grid = sketch.gridSize;
+  bool mirror = benchRandom(rng) & 1;
+  uint8_t drawWidth = mirror ? grid / 2 : grid;
+  int target = (drawWidth * grid) * (10 + benchRandom(rng) % 81) / 100;
+
+  int x = benchRandom(rng) % drawWidth;
+  int y = benchRandom(rng) % grid;
+  uint8_t color = 1 + benchRandom(rng) % sketch.paletteSize;
+  int filled = 0;
+  for (int steps = 0; filled < target && steps < 2048; steps++) {
+    if (sketch.pixels[y][x] == 0) {
+      filled++;
+    }
+    sketch.pixels[y][x] = color;
+
+    uint32_t r = benchRandom(rng);
+    if ((r & 15) == 0) {
+      color = 1 + (r >> 4) % sketch.paletteSize;   // New stroke colour
+    }
+    switch ((r >> 8) & 3) {
+      case 0: x = (x + 1) % drawWidth; break;
+      case 1: x = (x + drawWidth - 1) % drawWidth; break;
+      case 2: y = (y + 1) % grid; break;
+      case 3: y = (y + grid - 1) % grid; break;
+    }
+  }
+
+  if (mirror) {
+    for (int py = 0; py < grid; py++) {
+      for (int px = 0; px < drawWidth; px++) {
+        sketch.pixels[py][grid - 1 - px] = sketch.pixels[py][px];
+      }
+    }
+  }
+}
+
+/**
+ * Write a synthetic Lospec-style .hex palette with 4, 8 or 16 colors
+ */
+bool writeBenchPalette(uint16_t index) {
+  char path[48];
+  snprintf(path, sizeof(path), BENCH_PALETTE_DIR "/bench_%02u.hex", index);
+  if (SD.exists(path)) {
+    return true;
+  }
+
+  uint32_t rng = 0x2545F491u ^ (index * 2654435761u);
+  benchRandom(rng);
+  const uint8_t sizes[3] = {4, 8, 16};
+  uint8_t count = sizes[benchRandom(rng) % 3];
+
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  char line[8];
+  for (uint8_t i = 0; i < count; i++) {
+    snprintf(line, sizeof(line), "%06lx\n", (unsigned long)(benchRandom(rng) & 0xFFFFFF));
+    file.print(line);
+  }
+  file.close();
+  return true;
+}
+
+/**
+ * Append one line to a bench CSV (header written when truncate is set)
+ */
+bool writeBenchLine(const char* path, const char* line, bool truncate = false) {
+  if (truncate && SD.exists(path)) {
+    SD.remove(path);
+  }
+  File file = SD.open(path, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+  file.print(line);
+  file.close();
+  return true;
+}
+
+/**
+ * Measure the memory view against the bench library at its current size.
+ * Blocking by nature - each figure is the cost of one real operation.
+ * @return false if the list didn't fit in memory (sweep stops)
+ */
+bool measureBenchLibrary(uint16_t sketchCount) {
+  char row[96];
+
+  // Estimated peak while the list vector grows (old + doubled buffer) plus filenames
+  uint32_t needed = (uint32_t)sketchCount * (sizeof(SketchInfo) * 3 + 24);
+  if (needed > ESP.getMaxAllocHeap() + ESP.getFreeHeap() / 2) {
+    snprintf(row, sizeof(row), "%u,oom,,,,,%lu,%lu\n", sketchCount,
+             (unsigned long)(ESP.getFreeHeap() / 1024), (unsigned long)(ESP.getMaxAllocHeap() / 1024));
+    writeBenchLine(BENCH_DIR "/library.csv", row);
+    return false;
+  }
+
+  // Swap the user's list out and point the sketch helpers at the bench library
+  std::vector<SketchInfo> userList;
+  userList.swap(sketchList);
+  int savedCursor = memoryViewCursor;
+  int savedOffset = memoryViewScrollOffset;
+  float savedPos = memoryViewScrollPos;
+  sketchRoot = BENCH_LIBRARY_DIR;
+
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long start = millis();
+  loadSketchListFromSD();
+  unsigned long listMs = millis() - start;
+  uint32_t heapAfter = ESP.getFreeHeap();
+  uint32_t maxBlock = ESP.getMaxAllocHeap();
+
+  // Cold thumbnail loads from the top of the list
+  int thumbs = min((int)sketchList.size(), BENCH_THUMBS);
+  unsigned long startUs = micros();
+  for (int i = 0; i < thumbs; i++) {
+    loadSketchPreview(sketchList[i]);
+  }
+  uint32_t thumbUs = thumbs ? (micros() - startUs) / thumbs : 0;
+
+  // Scroll up a row per frame starting from the end of the list
+  memoryViewCursor = sketchList.size();
+  drawMemoryViewGrid(true);
+  memoryViewScrollPos = memoryViewScrollOffset;
+  uint32_t scrollTotalUs = 0;
+  uint32_t scrollMaxUs = 0;
+  for (int f = 0; f < BENCH_SCROLL_FRAMES; f++) {
+    if (memoryViewCursor >= 4) {
+      memoryViewCursor -= 4;
+    }
+    startUs = micros();
+    drawMemoryViewGrid(false);
+    uint32_t frameUs = micros() - startUs;
+    memoryViewScrollPos = memoryViewScrollOffset;
+    scrollTotalUs += frameUs;
+    if (frameUs > scrollMaxUs) {
+      scrollMaxUs = frameUs;
+    }
+  }
+
+  // Put everything back
+  sketchRoot = SKETCH_DIR;
+  std::vector<SketchInfo>().swap(sketchList);
+  sketchList.swap(userList);
+  memoryViewCursor = savedCursor;
+  memoryViewScrollOffset = savedOffset;
+  memoryViewScrollPos = savedPos;
+
+  snprintf(row, sizeof(row), "%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n", sketchCount, listMs,
+           (unsigned long)((heapBefore - heapAfter) / 1024), (unsigned long)thumbUs,
+           (unsigned long)(scrollTotalUs / BENCH_SCROLL_FRAMES), (unsigned long)scrollMaxUs,
+           (unsigned long)(heapAfter / 1024), (unsigned long)(maxBlock / 1024));
+  writeBenchLine(BENCH_DIR "/library.csv", row);
+  return true;
+}
+
+/**
+ * Bench job step: make palettes, time parsing them, then alternate
+ * generating sketches (one per step) and measuring each size
+ */
+JobState libraryBenchStep(Job& job) {
+  LibraryBenchJob* bench = (LibraryBenchJob*)job.context;
+
+  switch (bench->phase) {
+    case BENCH_MAKE_PALETTES:
+      if (!writeBenchPalette(bench->palettesMade)) {
+        return JOB_FAILED;
+      }
+      if (++bench->palettesMade == BENCH_USER_PALETTES) {
+        bench->phase = BENCH_PARSE_PALETTES;
+      }
+      return JOB_RUNNING;
+
+    case BENCH_PARSE_PALETTES: {
+      uint16_t colors[16];
+      uint8_t size;
+      char path[48];
+      unsigned long startUs = micros();
+      for (uint16_t i = 0; i < BENCH_USER_PALETTES; i++) {
+        snprintf(path, sizeof(path), BENCH_PALETTE_DIR "/bench_%02u.hex", i);
+        loadPaletteFromHex(path, colors, &size);
+      }
+      unsigned long totalUs = micros() - startUs;
+      char row[48];
+      snprintf(row, sizeof(row), "%u,%lu,%lu\n", BENCH_USER_PALETTES, totalUs / 1000,
+               totalUs / BENCH_USER_PALETTES);
+      writeBenchLine(BENCH_DIR "/palettes.csv", "palettes,parse_ms,per_palette_us\n", true);
+      writeBenchLine(BENCH_DIR "/palettes.csv", row);
+      bench->phase = BENCH_GENERATE;
+      return JOB_RUNNING;
+    }
+
+    case BENCH_GENERATE: {
+      if (bench->sketchesMade >= BENCH_SIZES[bench->sizeIndex]) {
+        bench->phase = BENCH_MEASURE;
+        return JOB_RUNNING;
+      }
+      unsigned long id = bench->sketchesMade + 1;
+      char filename[24];
+      snprintf(filename, sizeof(filename), "sketch_%lu.dat", id);
+
+      sketchRoot = BENCH_LIBRARY_DIR;
+      String path = sketchPath(filename);
+      bool ok = SD.exists(path.c_str());
+      if (!ok && ensureSketchShard(id)) {
+        Sketch sketch;
+        generateBenchSketch(id, sketch);
+        ok = writeSketchFile(path.c_str(), sketch);
+      }
+      sketchRoot = SKETCH_DIR;
+      if (!ok) {
+        return JOB_FAILED;
+      }
+
+      bench->sketchesMade++;
+      job.progress = (uint32_t)bench->sketchesMade * 100 / BENCH_SIZES[BENCH_SIZE_COUNT - 1];
+      return JOB_RUNNING;
+    }
+
+    case BENCH_MEASURE:
+      if (!measureBenchLibrary(bench->sketchesMade) || ++bench->sizeIndex == BENCH_SIZE_COUNT) {
+        return JOB_DONE;
+      }
+      bench->phase = BENCH_GENERATE;
+      return JOB_RUNNING;
+  }
+  return JOB_FAILED;
+}
+
+void libraryBenchFinish(Job& job, JobState state) {
+  sketchRoot = SKETCH_DIR;
+  free(job.context);
+  if (state == JOB_DONE) {
+    setStatusMessage(StatusMsg::BENCH_DONE);
+  } else if (state == JOB_FAILED) {
+    setStatusMessage(StatusMsg::BENCH_FAIL);
+  }
+}
+
+/**
+ * Start the library benchmark (ESC cancels; completed rows stay in the CSV)
+ */
+bool startLibraryBench() {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
+  }
+
+  const char* dirs[] = {BENCH_DIR, BENCH_LIBRARY_DIR, BENCH_PALETTE_DIR};
+  for (const char* dir : dirs) {
+    if (!SD.exists(dir) && !SD.mkdir(dir)) {
+      setStatusMessage(StatusMsg::BENCH_FAIL);
+      return false;
+    }
+  }
+
+  LibraryBenchJob* bench = (LibraryBenchJob*)calloc(1, sizeof(LibraryBenchJob));
+  if (!bench) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
+  }
+  if (!startJob("Bench", libraryBenchStep, libraryBenchFinish, bench)) {
+    free(bench);
+    return false;
+  }
+
+  writeBenchLine(BENCH_DIR "/library.csv",
+                 "sketches,list_ms,list_kb,thumb_us,scroll_avg_us,scroll_max_us,free_kb,max_block_kb\n", true);
+  return true;
+}
+#endif // ENABLE_LIBRARY_BENCH
+
+/**
+ * Draw Hint Screen - displays all keyboard controls
+ */
+void drawHelpView() {
+  if (!helpCanvasAvailable) return;
+
+  helpCanvas.fillSprite(currentTheme->background);
+  helpCanvas.setTextSize(1);
+
+  // Title
+  helpCanvas.setTextColor(currentTheme->text);
+  helpCanvas.setCursor(4, 4);
+  helpCanvas.print("HINTS");
+
+  struct HelpItem {
+    const char* label;
+    const char* key;
+    int group;
+  };
+
+  const HelpItem helpItems[] = {
+    {"Move",        "Arrows",  0},
+    {"Draw",        "Ok",      0},
+    {"Erase",       "Del",     0},
+    {"Fill",        "F",       0},
+    {"Color 1-8",   "1-8",     0},
+    {"Color 9-16",  "Fn 1-8",  0},
+    {"Palette",     "P",       0},
+    {"Clear",       "G0",      0},
+    {"Preview",     "V",       0},
+    {"Tile strip",  "Fn V",    0},
+    {"Grid size",   "G",       0},
+    {"Grid ruler",  "R",       0},
+    {"Open",        "O",       1},
+    {"Mural",       "M",       1},
+    {"Undo",        "Z",       1},
+    {"Save",        "S",       1},
+    {"Save as",     "Fn S",    1},
+    {"Settings",    "T",       1},
+    {"Export",      "X",       1},
+    {"Brightness",  "B +/-",   1},
+    {"Charge",      "Fn B",    1},
+#if ENABLE_LED_MATRIX
+    {"RGB on/off",  "L Ok",    2},
+    {"RGB Bright",  "L +/-",   2},
 #endif
   };
 
+  const int totalItems = sizeof(helpItems) / sizeof(helpItems[0]);
+  const int startY = 18;
+  const int lineHeight = 14;
+  const int selectedLineHeight = 24;
+  const int groupGap = 8;
+  const int labelX = 12;
+  const int keyX = 156;
+
+  // Auto-scroll to keep cursor visible
+  if (helpViewCursor < helpViewScrollOffset) {
+    helpViewScrollOffset = helpViewCursor;
+  }
+  while (helpViewScrollOffset < helpViewCursor) {
+    int y = startY;
+    for (int i = helpViewScrollOffset; i <= helpViewCursor && i < totalItems; i++) {
+      if (i > helpViewScrollOffset && helpItems[i].group != helpItems[i-1].group) y += groupGap;
+      y += (i == helpViewCursor) ? selectedLineHeight : lineHeight;
+    }
+    if (y <= 135) break;
+    helpViewScrollOffset++;
+  }
+
+  // Draw visible rows
   int y = startY;
-  for (int i = 0; i < SETTINGS_ITEM_COUNT; i++) {
-    bool isSelected = (i == settingsViewCursor);
+  for (int i = helpViewScrollOffset; i < totalItems; i++) {
+    if (i > helpViewScrollOffset && helpItems[i].group != helpItems[i-1].group) y += groupGap;
+    if (y >= 135) break;
+
+    bool isSelected = (i == helpViewCursor);
     int rowH = isSelected ? selectedLineHeight : lineHeight;
     int textY = isSelected ? y + 4 : y;
+
     uint16_t color = isSelected ? currentTheme->text : currentTheme->textSecondary;
 
-    // Draw label
-    settingsCanvas.setTextSize(isSelected ? 2 : 1);
-    settingsCanvas.setTextColor(color);
-    settingsCanvas.setCursor(labelX, textY);
-    settingsCanvas.print(menuLabels[i]);
+    helpCanvas.setTextSize(isSelected ? 2 : 1);
+    helpCanvas.setTextColor(color);
+    helpCanvas.setCursor(labelX, textY);
+    helpCanvas.print(helpItems[i].label);
 
-    // Determine current value string
-    const char* valueText;
-    static char btBuf[16];
+    helpCanvas.setTextSize(isSelected ? 2 : 1);
+    helpCanvas.setTextColor(color);
+    helpCanvas.setCursor(keyX, textY);
+    helpCanvas.print(helpItems[i].key);
 
-    switch(i) {
-      case 0:
-        valueText = currentTheme == &THEME_LIGHT ? "Light" : "Dark";
-        break;
-      case 1:
-        valueText = defaultGridSize == 8 ? "8" : "16";
-        break;
-      case 2:
-        valueText = rgbMatrixUnits == 1 ? "1" : "4";
-        break;
-      case 3:
-        valueText = exportRGB565 ? "RGB565" : "RGB888";
-        break;
-      case 4:
-        valueText = shakeUndoEnabled ? "ON" : "OFF";
-        break;
-#if ENABLE_BLUETOOTH
-      case 5:
-        if (btConnected) {
-          valueText = "Paired";
-        } else if (btScanning) {
-          snprintf(btBuf, sizeof(btBuf), "Scan %d", btScanCountdown);
-          valueText = btBuf;
-        } else if (btEnabled && btHasBondedDevice) {
-          valueText = "Reconnect";
-        } else if (btEnabled) {
-          valueText = "Scan";
-        } else {
-          valueText = "OFF";
-        }
-        break;
-#endif
-      default:
-        valueText = "";
-        break;
+    y += rowH;
+  }
+
+  helpCanvas.pushSprite(0, 0);
+}
+
+/**
+ * Cut the corners of the 128×128 grid area by drawing background color over them
+ * BR corner shows shadow color (reveals the shadow underneath)
+ */
+void drawGridCorners() {
+  M5Cardputer.Display.fillRect(GRID_X, GRID_Y, 2, 2, currentTheme->background);                          // Top-left
+  M5Cardputer.Display.fillRect(GRID_X + 128 - 2, GRID_Y, 2, 2, currentTheme->background);                // Top-right
+  M5Cardputer.Display.fillRect(GRID_X, GRID_Y + 128 - 2, 2, 2, currentTheme->background);                // Bottom-left
+  M5Cardputer.Display.fillRect(GRID_X + 128 - 2, GRID_Y + 128 - 2, 2, 2, currentTheme->shadow);                // Bottom-right (shadow color!)
+}
+
+/**
+ * Draw the grid with checkerboard pattern
+ *
+ * This function draws a 2×2 checkerboard pattern within each cell
+ * to create a finer transparency grid, with cut corners.
+ */
+void drawGrid() {
+  // Draw shadow behind the grid (with bottom-right cut corner)
+  drawShadow(GRID_X, GRID_Y, 128, 128, true);
+
+  // Draw each cell
+  for (int y = 0; y < currentGridSize; y++) {
+    for (int x = 0; x < currentGridSize; x++) {
+      drawCell(x, y);
     }
+  }
 
-    // Draw value right-aligned, with < > on selected row
-    settingsCanvas.setTextSize(isSelected ? 2 : 1);
-    settingsCanvas.setTextColor(color);
-    const int valueRight = 228;
-    int charW = isSelected ? 12 : 6;
-    int valueLen;
-    if (isSelected) {
-      valueLen = strlen(valueText) + 2;  // "<" + text + ">"
-    } else {
-      valueLen = strlen(valueText);
+  drawGridCorners();
+}
+
+// ============================================================================
+// SETUP AND LOOP
+// ============================================================================
+
+/**
+ * Show boot screen with logo
+ * Displays boot image from boot.png (240×135)
+ */
+void showBootScreen() {
+  // Fill screen with black background for boot screen
+  M5Cardputer.Display.fillScreen(TFT_BLACK);
+
+  // Display the indexed boot image with palette
+  // Convert indices to RGB565 colors on-the-fly
+  uint16_t* lineBuffer = (uint16_t*)malloc(240 * sizeof(uint16_t));
+  if (lineBuffer) {
+    for (int y = 0; y < 135; y++) {
+      for (int x = 0; x < 240; x++) {
+        uint8_t index = pgm_read_byte(&BOOT_IMAGE[y * 240 + x]);
+        lineBuffer[x] = pgm_read_word(&BOOT_PALETTE[index]);
+      }
+      M5Cardputer.Display.pushImage(0, y, 240, 1, lineBuffer, 0xF81F);
     }
-    settingsCanvas.setCursor(valueRight - (valueLen * charW), textY);
-    if (isSelected) {
-      settingsCanvas.printf("<%s>", valueText);
-    } else {
-      settingsCanvas.print(valueText);
+    free(lineBuffer);
+  }
+
+  // Display version number in lower left corner
+  M5Cardputer.Display.setTextColor(TFT_WHITE);
+  M5Cardputer.Display.setTextSize(1);
+  M5Cardputer.Display.setCursor(4, 135 - 12);  // 4px from left, 12px from bottom
+  M5Cardputer.Display.print(FIRMWARE_VERSION);
+
+  // Wait for ESC key (`) press to continue, or timeout after 5 seconds
+  bool waiting = true;
+  unsigned long startTime = millis();
+  const unsigned long timeout = 2500; // 2.5 second timeout
+
+  while (waiting) {
+    M5Cardputer.update();
+
+    // Check for timeout
+    if (millis() - startTime > timeout) {
+      waiting = false;
+      break;
+    }
+
+    if (M5Cardputer.Keyboard.isChange() && M5Cardputer.Keyboard.isPressed()) {
+      // Check for backtick (ESC key)
+      for (auto i : M5Cardputer.Keyboard.keysState().word) {
+        if (i == '`') {
+          waiting = false;
+          break;
+        }
+      }
     }
+    delay(10);  // Small delay to prevent busy-waiting
+  }
+}
+
+// ============================================================================
+// PALETTE SYSTEM FUNCTIONS
+// ============================================================================
+
+// Initialize stock palettes into dynamic palette arrays
+void initStockPalettes() {
+  for (int i = 0; i < NUM_PALETTES; i++) {
+    allPalettes[i] = PALETTE_CATALOG[i];
+    allPaletteNames[i] = PALETTE_NAMES[i];
+    allPaletteSizes[i] = PALETTE_SIZES[i];
+    paletteIsUserLoaded[i] = false;
+  }
+  rebuildPaletteIndex();
+}
+
+// Parse Lospec .hex file from SD card
+// Returns true if valid palette loaded
+bool loadPaletteFromHex(const char* filepath, uint16_t* colors, uint8_t* size) {
+  File file = SD.open(filepath);
+  if (!file) return false;
+
+  uint8_t colorCount = 0;
+
+  while (file.available() && colorCount < 16) {
+    String line = file.readStringUntil('\n');
+    line.trim();
+
+    // Skip empty lines and comments
+    if (line.length() == 0 || line.startsWith("//")) continue;
+
+    // Remove # prefix if present
+    if (line.startsWith("#")) line = line.substring(1);
+
+    // Must be 6-char hex code
+    if (line.length() != 6) continue;
 
-    y += rowH;
-  }
+    // Parse RGB hex
+    long rgb = strtol(line.c_str(), NULL, 16);
+    uint8_t r = (rgb >> 16) & 0xFF;
+    uint8_t g = (rgb >> 8) & 0xFF;
+    uint8_t b = rgb & 0xFF;
 
-  // Draw status message if one exists
-  if (statusMessage[0] != '\0' && (millis() - statusMessageTime < STATUS_DISPLAY_DURATION)) {
-    settingsCanvas.setTextColor(currentTheme->text);
-    settingsCanvas.setTextSize(1);
-    settingsCanvas.setCursor(3, 124);
-    settingsCanvas.print(statusMessage);
+    // Convert to RGB565
+    colors[colorCount++] = RGB565(r, g, b);
   }
 
-  // Push canvas to display
-  settingsCanvas.pushSprite(0, 0);
-}
+  file.close();
 
-/**
- * Handle Settings Menu input and navigation
- */
-void handleSettingsView(Keyboard_Class::KeysState& status) {
-  // Track if we need to redraw
-  static bool settingsViewNeedsRedraw = true;
-  static int lastSettingsViewCursor = -1;
-  static bool settingsPrevUp = false, settingsPrevDown = false;
+  // Validate size (must be exactly 4, 8, or 16)
+  if (colorCount != 4 && colorCount != 8 && colorCount != 16) {
+    return false;
+  }
 
-  // Redraw if cursor changed or first time
-  if (settingsViewNeedsRedraw || lastSettingsViewCursor != settingsViewCursor) {
-    drawSettingsView();
-    settingsViewNeedsRedraw = false;
-    lastSettingsViewCursor = settingsViewCursor;
+  // Wrap remaining slots cyclically (for 4/8 color palettes)
+  // For 8-color palette: indices 9-16 map to colors 1-8
+  // For 4-color palette: indices 5-16 map to colors 1-4 repeated
+  for (uint8_t i = colorCount; i < 16; i++) {
+    colors[i] = colors[i % colorCount];
   }
 
-  // Check for BT enter (edge-triggered)
-#if ENABLE_BLUETOOTH
-  static bool btPrevEnterSettings = false;
-  bool btEnterPressed = btEnter && !btPrevEnterSettings;
-  btPrevEnterSettings = btEnter;
-#else
-  bool btEnterPressed = false;
-#endif
+  *size = colorCount;
+  return true;
+}
 
-  if (M5Cardputer.Keyboard.isPressed() || btEnterPressed) {
-    // Check if left/right arrow pressed (treat as toggle)
-    for (auto i : status.word) {
-      if (i == ',' || i == '/') status.enter = true;
+// Load user palettes from SD card /bitmap16dx/palettes/ folder
+void loadUserPalettes() {
+  // Check if /bitmap16dx/palettes folder exists
+  File root = SD.open("/bitmap16dx/palettes");
+  if (!root || !root.isDirectory()) {
+    // Try to create the folder
+    if (SD.mkdir("/bitmap16dx/palettes")) {
+      // Try opening again
+      root = SD.open("/bitmap16dx/palettes");
+      if (!root || !root.isDirectory()) {
+        return;
+      }
+    } else {
+      return;
     }
+  }
 
-    // Enter key - toggle selected setting
-    if (status.enter || btEnterPressed) {
-      bool needsFullRedraw = false;
+  File file = root.openNextFile();
+  while (file && totalPaletteCount < 32) {
+    String filename = String(file.name());
 
-      switch(settingsViewCursor) {
-        case 0:  // Theme
-          // Toggle theme
-          if (currentTheme == &THEME_LIGHT) {
-            currentTheme = &THEME_DARK;
-            setStatusMessage("Dark Mode");
-          } else {
-            currentTheme = &THEME_LIGHT;
-            setStatusMessage("Light Mode");
-          }
+    // Only process .hex files
+    if (!file.isDirectory() && filename.endsWith(".hex")) {
+      // Allocate memory for this palette
+      uint16_t* colors = (uint16_t*)malloc(16 * sizeof(uint16_t));
+      char* name = (char*)malloc(32);
+      uint8_t size;
 
-          // Save preference
-          preferences.begin("bitmap16dx", false);
-          preferences.putBool("darkMode", (currentTheme == &THEME_DARK));
-          preferences.end();
+      // Try to load palette
+      String filepath = String("/bitmap16dx/palettes/") + filename;
+      if (loadPaletteFromHex(filepath.c_str(), colors, &size)) {
+        // Extract name from filename (remove .hex, convert to uppercase)
+        String paletteName = filename.substring(0, filename.length() - 4);
+        paletteName.toUpperCase();
+        paletteName.replace("-", " ");
+        paletteName.replace("_", " ");
+        strncpy(name, paletteName.c_str(), 31);
+        name[31] = '\0';
 
-          needsFullRedraw = true;
-          break;
+        // Add to catalog
+        allPalettes[totalPaletteCount] = colors;
+        allPaletteNames[totalPaletteCount] = name;
+        allPaletteSizes[totalPaletteCount] = size;
+        paletteIsUserLoaded[totalPaletteCount] = true;
 
-        case 1:  // Default Grid Size
-          // Toggle between 8×8 and 16×16
-          defaultGridSize = (defaultGridSize == 8) ? 16 : 8;
+        totalPaletteCount++;
+      } else {
+        // Invalid palette - free memory and skip silently
+        free(colors);
+        free(name);
+      }
+    }
 
-          // Save preference
-          preferences.begin("bitmap16dx", false);
-          preferences.putUChar("defaultGrid", defaultGridSize);
-          preferences.end();
+    file = root.openNextFile();
+  }
 
-          setStatusMessage(defaultGridSize == 8 ? "Default: 8x8" : "Default: 16x16");
-          break;
+  root.close();
+  rebuildPaletteIndex();
+}
 
-        case 2:  // RGB Matrix Units
-          // Toggle between 1 and 4 units
-          rgbMatrixUnits = (rgbMatrixUnits == 1) ? 4 : 1;
+// Update the filtered palette list based on current filter settings
+void updatePaletteFilter() {
+  filteredPaletteCount = 0;
+  memset(paletteFilterPosition, -1, sizeof(paletteFilterPosition));
 
-          // Save preference
-          preferences.begin("bitmap16dx", false);
-          preferences.putUChar("puzzleUnits", rgbMatrixUnits);
-          preferences.end();
+  for (uint8_t i = 0; i < totalPaletteCount; i++) {
+    bool matches = true;
 
-#if ENABLE_LED_MATRIX
-          // Clear all LEDs first (in case going from 4 to 1 unit)
-          FastLED.clear();
-          FastLED.show();
+    // Apply size filter
+    if (paletteFilterSize != 0 && allPaletteSizes[i] != paletteFilterSize) {
+      matches = false;
+    }
 
-          // Update LED matrix immediately with current canvas
-          if (ledMatrixEnabled) {
-            updateLEDMatrix(false);  // Show canvas without cursor while in settings
-          }
-#endif
+    // Apply user filter
+    if (paletteFilterUser && !paletteIsUserLoaded[i]) {
+      matches = false;
+    }
 
-          setStatusMessage(rgbMatrixUnits == 1 ? "1 Unit" : "4 Units");
-          break;
+    // Add to filtered list if matches
+    if (matches) {
+      paletteFilterPosition[i] = filteredPaletteCount;
+      filteredPaletteIndices[filteredPaletteCount++] = i;
+    }
+  }
+}
 
-        case 3:  // Export Format
-          // Toggle between RGB888 and RGB565
-          exportRGB565 = !exportRGB565;
+// ============================================================================
+// SPRITE SHEET IMPORT (U in memory view)
+// ============================================================================
+// Slices PNG sheets in /bitmap16dx/import/ into sketches, one per non-empty
+// cell. hero.png is cut into 16×16 cells and hero@8.png into 8×8 cells. If
+// hero.hex sits next to the sheet, every cell is mapped to that palette;
+// otherwise each cell gets the smallest catalog palette that holds all of its
+// colors, or a palette built from the cell (most used colors first).
+//
+// The sheet is inflated a row at a time into a band of cellSize rows, and a
+// full band's cells are written out before the next row is decoded, so memory
+// is one band plus the decoder (32KB inflate window and two scanlines) at any
+// sheet height. Identical cells are written once (a hash per written cell is
+// kept). Pixels with alpha < 128 are empty; in sheets without transparency
+// the top-left pixel's color is the background. Each sheet's sketches form a
+// collection named after it, and imported sheets are moved to import/done/.
+
+#define IMPORT_DIR "/bitmap16dx/import"
+#define IMPORT_MAX_WIDTH 2048      // Pixels (band buffer is width × 16 × 2 bytes)
+#define IMPORT_ID_BLOCK 64         // Sketch IDs claimed from NVS at a time
+
+const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+// Row-at-a-time PNG reader (non-interlaced; any color type and bit depth)
+struct PNGStream {
+  File file;
+  uint32_t width;
+  uint32_t height;
+  uint8_t bitDepth;
+  uint8_t colorType;            // 0 gray, 2 RGB, 3 indexed, 4 gray+alpha, 6 RGBA
+  uint8_t channels;
+  uint8_t filterBytes;          // Bytes per pixel for filtering (at least 1)
+  size_t lineBytes;             // Bytes per scanline, without the filter byte
+  uint16_t palette[256];        // PLTE as RGB565
+  uint8_t paletteAlpha[256];    // tRNS for indexed sheets
+  bool hasKey;                  // tRNS color key for gray/RGB sheets
+  uint16_t key[3];
+  bool transparent;             // Alpha channel or tRNS present
+  uint32_t idatLeft;            // Bytes left in the current IDAT chunk
+  bool idatDone;
+  InflateWindow inflate;        // IDAT stream decoder
+  uint8_t input[512];
+  size_t inputPos;
+  size_t inputLen;
+  uint8_t* line;                // Filter byte + scanline being inflated
+  uint8_t* prevLine;            // Previous unfiltered scanline (zeros above row 0)
+  size_t linePos;
+  uint32_t y;                   // Rows decoded so far
+};
 
-          // Save preference
-          preferences.begin("bitmap16dx", false);
-          preferences.putBool("exportRGB565", exportRGB565);
-          preferences.end();
+/**
+ * Read one chunk header
+ * @return false at end of file
+ */
+bool pngReadChunkHeader(File& file, uint32_t& length, char type[4]) {
+  uint8_t header[8];
+  if (file.read(header, 8) != 8) {
+    return false;
+  }
+  length = readBE32(header);
+  memcpy(type, header + 4, 4);
+  return true;
+}
 
-          setStatusMessage(exportRGB565 ? "Export: RGB565" : "Export: RGB888");
-          break;
+void pngStreamClose(PNGStream& png) {
+  png.file.close();
+  scopedFree(png.inflate.inflator, sizeof(tinfl_decompressor));
+  scopedFree(png.inflate.window, TINFL_LZ_DICT_SIZE);
+  scopedFree(png.line, png.lineBytes + 1);
+  scopedFree(png.prevLine, png.lineBytes + 1);
+}
 
-        case 4:  // Shake Undo
-          // Toggle shake-to-undo
-          shakeUndoEnabled = !shakeUndoEnabled;
+/**
+ * Open a PNG and read its header chunks, up to the first IDAT
+ * @return false if the file isn't a PNG this reader supports (or out of memory)
+ */
+bool pngStreamOpen(PNGStream& png, const char* path) {
+  png.file = SD.open(path, FILE_READ);
+  if (!png.file) {
+    return false;
+  }
 
-          // Save preference
-          preferences.begin("bitmap16dx", false);
-          preferences.putBool("shakeUndo", shakeUndoEnabled);
-          preferences.end();
+  uint8_t signature[8];
+  uint32_t length;
+  char type[4];
+  if (png.file.read(signature, 8) != 8 || memcmp(signature, PNG_SIGNATURE, 8) != 0 ||
+      !pngReadChunkHeader(png.file, length, type) || memcmp(type, "IHDR", 4) != 0 || length != 13) {
+    png.file.close();
+    return false;
+  }
+  uint8_t ihdr[13];
+  png.file.read(ihdr, 13);
+  png.file.seek(png.file.position() + 4);  // CRC
+  png.width = readBE32(ihdr);
+  png.height = readBE32(ihdr + 4);
+  png.bitDepth = ihdr[8];
+  png.colorType = ihdr[9];
+  const uint8_t channelCounts[7] = {1, 0, 3, 1, 2, 0, 4};
+  png.channels = png.colorType < 7 ? channelCounts[png.colorType] : 0;
+  bool depthOk = (png.bitDepth == 8) || (png.bitDepth == 16 && png.colorType != 3) ||
+                 (png.bitDepth < 8 && (png.colorType == 0 || png.colorType == 3));
+  if (png.channels == 0 || !depthOk || ihdr[12] != 0 ||  // Interlaced sheets aren't supported
+      png.width == 0 || png.width > IMPORT_MAX_WIDTH || png.height == 0) {
+    png.file.close();
+    return false;
+  }
+  png.filterBytes = max(1, png.channels * png.bitDepth / 8);
+  png.lineBytes = ((size_t)png.width * png.channels * png.bitDepth + 7) / 8;
+  png.transparent = (png.colorType == 4 || png.colorType == 6);
+  png.hasKey = false;
+  memset(png.paletteAlpha, 255, sizeof(png.paletteAlpha));
 
-          setStatusMessage(shakeUndoEnabled ? "Shake: ON" : "Shake: OFF");
-          break;
+  // Palette and transparency come before the image data
+  while (true) {
+    if (!pngReadChunkHeader(png.file, length, type)) {
+      png.file.close();
+      return false;
+    }
+    if (memcmp(type, "IDAT", 4) == 0) {
+      break;
+    }
+    uint32_t next = png.file.position() + length + 4;
+    if (memcmp(type, "PLTE", 4) == 0) {
+      uint8_t rgb[3];
+      for (uint32_t i = 0; i < length / 3 && i < 256; i++) {
+        png.file.read(rgb, 3);
+        png.palette[i] = ((rgb[0] & 0xF8) << 8) | ((rgb[1] & 0xFC) << 3) | (rgb[2] >> 3);
+      }
+    } else if (memcmp(type, "tRNS", 4) == 0) {
+      uint8_t trns[256];
+      size_t n = png.file.read(trns, min(length, (uint32_t)sizeof(trns)));
+      png.transparent = true;
+      if (png.colorType == 3) {
+        memcpy(png.paletteAlpha, trns, n);
+      } else {
+        png.hasKey = true;
+        for (int c = 0; c < 3 && c * 2 + 1 < (int)n; c++) {
+          png.key[c] = (trns[c * 2] << 8) | trns[c * 2 + 1];
+        }
+      }
+    }
+    png.file.seek(next);
+  }
+  png.idatLeft = length;
+  png.idatDone = false;
+  png.inputPos = png.inputLen = 0;
 
-#if ENABLE_BLUETOOTH
-        case 5:  // Bluetooth
-          if (btConnected) {
-            // Disconnect if connected (Fn+Enter forgets pairing too)
-            btDisconnect();
-            btDeinit();  // Free BLE memory
-            if (status.fn) {
-              // Fn held - forget bonded device
-              btHasBondedDevice = false;
-              preferences.begin("bitmap16dx", false);
-              preferences.putBool("btHasBonded", false);
-              preferences.end();
-              setStatusMessage("BT Forgotten");
-            } else {
-              setStatusMessage("BT Disconnected");
-            }
-          } else if (btScanning) {
-            // Already scanning, do nothing
-          } else if (btEnabled && btHasBondedDevice && !status.fn) {
-            // Try to reconnect to bonded device (no scan needed)
-            // Fn bypasses this to force new scan
-            if (btReconnect()) {
-              setStatusMessage("BT Connected!");
-            } else {
-              setStatusMessage("Reconnect failed");
-            }
-          } else if (btEnabled) {
-            // Start scanning for keyboard (no bonded device, or Fn held to force scan)
-            if (status.fn && btHasBondedDevice) {
-              // Forget old pairing first
-              btHasBondedDevice = false;
-              preferences.begin("bitmap16dx", false);
-              preferences.putBool("btHasBonded", false);
-              preferences.end();
-            }
-            btStartScan();
-            if (btAdvDevice) {
-              btConnect();
-              if (btConnected) {
-                // Save bonded device
-                preferences.begin("bitmap16dx", false);
-                preferences.putBytes("btBonded", btBondedAddr, 6);
-                preferences.putBool("btHasBonded", true);
-                preferences.end();
-                setStatusMessage("BT Connected!");
-              } else {
-                btDeinit();  // Free BLE memory on connect failure
-                setStatusMessage("Connect failed");
-              }
-            } else {
-              btDeinit();  // Free BLE memory - no keyboard found
-              char msg[32];
-              snprintf(msg, sizeof(msg), "No kbd (%d devices)", btLastScanCount);
-              setStatusMessage(msg);
-            }
-          } else {
-            // Enable Bluetooth (stack will init on scan/reconnect)
-            btEnabled = true;
-            preferences.begin("bitmap16dx", false);
-            preferences.putBool("btEnabled", btEnabled);
-            preferences.end();
-            setStatusMessage(btHasBondedDevice ? "BT On - Reconnect" : "BT On - Scan");
-          }
-          break;
-#endif
+  png.inflate.inflator = (tinfl_decompressor*)scopedAlloc(sizeof(tinfl_decompressor));
+  png.inflate.window = (uint8_t*)scopedAlloc(TINFL_LZ_DICT_SIZE);
+  png.line = (uint8_t*)scopedAlloc(png.lineBytes + 1);
+  png.prevLine = (uint8_t*)scopedAlloc(png.lineBytes + 1);
+  if (!png.inflate.inflator || !png.inflate.window || !png.line || !png.prevLine) {
+    pngStreamClose(png);
+    return false;
+  }
+  inflateWindowBegin(png.inflate);
+  memset(png.prevLine, 0, png.lineBytes + 1);
+  png.linePos = 0;
+  png.y = 0;
+  return true;
+}
+
+/**
+ * Read more compressed data, following IDAT chunks as they continue
+ * @return false on a read error
+ */
+bool pngStreamFill(PNGStream& png) {
+  while (png.idatLeft == 0 && !png.idatDone) {
+    uint32_t length;
+    char type[4];
+    png.file.seek(png.file.position() + 4);  // CRC of the previous chunk
+    if (!pngReadChunkHeader(png.file, length, type) || memcmp(type, "IDAT", 4) != 0) {
+      png.idatDone = true;
+    } else {
+      png.idatLeft = length;
+    }
+  }
+  if (png.idatDone) {
+    return true;
+  }
+  size_t n = png.file.read(png.input, min((uint32_t)sizeof(png.input), png.idatLeft));
+  if (n == 0) {
+    return false;
+  }
+  png.idatLeft -= n;
+  png.inputPos = 0;
+  png.inputLen = n;
+  return true;
+}
+
+/**
+ * Undo a scanline's PNG filter in place
+ */
+void pngUnfilter(uint8_t filter, uint8_t* line, const uint8_t* prev, size_t n, uint8_t bpp) {
+  for (size_t i = 0; i < n; i++) {
+    int left = i >= bpp ? line[i - bpp] : 0;
+    int up = prev[i];
+    int upLeft = i >= bpp ? prev[i - bpp] : 0;
+    switch (filter) {
+      case 1: line[i] += left; break;
+      case 2: line[i] += up; break;
+      case 3: line[i] += (left + up) >> 1; break;
+      case 4: {
+        int p = left + up - upLeft;
+        int pa = abs(p - left), pb = abs(p - up), pc = abs(p - upLeft);
+        line[i] += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+        break;
       }
+    }
+  }
+}
 
-      // Force redraw (especially important for theme changes)
-      settingsViewNeedsRedraw = true;
+/**
+ * Sample channel c of pixel x from an unfiltered scanline (full bit depth)
+ */
+uint16_t pngSample(const PNGStream& png, const uint8_t* row, uint32_t x, int c) {
+  if (png.bitDepth == 16) {
+    const uint8_t* p = row + (x * png.channels + c) * 2;
+    return (p[0] << 8) | p[1];
+  }
+  if (png.bitDepth == 8) {
+    return row[x * png.channels + c];
+  }
+  uint32_t bit = x * png.bitDepth;
+  return (row[bit >> 3] >> (8 - png.bitDepth - (bit & 7))) & ((1 << png.bitDepth) - 1);
+}
 
-      // Debounce
-      delay(200);
+/**
+ * Inflate and convert the next row to RGB565 plus opacity bits (MSB first)
+ * @return false on corrupt or truncated data
+ */
+bool pngStreamNextRow(PNGStream& png, uint16_t* out, uint8_t* opaque) {
+  const size_t rowBytes = png.lineBytes + 1;
+  while (png.linePos < rowBytes) {
+    if (png.inputPos == png.inputLen && !pngStreamFill(png)) {
+      return false;
     }
-
-    // Check for character keys
-    bool upPressed = false, downPressed = false;
-    for (auto i : status.word) {
-      if (i == '`') {
-        exitSettingsView();
-        settingsViewNeedsRedraw = true;
-        lastSettingsViewCursor = -1;
-        delay(200);
-        return;
+    size_t inBytes = png.inputLen - png.inputPos;
+    size_t outBytes = rowBytes - png.linePos;
+    tinfl_status status = inflateWindowRead(png.inflate, png.input + png.inputPos, inBytes,
+                                            png.line + png.linePos, outBytes, !png.idatDone);
+    png.inputPos += inBytes;
+    png.linePos += outBytes;
+    if (status < 0 || (png.linePos < rowBytes && (status == TINFL_STATUS_DONE ||
+                                                   (png.idatDone && inBytes == 0 && outBytes == 0)))) {
+      return false;
+    }
+  }
+  png.linePos = 0;
+
+  uint8_t* row = png.line + 1;
+  pngUnfilter(png.line[0], row, png.prevLine + 1, png.lineBytes, png.filterBytes);
+  int shift = png.bitDepth == 16 ? 8 : 0;
+  int grayScale = png.bitDepth < 8 ? 255 / ((1 << png.bitDepth) - 1) : 1;
+  memset(opaque, 0, (png.width + 7) / 8);
+  for (uint32_t x = 0; x < png.width; x++) {
+    uint8_t r, g, b;
+    bool visible = true;
+    switch (png.colorType) {
+      case 3: {
+        uint8_t index = pngSample(png, row, x, 0);
+        out[x] = png.palette[index];
+        visible = png.paletteAlpha[index] >= 128;
+        break;
       }
-      else if (i == ';') upPressed = true;
-      else if (i == '.') downPressed = true;
-      else if (i == ' ') {
-        status.enter = true;
+      case 0:
+      case 4: {
+        uint16_t gray = pngSample(png, row, x, 0);
+        visible = png.colorType == 4 ? (pngSample(png, row, x, 1) >> shift) >= 128 : !(png.hasKey && gray == png.key[0]);
+        r = g = b = png.bitDepth < 8 ? gray * grayScale : gray >> shift;
+        out[x] = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        break;
       }
-#if ENABLE_SCREENSHOTS
-      else if (i == 'y' || i == 'Y') {
-        takeScreenshot();
-        settingsViewNeedsRedraw = true;
+      default: {
+        uint16_t rs = pngSample(png, row, x, 0), gs = pngSample(png, row, x, 1), bs = pngSample(png, row, x, 2);
+        visible = png.colorType == 6 ? (pngSample(png, row, x, 3) >> shift) >= 128
+                                     : !(png.hasKey && rs == png.key[0] && gs == png.key[1] && bs == png.key[2]);
+        r = rs >> shift;
+        g = gs >> shift;
+        b = bs >> shift;
+        out[x] = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        break;
       }
-#endif
-    }
-
-    if (upPressed && !settingsPrevUp && settingsViewCursor > 0) {
-      settingsViewCursor--;
-      settingsViewNeedsRedraw = true;
     }
-    if (downPressed && !settingsPrevDown && settingsViewCursor < SETTINGS_ITEM_COUNT - 1) {
-      settingsViewCursor++;
-      settingsViewNeedsRedraw = true;
+    if (visible) {
+      opaque[x >> 3] |= 0x80 >> (x & 7);
     }
-    settingsPrevUp = upPressed;
-    settingsPrevDown = downPressed;
-  } else {
-    settingsPrevUp = false;
-    settingsPrevDown = false;
   }
 
-#if ENABLE_BLUETOOTH
-  // BT keyboard navigation (arrows and escape - enter handled above)
-  static bool btPrevUpSettings = false, btPrevDownSettings = false;
-  static bool btPrevEscSettings = false;
+  // This row is the next one's "up"
+  uint8_t* swap = png.prevLine;
+  png.prevLine = png.line;
+  png.line = swap;
+  png.y++;
+  return true;
+}
 
-  if (btArrowUp && !btPrevUpSettings && settingsViewCursor > 0) {
-    settingsViewCursor--;
-    settingsViewNeedsRedraw = true;
-  }
-  if (btArrowDown && !btPrevDownSettings && settingsViewCursor < SETTINGS_ITEM_COUNT - 1) {
-    settingsViewCursor++;
-    settingsViewNeedsRedraw = true;
+// State of a running sheet import job
+struct SheetImportJob {
+  const char* dir;                  // Folder of sheets (IMPORT_DIR, or the bench's)
+  bool scratch;                     // Bench run: IDs from 1, no collections, sheets left in place
+  uint16_t sheetCount;
+  uint16_t sheetsDone;
+  uint16_t sheetsSkipped;           // Left in dir because they couldn't be read
+  unsigned long lastId;             // Last sketch ID used
+  unsigned long claimedId;          // IDs up to here are reserved in NVS
+
+  // Sheet being imported
+  bool open;
+  char sheetName[64];
+  PNGStream png;
+  uint8_t cellSize;
+  uint32_t cellsAcross;
+  uint16_t* band;                   // cellSize rows of RGB565
+  uint8_t* bandOpaque;              // cellSize rows of opacity bits
+  uint8_t bandRows;                 // Rows decoded into the band
+  int32_t nextCell;                 // Next cell of a full band to write (-1 = decoding)
+  uint16_t background;              // Color treated as empty when the sheet has no transparency
+  uint16_t sheetPalette[16];        // From the .hex next to the sheet
+  uint8_t sheetPaletteSize;         // 0 = none
+  uint16_t lastPalette[16];         // Palette of the last cell (tried first)
+  uint8_t lastPaletteSize;
+  uint64_t* seen;                   // Open-addressed set of written cell hashes (0 = free)
+  uint32_t seenSlots;
+  uint32_t seenCount;
+  std::vector<uint32_t> members;    // Sketches written from this sheet
+  char collection[COLLECTION_NAME_MAX + 1];
+
+  uint32_t written;
+  uint32_t duplicates;
+};
+
+/**
+ * Record a cell hash
+ * @return true if the hash was already recorded
+ */
+bool importCellSeen(SheetImportJob* im, uint64_t hash) {
+  if (hash == 0) {
+    hash = 1;
+  }
+  if ((im->seenCount + 1) * 2 > im->seenSlots) {
+    // Keep the set at most half full
+    uint32_t slots = im->seenSlots ? im->seenSlots * 2 : 256;
+    uint64_t* table = (uint64_t*)scopedAlloc(slots * sizeof(uint64_t));
+    if (!table) {
+      return false;  // Can't grow: write the cell even if it's a duplicate
+    }
+    memset(table, 0, slots * sizeof(uint64_t));
+    for (uint32_t i = 0; i < im->seenSlots; i++) {
+      if (im->seen[i]) {
+        uint32_t slot = im->seen[i] & (slots - 1);
+        while (table[slot]) {
+          slot = (slot + 1) & (slots - 1);
+        }
+        table[slot] = im->seen[i];
+      }
+    }
+    scopedFree(im->seen, im->seenSlots * sizeof(uint64_t));
+    im->seen = table;
+    im->seenSlots = slots;
   }
-  if (btEscape && !btPrevEscSettings) {
-    exitSettingsView();
-    settingsViewNeedsRedraw = true;
-    lastSettingsViewCursor = -1;
+  uint32_t slot = hash & (im->seenSlots - 1);
+  while (im->seen[slot]) {
+    if (im->seen[slot] == hash) {
+      return true;
+    }
+    slot = (slot + 1) & (im->seenSlots - 1);
   }
-
-  btPrevUpSettings = btArrowUp; btPrevDownSettings = btArrowDown;
-  btPrevEscSettings = btEscape;
-#endif
+  im->seen[slot] = hash;
+  im->seenCount++;
+  return false;
 }
 
-// ============================================================================
-// DRAWING HELPERS
-// ============================================================================
-
-// Corner flags for cut corner rectangles
-#define CORNER_NONE         0b0000
-#define CORNER_TOP_LEFT     0b0001
-#define CORNER_TOP_RIGHT    0b0010
-#define CORNER_BOTTOM_LEFT  0b0100
-#define CORNER_BOTTOM_RIGHT 0b1000
-#define CORNER_ALL          0b1111
-
-// Forward declaration
-void drawCutCornerRect(int x, int y, int w, int h, int cutSize, uint16_t color, uint8_t corners, M5Canvas* canvas);
+/**
+ * Squared RGB distance between two RGB565 colors
+ */
+uint32_t colorDistance565(uint16_t a, uint16_t b) {
+  int dr = (int)((a >> 11) & 0x1F) - ((b >> 11) & 0x1F);
+  int dg = (int)((a >> 5) & 0x3F) - ((b >> 5) & 0x3F);
+  int db = (int)(a & 0x1F) - (b & 0x1F);
+  return dr * dr * 4 + dg * dg + db * db * 4;  // Scale 5-bit channels to the 6-bit green's range
+}
 
 /**
- * Helper function to get theme-appropriate cartridge color
- * Maps light theme cartridge colors to dark theme equivalents
+ * Index (0-based) of the closest palette color
  */
-inline uint16_t getCartridgeColor(uint16_t originalColor) {
-  if (currentTheme == &THEME_DARK) {
-    // Map light theme colors to dark theme
-    const uint16_t LIGHT_BG = RGB565(0xD3, 0xD3, 0xDD);    // #d3d3dd
-    const uint16_t LIGHT_SHADOW = RGB565(0xC1, 0xC4, 0xD6); // #c1c4d6
-    const uint16_t DARK_BG = RGB565(0x0e, 0x0e, 0x0e);      // #0e0e0e
-    const uint16_t DARK_SHADOW = TFT_BLACK;                 // #000000
+uint8_t nearestPaletteColor(const uint16_t* palette, uint8_t size, uint16_t color) {
+  uint8_t best = 0;
+  uint32_t bestDistance = UINT32_MAX;
+  for (uint8_t i = 0; i < size && bestDistance > 0; i++) {
+    uint32_t distance = colorDistance565(palette[i], color);
+    if (distance < bestDistance) {
+      bestDistance = distance;
+      best = i;
+    }
+  }
+  return best;
+}
 
-    if (originalColor == LIGHT_BG || originalColor == RGB565(0xD6, 0x9B, 0x00)) { // 0xD69B
-      return DARK_BG;
+/**
+ * True if every color is in the palette
+ */
+bool paletteHoldsColors(const uint16_t* palette, uint8_t size, const uint16_t* colors, int count) {
+  for (int c = 0; c < count; c++) {
+    bool found = false;
+    for (uint8_t i = 0; i < size && !found; i++) {
+      found = pgm_read_word(&palette[i]) == colors[c];
     }
-    if (originalColor == LIGHT_SHADOW || originalColor == RGB565(0xC6, 0x3A, 0x00)) { // 0xC63A
-      return DARK_SHADOW;
+    if (!found) {
+      return false;
     }
   }
-  return originalColor; // Return unchanged in light mode or if no match
+  return true;
 }
 
 /**
- * Draw theme-aware cartridge graphic
- * Transforms colors for dark mode on-the-fly
+ * Pick a palette for a cell's colors: the sheet's .hex palette, the previous
+ * cell's, the smallest catalog palette holding them all, or the cell's own
+ * colors (16 most used if there are more)
  */
-void drawThemedCartridge(int x, int y, M5Canvas* canvas = nullptr) {
-  // For light mode, use original graphic directly
-  if (currentTheme == &THEME_LIGHT) {
-    if (canvas != nullptr) {
-      bool oldSwap = canvas->getSwapBytes();
-      canvas->setSwapBytes(true);
-      canvas->pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, CARTRIDGE_GRAPHIC);
-      canvas->setSwapBytes(oldSwap);
-    } else {
-      bool oldSwap = M5Cardputer.Display.getSwapBytes();
-      M5Cardputer.Display.setSwapBytes(true);
-      M5Cardputer.Display.pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, CARTRIDGE_GRAPHIC);
-      M5Cardputer.Display.setSwapBytes(oldSwap);
-    }
+void chooseCellPalette(SheetImportJob* im, uint16_t* colors, uint16_t* counts, int count, Sketch& sketch) {
+  if (im->sheetPaletteSize > 0) {
+    memcpy(sketch.paletteColors, im->sheetPalette, sizeof(sketch.paletteColors));
+    sketch.paletteSize = im->sheetPaletteSize;
     return;
   }
 
-  // For dark mode, transform colors
-  // Create a temporary buffer for the transformed graphic
-  static uint16_t cartridgeBuffer[CARTRIDGE_WIDTH * CARTRIDGE_HEIGHT];
-
-  // Copy and transform colors
-  for (int i = 0; i < CARTRIDGE_WIDTH * CARTRIDGE_HEIGHT; i++) {
-    cartridgeBuffer[i] = getCartridgeColor(pgm_read_word(&CARTRIDGE_GRAPHIC[i]));
+  if (count <= 16) {
+    if (im->lastPaletteSize > 0 && paletteHoldsColors(im->lastPalette, im->lastPaletteSize, colors, count)) {
+      memcpy(sketch.paletteColors, im->lastPalette, sizeof(sketch.paletteColors));
+      sketch.paletteSize = im->lastPaletteSize;
+      return;
+    }
+    int best = -1;
+    for (uint8_t p = 0; p < totalPaletteCount; p++) {
+      if (allPaletteSizes[p] >= count && (best < 0 || allPaletteSizes[p] < allPaletteSizes[best]) &&
+          paletteHoldsColors(allPalettes[p], allPaletteSizes[p], colors, count)) {
+        best = p;
+      }
+    }
+    if (best >= 0) {
+      for (int i = 0; i < 16; i++) {
+        sketch.paletteColors[i] = pgm_read_word(&allPalettes[best][i]);
+      }
+      sketch.paletteSize = allPaletteSizes[best];
+      return;
+    }
   }
 
-  // Draw the transformed graphic
-  if (canvas != nullptr) {
-    bool oldSwap = canvas->getSwapBytes();
-    canvas->setSwapBytes(true);
-    canvas->pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, cartridgeBuffer);
-    canvas->setSwapBytes(oldSwap);
-  } else {
-    bool oldSwap = M5Cardputer.Display.getSwapBytes();
-    M5Cardputer.Display.setSwapBytes(true);
-    M5Cardputer.Display.pushImage(x, y, CARTRIDGE_WIDTH, CARTRIDGE_HEIGHT, cartridgeBuffer);
-    M5Cardputer.Display.setSwapBytes(oldSwap);
+  // Build one: most used colors first
+  for (int i = 1; i < count; i++) {
+    for (int j = i; j > 0 && counts[j] > counts[j - 1]; j--) {
+      std::swap(counts[j], counts[j - 1]);
+      std::swap(colors[j], colors[j - 1]);
+    }
   }
+  int used = min(count, 16);
+  sketch.paletteSize = used <= 4 ? 4 : (used <= 8 ? 8 : 16);
+  memset(sketch.paletteColors, 0, sizeof(sketch.paletteColors));
+  memcpy(sketch.paletteColors, colors, used * sizeof(uint16_t));
 }
 
 /**
- * Draw a single palette preview at given position
- * Shows cartridge graphic with color swatches displayed on it
- * @param canvas Optional canvas to draw to (defaults to main display)
+ * Write one cell of the full band as a sketch (skipping empty and repeated cells)
+ * @return false if the sketch couldn't be written
  */
-void drawPalettePreview(int x, int y, const uint16_t* palette, bool isCursor, bool isActive, int paletteIndex, M5Canvas* canvas = nullptr) {
-  int numColors = allPaletteSizes[paletteIndex];
-
-  // Draw cartridge background graphic (80×92)
-  // Center it at the given x, y position
-  int cartX = x - (CARTRIDGE_WIDTH / 2);
-  int cartY = y - (CARTRIDGE_HEIGHT / 2);
-
-  // Apply insertion animation if active and this is the cursor
-  if (paletteInsertionAnimating && isCursor) {
-    // Apply quartic ease-in: slow start, accelerates dramatically (gravity/force feel)
-    float t = paletteInsertionProgress;
-    float eased = t * t * t * t;  // Quartic ease-in
-
-    // Animate cartridge moving DOWN with easing
-    cartY = cartY + (int)(PALETTE_INSERT_DISTANCE * eased);
+bool importSheetCell(SheetImportJob* im, uint32_t cellX) {
+  const int n = im->cellSize;
+  const uint32_t width = im->png.width;
+  uint16_t colors[256];
+  uint16_t counts[256];
+  int count = 0;
+
+  // Hash the cell (transparent pixels as their own value) and count its colors
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (int y = 0; y < n; y++) {
+    const uint8_t* opaque = im->bandOpaque + y * ((width + 7) / 8);
+    for (int x = 0; x < n; x++) {
+      uint32_t px = cellX * n + x;
+      uint16_t color = im->band[y * width + px];
+      bool visible = (opaque[px >> 3] & (0x80 >> (px & 7))) && (im->png.transparent || color != im->background);
+      uint32_t value = visible ? color : 0x10000;
+      hash = (hash ^ (value & 0xFF)) * 0x100000001B3ULL;
+      hash = (hash ^ (value >> 8)) * 0x100000001B3ULL;
+      if (visible) {
+        int c = 0;
+        while (c < count && colors[c] != color) {
+          c++;
+        }
+        if (c == count) {
+          colors[count] = color;
+          counts[count++] = 0;
+        }
+        counts[c]++;
+      }
+    }
+  }
+  if (count == 0) {
+    return true;  // Empty cell
+  }
+  if (importCellSeen(im, hash)) {
+    im->duplicates++;
+    return true;
   }
 
-  // Draw theme-aware cartridge graphic
-  drawThemedCartridge(cartX, cartY, canvas);
-
-  // Draw color swatches: 64×64 area positioned 8px from left, 6px from top of cartridge
-  const int swatchAreaWidth = 64;
-  const int swatchAreaHeight = 64;
-  int swatchX = cartX + 8;   // 8 pixels from left edge of cartridge
-  int swatchY = cartY + 6;   // 6 pixels from top edge of cartridge
+  Sketch sketch;
+  memset(sketch.pixels, 0, sizeof(sketch.pixels));
+  sketch.gridSize = n;
+  sketch.isEmpty = false;
+  chooseCellPalette(im, colors, counts, count, sketch);
+  for (int y = 0; y < n; y++) {
+    const uint8_t* opaque = im->bandOpaque + y * ((width + 7) / 8);
+    for (int x = 0; x < n; x++) {
+      uint32_t px = cellX * n + x;
+      uint16_t color = im->band[y * width + px];
+      bool visible = (opaque[px >> 3] & (0x80 >> (px & 7))) && (im->png.transparent || color != im->background);
+      if (visible) {
+        sketch.pixels[y][x] = nearestPaletteColor(sketch.paletteColors, sketch.paletteSize, color) + 1;
+      }
+    }
+  }
+  memcpy(im->lastPalette, sketch.paletteColors, sizeof(im->lastPalette));
+  im->lastPaletteSize = sketch.paletteSize;
 
-  const int cutSize = 2;  // Size of corner cuts
+  // Claim IDs in blocks so a save during the import can't reuse one
+  unsigned long id = ++im->lastId;
+  if (!im->scratch && id > im->claimedId) {
+    im->claimedId = id + IMPORT_ID_BLOCK - 1;
+    storeSketchCounter(im->claimedId);
+  }
+  String filename = "sketch_" + String(id) + ".dat";
+  if (!ensureSketchShard(id) || !writeSketchFile(sketchPath(filename).c_str(), sketch)) {
+    return false;
+  }
+  im->members.push_back(id);
+  im->written++;
+  return true;
+}
 
-  if (numColors == 4) {
-    // 4-color: 1 column × 4 rows, 64×16 each (single wide column)
-    const int colorWidth = 64;
-    const int colorHeight = 16;
+/**
+ * Release the sheet being imported
+ */
+void closeImportSheet(SheetImportJob* im) {
+  if (!im->open) {
+    return;
+  }
+  size_t maskBytes = (im->png.width + 7) / 8;
+  scopedFree(im->band, (size_t)im->png.width * im->cellSize * sizeof(uint16_t));
+  scopedFree(im->bandOpaque, maskBytes * im->cellSize);
+  scopedFree(im->seen, im->seenSlots * sizeof(uint64_t));
+  im->seenSlots = im->seenCount = 0;
+  pngStreamClose(im->png);
+  std::vector<uint32_t>().swap(im->members);
+  im->open = false;
+}
 
-    for (int i = 0; i < 4; i++) {
-      int px = swatchX;
-      int py = swatchY + (i * colorHeight);
+/**
+ * Name of the n-th sheet left in the folder
+ * @return false if there are fewer sheets
+ */
+bool findImportSheet(const char* dir, int n, char* name, size_t nameSize) {
+  File root = SD.open(dir);
+  if (!root || !root.isDirectory()) {
+    return false;
+  }
+  bool found = false;
+  File file = root.openNextFile();
+  while (file && !found) {
+    String fileName = fileBaseName(file);
+    String lower = fileName;
+    lower.toLowerCase();
+    if (!file.isDirectory() && lower.endsWith(".png") && n-- == 0) {
+      strncpy(name, fileName.c_str(), nameSize - 1);
+      name[nameSize - 1] = '\0';
+      found = true;
+    }
+    file.close();
+    file = root.openNextFile();
+  }
+  file.close();
+  root.close();
+  return found;
+}
 
-      // Determine which corners to cut based on position
-      uint8_t corners = CORNER_NONE;
-      if (i == 0) corners = CORNER_TOP_LEFT | CORNER_TOP_RIGHT;        // Top row: cut both top corners
-      else if (i == 3) corners = CORNER_BOTTOM_LEFT | CORNER_BOTTOM_RIGHT;  // Bottom row: cut both bottom corners
+/**
+ * Open the next sheet: cell size and collection from its name, .hex palette if present
+ * @return false if there's no sheet left
+ */
+bool openImportSheet(SheetImportJob* im) {
+  while (findImportSheet(im->dir, im->sheetsSkipped, im->sheetName, sizeof(im->sheetName))) {
+    String base = String(im->sheetName).substring(0, strlen(im->sheetName) - 4);
+    im->cellSize = 16;
+    if (base.endsWith("@8") || base.endsWith("@16")) {
+      im->cellSize = base.endsWith("@8") ? 8 : 16;
+      base = base.substring(0, base.lastIndexOf('@'));
+    }
+
+    String path = String(im->dir) + "/" + im->sheetName;
+    if (pngStreamOpen(im->png, path.c_str())) {
+      size_t maskBytes = (im->png.width + 7) / 8;
+      im->band = (uint16_t*)scopedAlloc((size_t)im->png.width * im->cellSize * sizeof(uint16_t));
+      im->bandOpaque = (uint8_t*)scopedAlloc(maskBytes * im->cellSize);
+      im->open = true;
+      if (im->band && im->bandOpaque) {
+        im->cellsAcross = im->png.width / im->cellSize;
+        im->bandRows = 0;
+        im->nextCell = -1;
+        im->lastPaletteSize = 0;
+        im->sheetPaletteSize = 0;
+        String hexPath = String(im->dir) + "/" + base + ".hex";
+        if (SD.exists(hexPath.c_str()) &&
+            !loadPaletteFromHex(hexPath.c_str(), im->sheetPalette, &im->sheetPaletteSize)) {
+          im->sheetPaletteSize = 0;
+        }
 
-      drawCutCornerRect(px, py, colorWidth, colorHeight, cutSize, pgm_read_word(&palette[i]), corners, canvas);
+        // Collection names are plain file names
+        int length = 0;
+        for (unsigned int i = 0; i < base.length() && length < COLLECTION_NAME_MAX && !im->scratch; i++) {
+          char c = base[i];
+          if (isalnum((unsigned char)c) || c == '-' || c == '_') {
+            im->collection[length++] = c;
+          }
+        }
+        im->collection[length] = '\0';
+        return true;
+      }
+      closeImportSheet(im);
+      setStatusMessage(StatusMsg::OUT_OF_MEMORY);
     }
-  } else if (numColors == 8) {
-    // 8-color: 2 colors wide × 4 colors tall = 8 colors, 32×16 each (colors go DOWN)
-    const int colorWidth = 32;
-    const int colorHeight = 16;
-
-    for (int i = 0; i < 8; i++) {
-      int col = i / 4;  // Column changes every 4 colors (0-3 in col 0, 4-7 in col 1)
-      int row = i % 4;  // Row cycles 0-3
-      int px = swatchX + (col * colorWidth);
-      int py = swatchY + (row * colorHeight);
+    im->sheetsSkipped++;  // Unreadable or unsupported: leave it where it is
+    im->sheetsDone++;
+  }
+  return false;
+}
 
-      // Determine which corners to cut based on position
-      uint8_t corners = CORNER_NONE;
-      if (col == 0 && row == 0) corners = CORNER_TOP_LEFT;           // Top-left swatch
-      else if (col == 1 && row == 0) corners = CORNER_TOP_RIGHT;     // Top-right swatch
-      else if (col == 0 && row == 3) corners = CORNER_BOTTOM_LEFT;   // Bottom-left swatch
-      else if (col == 1 && row == 3) corners = CORNER_BOTTOM_RIGHT;  // Bottom-right swatch
+/**
+ * Add the sketches written from the open sheet to its collection
+ */
+void collectImportedSketches(SheetImportJob* im) {
+  if (!im->open || im->collection[0] == '\0' || im->members.empty()) {
+    return;
+  }
+  std::vector<uint32_t> ids;
+  readCollectionIndex(im->collection, ids);
+  ids.insert(ids.end(), im->members.begin(), im->members.end());
+  std::sort(ids.begin(), ids.end(), std::greater<uint32_t>());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  writeCollectionIndex(im->collection, ids);
+}
 
-      drawCutCornerRect(px, py, colorWidth, colorHeight, cutSize, pgm_read_word(&palette[i]), corners, canvas);
+/**
+ * Collect the sheet's sketches and move it out of the way
+ */
+void finishImportSheet(SheetImportJob* im) {
+  collectImportedSketches(im);
+  closeImportSheet(im);
+
+  String from = String(im->dir) + "/" + im->sheetName;
+  if (!im->scratch) {
+    String doneDir = String(im->dir) + "/done";
+    String to = doneDir + "/" + im->sheetName;
+    if (!SD.exists(doneDir.c_str())) {
+      SD.mkdir(doneDir.c_str());
+    }
+    SD.remove(to.c_str());
+    if (!SD.rename(from.c_str(), to.c_str())) {
+      im->sheetsSkipped++;  // Still there: don't import it again in this run
     }
   } else {
-    // 16-color: 4×4 grid, 16×16 each (colors go DOWN columns - VERTICAL LAYOUT)
-    const int colorSize = 16;
+    im->sheetsSkipped++;
+  }
+  im->sheetsDone++;
+}
 
-    for (int i = 0; i < 16; i++) {
-      int col = i / 4;  // Column changes every 4 colors
-      int row = i % 4;  // Row cycles 0-3
-      int px = swatchX + (col * colorSize);
-      int py = swatchY + (row * colorSize);
+/**
+ * Import job step: decode one row, or write one cell of a full band
+ */
+JobState sheetImportStep(Job& job) {
+  SheetImportJob* im = (SheetImportJob*)job.context;
 
-      // Determine which corners to cut based on position in 4×4 grid
-      uint8_t corners = CORNER_NONE;
-      if (col == 0 && row == 0) corners = CORNER_TOP_LEFT;           // Top-left corner
-      else if (col == 3 && row == 0) corners = CORNER_TOP_RIGHT;     // Top-right corner
-      else if (col == 0 && row == 3) corners = CORNER_BOTTOM_LEFT;   // Bottom-left corner
-      else if (col == 3 && row == 3) corners = CORNER_BOTTOM_RIGHT;  // Bottom-right corner
+  if (!im->open) {
+    return openImportSheet(im) ? JOB_RUNNING : JOB_DONE;
+  }
 
-      drawCutCornerRect(px, py, colorSize, colorSize, cutSize, pgm_read_word(&palette[i]), corners, canvas);
+  if (im->nextCell >= 0) {
+    if (!importSheetCell(im, im->nextCell)) {
+      setStatusMessage(StatusMsg::FAILED_TO_SAVE);
+      return JOB_FAILED;
+    }
+    if (++im->nextCell >= (int32_t)im->cellsAcross) {
+      im->nextCell = -1;
+      im->bandRows = 0;
     }
+    return JOB_RUNNING;
   }
 
-  // No border around cartridge
-  // Active palette is indicated by ">" before the name
+  // Rows below the last whole band are never needed
+  if (im->png.y >= im->png.height - im->png.height % im->cellSize) {
+    finishImportSheet(im);
+    return JOB_RUNNING;
+  }
+
+  size_t maskBytes = (im->png.width + 7) / 8;
+  if (!pngStreamNextRow(im->png, im->band + im->bandRows * im->png.width, im->bandOpaque + im->bandRows * maskBytes)) {
+    // Corrupt or truncated: keep what was imported and move on
+    setStatusMessage(StatusMsg::FILE_CORRUPT);
+    finishImportSheet(im);
+    return JOB_RUNNING;
+  }
+  if (im->png.y == 1 && !im->png.transparent) {
+    im->background = im->band[0];
+  }
+  if (++im->bandRows == im->cellSize) {
+    im->nextCell = 0;
+  }
+  job.progress = (im->sheetsDone * 100 + im->png.y * 100 / im->png.height) / max(1, (int)im->sheetCount);
+  return JOB_RUNNING;
+}
+
+void sheetImportFinish(Job& job, JobState state) {
+  SheetImportJob* im = (SheetImportJob*)job.context;
+  collectImportedSketches(im);  // Sketches from a cancelled sheet stay findable
+  closeImportSheet(im);
+
+  // Hand back claimed IDs nobody used, unless a save took a newer one meanwhile
+  if (!im->scratch && im->claimedId > im->lastId && loadSketchCounter() == im->claimedId) {
+    storeSketchCounter(im->lastId);
+  }
+  if (state == JOB_DONE) {
+    char msg[32];
+    snprintf(msg, sizeof(msg), StatusMsg::IMPORTED_FMT, (unsigned long)im->written, (unsigned long)im->duplicates);
+    setStatusMessage(msg);
+  }
+  if (inMemoryView && im->written > 0) {
+    startSketchScan(memoryScan, activeCollection);  // Show the new sketches
+  }
+  delete im;
 }
 
 /**
- * Draw Palette Menu - horizontally scrolling carousel of palettes
- * Center palette is selected, left/right arrows navigate
- *
- * @param fullRedraw If true, clears entire screen. If false, only redraws content area for animation
+ * Import every sheet in /bitmap16dx/import as a background job (ESC cancels)
+ * @return true if the job started
  */
-void drawPaletteView(bool fullRedraw = true) {
-  // Check if canvas is available
-  if (!paletteCanvasAvailable) {
-    // Canvas wasn't allocated - show error message
-    M5Cardputer.Display.fillScreen(currentTheme->background);
-    M5Cardputer.Display.setTextColor(TFT_RED);
-    M5Cardputer.Display.setCursor(10, 50);
-    M5Cardputer.Display.println("WARNING: Low memory!");
-    M5Cardputer.Display.setCursor(10, 65);
-    M5Cardputer.Display.println("Cannot show palette menu.");
-    M5Cardputer.Display.setCursor(10, 85);
-    M5Cardputer.Display.setTextColor(currentTheme->text);
-    M5Cardputer.Display.println("Press ESC (`) to exit");
-    M5Cardputer.Display.setCursor(10, 100);
-    M5Cardputer.Display.println("Restart device to recover");
-    return;  // Skip drawing, but allow keyboard handling
+bool startSheetImport() {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
+  }
+  int sheetCount = 0;
+  char name[64];
+  while (findImportSheet(IMPORT_DIR, sheetCount, name, sizeof(name))) {
+    sheetCount++;
+  }
+  if (sheetCount == 0) {
+    setStatusMessage(StatusMsg::NO_SHEETS);
+    return false;
   }
 
-  // Clear the canvas buffer (full screen)
-  paletteCanvas.fillSprite(currentTheme->background);
-
-  // Draw title to canvas
-  paletteCanvas.setTextColor(currentTheme->text);
-  paletteCanvas.setTextSize(1);
-  paletteCanvas.setCursor(4, 4);
-  paletteCanvas.print("PALETTES");
+  SheetImportJob* im = new SheetImportJob();
+  im->dir = IMPORT_DIR;
+  im->sheetCount = sheetCount;
+  im->lastId = im->claimedId = loadSketchCounter();
 
-  // Draw filter status in top-right corner (only if filters are active)
-  if (paletteFilterSize > 0 || paletteFilterUser) {
-    String filterText = "";
-    if (paletteFilterSize > 0 && paletteFilterUser) {
-      filterText = "USER+" + String(paletteFilterSize);
-    } else if (paletteFilterSize > 0) {
-      filterText = String(paletteFilterSize) + "-COLOR";
-    } else if (paletteFilterUser) {
-      filterText = "USER";
-    }
-    // Right-align text: calculate position based on text width
-    int16_t textWidth = paletteCanvas.textWidth(filterText);
-    paletteCanvas.setCursor(240 - textWidth - 4, 4);  // 4px padding from right edge
-    paletteCanvas.print(filterText);
+  if (!startJob("Import", sheetImportStep, sheetImportFinish, im)) {
+    delete im;
+    return false;
   }
+  return true;
+}
 
-  const int paletteGap = 20;  // Gap between cartridges
-  const int centerX = 120;  // Center of 240px screen (horizontal)
-  // Cartridge top at Y=20 from screen top, cartridge is 92px tall
-  // So center is at Y=20+46=66 (simple screen coordinates now!)
-  const int centerY = 66;  // Browsing position: top of cartridge at Y=20 on screen
+// ============================================================================
+// SHARED PALETTE (P / Fn+P in memory view)
+// ============================================================================
+// Works out one 4, 8 or 16 color palette for every sketch listed in the
+// memory view (the collection being browsed, or the whole library) and saves
+// it as a user palette, /bitmap16dx/palettes/shared-<collection>-<size>.hex.
+// Fn+P then also moves each of those sketches onto it.
+//
+// The job reads each sketch once and counts the cells drawn in each color.
+// Only the counts are kept (a table of at most SHARED_MAX_COLORS colors), so
+// memory stays the same however many sketches there are. Colors are then
+// grouped in Oklab, where distance follows how different colors look:
+// median cut gives a starting set, weighted k-means refines it, and each
+// group is represented by its member color nearest the center, so the
+// palette keeps colors that were actually drawn with.
+
+#define SHARED_MAX_COLORS 2048          // Distinct colors counted (hash slots); more fold into the nearest
+#define SHARED_MAX_ITERATIONS 16        // k-means passes (it usually settles sooner)
+#define SHARED_SKETCHES_PER_STEP 4      // Sketches read (or rewritten) per job step
+#define SHARED_PALETTE_DIR "/bitmap16dx/palettes"
+
+enum SharedPalettePrompt {
+  SHARED_PROMPT_NONE,
+  SHARED_PROMPT_SAVE,         // P: save the palette
+  SHARED_PROMPT_REMAP         // Fn+P: save it and remap the sketches
+};
 
-  // Determine which palette is currently active on the sketch
-  int activePaletteIndex = -1;
-  // Compare active sketch's palette with each catalog palette
-  for (int p = 0; p < totalPaletteCount; p++) {
-    bool matches = true;
-    for (int c = 0; c < 16; c++) {
-      if (activeSketch.paletteColors[c] != pgm_read_word(&allPalettes[p][c])) {
-        matches = false;
-        break;
-      }
-    }
-    if (matches) {
-      activePaletteIndex = p;
-      break;
-    }
-  }
+enum SharedPalettePhase {
+  SHARED_GATHER,
+  SHARED_SPLIT,
+  SHARED_REFINE,
+  SHARED_REMAP
+};
 
-  // Smooth scroll animation - now tear-free thanks to M5Canvas!
-  // Skip scroll interpolation during insertion animation (keeps everything frozen)
-  if (!paletteInsertionAnimating) {
-    // Interpolate scroll position towards cursor position
-    float targetPos = (float)paletteViewCursor;
-    float diff = targetPos - paletteViewScrollPos;
+struct OklabColor {
+  float L;
+  float a;
+  float b;
+};
 
-    if (fabs(diff) > 0.01f) {
-      // Smoothly animate towards target
-      paletteViewScrollPos += diff * PALETTE_SCROLL_SPEED;
-    } else {
-      // Close enough - snap to target
-      paletteViewScrollPos = targetPos;
-    }
-  }
+struct SharedColor {
+  uint16_t color;             // RGB565
+  uint8_t group;              // Palette entry it's closest to
+  uint32_t weight;            // Cells drawn in it (0 = free slot)
+  OklabColor lab;
+};
 
-  // Draw filtered palettes to canvas - selected one in center, others offset to sides
-  for (int i = 0; i < filteredPaletteCount; i++) {
-    // Get actual palette index from filtered list
-    uint8_t paletteIdx = filteredPaletteIndices[i];
+struct SharedPaletteJob {
+  SharedPalettePhase phase;
+  uint8_t size;               // 4, 8 or 16
+  bool remap;                 // Fn+P: rewrite the sketches too
+  std::vector<uint32_t> ids;  // Sketch IDs to visit
+  size_t next;
+  SharedColor* colors;        // Hash table while gathering, then packed at the front
+  uint16_t colorCount;
+  uint32_t foldedColors;      // Colors merged into a neighbor because the table was full
+  OklabColor centers[16];
+  uint8_t groups;             // Entries in use (fewer than size if there are fewer colors)
+  uint8_t iteration;
+  uint16_t palette[16];
+  char name[32];              // Palette file name, no extension
+  uint32_t remapped;
+  uint32_t activeRemappedId;  // Sketch open when its file was remapped (0 = none)
+};
 
-    // During insertion animation, freeze ALL cartridges horizontally using frozen scroll position
-    // This keeps everything stable - only vertical (Y) movement happens during insertion
-    float scrollPosToUse = paletteInsertionAnimating ? paletteInsertionFrozenScrollPos : paletteViewScrollPos;
+/**
+ * sRGB channel (0-1) to linear light
+ */
+float srgbToLinear(float c) {
+  return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
 
-    float offset = (i - scrollPosToUse) * (CARTRIDGE_WIDTH + paletteGap);
-    int paletteX = centerX + (int)offset;  // X is center point for cartridge
-    int paletteY = centerY;
+/**
+ * RGB565 to Oklab (Björn Ottosson's matrices)
+ */
+OklabColor rgb565ToOklab(uint16_t color) {
+  float r = srgbToLinear(((color >> 11) & 0x1F) / 31.0f);
+  float g = srgbToLinear(((color >> 5) & 0x3F) / 63.0f);
+  float b = srgbToLinear((color & 0x1F) / 31.0f);
+  float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+  float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+  float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+  return {0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+          1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+          0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s};
+}
 
-    // Only draw if on screen (with some margin)
-    if (paletteX > -(CARTRIDGE_WIDTH / 2) && paletteX < 240 + (CARTRIDGE_WIDTH / 2)) {
-      bool isCursor = (i == paletteViewCursor);
-      bool isActive = (paletteIdx == activePaletteIndex);
+float oklabDistance(const OklabColor& x, const OklabColor& y) {
+  float dL = x.L - y.L;
+  float da = x.a - y.a;
+  float db = x.b - y.b;
+  return dL * dL + da * da + db * db;
+}
 
-      // Draw palette name FIRST (but not during insertion animation to prevent text peeking out)
-      if (isCursor && !paletteInsertionAnimating) {
-        paletteCanvas.setTextSize(1);
-        paletteCanvas.setTextColor(currentTheme->text);
+/**
+ * Index (0-based) of the palette color that looks closest
+ */
+uint8_t nearestOklabColor(const OklabColor* palette, uint8_t size, const OklabColor& color) {
+  uint8_t best = 0;
+  float bestDistance = oklabDistance(palette[0], color);
+  for (uint8_t i = 1; i < size; i++) {
+    float distance = oklabDistance(palette[i], color);
+    if (distance < bestDistance) {
+      bestDistance = distance;
+      best = i;
+    }
+  }
+  return best;
+}
 
-        // Add checkmark if this is the active palette, star if user-loaded
-        String displayText = String(allPaletteNames[paletteIdx]);
-        if (paletteIsUserLoaded[paletteIdx]) {
-          displayText = "* " + displayText;  // Star for user palettes
-        }
-        if (isActive) {
-          displayText = "> " + displayText;  // Use ">" as checkmark/indicator
+/**
+ * Add cells drawn in a color to the count table. When the table is full the
+ * cells go to the color in it that looks closest.
+ */
+void countSharedColor(SharedPaletteJob* sp, uint16_t color, uint32_t cells) {
+  uint32_t slot = (color * 2654435761u) >> 21;  // Top 11 bits (SHARED_MAX_COLORS slots)
+  while (sp->colors[slot].weight > 0 && sp->colors[slot].color != color) {
+    slot = (slot + 1) % SHARED_MAX_COLORS;
+  }
+  if (sp->colors[slot].weight == 0) {
+    OklabColor lab = rgb565ToOklab(color);
+    if (sp->colorCount >= SHARED_MAX_COLORS * 3 / 4) {
+      // Keep probing short: fold into the nearest counted color instead
+      uint32_t best = 0;
+      float bestDistance = INFINITY;
+      for (uint32_t i = 0; i < SHARED_MAX_COLORS; i++) {
+        if (sp->colors[i].weight > 0) {
+          float distance = oklabDistance(sp->colors[i].lab, lab);
+          if (distance < bestDistance) {
+            bestDistance = distance;
+            best = i;
+          }
         }
-
-        int textWidth = displayText.length() * 6;  // Approximate width
-        paletteCanvas.setCursor(centerX - (textWidth / 2), centerY + (CARTRIDGE_HEIGHT / 2) + 6);
-        paletteCanvas.print(displayText);
       }
+      sp->colors[best].weight += cells;
+      sp->foldedColors++;
+      return;
+    }
+    sp->colors[slot].color = color;
+    sp->colors[slot].lab = lab;
+    sp->colorCount++;
+  }
+  sp->colors[slot].weight += cells;
+}
 
-      // Draw cartridge AFTER label (so it covers the label during animation)
-      drawPalettePreview(paletteX, paletteY, allPalettes[paletteIdx], isCursor, isActive, paletteIdx, &paletteCanvas);
+/**
+ * Count the cells drawn in each color of a sketch (inside its grid, as shown)
+ */
+void countSketchColors(SharedPaletteJob* sp, const Sketch& sketch) {
+  uint32_t cells[17] = {0};
+  for (int y = 0; y < sketch.gridSize; y++) {
+    for (int x = 0; x < sketch.gridSize; x++) {
+      uint8_t value = sketch.pixels[y][x];
+      if (value > 0 && value <= 16) {
+        cells[collapseIndex(value, sketch.paletteSize)]++;
+      }
+    }
+  }
+  for (int i = 1; i <= 16; i++) {
+    if (cells[i] > 0) {
+      countSharedColor(sp, sketch.paletteColors[i - 1], cells[i]);
     }
   }
+}
 
-  // Draw status message at bottom if one exists
-  if (statusMessage[0] != '\0' && (millis() - statusMessageTime < STATUS_DISPLAY_DURATION)) {
-    paletteCanvas.setTextColor(currentTheme->text);
-    paletteCanvas.setTextSize(1);
-    paletteCanvas.setCursor(3, 124);
-    paletteCanvas.print(statusMessage);
+/**
+ * Move the counted colors to the front of the table
+ */
+void packSharedColors(SharedPaletteJob* sp) {
+  uint16_t packed = 0;
+  for (uint32_t i = 0; i < SHARED_MAX_COLORS; i++) {
+    if (sp->colors[i].weight > 0) {
+      sp->colors[packed] = sp->colors[i];
+      sp->colors[packed].group = 0;
+      packed++;
+    }
   }
+  sp->groups = min((uint16_t)sp->size, sp->colorCount);
+}
 
-  // NOW push the entire frame to display at once - NO TEARING!
-  paletteCanvas.pushSprite(0, 0);  // Push full-screen canvas
+/**
+ * Path of a listed sketch by ID
+ */
+String sharedSketchPath(uint32_t id) {
+  return sketchPath("sketch_" + String(id) + ".dat");
+}
 
-  // No instructions at bottom - keeping the interface minimal
+/**
+ * Read a whole sketch by ID
+ */
+bool readSharedSketch(uint32_t id, Sketch& sketch) {
+  File file = SD.open(sharedSketchPath(id).c_str(), FILE_READ);
+  if (!file) {
+    return false;
+  }
+  SketchFileIndex index;
+  bool ok = readSketchFileIndex(file, index) && readSketchFull(file, index, sketch);
+  file.close();
+  return ok;
 }
 
-// ============================================================================
-// DRAWING FUNCTIONS
-// ============================================================================
+/**
+ * Weighted mean of colors [start, end) in Oklab
+ */
+OklabColor sharedColorCenter(const SharedColor* colors, uint16_t start, uint16_t end) {
+  double L = 0, a = 0, b = 0, weight = 0;
+  for (uint16_t i = start; i < end; i++) {
+    L += (double)colors[i].lab.L * colors[i].weight;
+    a += (double)colors[i].lab.a * colors[i].weight;
+    b += (double)colors[i].lab.b * colors[i].weight;
+    weight += colors[i].weight;
+  }
+  return {(float)(L / weight), (float)(a / weight), (float)(b / weight)};
+}
 
 /**
- * Draw a 2px offset shadow behind any rectangle with cut corners
- *
- * Shadow is drawn 2px down and 2px right from the specified position.
- * Draw this BEFORE drawing your main element so the element appears on top.
- *
- * For cut corner elements:
- * - Shadow fills behind element's top-left, top-right, and bottom-left cut corners
- * - Shadow's own top-right corner is cut (2px)
- * - Shadow's own bottom-left corner is cut (2px)
- * - Shadow's bottom-right corner remains filled (visible through element's BR cut)
- *
- * @param x X position of the element (shadow will be at x+2)
- * @param y Y position of the element (shadow will be at y+2)
- * @param w Width of the shadow
- * @param h Height of the shadow
- * @param cutCorners Whether to handle cut corners (default: false)
+ * Median cut in Oklab: split the box with the most weighted spread along
+ * its widest axis, at the weighted median, until there are enough boxes.
+ * Box centers become the starting palette.
  */
-void drawShadow(int x, int y, int w, int h, bool cutCorners = false) {
-  // Draw main shadow rectangle (offset 2px down and right)
-  // This extends under the element and will show through any cut corners
-  M5Cardputer.Display.fillRect(x + 2, y + 2, w, h, currentTheme->shadow);
+void splitSharedColors(SharedPaletteJob* sp) {
+  uint16_t boxStart[17] = {0, sp->colorCount};
+  uint8_t boxes = 1;
+  while (boxes < sp->groups) {
+    // Box and axis with the largest weighted variance
+    int bestBox = -1;
+    int bestAxis = 0;
+    double bestSpread = 0;
+    for (uint8_t box = 0; box < boxes; box++) {
+      uint16_t start = boxStart[box];
+      uint16_t end = boxStart[box + 1];
+      if (end - start < 2) {
+        continue;
+      }
+      OklabColor center = sharedColorCenter(sp->colors, start, end);
+      double spread[3] = {0, 0, 0};
+      for (uint16_t i = start; i < end; i++) {
+        const OklabColor& lab = sp->colors[i].lab;
+        spread[0] += (double)sp->colors[i].weight * (lab.L - center.L) * (lab.L - center.L);
+        spread[1] += (double)sp->colors[i].weight * (lab.a - center.a) * (lab.a - center.a);
+        spread[2] += (double)sp->colors[i].weight * (lab.b - center.b) * (lab.b - center.b);
+      }
+      for (int axis = 0; axis < 3; axis++) {
+        if (bestBox < 0 || spread[axis] > bestSpread) {
+          bestBox = box;
+          bestAxis = axis;
+          bestSpread = spread[axis];
+        }
+      }
+    }
+    if (bestBox < 0) {
+      break;  // Every box is down to one color
+    }
 
-  if (cutCorners) {
-    // Cut the shadow's own visible corners (the parts that stick out beyond the element)
-    M5Cardputer.Display.fillRect(x + w, y + 2, 2, 2, currentTheme->background);  // Cut shadow's TR
-    M5Cardputer.Display.fillRect(x + 2, y + h, 2, 2, currentTheme->background);  // Cut shadow's BL
-    M5Cardputer.Display.fillRect(x + w, y + h, 2, 2, currentTheme->background);  // Cut shadow's BR
+    // Sort the box along the axis and cut where half its weight is passed
+    uint16_t start = boxStart[bestBox];
+    uint16_t end = boxStart[bestBox + 1];
+    std::sort(sp->colors + start, sp->colors + end, [bestAxis](const SharedColor& x, const SharedColor& y) {
+      return bestAxis == 0 ? x.lab.L < y.lab.L : (bestAxis == 1 ? x.lab.a < y.lab.a : x.lab.b < y.lab.b);
+    });
+    double total = 0;
+    for (uint16_t i = start; i < end; i++) {
+      total += sp->colors[i].weight;
+    }
+    double passed = 0;
+    uint16_t cut = start + 1;
+    while (cut < end - 1 && passed + sp->colors[cut - 1].weight < total / 2) {
+      passed += sp->colors[cut - 1].weight;
+      cut++;
+    }
+    memmove(boxStart + bestBox + 2, boxStart + bestBox + 1, (boxes - bestBox) * sizeof(uint16_t));
+    boxStart[bestBox + 1] = cut;
+    boxes++;
+  }
+
+  sp->groups = boxes;
+  for (uint8_t box = 0; box < boxes; box++) {
+    sp->centers[box] = sharedColorCenter(sp->colors, boxStart[box], boxStart[box + 1]);
   }
 }
 
 /**
- * Draw a filled rectangle with optional cut corners
- *
- * @param x X position
- * @param y Y position
- * @param w Width
- * @param h Height
- * @param cutSize Size of corner cuts in pixels
- * @param color Fill color
- * @param corners Bitfield of which corners to cut (use CORNER_* flags)
- * @param canvas Optional canvas to draw to (defaults to main display)
+ * One k-means pass: move every color to its nearest center, then every
+ * center to the weighted mean of its colors
+ * @return true if no color changed group
  */
-void drawCutCornerRect(int x, int y, int w, int h, int cutSize, uint16_t color, uint8_t corners = CORNER_ALL, M5Canvas* canvas = nullptr) {
-  // Draw main middle section (always full width)
-  if (canvas != nullptr) {
-    canvas->fillRect(x, y + cutSize, w, h - (cutSize * 2), color);
-  } else {
-    M5Cardputer.Display.fillRect(x, y + cutSize, w, h - (cutSize * 2), color);
+bool refineSharedColors(SharedPaletteJob* sp) {
+  bool settled = sp->iteration > 0;  // The first pass only assigns groups
+  double sums[16][4] = {};
+  for (uint16_t i = 0; i < sp->colorCount; i++) {
+    SharedColor& c = sp->colors[i];
+    uint8_t group = nearestOklabColor(sp->centers, sp->groups, c.lab);
+    if (group != c.group) {
+      settled = false;
+      c.group = group;
+    }
+    sums[group][0] += (double)c.lab.L * c.weight;
+    sums[group][1] += (double)c.lab.a * c.weight;
+    sums[group][2] += (double)c.lab.b * c.weight;
+    sums[group][3] += c.weight;
+  }
+  for (uint8_t g = 0; g < sp->groups; g++) {
+    if (sums[g][3] > 0) {  // An emptied group keeps its place
+      sp->centers[g] = {(float)(sums[g][0] / sums[g][3]), (float)(sums[g][1] / sums[g][3]),
+                        (float)(sums[g][2] / sums[g][3])};
+    }
+  }
+  return settled;
+}
+
+/**
+ * Pick each group's member nearest its center as the palette color, and
+ * sort the palette dark to light
+ */
+void pickSharedPalette(SharedPaletteJob* sp) {
+  int best[16];
+  float bestDistance[16];
+  for (uint8_t g = 0; g < sp->groups; g++) {
+    best[g] = -1;
+  }
+  for (uint16_t i = 0; i < sp->colorCount; i++) {
+    const SharedColor& c = sp->colors[i];
+    float distance = oklabDistance(c.lab, sp->centers[c.group]);
+    if (best[c.group] < 0 || distance < bestDistance[c.group]) {
+      best[c.group] = i;
+      bestDistance[c.group] = distance;
+    }
   }
 
-  // Top edge
-  int topStart = (corners & CORNER_TOP_LEFT) ? cutSize : 0;
-  int topEnd = (corners & CORNER_TOP_RIGHT) ? w - cutSize : w;
-  if (canvas != nullptr) {
-    canvas->fillRect(x + topStart, y, topEnd - topStart, cutSize, color);
-  } else {
-    M5Cardputer.Display.fillRect(x + topStart, y, topEnd - topStart, cutSize, color);
+  uint8_t count = 0;
+  OklabColor labs[16];
+  for (uint8_t g = 0; g < sp->groups; g++) {
+    if (best[g] >= 0) {
+      sp->palette[count] = sp->colors[best[g]].color;
+      labs[count++] = sp->colors[best[g]].lab;
+    }
+  }
+  for (uint8_t i = 1; i < count; i++) {
+    for (uint8_t j = i; j > 0 && labs[j].L < labs[j - 1].L; j--) {
+      std::swap(labs[j], labs[j - 1]);
+      std::swap(sp->palette[j], sp->palette[j - 1]);
+    }
   }
+  sp->groups = count;
+  memcpy(sp->centers, labs, sizeof(labs));
 
-  // Bottom edge
-  int bottomStart = (corners & CORNER_BOTTOM_LEFT) ? cutSize : 0;
-  int bottomEnd = (corners & CORNER_BOTTOM_RIGHT) ? w - cutSize : w;
-  if (canvas != nullptr) {
-    canvas->fillRect(x + bottomStart, y + h - cutSize, bottomEnd - bottomStart, cutSize, color);
-  } else {
-    M5Cardputer.Display.fillRect(x + bottomStart, y + h - cutSize, bottomEnd - bottomStart, cutSize, color);
+  // Fewer colors than the palette size: repeat them (as .hex palettes do)
+  for (uint8_t i = count; i < 16; i++) {
+    sp->palette[i] = sp->palette[i % count];
   }
 }
 
 /**
- * Draw an outline rectangle with optional cut corners
- *
- * @param x X position
- * @param y Y position
- * @param w Width
- * @param h Height
- * @param cutSize Size of corner cuts in pixels
- * @param color Line color
- * @param corners Bitfield of which corners to cut (use CORNER_* flags)
+ * Write the palette as a .hex file and add it to the catalog (or update the
+ * entry loaded from the same file)
  */
-void drawCutCornerOutline(int x, int y, int w, int h, int cutSize, uint16_t color, uint8_t corners = CORNER_ALL, M5Canvas* canvas = nullptr) {
-  // Draw the four edges with proper gaps at corners to create clean cutouts
+bool saveSharedPalette(SharedPaletteJob* sp) {
+  if (!SD.exists(SHARED_PALETTE_DIR)) {
+    SD.mkdir(SHARED_PALETTE_DIR);
+  }
+  String path = String(SHARED_PALETTE_DIR) + "/" + sp->name + ".hex";
+  SD.remove(path.c_str());
+  File file = SD.open(path.c_str(), FILE_WRITE);
+  if (!file) {
+    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+    return false;
+  }
+  bool ok = true;
+  for (uint8_t i = 0; i < sp->size; i++) {
+    uint16_t c = sp->palette[i];
+    uint8_t r = (c >> 11) & 0x1F;
+    uint8_t g = (c >> 5) & 0x3F;
+    uint8_t b = c & 0x1F;
+    char line[8];
+    snprintf(line, sizeof(line), "%02x%02x%02x\n", (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    ok = ok && file.print(line) == 7;
+  }
+  file.close();
+  if (!ok) {
+    setStatusMessage(StatusMsg::WRITE_FAIL);
+    return false;
+  }
 
-  // Top edge - skip cutSize pixels on each end where corners are cut
-  int topStart = (corners & CORNER_TOP_LEFT) ? cutSize : 0;
-  int topEnd = (corners & CORNER_TOP_RIGHT) ? w - cutSize : w;
-  if (topEnd > topStart) {
-    if (canvas != nullptr) {
-      canvas->fillRect(x + topStart, y, topEnd - topStart, 1, color);
+  // Catalog name as loadUserPalettes() would make it
+  String paletteName = sp->name;
+  paletteName.toUpperCase();
+  paletteName.replace("-", " ");
+  paletteName.replace("_", " ");
+  int entry = -1;
+  for (uint8_t p = 0; p < totalPaletteCount; p++) {
+    if (paletteIsUserLoaded[p] && paletteName == allPaletteNames[p]) {
+      entry = p;
+    }
+  }
+  if (entry < 0 && totalPaletteCount < 32) {
+    uint16_t* colors = (uint16_t*)malloc(16 * sizeof(uint16_t));
+    char* name = (char*)malloc(32);
+    if (colors && name) {
+      strncpy(name, paletteName.c_str(), 31);
+      name[31] = '\0';
+      entry = totalPaletteCount++;
+      allPalettes[entry] = colors;
+      allPaletteNames[entry] = name;
+      paletteIsUserLoaded[entry] = true;
     } else {
-      M5Cardputer.Display.fillRect(x + topStart, y, topEnd - topStart, 1, color);
+      free(colors);
+      free(name);
     }
   }
+  if (entry >= 0) {
+    memcpy((uint16_t*)allPalettes[entry], sp->palette, 16 * sizeof(uint16_t));
+    allPaletteSizes[entry] = sp->size;
+    rebuildPaletteIndex();
+  }
+  return true;
+}
 
-  // Bottom edge
-  int bottomStart = (corners & CORNER_BOTTOM_LEFT) ? cutSize : 0;
-  int bottomEnd = (corners & CORNER_BOTTOM_RIGHT) ? w - cutSize : w;
-  if (bottomEnd > bottomStart) {
-    if (canvas != nullptr) {
-      canvas->fillRect(x + bottomStart, y + h - 1, bottomEnd - bottomStart, 1, color);
-    } else {
-      M5Cardputer.Display.fillRect(x + bottomStart, y + h - 1, bottomEnd - bottomStart, 1, color);
+/**
+ * Move pixels onto the shared palette: each color shown goes to the palette
+ * entry that looks closest
+ * @param pixels 16x16 indices (a sketch's or the canvas)
+ * @param colors Palette the pixels are drawn with (becomes the shared one)
+ * @param paletteSize Its size (becomes the shared size)
+ */
+void remapToSharedPalette(SharedPaletteJob* sp, uint8_t pixels[16][16], uint16_t* colors, uint8_t& paletteSize) {
+  uint8_t map[17] = {0};
+  for (uint8_t i = 1; i <= 16; i++) {
+    uint16_t shown = colors[collapseIndex(i, paletteSize) - 1];
+    map[i] = nearestOklabColor(sp->centers, sp->groups, rgb565ToOklab(shown)) + 1;
+  }
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      if (pixels[y][x] <= 16) {
+        pixels[y][x] = map[pixels[y][x]];
+      }
     }
   }
+  memcpy(colors, sp->palette, 16 * sizeof(uint16_t));
+  paletteSize = sp->size;
+}
 
-  // Left edge - skip cutSize pixels on each end where corners are cut
-  int leftStart = (corners & CORNER_TOP_LEFT) ? cutSize : 0;
-  int leftEnd = (corners & CORNER_BOTTOM_LEFT) ? h - cutSize : h;
-  if (leftEnd > leftStart) {
-    if (canvas != nullptr) {
-      canvas->fillRect(x, y + leftStart, 1, leftEnd - leftStart, color);
-    } else {
-      M5Cardputer.Display.fillRect(x, y + leftStart, 1, leftEnd - leftStart, color);
+JobState sharedPaletteStep(Job& job) {
+  SharedPaletteJob* sp = (SharedPaletteJob*)job.context;
+  switch (sp->phase) {
+    case SHARED_GATHER: {
+      // Count the cells drawn in each color, a few sketches per step
+      for (int n = 0; n < SHARED_SKETCHES_PER_STEP && sp->next < sp->ids.size(); n++) {
+        Sketch sketch;
+        if (readSharedSketch(sp->ids[sp->next++], sketch)) {
+          countSketchColors(sp, sketch);
+        }
+      }
+      job.progress = sp->next * (sp->remap ? 45 : 90) / sp->ids.size();
+      if (sp->next < sp->ids.size()) {
+        return JOB_RUNNING;
+      }
+      if (sp->colorCount == 0) {
+        setStatusMessage(StatusMsg::NO_COLORS);
+        return JOB_FAILED;
+      }
+      packSharedColors(sp);
+      sp->phase = SHARED_SPLIT;
+      return JOB_RUNNING;
+    }
+
+    case SHARED_SPLIT:
+      splitSharedColors(sp);
+      sp->iteration = 0;
+      sp->phase = SHARED_REFINE;
+      return JOB_RUNNING;
+
+    case SHARED_REFINE: {
+      // One k-means pass per step
+      bool settled = refineSharedColors(sp);
+      sp->iteration++;
+      if (!settled && sp->iteration < SHARED_MAX_ITERATIONS) {
+        return JOB_RUNNING;
+      }
+      pickSharedPalette(sp);
+      if (!saveSharedPalette(sp)) {
+        return JOB_FAILED;
+      }
+      if (!sp->remap) {
+        return JOB_DONE;
+      }
+      sp->next = 0;
+      sp->phase = SHARED_REMAP;
+      return JOB_RUNNING;
+    }
+
+    case SHARED_REMAP: {
+      unsigned long activeId = sketchIdFromFilename(activeSketchFilename);
+      for (int n = 0; n < SHARED_SKETCHES_PER_STEP && sp->next < sp->ids.size(); n++) {
+        uint32_t id = sp->ids[sp->next++];
+        Sketch sketch;
+        if (!readSharedSketch(id, sketch)) {
+          continue;  // Gone since it was counted
+        }
+        remapToSharedPalette(sp, sketch.pixels, sketch.paletteColors, sketch.paletteSize);
+        if (!writeSketchFile(sharedSketchPath(id).c_str(), sketch)) {
+          setStatusMessage(StatusMsg::WRITE_FAIL);
+          return JOB_FAILED;
+        }
+        sp->remapped++;
+        if (id == activeId) {
+          sp->activeRemappedId = id;
+        }
+      }
+      job.progress = 45 + sp->next * 54 / sp->ids.size();
+      return sp->next < sp->ids.size() ? JOB_RUNNING : JOB_DONE;
     }
   }
+  return JOB_FAILED;
+}
 
-  // Right edge
-  int rightStart = (corners & CORNER_TOP_RIGHT) ? cutSize : 0;
-  int rightEnd = (corners & CORNER_BOTTOM_RIGHT) ? h - cutSize : h;
-  if (rightEnd > rightStart) {
-    if (canvas != nullptr) {
-      canvas->fillRect(x + w - 1, y + rightStart, 1, rightEnd - rightStart, color);
+void sharedPaletteFinish(Job& job, JobState state) {
+  SharedPaletteJob* sp = (SharedPaletteJob*)job.context;
+  scopedFree(sp->colors, SHARED_MAX_COLORS * sizeof(SharedColor));
+
+  // The open sketch's file was remapped: remap the canvas to match. Not if
+  // another sketch has been opened since: it was read after its own remap,
+  // or wasn't remapped at all.
+  if (sp->activeRemappedId != 0 && sp->activeRemappedId == sketchIdFromFilename(activeSketchFilename)) {
+    remapToSharedPalette(sp, canvas, activeSketch.paletteColors, activeSketch.paletteSize);
+    syncCanvasPlanes();
+    undoAvailable = false;  // Undo holds the old indices
+    canvasStroke.open = false;
+    LED_CANVAS_UPDATED();
+  }
+  if (sp->remapped > 0 && inMemoryView) {
+    startSketchScan(memoryScan, activeCollection);  // Thumbnails in the new colors
+  }
+
+  if (state == JOB_DONE) {
+    char msg[32];
+    if (sp->remap) {
+      snprintf(msg, sizeof(msg), StatusMsg::SHARED_REMAPPED_FMT, (unsigned long)sp->remapped, (unsigned)sp->size);
     } else {
-      M5Cardputer.Display.fillRect(x + w - 1, y + rightStart, 1, rightEnd - rightStart, color);
+      snprintf(msg, sizeof(msg), StatusMsg::SHARED_SAVED_FMT, (unsigned)sp->size, (unsigned)sp->colorCount);
     }
+    setStatusMessage(msg);
   }
-
-  // Corners are left as empty cutouts (cutSize × cutSize squares removed from each corner)
+  delete sp;
 }
 
 /**
- * Blend two RGB565 colors with alpha (0.0 = bg only, 1.0 = fg only)
+ * Derive a shared palette for the sketches listed in the memory view, as a
+ * background job (ESC cancels)
+ * @param size 4, 8 or 16 colors
+ * @param remap Also move the sketches onto the palette
+ * @return true if the job started
  */
-uint16_t blendRGB565(uint16_t bg, uint16_t fg, float alpha) {
-  // Extract RGB components from RGB565
-  uint8_t bgR = (bg >> 11) & 0x1F;
-  uint8_t bgG = (bg >> 5) & 0x3F;
-  uint8_t bgB = bg & 0x1F;
+bool startSharedPalette(uint8_t size, bool remap) {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
+  }
+  if (memoryScan.active) {
+    setStatusMessage(StatusMsg::STILL_LISTING);
+    return false;
+  }
+  if (sketchList.empty()) {
+    setStatusMessage(StatusMsg::NO_SKETCHES);
+    return false;
+  }
 
-  uint8_t fgR = (fg >> 11) & 0x1F;
-  uint8_t fgG = (fg >> 5) & 0x3F;
-  uint8_t fgB = fg & 0x1F;
+  SharedPaletteJob* sp = new SharedPaletteJob();
+  if (!sp) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
+  }
+  sp->colors = (SharedColor*)scopedAlloc(SHARED_MAX_COLORS * sizeof(SharedColor));
+  if (!sp->colors) {
+    delete sp;
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
+  }
+  memset(sp->colors, 0, SHARED_MAX_COLORS * sizeof(SharedColor));
+  sp->size = size;
+  sp->remap = remap;
+  sp->ids.reserve(sketchList.size());
+  for (const SketchInfo& info : sketchList) {
+    sp->ids.push_back(info.timestamp);
+  }
+  snprintf(sp->name, sizeof(sp->name), "shared-%s-%u", activeCollection[0] ? activeCollection : "library", size);
 
-  // Blend
-  uint8_t outR = bgR + (fgR - bgR) * alpha;
-  uint8_t outG = bgG + (fgG - bgG) * alpha;
-  uint8_t outB = bgB + (fgB - bgB) * alpha;
+  if (!startJob("Palette", sharedPaletteStep, sharedPaletteFinish, sp)) {
+    scopedFree(sp->colors, SHARED_MAX_COLORS * sizeof(SharedColor));
+    delete sp;
+    return false;
+  }
+  return true;
+}
 
-  // Pack back to RGB565
-  return (outR << 11) | (outG << 5) | outB;
+// ============================================================================
+// MURAL (M in canvas view)
+// ============================================================================
+// A 512×512 canvas kept sparsely on SD as 16×16 chunks. The chunk file holds
+// a header, a directory (slot number per chunk, 0 = empty and not stored), a
+// 4×4 summary per chunk for the overview, then one 256-byte slot per stored
+// chunk. Slots are rewritten in place, and slots of chunks that become empty
+// are reused. A small LRU cache holds the chunks around the viewport; dirty
+// chunks are written back when evicted, before the overview and on exit.
+// Multi-byte fields are big-endian. Cells are palette indices like canvas[][]
+// and are drawn with the active sketch's palette.
+
+const char* MURAL_PATH = "/bitmap16dx/mural.b16m";
+const char MURAL_MAGIC[4] = {'B', '1', '6', 'M'};
+const uint8_t MURAL_VERSION = 1;
+const int MURAL_CHUNK_SIZE = 16;                 // Cells per chunk side
+const int MURAL_CHUNKS_ACROSS = 32;              // 512×512 cells
+const int MURAL_SIZE = MURAL_CHUNK_SIZE * MURAL_CHUNKS_ACROSS;
+const int MURAL_CHUNK_COUNT = MURAL_CHUNKS_ACROSS * MURAL_CHUNKS_ACROSS;
+const int MURAL_CHUNK_BYTES = MURAL_CHUNK_SIZE * MURAL_CHUNK_SIZE;
+const int MURAL_MIP_SIZE = 4;                    // Overview cells per chunk side
+const int MURAL_MIP_BYTES = MURAL_MIP_SIZE * MURAL_MIP_SIZE;
+const uint32_t MURAL_DIR_OFFSET = 40;            // Magic, version, size, 33 reserved bytes
+const uint32_t MURAL_MIP_OFFSET = MURAL_DIR_OFFSET + MURAL_CHUNK_COUNT * 2;
+const uint32_t MURAL_DATA_OFFSET = MURAL_MIP_OFFSET + MURAL_CHUNK_COUNT * MURAL_MIP_BYTES;
+const int MURAL_CACHE_CHUNKS = 12;               // The viewport touches at most 4
+const int MURAL_CELL = 8;                        // Screen pixels per cell
+const int MURAL_VIEW = 128 / MURAL_CELL;         // Cells across the viewport
+const int MURAL_PAN_STEP = MURAL_VIEW / 2;       // The viewport moves half a view at a time
+
+struct MuralChunk {
+  int16_t index;       // row * MURAL_CHUNKS_ACROSS + column, -1 if unused
+  bool dirty;
+  uint32_t lastUsed;   // LRU stamp (0 = never)
+  uint8_t pixels[MURAL_CHUNK_SIZE][MURAL_CHUNK_SIZE];
+};
+
+struct MuralStats {
+  uint32_t hits;       // Chunk lookups served by the cache
+  uint32_t misses;
+  uint32_t reads;      // Misses that read a stored chunk from SD
+  uint32_t writes;     // Dirty chunks written back
+  uint32_t pans;
+  uint32_t panTotalUs;
+  uint32_t panMaxUs;
+};
+
+struct Mural {
+  File file;
+  uint16_t* directory = nullptr;  // Slot + 1 per chunk, 0 = empty
+  uint8_t* mip = nullptr;         // MURAL_MIP_BYTES per chunk
+  MuralChunk* cache = nullptr;
+  uint16_t* band = nullptr;       // One row of cells (128×8 pixels) on its way to the display
+  uint8_t slotUsed[MURAL_CHUNK_COUNT / 8];
+  uint16_t slotCount;             // Slots in the file, used or free
+  uint16_t storedChunks;
+  uint32_t clock;
+  MuralStats stats;
+};
+
+Mural mural;
+bool inMuralView = false;
+bool muralOverview = false;
+int muralViewX = 0;                 // Top-left cell of the viewport (multiple of MURAL_PAN_STEP)
+int muralViewY = 0;
+int muralCursorX = MURAL_VIEW / 2;  // Cursor in mural cells
+int muralCursorY = MURAL_VIEW / 2;
+
+inline int muralChunkIndex(int x, int y) {
+  return (y / MURAL_CHUNK_SIZE) * MURAL_CHUNKS_ACROSS + x / MURAL_CHUNK_SIZE;
 }
 
 /**
- * Draw a line with alpha transparency by blending a color with existing pixels
+ * Write one directory entry to the chunk file
  */
-void drawLineWithAlpha(int x, int y, int w, int h, uint16_t color, float alpha) {
-  for (int py = 0; py < h; py++) {
-    for (int px = 0; px < w; px++) {
-      uint16_t bgColor = M5Cardputer.Display.readPixel(x + px, y + py);
-      uint16_t blended = blendRGB565(bgColor, color, alpha);
-      M5Cardputer.Display.drawPixel(x + px, y + py, blended);
+bool writeMuralDirectoryEntry(int index) {
+  uint8_t entry[2] = {(uint8_t)(mural.directory[index] >> 8), (uint8_t)mural.directory[index]};
+  return mural.file.seek(MURAL_DIR_OFFSET + index * 2) && mural.file.write(entry, 2) == 2;
+}
+
+/**
+ * Summarize a chunk for the overview: each 4×4 block shows its most common
+ * color, and is empty only if the whole block is
+ */
+void muralChunkMip(const MuralChunk& chunk, uint8_t* mip) {
+  const int block = MURAL_CHUNK_SIZE / MURAL_MIP_SIZE;
+  for (int my = 0; my < MURAL_MIP_SIZE; my++) {
+    for (int mx = 0; mx < MURAL_MIP_SIZE; mx++) {
+      uint8_t counts[17] = {0};
+      for (int y = 0; y < block; y++) {
+        for (int x = 0; x < block; x++) {
+          counts[chunk.pixels[my * block + y][mx * block + x]]++;
+        }
+      }
+      uint8_t best = 0;
+      for (uint8_t c = 1; c <= 16; c++) {
+        if (counts[c] > counts[best] || (best == 0 && counts[c] > 0)) {
+          best = c;
+        }
+      }
+      mip[my * MURAL_MIP_SIZE + mx] = best;
     }
   }
 }
 
 /**
- * Draw a single cell at the given grid coordinates
- *
- * This redraws one cell with either:
- * - The pixel color if a pixel is placed there
- * - The checkerboard background if empty (pattern based on screen pixels)
+ * Write a cached chunk back to its slot (or free the slot if it's now empty)
  */
-void drawCell(int x, int y, bool isSelected = false) {
-  int screenX = GRID_X + (x * currentCellSize);
-  int screenY = GRID_Y + (y * currentCellSize);
-
-  // Check if this cell has a color
-  if (canvas[y][x] != 0) {
-    // FILLED CELL: Draw solid color directly (center lines will be underneath/hidden)
-    uint16_t cellColor = activeSketch.paletteColors[canvas[y][x] - 1];
-
-    // Apply tint if this is the selected cell
-    if (isSelected) {
-      // Darken the cell in both themes
-      uint8_t r = ((cellColor >> 11) & 0x1F) * 0.8;
-      uint8_t g = ((cellColor >> 5) & 0x3F) * 0.8;
-      uint8_t b = (cellColor & 0x1F) * 0.8;
-      cellColor = (r << 11) | (g << 5) | b;
+bool writeMuralChunk(MuralChunk& chunk) {
+  bool empty = true;
+  const uint8_t* cells = &chunk.pixels[0][0];
+  for (int i = 0; i < MURAL_CHUNK_BYTES && empty; i++) {
+    empty = cells[i] == 0;
+  }
+
+  uint16_t& slot = mural.directory[chunk.index];
+  bool ok = true;
+  if (empty) {
+    if (slot) {
+      uint16_t oldSlot = slot;
+      slot = 0;
+      ok = writeMuralDirectoryEntry(chunk.index);
+      if (ok) {
+        mural.slotUsed[(oldSlot - 1) / 8] &= ~(1 << ((oldSlot - 1) % 8));
+        mural.storedChunks--;
+      } else {
+        slot = oldSlot;  // Still stored; retried on the next write-back
+      }
     }
-
-    M5Cardputer.Display.fillRect(screenX, screenY, currentCellSize, currentCellSize, cellColor);
   } else {
-    // EMPTY CELL: Draw checkerboard pattern, then center lines on top
-    int checkSize = currentCellSize / 2;
-
-    // Draw checkerboard pattern
-    for (int py = 0; py < currentCellSize; py += checkSize) {
-      for (int px = 0; px < currentCellSize; px += checkSize) {
-        int absX = screenX + px;
-        int absY = screenY + py;
-        bool isDark = ((absX / checkSize) + (absY / checkSize)) % 2 == 0;
-        uint16_t color = isDark ? currentTheme->cellDark : currentTheme->cellLight;
-
-        // Apply tint if this is the selected cell
-        if (isSelected) {
-          if (currentTheme == &THEME_DARK) {
-            // In dark mode, darken each square differently to maintain checkerboard visibility
-            // Dark squares: darken less (0.5) - already very dark, don't over-darken
-            // Light squares: darken more (0.3) - bring them closer to dark squares
-            float multiplier = isDark ? 0.4 : 0.2;
-            uint8_t r = ((color >> 11) & 0x1F) * multiplier;
-            uint8_t g = ((color >> 5) & 0x3F) * multiplier;
-            uint8_t b = (color & 0x1F) * multiplier;
-            color = (r << 11) | (g << 5) | b;
-          } else {
-            // In light mode, darken the cell uniformly
-            uint8_t r = ((color >> 11) & 0x1F) * 0.8;
-            uint8_t g = ((color >> 5) & 0x3F) * 0.8;
-            uint8_t b = (color & 0x1F) * 0.8;
-            color = (r << 11) | (g << 5) | b;
-          }
-        }
-
-        int drawWidth = min(checkSize, currentCellSize - px);
-        int drawHeight = min(checkSize, currentCellSize - py);
-        M5Cardputer.Display.fillRect(absX, absY, drawWidth, drawHeight, color);
+    bool newSlot = (slot == 0);
+    if (newSlot) {
+      // First free slot, or a new one at the end of the file
+      uint16_t freeSlot = 0;
+      while (freeSlot < mural.slotCount && (mural.slotUsed[freeSlot / 8] & (1 << (freeSlot % 8)))) {
+        freeSlot++;
       }
+      if (freeSlot == mural.slotCount) {
+        mural.slotCount++;
+      }
+      mural.slotUsed[freeSlot / 8] |= 1 << (freeSlot % 8);
+      slot = freeSlot + 1;
+      mural.storedChunks++;
     }
+    // Data before directory, so a cut-off write never points at a stale slot
+    uint8_t* mip = mural.mip + chunk.index * MURAL_MIP_BYTES;
+    muralChunkMip(chunk, mip);
+    ok = mural.file.seek(MURAL_DATA_OFFSET + (uint32_t)(slot - 1) * MURAL_CHUNK_BYTES) &&
+         mural.file.write(cells, MURAL_CHUNK_BYTES) == MURAL_CHUNK_BYTES &&
+         mural.file.seek(MURAL_MIP_OFFSET + chunk.index * MURAL_MIP_BYTES) &&
+         mural.file.write(mip, MURAL_MIP_BYTES) == MURAL_MIP_BYTES;
+    if (ok && newSlot) {
+      ok = writeMuralDirectoryEntry(chunk.index);
+    }
+    if (!ok && newSlot) {
+      // Give the slot back so the retry allocates it (and its directory entry) again
+      mural.slotUsed[(slot - 1) / 8] &= ~(1 << ((slot - 1) % 8));
+      slot = 0;
+      mural.storedChunks--;
+    }
+  }
 
-    // Draw center lines (if rulers are visible and they pass through this cell)
-    if (rulersVisible) {
-      int centerX = GRID_X + 64;  // Vertical line at x=120
-      int centerY = GRID_Y + 64;  // Horizontal line at y=68
-
-      if (centerX >= screenX && centerX < screenX + currentCellSize) {
-        // Redraw the vertical line segment for this cell
-        M5Cardputer.Display.fillRect(centerX, screenY, 1, currentCellSize, currentTheme->centerLine);
-      }
+  if (!ok) {
+    setStatusMessage(StatusMsg::FAILED_TO_SAVE);
+    return false;  // Stays dirty
+  }
+  mural.stats.writes++;
+  chunk.dirty = false;
+  return true;
+}
 
-      if (centerY >= screenY && centerY < screenY + currentCellSize) {
-        // Redraw the horizontal line segment for this cell
-        M5Cardputer.Display.fillRect(screenX, centerY, currentCellSize, 1, currentTheme->centerLine);
+/**
+ * Get a chunk through the cache, reading it from SD (or starting it empty) on a miss
+ */
+MuralChunk* muralChunk(int index) {
+  mural.clock++;
+  MuralChunk* victim = &mural.cache[0];
+  for (int i = 0; i < MURAL_CACHE_CHUNKS; i++) {
+    MuralChunk& entry = mural.cache[i];
+    if (entry.index == index) {
+      mural.stats.hits++;
+      entry.lastUsed = mural.clock;
+      return &entry;
+    }
+    if (entry.lastUsed < victim->lastUsed) {
+      victim = &entry;
+    }
+  }
+
+  mural.stats.misses++;
+  if (victim->index >= 0 && victim->dirty && !writeMuralChunk(*victim)) {
+    // Keep the unsaved chunk and evict the least recently used clean one instead
+    // (only when every cached chunk is unsaved are edits lost)
+    for (int i = 0; i < MURAL_CACHE_CHUNKS; i++) {
+      MuralChunk& entry = mural.cache[i];
+      if (!entry.dirty && (victim->dirty || entry.lastUsed < victim->lastUsed)) {
+        victim = &entry;
       }
     }
   }
+  victim->index = index;
+  victim->dirty = false;
+  victim->lastUsed = mural.clock;
 
-  // LAYER 4: Apply corner masking for corner cells
-  if (x == 0 && y == 0) {
-    M5Cardputer.Display.fillRect(screenX, screenY, 2, 2, currentTheme->background);
+  uint16_t slot = mural.directory[index];
+  if (slot == 0) {
+    memset(victim->pixels, 0, MURAL_CHUNK_BYTES);
+    return victim;
   }
-  else if (x == currentGridSize - 1 && y == 0) {
-    M5Cardputer.Display.fillRect(screenX + currentCellSize - 2, screenY, 2, 2, currentTheme->background);
+  mural.stats.reads++;
+  if (!mural.file.seek(MURAL_DATA_OFFSET + (uint32_t)(slot - 1) * MURAL_CHUNK_BYTES) ||
+      mural.file.read(&victim->pixels[0][0], MURAL_CHUNK_BYTES) != MURAL_CHUNK_BYTES) {
+    memset(victim->pixels, 0, MURAL_CHUNK_BYTES);
+    setStatusMessage(StatusMsg::FAILED_TO_LOAD);
   }
-  else if (x == 0 && y == currentGridSize - 1) {
-    M5Cardputer.Display.fillRect(screenX, screenY + currentCellSize - 2, 2, 2, currentTheme->background);
+  return victim;
+}
+
+/**
+ * Set one mural cell
+ */
+void setMuralCell(int x, int y, uint8_t value) {
+  MuralChunk* chunk = muralChunk(muralChunkIndex(x, y));
+  uint8_t& cell = chunk->pixels[y % MURAL_CHUNK_SIZE][x % MURAL_CHUNK_SIZE];
+  if (cell != value) {
+    cell = value;
+    chunk->dirty = true;
   }
-  else if (x == currentGridSize - 1 && y == currentGridSize - 1) {
-    M5Cardputer.Display.fillRect(screenX + currentCellSize - 2, screenY + currentCellSize - 2, 2, 2, currentTheme->shadow);
+}
+
+/**
+ * Write back every dirty cached chunk (chunks that fail stay dirty)
+ */
+bool flushMural() {
+  bool ok = true;
+  for (int i = 0; i < MURAL_CACHE_CHUNKS; i++) {
+    if (mural.cache[i].index >= 0 && mural.cache[i].dirty) {
+      ok = writeMuralChunk(mural.cache[i]) && ok;
+    }
   }
+  mural.file.flush();
+  return ok;
 }
 
 /**
- * Draw the cursor
- *
- * Draws a simple arrow pointer below and to the right of the selected cell
+ * Free the mural's buffers and close its file (without writing back)
  */
-void drawCursor() {
-  // Clear the old cursor icon position if it exists
-  if (lastCursorScreenX >= 0 && lastCursorScreenY >= 0) {
-    // Calculate which cells might have been covered by the old cursor icon
-    int oldCursorEndX = lastCursorScreenX + ICON_CANVAS_CURSOR_WIDTH;
-    int oldCursorEndY = lastCursorScreenY + ICON_CANVAS_CURSOR_HEIGHT;
+void releaseMural() {
+  mural.file.close();
+  scopedFree(mural.directory, MURAL_CHUNK_COUNT * sizeof(uint16_t));
+  scopedFree(mural.mip, MURAL_CHUNK_COUNT * MURAL_MIP_BYTES);
+  scopedFree(mural.cache, MURAL_CACHE_CHUNKS * sizeof(MuralChunk));
+  scopedFree(mural.band, 128 * MURAL_CELL * sizeof(uint16_t));
+}
 
-    // Find grid cells that overlap with the old cursor area
-    int startCellX = max(0, (lastCursorScreenX - GRID_X) / currentCellSize);
-    int startCellY = max(0, (lastCursorScreenY - GRID_Y) / currentCellSize);
-    int endCellX = min(currentGridSize - 1, (oldCursorEndX - GRID_X) / currentCellSize);
-    int endCellY = min(currentGridSize - 1, (oldCursorEndY - GRID_Y) / currentCellSize);
+/**
+ * Create an empty chunk file: header, empty directory and overview, no slots
+ */
+bool createMuralFile(const char* path) {
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  uint8_t block[256] = {0};
+  memcpy(block, MURAL_MAGIC, 4);
+  block[4] = MURAL_VERSION;
+  block[5] = MURAL_CHUNKS_ACROSS;
+  block[6] = MURAL_CHUNKS_ACROSS;
+  bool ok = file.write(block, 7) == 7;
+  memset(block, 0, sizeof(block));
+  for (uint32_t written = 7; written < MURAL_DATA_OFFSET && ok; written += sizeof(block)) {
+    size_t n = min((uint32_t)sizeof(block), MURAL_DATA_OFFSET - written);
+    ok = file.write(block, n) == n;
+  }
+  file.close();
+  if (!ok) {
+    SD.remove(path);
+  }
+  return ok;
+}
 
-    // First, fill the old cursor area with background color
-    M5Cardputer.Display.fillRect(
-      lastCursorScreenX,
-      lastCursorScreenY,
-      ICON_CANVAS_CURSOR_WIDTH,
-      ICON_CANVAS_CURSOR_HEIGHT,
-      currentTheme->background
-    );
+/**
+ * Open (or create) a chunk file and load its directory and overview
+ */
+bool openMural(const char* path) {
+  if (!SD.exists(path) && !createMuralFile(path)) {
+    setStatusMessage(StatusMsg::FAILED_TO_SAVE);
+    return false;
+  }
+  mural.file = SD.open(path, "r+");
+  if (!mural.file) {
+    setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+    return false;
+  }
+  mural.directory = (uint16_t*)scopedAlloc(MURAL_CHUNK_COUNT * sizeof(uint16_t));
+  mural.mip = (uint8_t*)scopedAlloc(MURAL_CHUNK_COUNT * MURAL_MIP_BYTES);
+  mural.cache = (MuralChunk*)scopedAlloc(MURAL_CACHE_CHUNKS * sizeof(MuralChunk));
+  mural.band = (uint16_t*)scopedAlloc(128 * MURAL_CELL * sizeof(uint16_t));
+  if (!mural.directory || !mural.mip || !mural.cache || !mural.band) {
+    releaseMural();
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
+  }
 
-    // Then redraw all cells that were covered by the old cursor
-    for (int y = startCellY; y <= endCellY && y < currentGridSize; y++) {
-      for (int x = startCellX; x <= endCellX && x < currentGridSize; x++) {
-        drawCell(x, y);
+  uint8_t header[7];
+  uint8_t* dirBytes = (uint8_t*)mural.directory;
+  bool ok = mural.file.read(header, sizeof(header)) == sizeof(header) &&
+            memcmp(header, MURAL_MAGIC, 4) == 0 && header[4] == MURAL_VERSION &&
+            header[5] == MURAL_CHUNKS_ACROSS && header[6] == MURAL_CHUNKS_ACROSS &&
+            mural.file.size() >= MURAL_DATA_OFFSET &&
+            mural.file.seek(MURAL_DIR_OFFSET) &&
+            mural.file.read(dirBytes, MURAL_CHUNK_COUNT * 2) == MURAL_CHUNK_COUNT * 2 &&
+            mural.file.read(mural.mip, MURAL_CHUNK_COUNT * MURAL_MIP_BYTES) == MURAL_CHUNK_COUNT * MURAL_MIP_BYTES;
+
+  // Directory entries are big-endian on disk; mark the slots they use
+  mural.slotCount = ok ? (mural.file.size() - MURAL_DATA_OFFSET) / MURAL_CHUNK_BYTES : 0;
+  mural.storedChunks = 0;
+  memset(mural.slotUsed, 0, sizeof(mural.slotUsed));
+  for (int i = 0; i < MURAL_CHUNK_COUNT && ok; i++) {
+    uint16_t slot = (dirBytes[i * 2] << 8) | dirBytes[i * 2 + 1];
+    mural.directory[i] = slot;
+    if (slot) {
+      ok = slot <= mural.slotCount && !(mural.slotUsed[(slot - 1) / 8] & (1 << ((slot - 1) % 8)));
+      mural.slotUsed[(slot - 1) / 8] |= 1 << ((slot - 1) % 8);
+      mural.storedChunks++;
+    }
+  }
+  if (!ok) {
+    releaseMural();
+    setStatusMessage(StatusMsg::FILE_CORRUPT);
+    return false;
+  }
+
+  for (int i = 0; i < MURAL_CACHE_CHUNKS; i++) {
+    mural.cache[i].index = -1;
+    mural.cache[i].dirty = false;
+    mural.cache[i].lastUsed = 0;
+  }
+  mural.clock = 0;
+  mural.stats = {};
+  return true;
+}
+
+/**
+ * Render one cell into a pixel buffer (stride in pixels), with the canvas's
+ * checkerboard for empty cells so the mural reads like the canvas
+ */
+void renderMuralCell(uint16_t* dst, int stride, int screenX, int screenY, uint8_t value) {
+  const int checkSize = MURAL_CELL / 2;
+  for (int py = 0; py < MURAL_CELL; py++) {
+    uint16_t* line = dst + py * stride;
+    for (int px = 0; px < MURAL_CELL; px++) {
+      if (value != 0) {
+        line[px] = activeSketch.paletteColors[value - 1];
+      } else {
+        bool isDark = (((screenX + px) / checkSize) + ((screenY + py) / checkSize)) % 2 == 0;
+        line[px] = isDark ? currentTheme->cellDark : currentTheme->cellLight;
       }
     }
+  }
+}
 
-    // Redraw shadow edges if cursor overlapped them (shadow extends 2px beyond grid)
-    // Right edge shadow: from GRID_X+128 to GRID_X+130
-    if (oldCursorEndX > GRID_X + 128) {
-      M5Cardputer.Display.fillRect(GRID_X + 128, GRID_Y + 2, 2, 128, currentTheme->shadow);
-    }
-    // Bottom edge shadow: from GRID_Y+128 to GRID_Y+130
-    if (oldCursorEndY > GRID_Y + 128) {
-      M5Cardputer.Display.fillRect(GRID_X + 2, GRID_Y + 128, 128, 2, currentTheme->shadow);
+/**
+ * Draw rows of the viewport, one row of cells per block transfer
+ */
+void drawMuralRows(int firstRow, int lastRow) {
+  bool oldSwap = M5Cardputer.Display.getSwapBytes();
+  M5Cardputer.Display.setSwapBytes(true);
+  for (int row = firstRow; row <= lastRow; row++) {
+    int y = muralViewY + row;
+    int screenY = GRID_Y + row * MURAL_CELL;
+    // A row spans at most two chunks
+    for (int col = 0; col < MURAL_VIEW;) {
+      int x = muralViewX + col;
+      MuralChunk* chunk = muralChunk(muralChunkIndex(x, y));
+      int run = min(MURAL_VIEW - col, MURAL_CHUNK_SIZE - x % MURAL_CHUNK_SIZE);
+      for (int i = 0; i < run; i++) {
+        renderMuralCell(mural.band + (col + i) * MURAL_CELL, 128, GRID_X + (col + i) * MURAL_CELL, screenY,
+                        chunk->pixels[y % MURAL_CHUNK_SIZE][(x + i) % MURAL_CHUNK_SIZE]);
+      }
+      col += run;
     }
-    // Restore corner cuts if we redrew shadow
-    if (oldCursorEndX > GRID_X + 128 || oldCursorEndY > GRID_Y + 128) {
-      M5Cardputer.Display.fillRect(GRID_X + 128, GRID_Y + 2, 2, 2, currentTheme->background);  // Shadow's TR cut
-      M5Cardputer.Display.fillRect(GRID_X + 2, GRID_Y + 128, 2, 2, currentTheme->background);  // Shadow's BL cut
-      M5Cardputer.Display.fillRect(GRID_X + 128, GRID_Y + 128, 2, 2, currentTheme->background); // Shadow's BR cut
+    M5Cardputer.Display.pushImage(GRID_X, screenY, 128, MURAL_CELL, mural.band);
+  }
+  M5Cardputer.Display.setSwapBytes(oldSwap);
+  drawGridCorners();
+}
+
+/**
+ * Draw one viewport cell, outlined if it's under the cursor
+ */
+void drawMuralCell(int x, int y) {
+  int col = x - muralViewX;
+  int row = y - muralViewY;
+  if (col < 0 || col >= MURAL_VIEW || row < 0 || row >= MURAL_VIEW) {
+    return;
+  }
+  uint16_t pixels[MURAL_CELL * MURAL_CELL];
+  int screenX = GRID_X + col * MURAL_CELL;
+  int screenY = GRID_Y + row * MURAL_CELL;
+  MuralChunk* chunk = muralChunk(muralChunkIndex(x, y));
+  renderMuralCell(pixels, MURAL_CELL, screenX, screenY, chunk->pixels[y % MURAL_CHUNK_SIZE][x % MURAL_CHUNK_SIZE]);
+
+  bool oldSwap = M5Cardputer.Display.getSwapBytes();
+  M5Cardputer.Display.setSwapBytes(true);
+  M5Cardputer.Display.pushImage(screenX, screenY, MURAL_CELL, MURAL_CELL, pixels);
+  M5Cardputer.Display.setSwapBytes(oldSwap);
+
+  if (x == muralCursorX && y == muralCursorY) {
+    M5Cardputer.Display.drawRect(screenX, screenY, MURAL_CELL, MURAL_CELL, currentTheme->text);
+  }
+}
+
+/**
+ * Move the viewport by whole cells and redraw it, timing the pan
+ */
+void panMural(int dx, int dy) {
+  int newX = max(0, min(MURAL_SIZE - MURAL_VIEW, muralViewX + dx));
+  int newY = max(0, min(MURAL_SIZE - MURAL_VIEW, muralViewY + dy));
+  if (newX == muralViewX && newY == muralViewY) {
+    return;
+  }
+  unsigned long start = micros();
+  muralViewX = newX;
+  muralViewY = newY;
+  drawMuralRows(0, MURAL_VIEW - 1);
+  drawMuralCell(muralCursorX, muralCursorY);
+
+  uint32_t elapsed = micros() - start;
+  mural.stats.pans++;
+  mural.stats.panTotalUs += elapsed;
+  mural.stats.panMaxUs = max(mural.stats.panMaxUs, elapsed);
+}
+
+/**
+ * Draw the whole mural from the chunk summaries (4 screen pixels per chunk),
+ * with the viewport outlined
+ */
+void drawMuralOverview() {
+  bool oldSwap = M5Cardputer.Display.getSwapBytes();
+  M5Cardputer.Display.setSwapBytes(true);
+  const int chunkPixels = 128 / MURAL_CHUNKS_ACROSS;
+  for (int y = 0; y < 128; y++) {
+    int chunkRow = y / chunkPixels;
+    int mipRow = (y % chunkPixels) * MURAL_MIP_SIZE / chunkPixels;
+    for (int x = 0; x < 128; x++) {
+      int chunkCol = x / chunkPixels;
+      int index = chunkRow * MURAL_CHUNKS_ACROSS + chunkCol;
+      uint8_t value = 0;
+      if (mural.directory[index]) {
+        value = mural.mip[index * MURAL_MIP_BYTES + mipRow * MURAL_MIP_SIZE + (x % chunkPixels) * MURAL_MIP_SIZE / chunkPixels];
+      }
+      if (value != 0) {
+        mural.band[x] = activeSketch.paletteColors[value - 1];
+      } else {
+        // Empty chunks alternate so the chunk grid shows
+        mural.band[x] = ((chunkRow + chunkCol) % 2 == 0) ? currentTheme->cellDark : currentTheme->cellLight;
+      }
     }
+    M5Cardputer.Display.pushImage(GRID_X, GRID_Y + y, 128, 1, mural.band);
   }
+  M5Cardputer.Display.setSwapBytes(oldSwap);
+  drawGridCorners();
 
-  // Draw the selected cell with tint
-  drawCell(cursorX, cursorY, true);
+  int scale = MURAL_SIZE / 128;
+  M5Cardputer.Display.drawRect(GRID_X + muralViewX / scale - 1, GRID_Y + muralViewY / scale - 1,
+                               MURAL_VIEW / scale + 2, MURAL_VIEW / scale + 2, currentTheme->text);
+}
 
-  // Convert grid coordinates to screen coordinates (top-left of cell)
-  int cellX = GRID_X + (cursorX * currentCellSize);
-  int cellY = GRID_Y + (cursorY * currentCellSize);
+/**
+ * Draw the position readout in the left column
+ */
+void drawMuralInfo() {
+  M5Cardputer.Display.fillRect(3, 4, 50, 44, currentTheme->background);
+  M5Cardputer.Display.setTextColor(currentTheme->text);
+  M5Cardputer.Display.setTextSize(1);
+  M5Cardputer.Display.setCursor(3, 4);
+  M5Cardputer.Display.print(muralOverview ? "OVERVIEW" : "MURAL");
+  char line[12];
+  snprintf(line, sizeof(line), "X %d", muralOverview ? muralViewX : muralCursorX);
+  M5Cardputer.Display.setCursor(3, 18);
+  M5Cardputer.Display.print(line);
+  snprintf(line, sizeof(line), "Y %d", muralOverview ? muralViewY : muralCursorY);
+  M5Cardputer.Display.setCursor(3, 28);
+  M5Cardputer.Display.print(line);
+  snprintf(line, sizeof(line), "%u chk", mural.storedChunks);
+  M5Cardputer.Display.setCursor(3, 38);
+  M5Cardputer.Display.print(line);
+}
 
-  // Position cursor below and to the right of the cell, with offset for alignment
-  int cursorX_pos = cellX + currentCellSize + CURSOR_OFFSET_X;
-  int cursorY_pos = cellY + currentCellSize + CURSOR_OFFSET_Y;
+/**
+ * Draw the whole mural view (viewport or overview, palette, readout)
+ */
+void drawMuralView() {
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawShadow(GRID_X, GRID_Y, 128, 128, true);
+  if (muralOverview) {
+    drawMuralOverview();
+  } else {
+    drawMuralRows(0, MURAL_VIEW - 1);
+    drawMuralCell(muralCursorX, muralCursorY);
+  }
+  drawPalette();
+  drawMuralInfo();
+}
 
-  // Draw the cursor icon
-  drawIcon(cursorX_pos, cursorY_pos, ICON_CANVAS_CURSOR, ICON_CANVAS_CURSOR_WIDTH, ICON_CANVAS_CURSOR_HEIGHT, ICON_CANVAS_CURSOR_IS_INDEXED);
+/**
+ * Enter the mural view (M in canvas view)
+ */
+void enterMuralView() {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return;
+  }
+  if (!openMural(MURAL_PATH)) {
+    return;
+  }
+  inMuralView = true;
+  muralOverview = false;
+  drawMuralView();
+}
 
-  // Save this position for next time
-  lastCursorScreenX = cursorX_pos;
-  lastCursorScreenY = cursorY_pos;
+/**
+ * Write back the mural and return to the canvas
+ */
+void exitMuralView() {
+  flushMural();
+  releaseMural();
+  inMuralView = false;
+
+  // Redraw the canvas view
+  M5Cardputer.Display.fillScreen(currentTheme->background);
+  drawGrid();
+  drawPalette();
+  drawCursor();
+  drawToolIcons();
+
+  lastBatteryPercent = -1;  // Force redraw
+  batteryFirstCheck = true;  // Force immediate check
+  drawBatteryIndicator();
 }
 
 /**
- * Draw the palette column with selection indicator
- *
- * Draws color swatches and the selection indicator.
- * This is a simple, complete redraw - no optimization.
- * Layout:
- * - 4-color: single column, right-aligned
- * - 8-color: single column, right-aligned
- * - 16-color: two columns
+ * Switch between the viewport and the overview
+ * The overview reads summaries from the file, so pending edits are written first
  */
-void drawPalette() {
-  // Clear the entire palette area (with a bit of margin for the selection border)
-  M5Cardputer.Display.fillRect(
-    PALETTE_X - 4,
-    GRID_Y - 4,
-    PALETTE_WIDTH + 8,
-    (PALETTE_SWATCH_SIZE * 8) + 8,
-    currentTheme->background
-  );
+void toggleMuralOverview() {
+  muralOverview = !muralOverview;
+  if (muralOverview) {
+    flushMural();
+    drawMuralOverview();
+  } else {
+    // Bring the cursor into the chosen viewport
+    muralCursorX = max(muralViewX, min(muralViewX + MURAL_VIEW - 1, muralCursorX));
+    muralCursorY = max(muralViewY, min(muralViewY + MURAL_VIEW - 1, muralCursorY));
+    unsigned long start = micros();
+    drawMuralRows(0, MURAL_VIEW - 1);
+    drawMuralCell(muralCursorX, muralCursorY);
+    uint32_t elapsed = micros() - start;
+    mural.stats.pans++;
+    mural.stats.panTotalUs += elapsed;
+    mural.stats.panMaxUs = max(mural.stats.panMaxUs, elapsed);
+  }
+  drawMuralInfo();
+}
 
-  // Determine layout based on palette size
-  // 4-color and 8-color: one column, right-aligned
-  // 16-color: two columns
-  int numColors = activeSketch.paletteSize;
-  int startX = (numColors <= 8) ? (PALETTE_X + PALETTE_SWATCH_SIZE) : PALETTE_X;  // Right-aligned for 4 and 8-color
+/**
+ * Move the cursor (viewport) or the overview's viewport box by one step
+ */
+void moveMural(char key, bool enterHeld, bool deleteHeld) {
+  int dx = (key == '/') - (key == ',');
+  int dy = (key == '.') - (key == ';');
+
+  if (muralOverview) {
+    int oldX = muralViewX;
+    int oldY = muralViewY;
+    muralViewX = max(0, min(MURAL_SIZE - MURAL_VIEW, muralViewX + dx * MURAL_CHUNK_SIZE));
+    muralViewY = max(0, min(MURAL_SIZE - MURAL_VIEW, muralViewY + dy * MURAL_CHUNK_SIZE));
+    if (muralViewX != oldX || muralViewY != oldY) {
+      drawMuralOverview();
+      drawMuralInfo();
+    }
+    return;
+  }
 
-  // Draw shadow behind the palette (with cut corners)
-  int paletteWidth = (numColors <= 8) ? PALETTE_SWATCH_SIZE : PALETTE_WIDTH;
-  int paletteHeight = (numColors <= 8) ? (numColors * PALETTE_SWATCH_SIZE) : (8 * PALETTE_SWATCH_SIZE);
-  drawShadow(startX, GRID_Y, paletteWidth, paletteHeight, true);
+  int x = max(0, min(MURAL_SIZE - 1, muralCursorX + dx));
+  int y = max(0, min(MURAL_SIZE - 1, muralCursorY + dy));
+  if (x == muralCursorX && y == muralCursorY) {
+    return;
+  }
+  int oldX = muralCursorX;
+  int oldY = muralCursorY;
+  muralCursorX = x;
+  muralCursorY = y;
+  if (enterHeld) {
+    setMuralCell(x, y, selectedColor);
+  } else if (deleteHeld) {
+    setMuralCell(x, y, 0);
+  }
+
+  // Leaving the viewport pans half a view; otherwise just the two cells change
+  int panX = (x < muralViewX) ? -MURAL_PAN_STEP : (x >= muralViewX + MURAL_VIEW) ? MURAL_PAN_STEP : 0;
+  int panY = (y < muralViewY) ? -MURAL_PAN_STEP : (y >= muralViewY + MURAL_VIEW) ? MURAL_PAN_STEP : 0;
+  if (panX || panY) {
+    panMural(panX, panY);
+  } else {
+    drawMuralCell(oldX, oldY);
+    drawMuralCell(x, y);
+  }
+  drawMuralInfo();
+}
 
-  // Draw color swatches
-  for (int i = 0; i < numColors; i++) {
-    int col = (numColors <= 8) ? 0 : (i / 8);  // Always column 0 for 4/8-color
-    int row = (numColors <= 8) ? i : (i % 8);   // Row 0-3/0-7 for 4/8-color, 0-7 for 16-color
+/**
+ * Show the status message in the mural view, repairing the row it covered
+ */
+void drawMuralStatus() {
+  drawStatusMessage();
+  if (!statusMessageJustCleared) {
+    return;
+  }
+  statusMessageJustCleared = false;
 
-    int swatchX = startX + (col * PALETTE_SWATCH_SIZE);
-    int swatchY = GRID_Y + (row * PALETTE_SWATCH_SIZE);
+  // The message line (y=124) overlaps the last viewport row
+  M5Cardputer.Display.fillRect(3, 124, 53, 11, currentTheme->background);
+  if (muralOverview) {
+    drawMuralOverview();
+  } else {
+    drawMuralRows(MURAL_VIEW - 1, MURAL_VIEW - 1);
+    drawMuralCell(muralCursorX, muralCursorY);
+  }
+  if (statusMessage[0] != '\0') {
+    M5Cardputer.Display.setTextColor(currentTheme->text);
+    M5Cardputer.Display.setTextSize(1);
+    M5Cardputer.Display.setCursor(3, 124);
+    M5Cardputer.Display.print(statusMessage);
+  }
+}
 
-    // Draw the 16×16 color swatch using active sketch's palette
-    M5Cardputer.Display.fillRect(
-      swatchX,
-      swatchY,
-      PALETTE_SWATCH_SIZE,
-      PALETTE_SWATCH_SIZE,
-      activeSketch.paletteColors[i]
-    );
+/**
+ * Handle mural view input
+ */
+void handleMuralView(Keyboard_Class::KeysState& status) {
+  static unsigned long muralLastKeyTime = 0;
+  static bool muralKeyRepeating = false;
+  static char muralLastKey = 0;
 
-    // Apply corner masking for corner swatches (only if NOT currently selected)
-    bool isSelected = (i == selectedColor - 1);
-    if (!isSelected) {
-      if (numColors == 4) {
-        // 4-color: single column, right-aligned
-        if (i == 0) {
-          // Top: mask both top corners
-          M5Cardputer.Display.fillRect(swatchX, swatchY, 2, 2, currentTheme->background);  // Top-left
-          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, 2, currentTheme->background);  // Top-right
-        }
-        else if (i == 3) {
-          // Bottom: mask both bottom corners
-          M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->background);  // Bottom-left
-          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->shadow);  // Bottom-right (shadow!)
-        }
+  char arrowKey = 0;
+  for (auto i : status.word) {
+    if (i == ';' || i == '.' || i == ',' || i == '/') {
+      arrowKey = i;
+      break;
+    }
+  }
+
+  if (M5Cardputer.Keyboard.isChange() && M5Cardputer.Keyboard.isPressed()) {
+    if (!muralOverview && status.enter) {
+      setMuralCell(muralCursorX, muralCursorY, selectedColor);
+      drawMuralCell(muralCursorX, muralCursorY);
+    } else if (!muralOverview && status.del) {
+      setMuralCell(muralCursorX, muralCursorY, 0);
+      drawMuralCell(muralCursorX, muralCursorY);
+    }
+
+    for (auto i : status.word) {
+      // ESC or M - back to the canvas
+      if (i == '`' || i == 'm' || i == 'M') {
+        exitMuralView();
+        loopDelay(200);  // Debounce
+        return;
       }
-      else if (numColors == 8) {
-        // 8-color: single column, right-aligned
-        if (i == 0) {
-          // Top: mask both top corners
-          M5Cardputer.Display.fillRect(swatchX, swatchY, 2, 2, currentTheme->background);  // Top-left
-          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, 2, currentTheme->background);  // Top-right
-        }
-        else if (i == 7) {
-          // Bottom: mask both bottom corners
-          M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->background);  // Bottom-left
-          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->shadow);  // Bottom-right (shadow!)
-        }
-      } else {
-        // 16-color: two columns
-        if (i == 0) {
-          // Color 1 (index 0): top-left of left column - mask top-left corner
-          M5Cardputer.Display.fillRect(swatchX, swatchY, 2, 2, currentTheme->background);
-        }
-        else if (i == 7) {
-          // Color 8 (index 7): bottom-left of left column - mask bottom-left corner
-          M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->background);
-        }
-        else if (i == 8) {
-          // Color 9 (index 8): top-right of right column - mask top-right corner
-          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, 2, currentTheme->background);
-        }
-        else if (i == 15) {
-          // Color 16 (index 15): bottom-right of right column - mask bottom-right corner
-          M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY + PALETTE_SWATCH_SIZE - 2, 2, 2, currentTheme->shadow);  // Bottom-right (shadow!)
+      // V - overview (enter also picks the boxed area)
+      else if (i == 'v' || i == 'V') {
+        toggleMuralOverview();
+      }
+      // I - cache hit rate and pan times
+      else if (i == 'i' || i == 'I') {
+        uint32_t lookups = mural.stats.hits + mural.stats.misses;
+        char statsMsg[32];
+        snprintf(statsMsg, sizeof(statsMsg), StatusMsg::MURAL_STATS_FMT,
+                 (unsigned long)(lookups ? mural.stats.hits * 100ULL / lookups : 0),
+                 (unsigned long)(mural.stats.pans ? mural.stats.panTotalUs / mural.stats.pans / 1000 : 0),
+                 (unsigned long)(mural.stats.panMaxUs / 1000));
+        setStatusMessage(statsMsg);
+      }
+      // 1-8 (Fn: 9-16) and C - colors, as on the canvas
+      else if (i >= '1' && i <= '8') {
+        uint8_t newColor = status.fn ? (i - '0' + 8) : (i - '0');
+        if (newColor <= activeSketch.paletteSize && selectedColor != newColor) {
+          selectedColor = newColor;
+          drawPalette();
         }
       }
+      else if (i == 'c' || i == 'C') {
+        selectedColor = (selectedColor >= activeSketch.paletteSize) ? 1 : selectedColor + 1;
+        drawPalette();
+      }
+      else if (i == arrowKey) {
+        muralLastKey = i;
+        muralLastKeyTime = millis();
+        muralKeyRepeating = false;
+        moveMural(i, status.enter, status.del);
+      }
     }
-  }
 
-  // Draw selection indicator on the selected color
-  int selectedIndex = selectedColor - 1;
-  int col = (numColors <= 8) ? 0 : (selectedIndex / 8);
-  int row = (numColors <= 8) ? selectedIndex : (selectedIndex % 8);
+    // Enter in the overview jumps to the boxed area
+    if (muralOverview && status.enter) {
+      toggleMuralOverview();
+    }
+  }
 
-  int swatchX = startX + (col * PALETTE_SWATCH_SIZE);
-  int swatchY = GRID_Y + (row * PALETTE_SWATCH_SIZE);
+  // Key repeat while an arrow is held
+  if (arrowKey && arrowKey == muralLastKey) {
+    unsigned long elapsed = millis() - muralLastKeyTime;
+    unsigned long threshold = muralKeyRepeating ? keyRepeatRate : keyRepeatDelay;
+    if (elapsed >= threshold) {
+      muralKeyRepeating = true;
+      muralLastKeyTime = millis();
+      moveMural(arrowKey, status.enter, status.del);
+    }
+  } else if (!arrowKey) {
+    muralLastKey = 0;
+    muralKeyRepeating = false;
+  }
 
-  // Draw 2px black outline OUTSIDE the swatch
-  M5Cardputer.Display.fillRect(swatchX - 2, swatchY - 2, PALETTE_SWATCH_SIZE + 4, 2, TFT_BLACK);  // Top
-  M5Cardputer.Display.fillRect(swatchX - 2, swatchY + PALETTE_SWATCH_SIZE, PALETTE_SWATCH_SIZE + 4, 2, TFT_BLACK);  // Bottom
-  M5Cardputer.Display.fillRect(swatchX - 2, swatchY - 2, 2, PALETTE_SWATCH_SIZE + 4, TFT_BLACK);  // Left
-  M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE, swatchY - 2, 2, PALETTE_SWATCH_SIZE + 4, TFT_BLACK);  // Right
+#if ENABLE_BLUETOOTH
+  static bool btPrevEscMural = false;
+  if (btEscape && !btPrevEscMural) {
+    btPrevEscMural = btEscape;
+    exitMuralView();
+    return;
+  }
+  btPrevEscMural = btEscape;
+#endif
 
-  // Draw 2px light inset INSIDE the swatch (right against the edge)
-  M5Cardputer.Display.fillRect(swatchX, swatchY, PALETTE_SWATCH_SIZE, 2, currentTheme->iconLight);  // Top
-  M5Cardputer.Display.fillRect(swatchX, swatchY + PALETTE_SWATCH_SIZE - 2, PALETTE_SWATCH_SIZE, 2, currentTheme->iconLight);  // Bottom
-  M5Cardputer.Display.fillRect(swatchX, swatchY, 2, PALETTE_SWATCH_SIZE, currentTheme->iconLight);  // Left
-  M5Cardputer.Display.fillRect(swatchX + PALETTE_SWATCH_SIZE - 2, swatchY, 2, PALETTE_SWATCH_SIZE, currentTheme->iconLight);  // Right
+  drawMuralStatus();
 }
 
 // ============================================================================
-// DRAW MEMORY VIEW GRID - Vertical scrolling (NEW VERSION)
-// 4 columns, vertical scrolling through rows
+// LIBRARY ARCHIVE (A / Fn+A in memory view)
 // ============================================================================
-void drawMemoryViewGrid(bool fullRedraw = true) {
-  const int COLS = 4;         // 4 columns across
-  const int thumbSize = 48;   // Each thumbnail is 48×48 pixels
-  const int thumbGap = 8;     // Gap between thumbnails horizontally
-  const int rowGap = 8;       // Gap between rows vertically
-  const int titleHeight = 14; // Height of title area
-  const int titleGap = 5;     // Gap between title and first row
+// Backs the whole library up into one file, /bitmap16dx/backups/library_NNN.b16a,
+// and restores the newest one. After the "B16A" header and version byte the
+// file is one range-coded stream (LZMA-style adaptive binary coder, 11-bit
+// probabilities). Per sketch: its ID, grid size, palette and 16×16 cells.
+// Palettes go into a shared dictionary, so each sketch stores a reference to
+// one instead of 16 colors. Each cell is coded in up to three steps: whether
+// it's occupied (context: its left, up, up-left and up-right neighbours are
+// occupied, and whether it's inside the grid), whether it repeats its left or
+// up neighbour, and only then its 4-bit index. The model keeps learning across
+// sketches. Restoring writes normal v3 sketch files and leaves sketches whose
+// ID already exists alone.
+
+const char ARCHIVE_MAGIC[4] = {'B', '1', '6', 'A'};
+const uint8_t ARCHIVE_VERSION = 1;
+const int ARCHIVE_MAX_PALETTES = 256;      // Dictionary size; further palettes are stored inline
+const size_t ARCHIVE_IO_SIZE = 512;        // File buffer for the coder
+const int RC_PROB_BITS = 11;
+const uint16_t RC_PROB_INIT = 1 << (RC_PROB_BITS - 1);
+const int RC_MOVE_BITS = 5;                // Adaptation rate
+const uint32_t RC_TOP = 1UL << 24;
+
+struct ArchivePalette {
+  uint8_t size;
+  uint16_t colors[16];
+};
 
-  // Total items = 1 (create new button) + number of sketches
-  int totalItems = 1 + sketchList.size();
+// Adaptive probabilities (of a 0 bit)
+struct ArchiveModel {
+  uint16_t more;             // Another sketch follows
+  uint16_t bigGrid;          // 16×16 rather than 8×8
+  uint16_t samePalette;      // Same palette as the previous sketch
+  uint16_t knownPalette;     // Palette already in the dictionary
+  uint16_t occupied[2][16];  // [inside grid][left | up << 1 | up-left << 2 | up-right << 3 occupied]
+  uint16_t sameLeft[3];      // [up empty / up differs from left / up equals left]
+  uint16_t sameUp[2];        // [up-left equals up]
+  uint16_t index[16];        // Bit tree over index - 1
+};
 
-  // Calculate which column and row the cursor is in (4 columns)
-  int cursorCol = memoryViewCursor % COLS;
-  int cursorRow = memoryViewCursor / COLS;
+// Everything both directions keep in step
+struct ArchiveState {
+  ArchiveModel model;
+  ArchivePalette* palettes;  // Dictionary (ARCHIVE_MAX_PALETTES)
+  int paletteCount;
+  int lastPalette;           // Dictionary entry of the previous sketch (-1 if none)
+};
 
-  // Vertical scrolling logic: scroll to keep cursor row visible
-  const int topMargin = 5;     // Small margin at screen top
-  const int bottomMargin = 5;  // Space at bottom of screen
-  const int itemHeight = thumbSize + rowGap;
+struct ArchiveEncoder {
+  uint64_t low;
+  uint32_t range;
+  uint8_t cache;
+  uint32_t cacheSize;
+  uint8_t* out;              // Output buffer; flushed to file when it fills (if open)
+  size_t outSize;
+  size_t outPos;
+  File file;
+  uint32_t bytes;            // Total bytes produced
+  bool ok;
+};
 
-  // Calculate cursor position with current TARGET scroll offset
-  // Grid starts at: titleHeight + topMargin (title at 0, then topMargin gap)
-  int gridStartY = titleHeight + topMargin;
-  int cursorScreenY = gridStartY + (cursorRow * itemHeight) - memoryViewScrollOffset;
+struct ArchiveDecoder {
+  uint32_t range;
+  uint32_t code;
+  const uint8_t* in;         // Input; refilled from file when used up (if open)
+  uint8_t* buffer;
+  size_t inLen;
+  size_t inPos;
+  File file;
+  uint32_t bytes;            // Total bytes consumed
+  bool ok;                   // False once the input ran out
+};
 
-  // Define scrolling bounds (area where cursor should stay visible)
-  // When on first row, we want to scroll back to show the title (scroll offset = 0)
-  // So top bound should be where the first row naturally sits when title is visible
-  int topBound = titleHeight + topMargin;  // Allow room for title above
-  int bottomBound = 135 - bottomMargin - thumbSize;
+void initArchiveState(ArchiveState& st) {
+  uint16_t* probs = (uint16_t*)&st.model;
+  for (size_t i = 0; i < sizeof(ArchiveModel) / sizeof(uint16_t); i++) {
+    probs[i] = RC_PROB_INIT;
+  }
+  st.paletteCount = 0;
+  st.lastPalette = -1;
+}
 
-  // Adjust TARGET scroll offset to keep cursor in bounds
-  if (cursorScreenY > bottomBound) {
-    // Cursor is past bottom edge - scroll up (increase offset)
-    memoryViewScrollOffset += (cursorScreenY - bottomBound);
-  } else if (cursorScreenY < topBound) {
-    // Cursor is past top edge - scroll down (decrease offset)
-    memoryViewScrollOffset -= (topBound - cursorScreenY);
+void archiveFlushOutput(ArchiveEncoder& rc) {
+  if (rc.file && rc.outPos > 0) {
+    rc.ok = rc.file.write(rc.out, rc.outPos) == rc.outPos && rc.ok;
+    rc.outPos = 0;
   }
+}
 
-  // Clamp scroll offset to reasonable bounds
-  int totalRows = (totalItems + COLS - 1) / COLS;  // Ceiling division
-  int totalContentHeight = titleHeight + topMargin + (totalRows * thumbSize) + ((totalRows - 1) * rowGap);
-  int visibleHeight = 135 - bottomMargin;  // Can scroll from 0 to bottom
-  int maxScroll = max(0, totalContentHeight - visibleHeight);
+void archivePutByte(ArchiveEncoder& rc, uint8_t b) {
+  if (rc.outPos == rc.outSize) {
+    if (!rc.file) {
+      rc.ok = false;  // Memory output is full
+      return;
+    }
+    archiveFlushOutput(rc);
+  }
+  rc.out[rc.outPos++] = b;
+  rc.bytes++;
+}
 
-  if (memoryViewScrollOffset < 0) memoryViewScrollOffset = 0;
-  if (memoryViewScrollOffset > maxScroll) memoryViewScrollOffset = maxScroll;
+void archiveShiftLow(ArchiveEncoder& rc) {
+  if ((uint32_t)rc.low < 0xFF000000UL || (rc.low >> 32) != 0) {
+    uint8_t carry = rc.low >> 32;
+    uint8_t temp = rc.cache;
+    do {
+      archivePutByte(rc, temp + carry);
+      temp = 0xFF;
+    } while (--rc.cacheSize != 0);
+    rc.cache = (rc.low >> 24) & 0xFF;
+  }
+  rc.cacheSize++;
+  rc.low = (rc.low & 0x00FFFFFF) << 8;
+}
 
-  // Smooth animation: interpolate actual scroll position towards target
-  float targetPos = (float)memoryViewScrollOffset;
-  float diff = targetPos - memoryViewScrollPos;
+void initArchiveEncoder(ArchiveEncoder& rc, uint8_t* out, size_t outSize) {
+  rc.low = 0;
+  rc.range = 0xFFFFFFFF;
+  rc.cache = 0;
+  rc.cacheSize = 1;
+  rc.out = out;
+  rc.outSize = outSize;
+  rc.outPos = 0;
+  rc.bytes = 0;
+  rc.ok = true;
+}
 
-  if (fabs(diff) > 0.5f) {
-    // Smoothly animate towards target
-    memoryViewScrollPos += diff * MEMORY_SCROLL_SPEED;
-  } else {
-    // Close enough - snap to target
-    memoryViewScrollPos = targetPos;
+void finishArchiveEncoder(ArchiveEncoder& rc) {
+  for (int i = 0; i < 5; i++) {
+    archiveShiftLow(rc);
   }
+  archiveFlushOutput(rc);
+}
 
-  // Calculate title Y position (scrolls with content)
-  // Title starts at 0 (to match PALETTES position), not topMargin
-  int titleY = 0 - (int)memoryViewScrollPos;
+uint8_t archiveGetByte(ArchiveDecoder& rc) {
+  if (rc.inPos == rc.inLen) {
+    if (rc.file) {
+      rc.inLen = rc.file.read(rc.buffer, ARCHIVE_IO_SIZE);
+      rc.inPos = 0;
+      rc.in = rc.buffer;
+    }
+    if (rc.inPos == rc.inLen) {
+      rc.ok = false;
+      return 0;
+    }
+  }
+  rc.bytes++;
+  return rc.in[rc.inPos++];
+}
 
-  // Calculate base Y (where row 0 starts) using animated scroll position
-  // Grid starts after title, with topMargin acting as the gap
-  int baseY = titleHeight + topMargin - (int)memoryViewScrollPos;
+void initArchiveDecoder(ArchiveDecoder& rc, const uint8_t* in, size_t inLen) {
+  rc.in = in;
+  rc.inLen = inLen;
+  rc.inPos = 0;
+  rc.bytes = 0;
+  rc.ok = true;
+  rc.range = 0xFFFFFFFF;
+  rc.code = 0;
+  archiveGetByte(rc);  // Always 0 (the encoder's first cache byte)
+  for (int i = 0; i < 4; i++) {
+    rc.code = (rc.code << 8) | archiveGetByte(rc);
+  }
+}
 
-  // Calculate column X positions (horizontally centered)
-  // Total width: 4 columns × 48px + 3 gaps × 7px = 213px
-  int totalWidth = (COLS * thumbSize) + ((COLS - 1) * thumbGap);
-  int startX = (240 - totalWidth) / 2;
+// Coding primitives, overloaded so codeArchiveSketch() serves both directions:
+// the encoder writes the value it's given, the decoder ignores it and returns
+// what it read.
 
-  // Create canvas for entire screen to eliminate tearing
-  // Memory required: 240×135×2 = 64,800 bytes (~64KB)
-  if (!memoryCanvas.createSprite(240, 135)) {
-    // Memory allocation failed - show warning once to prevent flashing
-    static bool memoryErrorShown = false;
-    if (!memoryErrorShown) {
-      M5Cardputer.Display.fillScreen(currentTheme->background);
-      M5Cardputer.Display.setTextColor(TFT_RED);
-      M5Cardputer.Display.setCursor(10, 50);
-      M5Cardputer.Display.println("WARNING: Low memory!");
-      M5Cardputer.Display.setCursor(10, 65);
-      M5Cardputer.Display.println("Cannot display sketches.");
-      M5Cardputer.Display.setCursor(10, 85);
-      M5Cardputer.Display.setTextColor(currentTheme->text);
-      M5Cardputer.Display.println("Press ESC (`) to exit");
-      M5Cardputer.Display.setCursor(10, 100);
-      M5Cardputer.Display.println("Restart device to recover");
-      memoryErrorShown = true;
+bool archiveEncoding(ArchiveEncoder&) { return true; }
+bool archiveEncoding(ArchiveDecoder&) { return false; }
+
+int codeBit(ArchiveEncoder& rc, uint16_t& prob, int bit) {
+  uint32_t bound = (rc.range >> RC_PROB_BITS) * prob;
+  if (!bit) {
+    rc.range = bound;
+    prob += ((1 << RC_PROB_BITS) - prob) >> RC_MOVE_BITS;
+  } else {
+    rc.low += bound;
+    rc.range -= bound;
+    prob -= prob >> RC_MOVE_BITS;
+  }
+  while (rc.range < RC_TOP) {
+    rc.range <<= 8;
+    archiveShiftLow(rc);
+  }
+  return bit;
+}
+
+int codeBit(ArchiveDecoder& rc, uint16_t& prob, int) {
+  uint32_t bound = (rc.range >> RC_PROB_BITS) * prob;
+  int bit;
+  if (rc.code < bound) {
+    rc.range = bound;
+    prob += ((1 << RC_PROB_BITS) - prob) >> RC_MOVE_BITS;
+    bit = 0;
+  } else {
+    rc.code -= bound;
+    rc.range -= bound;
+    prob -= prob >> RC_MOVE_BITS;
+    bit = 1;
+  }
+  while (rc.range < RC_TOP) {
+    rc.range <<= 8;
+    rc.code = (rc.code << 8) | archiveGetByte(rc);
+  }
+  return bit;
+}
+
+// Fixed-probability bits, most significant first
+uint32_t codeDirect(ArchiveEncoder& rc, uint32_t value, int bits) {
+  for (int i = bits - 1; i >= 0; i--) {
+    rc.range >>= 1;
+    if ((value >> i) & 1) {
+      rc.low += rc.range;
+    }
+    while (rc.range < RC_TOP) {
+      rc.range <<= 8;
+      archiveShiftLow(rc);
     }
-    return;  // Skip drawing this frame, but allow keyboard handling
   }
-  memoryCanvas.fillSprite(currentTheme->background);
+  return value;
+}
 
-  // Draw title to canvas (scrollable position)
-  if (titleY > -titleHeight && titleY < 135) {  // Only draw if at least partially visible
-    memoryCanvas.setTextColor(currentTheme->text);
-    memoryCanvas.setTextSize(1);
-    memoryCanvas.setCursor(4, titleY + 4);
-    memoryCanvas.print("SKETCHES");
+uint32_t codeDirect(ArchiveDecoder& rc, uint32_t, int bits) {
+  uint32_t value = 0;
+  for (int i = 0; i < bits; i++) {
+    rc.range >>= 1;
+    uint32_t bit = rc.code >= rc.range;
+    if (bit) {
+      rc.code -= rc.range;
+    }
+    value = (value << 1) | bit;
+    while (rc.range < RC_TOP) {
+      rc.range <<= 8;
+      rc.code = (rc.code << 8) | archiveGetByte(rc);
+    }
   }
+  return value;
+}
 
-  // Draw all items in grid layout
-  for (int itemIndex = 0; itemIndex < totalItems; itemIndex++) {
-    int col = itemIndex % COLS;
-    int row = itemIndex / COLS;
+// Adaptive bit tree (probs needs 1 << bits entries), most significant bit first
+template <typename Coder>
+uint32_t codeTree(Coder& rc, uint16_t* probs, uint32_t value, int bits) {
+  uint32_t node = 1;
+  for (int i = bits - 1; i >= 0; i--) {
+    node = (node << 1) | codeBit(rc, probs[node], (value >> i) & 1);
+  }
+  return node - (1 << bits);
+}
 
-    int screenX = startX + (col * (thumbSize + thumbGap));
-    int screenY = baseY + (row * (thumbSize + rowGap));
+/**
+ * Dictionary entry holding a sketch's palette, or -1
+ */
+int findArchivePalette(const ArchiveState& st, const Sketch& sketch) {
+  for (int i = 0; i < st.paletteCount; i++) {
+    const ArchivePalette& p = st.palettes[i];
+    if (p.size == sketch.paletteSize && memcmp(p.colors, sketch.paletteColors, sizeof(p.colors)) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
 
-    // Only draw if thumbnail is at least partially visible on screen
-    if (screenY < -thumbSize - 10 || screenY > 135 + 10) {
-      continue;  // Skip off-screen thumbnails
+/**
+ * Code one sketch record (encoder: from id/sketch; decoder: into them)
+ */
+template <typename Coder>
+void codeArchiveSketch(Coder& rc, ArchiveState& st, uint32_t& id, Sketch& sketch) {
+  ArchiveModel& m = st.model;
+
+  // ID: bit count, then the bits
+  int idBits = 0;
+  while (idBits < 32 && (id >> idBits) != 0) {
+    idBits++;
+  }
+  idBits = codeDirect(rc, idBits, 6);
+  id = codeDirect(rc, id, idBits);
+
+  sketch.gridSize = codeBit(rc, m.bigGrid, sketch.gridSize == 16) ? 16 : 8;
+
+  // Palette: the previous sketch's, a dictionary entry, or a new one
+  int entry = archiveEncoding(rc) ? findArchivePalette(st, sketch) : -1;
+  if (codeBit(rc, m.samePalette, entry >= 0 && entry == st.lastPalette)) {
+    entry = st.lastPalette;
+  } else if (codeBit(rc, m.knownPalette, entry >= 0)) {
+    entry = codeDirect(rc, entry, 8);
+  } else {
+    sketch.paletteSize = codeDirect(rc, sketch.paletteSize, 5);
+    for (int i = 0; i < 16; i++) {
+      sketch.paletteColors[i] = codeDirect(rc, sketch.paletteColors[i], 16);
+    }
+    entry = -1;
+    if (st.paletteCount < ARCHIVE_MAX_PALETTES) {
+      entry = st.paletteCount++;
+      st.palettes[entry].size = sketch.paletteSize;
+      memcpy(st.palettes[entry].colors, sketch.paletteColors, sizeof(sketch.paletteColors));
     }
+  }
+  if (entry >= 0 && entry < st.paletteCount) {
+    sketch.paletteSize = st.palettes[entry].size;
+    memcpy(sketch.paletteColors, st.palettes[entry].colors, sizeof(sketch.paletteColors));
+  }
+  st.lastPalette = entry;
 
-    if (itemIndex == 0) {
-      // First item is the "create new" button
-      drawCreateNewSketchThumbnail(screenX, screenY, thumbSize);
-    } else {
-      // Subsequent items are sketches (using cached data!)
-      drawSketchThumbnail(itemIndex - 1, screenX, screenY, thumbSize);
+  // Cells in raster order, predicted from the ones already coded
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      uint8_t left = x > 0 ? sketch.pixels[y][x - 1] : 0;
+      uint8_t up = y > 0 ? sketch.pixels[y - 1][x] : 0;
+      uint8_t upLeft = (x > 0 && y > 0) ? sketch.pixels[y - 1][x - 1] : 0;
+      uint8_t upRight = (x < 15 && y > 0) ? sketch.pixels[y - 1][x + 1] : 0;
+      int context = (left != 0) | (up != 0) << 1 | (upLeft != 0) << 2 | (upRight != 0) << 3;
+      bool inside = x < sketch.gridSize && y < sketch.gridSize;
+
+      uint8_t value = sketch.pixels[y][x];
+      if (!codeBit(rc, m.occupied[inside][context], value != 0)) {
+        value = 0;
+      } else if (left && codeBit(rc, m.sameLeft[!up ? 0 : (up == left ? 2 : 1)], value == left)) {
+        value = left;
+      } else if (up && up != left && codeBit(rc, m.sameUp[upLeft == up], value == up)) {
+        value = up;
+      } else {
+        value = 1 + codeTree(rc, m.index, value - 1, 4);
+      }
+      sketch.pixels[y][x] = value;
     }
   }
+  sketch.isEmpty = false;
+}
 
-  // Draw breathing cursor AFTER all thumbnails (ensures cursor is on top)
-  int cursorX = startX + (cursorCol * (thumbSize + thumbGap));
-  int cursorY = baseY + (cursorRow * (thumbSize + rowGap));
+/**
+ * Whether every cell is an index the format can hold (0-16)
+ */
+bool archivableSketch(const Sketch& sketch) {
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      if (sketch.pixels[y][x] > 16) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-  // Only draw cursor if it's visible on screen
-  if (cursorY >= -thumbSize - 10 && cursorY <= 135 + 10) {
-    drawMemoryViewCursor(memoryViewCursor, cursorX, cursorY, thumbSize);
+struct ArchiveJob {
+  bool restoring;
+  char path[40];             // Archive file
+  File root;                 // Library walk (archiving)
+  File shard;
+  ArchiveState state;
+  ArchiveEncoder enc;
+  ArchiveDecoder dec;
+  uint32_t sketches;         // Archived, or restored
+  uint32_t kept;             // Restore: IDs that already existed
+  uint32_t rawBytes;         // Archive: size of the sketch files read
+  uint32_t maxId;
+  unsigned long lastId;      // Archive: sketch counter, for progress by shard
+  uint8_t* io;               // ARCHIVE_IO_SIZE
+};
+
+/**
+ * Free an archive job's buffers and close its files
+ */
+void closeArchiveJob(ArchiveJob* ar) {
+  ar->root.close();
+  ar->shard.close();
+  ar->enc.file.close();
+  ar->dec.file.close();
+  scopedFree(ar->state.palettes, ARCHIVE_MAX_PALETTES * sizeof(ArchivePalette));
+  scopedFree(ar->io, ARCHIVE_IO_SIZE);
+}
+
+/**
+ * Archive the next library entry (one directory entry per step)
+ */
+JobState archiveStep(Job& job) {
+  ArchiveJob* ar = (ArchiveJob*)job.context;
+  if (!ar->shard) {
+    ar->shard = ar->root.openNextFile();
+    if (!ar->shard) {
+      // End marker, then the coder's tail
+      uint16_t& more = ar->state.model.more;
+      codeBit(ar->enc, more, 0);
+      finishArchiveEncoder(ar->enc);
+      return ar->enc.ok ? JOB_DONE : JOB_FAILED;
+    }
+    if (!ar->shard.isDirectory()) {
+      ar->shard.close();
+    }
+    return JOB_RUNNING;
+  }
+
+  File file = ar->shard.openNextFile();
+  if (!file) {
+    ar->shard.close();
+    return JOB_RUNNING;
+  }
+  if (!file.isDirectory()) {
+    uint32_t id = sketchIdFromFilename(fileBaseName(file));
+    SketchFileIndex index;
+    Sketch sketch;
+    if (id > 0 && readSketchFileIndex(file, index) && readSketchFull(file, index, sketch) &&
+        archivableSketch(sketch)) {
+      ar->rawBytes += file.size();
+      codeBit(ar->enc, ar->state.model.more, 1);
+      codeArchiveSketch(ar->enc, ar->state, id, sketch);
+      ar->sketches++;
+    }
+    if (id > 0 && ar->lastId > 0) {
+      job.progress = min(99UL, id / SKETCHES_PER_SHARD * 100 / (ar->lastId / SKETCHES_PER_SHARD + 1));
+    }
   }
+  file.close();
+  return ar->enc.ok ? JOB_RUNNING : JOB_FAILED;
+}
 
-  // Draw status message at bottom if one exists
-  if (statusMessage[0] != '\0' && (millis() - statusMessageTime < STATUS_DISPLAY_DURATION)) {
-    memoryCanvas.setTextColor(currentTheme->text);
-    memoryCanvas.setTextSize(1);
-    memoryCanvas.setCursor(3, 124);
-    memoryCanvas.print(statusMessage);
+/**
+ * Restore the next sketch in the archive
+ */
+JobState restoreStep(Job& job) {
+  ArchiveJob* ar = (ArchiveJob*)job.context;
+  if (!codeBit(ar->dec, ar->state.model.more, 0)) {
+    return ar->dec.ok ? JOB_DONE : JOB_FAILED;
+  }
+  uint32_t id = 0;
+  Sketch sketch;
+  codeArchiveSketch(ar->dec, ar->state, id, sketch);
+  if (!ar->dec.ok || id == 0) {
+    return JOB_FAILED;  // Truncated or corrupt
+  }
+
+  String path = sketchPath("sketch_" + String(id) + ".dat");
+  if (SD.exists(path.c_str())) {
+    ar->kept++;
+  } else if (ensureSketchShard(id) && writeSketchFile(path.c_str(), sketch)) {
+    ar->sketches++;
+    ar->maxId = max(ar->maxId, id);
+  } else {
+    return JOB_FAILED;
   }
+  job.progress = ar->dec.file ? ar->dec.file.position() * 100 / max((size_t)1, ar->dec.file.size()) : 0;
+  return JOB_RUNNING;
+}
 
-  // Push entire canvas to display at (0, 0) to eliminate tearing
-  memoryCanvas.pushSprite(0, 0);
-  memoryCanvas.deleteSprite();
+void archiveFinish(Job& job, JobState state) {
+  ArchiveJob* ar = (ArchiveJob*)job.context;
+  bool wroteArchive = !ar->restoring && ar->enc.file;
+  closeArchiveJob(ar);
+
+  char msg[32];
+  if (ar->restoring) {
+    if (ar->maxId > loadSketchCounter()) {
+      storeSketchCounter(ar->maxId);  // New saves mustn't reuse restored IDs
+    }
+    if (state == JOB_DONE) {
+      snprintf(msg, sizeof(msg), StatusMsg::RESTORED_FMT, (unsigned long)ar->sketches, (unsigned long)ar->kept);
+      setStatusMessage(msg);
+    } else if (state == JOB_FAILED) {
+      setStatusMessage(StatusMsg::FILE_CORRUPT);
+    }
+    if (inMemoryView && ar->sketches > 0) {
+      startSketchScan(memoryScan, activeCollection);  // Show the restored sketches
+    }
+  } else if (state == JOB_DONE) {
+    // Ratio against the sketch files, one decimal
+    uint32_t tenths = ar->enc.bytes ? (uint64_t)ar->rawBytes * 10 / ar->enc.bytes : 0;
+    snprintf(msg, sizeof(msg), StatusMsg::ARCHIVED_FMT, (unsigned long)ar->sketches,
+             (unsigned long)(tenths / 10), (unsigned long)(tenths % 10));
+    setStatusMessage(msg);
+  } else {
+    if (wroteArchive) {
+      SD.remove(ar->path);  // Don't leave a partial backup behind
+    }
+    if (state == JOB_FAILED) {
+      setStatusMessage(StatusMsg::WRITE_FAIL);
+    }
+  }
+  delete ar;
 }
 
-// Helper function to draw a single memory sketch thumbnail (OBSOLETE - kept for compatibility)
-// Now replaced by drawCreateNewSketchThumbnail() and drawSketchThumbnail()
-void drawMemorySketchThumbnail(int sketchIndex, int x, int y, int thumbSize) {
-  // OBSOLETE: This function is no longer used in the unlimited sketches system
-  // It's kept as a stub to avoid breaking any remaining references
-  // The memory view now uses drawCreateNewSketchThumbnail() and drawSketchThumbnail()
+/**
+ * Allocate a job with an initialized model and dictionary
+ */
+ArchiveJob* newArchiveJob(bool restoring) {
+  ArchiveJob* ar = new ArchiveJob();
+  if (!ar) {
+    return nullptr;
+  }
+  ar->restoring = restoring;
+  ar->state.palettes = (ArchivePalette*)scopedAlloc(ARCHIVE_MAX_PALETTES * sizeof(ArchivePalette));
+  ar->io = (uint8_t*)scopedAlloc(ARCHIVE_IO_SIZE);
+  if (!ar->state.palettes || !ar->io) {
+    closeArchiveJob(ar);
+    delete ar;
+    return nullptr;
+  }
+  initArchiveState(ar->state);
+  return ar;
 }
 
-// Helper function to draw "+" create new sketch button
-void drawCreateNewSketchThumbnail(int x, int y, int thumbSize) {
-  // Draw dashed outline
-  uint16_t outlineColor = currentTheme->cellDark;
-  const int cutSize = 2;
-  const int dashLength = 4;
-  const int gapLength = 4;
+/**
+ * Newest archive in the backups folder
+ * @return false if there is none
+ */
+bool findNewestArchive(char* path, size_t pathSize) {
+  File dir = SD.open(BACKUP_DIR);
+  if (!dir) {
+    return false;
+  }
+  int newest = -1;
+  File entry;
+  while ((entry = dir.openNextFile())) {
+    int number;
+    String name = fileBaseName(entry);
+    if (!entry.isDirectory() && sscanf(name.c_str(), "library_%d.b16a", &number) == 1) {
+      newest = max(newest, number);
+    }
+    entry.close();
+  }
+  dir.close();
+  if (newest < 0) {
+    return false;
+  }
+  snprintf(path, pathSize, "%s/library_%03d.b16a", BACKUP_DIR, newest);
+  return true;
+}
 
-  // Draw dotted outline - 2px thick
-  // Top edge (skip corners)
-  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
-    int len = min(dashLength, thumbSize - cutSize - i);
-    memoryCanvas.fillRect(x + i, y, len, 2, outlineColor);
+/**
+ * Archive the library (restore = false) or restore the newest archive, as a
+ * background job (ESC cancels)
+ * @return true if the job started
+ */
+bool startLibraryArchive(bool restore) {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
   }
-  // Bottom edge (skip corners)
-  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
-    int len = min(dashLength, thumbSize - cutSize - i);
-    memoryCanvas.fillRect(x + i, y + thumbSize - 2, len, 2, outlineColor);
+  ArchiveJob* ar = newArchiveJob(restore);
+  if (!ar) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
   }
-  // Left edge (skip corners)
-  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
-    int len = min(dashLength, thumbSize - cutSize - i);
-    memoryCanvas.fillRect(x, y + i, 2, len, outlineColor);
+
+  bool ok;
+  if (restore) {
+    uint8_t header[5];
+    ok = findNewestArchive(ar->path, sizeof(ar->path));
+    if (!ok) {
+      setStatusMessage(StatusMsg::NO_BACKUPS);
+    } else {
+      ar->dec.file = SD.open(ar->path, FILE_READ);
+      ar->dec.buffer = ar->io;
+      ok = ar->dec.file && ar->dec.file.read(header, sizeof(header)) == sizeof(header) &&
+           memcmp(header, ARCHIVE_MAGIC, 4) == 0 && header[4] == ARCHIVE_VERSION;
+      if (ok) {
+        initArchiveDecoder(ar->dec, ar->io, 0);
+      } else {
+        setStatusMessage(StatusMsg::FILE_CORRUPT);
+      }
+    }
+  } else {
+    int number = 0;
+    do {
+      snprintf(ar->path, sizeof(ar->path), "%s/library_%03d.b16a", BACKUP_DIR, number++);
+    } while (SD.exists(ar->path) && number < 1000);
+    ar->root = SD.open(sketchRoot);
+    ar->lastId = loadSketchCounter();
+    ok = (SD.exists(BACKUP_DIR) || SD.mkdir(BACKUP_DIR)) && ar->root && !SD.exists(ar->path);
+    if (ok) {
+      ar->enc.file = SD.open(ar->path, FILE_WRITE);
+      ok = ar->enc.file && ar->enc.file.write((const uint8_t*)ARCHIVE_MAGIC, 4) == 4 &&
+           ar->enc.file.write(&ARCHIVE_VERSION, 1) == 1;
+      initArchiveEncoder(ar->enc, ar->io, ARCHIVE_IO_SIZE);
+    }
+    if (!ok) {
+      if (ar->enc.file) {
+        ar->enc.file.close();
+        SD.remove(ar->path);
+      }
+      setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+    }
   }
-  // Right edge (skip corners)
-  for (int i = cutSize; i < thumbSize - cutSize; i += dashLength + gapLength) {
-    int len = min(dashLength, thumbSize - cutSize - i);
-    memoryCanvas.fillRect(x + thumbSize - 2, y + i, 2, len, outlineColor);
+
+  if (!ok || !startJob(restore ? "Restore" : "Archive", restore ? restoreStep : archiveStep, archiveFinish, ar)) {
+    closeArchiveJob(ar);
+    delete ar;
+    return false;
   }
+  return true;
+}
 
-  // Draw "+" symbol in center
-  int centerX = x + thumbSize / 2;
-  int centerY = y + thumbSize / 2;
-  int plusSize = 15;
-  int plusThickness = 3;
+#if ENABLE_LED_MATRIX
+// ============================================================================
+// LED MATRIX FUNCTIONS (8×8 WS2812 RGB LEDs)
+// ============================================================================
 
-  memoryCanvas.fillRect(centerX - plusThickness/2, centerY - plusSize/2,
-                        plusThickness, plusSize, currentTheme->text);
-  memoryCanvas.fillRect(centerX - plusSize/2, centerY - plusThickness/2,
-                        plusSize, plusThickness, currentTheme->text);
+// Built-in layouts (chain order). Units 0 and 3 sit upside down because of
+// the connector alignment, so they're rotated 180°.
+//   [Unit 0] [Unit 1]
+//   [Unit 3] [Unit 2]
+const LEDUnitPlacement LED_LAYOUT_SINGLE[] = {
+    {0, 0, 2, LED_MIRROR_NONE}
+};
+const LEDUnitPlacement LED_LAYOUT_QUAD[] = {
+    {0, 0, 2, LED_MIRROR_NONE}, {1, 0, 0, LED_MIRROR_NONE},
+    {1, 1, 0, LED_MIRROR_NONE}, {0, 1, 2, LED_MIRROR_NONE}
+};
+static_assert(sizeof(LED_LAYOUT_QUAD) / sizeof(LED_LAYOUT_QUAD[0]) <= LED_MAX_CHAIN_UNITS,
+              "LED_POWER_BUDGET_MA is too low to power the built-in 2x2 layout");
+
+/**
+ * Free the LED buffer and layout table (up to ~12KB + ~8KB for a large wall).
+ * The controller must already point elsewhere.
+ */
+void releaseLEDBuffers() {
+    scopedFree(ledIndexLUT, (size_t)ledWallWidth * ledWallHeight * sizeof(uint16_t));
+    scopedFree(leds, ledCount * sizeof(CRGB));
+    ledCount = 0;
+    ledWallWidth = 0;
+    ledWallHeight = 0;
 }
 
-// Helper function to draw sketch thumbnail using cached data
-void drawSketchThumbnail(int sketchIndex, int x, int y, int thumbSize) {
-  if (sketchIndex < 0 || sketchIndex >= sketchList.size()) {
-    return;
-  }
+/**
+ * Compile a unit layout into the flat wall → chain index lookup table and
+ * (re)size the LED buffer to match. The previous layout stays active if the
+ * description is invalid or memory runs out.
+ *
+ * @param units Unit placements in chain order
+ * @param unitCount Number of units on the chain
+ * @param gridW Wall width in units (1-8)
+ * @param gridH Wall height in units (1-8)
+ * @return true if the new layout is active
+ */
+bool compileLEDLayout(const LEDUnitPlacement* units, uint8_t unitCount, uint8_t gridW, uint8_t gridH) {
+    if (gridW < 1 || gridH < 1 || gridW > MAX_LED_WALL_UNITS || gridH > MAX_LED_WALL_UNITS) return false;
+    if (unitCount < 1 || unitCount > gridW * gridH || unitCount > LED_MAX_CHAIN_UNITS) return false;
+
+    // Every unit must be inside the grid, on its own slot
+    uint64_t usedSlots = 0;
+    for (uint8_t i = 0; i < unitCount; i++) {
+        const LEDUnitPlacement& u = units[i];
+        if (u.col >= gridW || u.row >= gridH || u.rotation > 3 || u.mirror > LED_MIRROR_V) return false;
+        uint64_t slotBit = 1ULL << (u.row * MAX_LED_WALL_UNITS + u.col);
+        if (usedSlots & slotBit) return false;
+        usedSlots |= slotBit;
+    }
+
+    uint16_t wallW = gridW * LED_UNIT_SIZE;
+    uint16_t wallH = gridH * LED_UNIT_SIZE;
+    uint16_t count = unitCount * LED_UNIT_SIZE * LED_UNIT_SIZE;
+
+    uint16_t* lut = (uint16_t*)scopedAlloc(wallW * wallH * sizeof(uint16_t));
+    CRGB* buffer = (CRGB*)scopedAlloc(count * sizeof(CRGB));
+    if (!lut || !buffer) {
+        scopedFree(lut, wallW * wallH * sizeof(uint16_t));
+        scopedFree(buffer, count * sizeof(CRGB));
+        return false;
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)wallW * wallH; i++) {
+        lut[i] = LED_NO_INDEX;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        buffer[i] = CRGB::Black;
+    }
+
+    for (uint8_t i = 0; i < unitCount; i++) {
+        const LEDUnitPlacement& u = units[i];
+        for (uint8_t ly = 0; ly < LED_UNIT_SIZE; ly++) {
+            for (uint8_t lx = 0; lx < LED_UNIT_SIZE; lx++) {
+                // Wall-local position → the unit's own row-major position
+                uint8_t x = (u.mirror == LED_MIRROR_H) ? 7 - lx : lx;
+                uint8_t y = (u.mirror == LED_MIRROR_V) ? 7 - ly : ly;
+                uint8_t nx, ny;
+                switch (u.rotation) {
+                    case 1:  nx = y;     ny = 7 - x; break;  // 90°
+                    case 2:  nx = 7 - x; ny = 7 - y; break;  // 180°
+                    case 3:  nx = 7 - y; ny = x;     break;  // 270°
+                    default: nx = x;     ny = y;     break;
+                }
+                uint16_t wallX = u.col * LED_UNIT_SIZE + lx;
+                uint16_t wallY = u.row * LED_UNIT_SIZE + ly;
+                lut[wallY * wallW + wallX] = i * 64 + ny * LED_UNIT_SIZE + nx;
+            }
+        }
+    }
 
-  SketchInfo& info = sketchList[sketchIndex];
+    // Swap in the new layout
+    if (ledController) {
+        ledController->setLeds(buffer, count);
+    }
+    releaseLEDBuffers();
+    ledIndexLUT = lut;
+    leds = buffer;
+    ledCount = count;
+    ledWallWidth = wallW;
+    ledWallHeight = wallH;
+    return true;
+}
+
+/**
+ * Load a wall layout description from LED_LAYOUT_PATH and compile it.
+ *
+ * Format (one directive per line, # starts a comment):
+ *   grid <units across> <units down>
+ *   unit <col> <row> [rotation 0|90|180|270] [mirror none|h|v]
+ * Units are listed in the order the data line reaches them.
+ *
+ * @return true if the layout was loaded and is now active
+ */
+bool loadLEDLayoutFromSD() {
+    if (!sdCardAvailable || !SD.exists(LED_LAYOUT_PATH)) {
+        setStatusMessage(StatusMsg::NO_LED_LAYOUT);
+        return false;
+    }
 
-  // Load data from SD if not already cached
-  if (!info.dataLoaded) {
-    String fullPath = "/bitmap16dx/sketches/" + info.filename;
-    File file = SD.open(fullPath.c_str(), FILE_READ);
+    File file = SD.open(LED_LAYOUT_PATH, FILE_READ);
     if (!file) {
-      setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
-      return;
+        setStatusMessage(StatusMsg::FILE_OPEN_FAIL);
+        return false;
+    }
+
+    LEDUnitPlacement units[MAX_LED_WALL_UNITS * MAX_LED_WALL_UNITS];
+    uint8_t unitCount = 0;
+    int gridW = 0, gridH = 0;
+    bool valid = true;
+
+    while (file.available() && valid) {
+        String line = file.readStringUntil('\n');
+        int comment = line.indexOf('#');
+        if (comment >= 0) line = line.substring(0, comment);
+        line.trim();
+        if (line.length() == 0) continue;
+
+        int col, row, degrees = 0;
+        char mirror[8] = "none";
+        if (line.startsWith("grid")) {
+            valid = sscanf(line.c_str(), "grid %d %d", &gridW, &gridH) == 2;
+        } else if (line.startsWith("unit")) {
+            int fields = sscanf(line.c_str(), "unit %d %d %d %7s", &col, &row, &degrees, mirror);
+            if (fields < 2 || unitCount >= MAX_LED_WALL_UNITS * MAX_LED_WALL_UNITS ||
+                col < 0 || row < 0 || degrees < 0 || degrees % 90 != 0) {
+                valid = false;
+                break;
+            }
+            LEDUnitPlacement& u = units[unitCount++];
+            u.col = col;
+            u.row = row;
+            u.rotation = (degrees / 90) % 4;
+            u.mirror = (mirror[0] == 'h') ? LED_MIRROR_H : (mirror[0] == 'v') ? LED_MIRROR_V : LED_MIRROR_NONE;
+        } else {
+            valid = false;
+        }
+    }
+    file.close();
+
+    if (valid && unitCount > LED_MAX_CHAIN_UNITS) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), StatusMsg::LED_TOO_MANY_UNITS_FMT, (unsigned)LED_MAX_CHAIN_UNITS);
+        setStatusMessage(msg);
+        return false;
+    }
+    if (!valid || !compileLEDLayout(units, unitCount, gridW, gridH)) {
+        setStatusMessage(StatusMsg::BAD_LED_LAYOUT);
+        return false;
     }
+    return true;
+}
 
-    // Verify file size and detect format version
-    size_t fileSize = file.size();
-    uint8_t formatVersion = 1;
+/**
+ * Activate the layout selected by rgbMatrixUnits (1, 4 or LED_LAYOUT_CUSTOM).
+ * Falls back to a single unit if the SD layout can't be used.
+ * While the matrix is off no layout is held, so its buffers are freed.
+ */
+void applyLEDLayout() {
+    stopLEDPlaylist();  // Its frames only fit the old layout
 
-    if (fileSize == SKETCH_FILE_SIZE_V2) {
-      // New format with version byte
-      formatVersion = file.read();
-      if (formatVersion != SKETCH_FORMAT_VERSION) {
-        file.close();
+    if (!ledMatrixEnabled) {
+        if (ledController && ledCount) {
+            // Blank the chain while there's still a buffer to send
+            FastLED.clear();
+            FastLED.show();
+            ledController->setLeds(nullptr, 0);
+        }
+        releaseLEDBuffers();
         return;
-      }
-    } else if (fileSize == SKETCH_FILE_SIZE_V1) {
-      // Legacy format without version byte
-      formatVersion = 1;
+    }
+    if (rgbMatrixUnits == LED_LAYOUT_CUSTOM && loadLEDLayoutFromSD()) {
+        return;
+    }
+    if (rgbMatrixUnits == 4) {
+        compileLEDLayout(LED_LAYOUT_QUAD, 4, 2, 2);
     } else {
-      // Invalid file size
-      file.close();
-      return;
+        compileLEDLayout(LED_LAYOUT_SINGLE, 1, 1, 1);
     }
+}
+
+/**
+ * Convert RGB565 color to RGB888 for WS2812 LEDs.
+ * RGB565: 5 bits red, 6 bits green, 5 bits blue (16-bit)
+ * RGB888: 8 bits per channel (24-bit)
+ * This expands the color depth from 65K to 16.7M colors.
+ */
+CRGB rgb565ToRGB888(uint16_t rgb565) {
+    uint8_t r = ((rgb565 >> 11) & 0x1F) * 255 / 31;  // 5-bit → 8-bit
+    uint8_t g = ((rgb565 >> 5) & 0x3F) * 255 / 63;   // 6-bit → 8-bit
+    uint8_t b = (rgb565 & 0x1F) * 255 / 31;          // 5-bit → 8-bit
+    return CRGB(r, g, b);
+}
 
-    // Read sketch data into cache
-    info.sketchData.gridSize = file.read();
-    info.sketchData.paletteSize = file.read();
+/**
+ * Send the LED buffer to the matrix, dimming the frame if its estimated
+ * current would exceed the power budget. Use this instead of FastLED.show()
+ * whenever the buffer contains lit LEDs.
+ */
+void showLEDMatrix() {
+    uint8_t requested = (ledBrightness * 255) / 100;
+    uint32_t channelSum = sumLEDChannels(leds, ledCount);
 
-    for (int i = 0; i < 16; i++) {
-      uint8_t high = file.read();
-      uint8_t low = file.read();
-      info.sketchData.paletteColors[i] = (high << 8) | low;
+    ledAppliedBrightness = budgetLEDBrightness(channelSum, ledCount, requested);
+    ledEstimatedMA = estimateLEDCurrentMA(channelSum, ledCount, ledAppliedBrightness);
+    FastLED.show(ledAppliedBrightness);
+}
+
+/**
+ * Map a sketch onto a wall-sized LED buffer (chain order, no brightness).
+ * The sketch is scaled by the largest whole factor that fits the wall's
+ * shorter side, then tiled to fill the rest. For example, an 8×8 sketch
+ * on a 2×2 wall is shown at 2×, and on a 3×1 wall it repeats three times.
+ *
+ * @param out Buffer of ledCount LEDs
+ * @param pixels Sketch pixels (palette indices, 0 = empty)
+ * @param gridSize Sketch size (8 or 16)
+ * @param palette RGB565 palette for indices 1-16
+ * @param highlightX Cell to brighten as the cursor (-1 for none)
+ * @param highlightY Cell to brighten as the cursor (-1 for none)
+ * @return false (buffer untouched) if the sketch is larger than the wall (16×16 on one unit)
+ */
+bool mapSketchToLEDs(CRGB* out, const uint8_t pixels[16][16], uint8_t gridSize, const uint16_t* palette,
+                     int8_t highlightX, int8_t highlightY) {
+    uint16_t scale = min(ledWallWidth, ledWallHeight) / gridSize;
+    if (scale == 0) {
+        return false;
+    }
+
+    // Convert the palette once instead of per LED
+    CRGB colors[17];
+    colors[0] = CRGB::Black;
+    for (uint8_t i = 0; i < 16; i++) {
+        colors[i + 1] = rgb565ToRGB888(palette[i]);
+    }
+
+    for (uint16_t wy = 0; wy < ledWallHeight; wy++) {
+        uint8_t sy = (wy / scale) % gridSize;
+        const uint16_t* lutRow = ledIndexLUT + wy * ledWallWidth;
+        for (uint16_t wx = 0; wx < ledWallWidth; wx++) {
+            uint16_t ledIndex = lutRow[wx];
+            if (ledIndex == LED_NO_INDEX) continue;
+
+            uint8_t sx = (wx / scale) % gridSize;
+            uint8_t pixelValue = pixels[sy][sx];
+            CRGB color = colors[pixelValue];
+
+            if (sx == highlightX && sy == highlightY) {
+                if (pixelValue == 0) {
+                    // Empty cell: dim white cursor
+                    color = CRGB(40, 40, 40);
+                } else {
+                    // Filled cell: brighten by adding white
+                    color.r = min(255, color.r + 80);
+                    color.g = min(255, color.g + 80);
+                    color.b = min(255, color.b + 80);
+                }
+            }
+            out[ledIndex] = color;
+        }
     }
+    return true;
+}
 
-    for (int py = 0; py < 16; py++) {
-      for (int px = 0; px < 16; px++) {
-        info.sketchData.pixels[py][px] = file.read();
-      }
+/**
+ * Draw a sketch onto the LED wall (see mapSketchToLEDs).
+ * Nothing is shown if the sketch is larger than the wall.
+ */
+void renderSketchToLEDs(const uint8_t pixels[16][16], uint8_t gridSize, const uint16_t* palette,
+                        int8_t highlightX, int8_t highlightY) {
+    if (!mapSketchToLEDs(leds, pixels, gridSize, palette, highlightX, highlightY)) {
+        FastLED.clear();
+        FastLED.show();
+        return;
     }
 
-    file.close();
-    info.dataLoaded = true;  // Mark as cached
-  }
+    // Update the physical LEDs (within the power budget)
+    showLEDMatrix();
+}
+
+// ============================================================================
+// LED PLAYLIST (L in the memory view)
+// ============================================================================
+// A run of sketches compiled into frames that are ready to send: mapped
+// through the layout table, gamma-corrected, and scaled to the LED brightness
+// (dimmed to the power budget) once, when they're compiled. Playing a frame
+// is then a copy into the LED buffer and a transmit. Playback is stepped from
+// loop() in every view, so it keeps going while you draw; the canvas mirror
+// waits until it stops. Changing the brightness re-bakes the frames from the
+// kept previews; changing the layout or turning the matrix off stops it.
+
+struct LEDPlaylistSlot {
+  Sketch source;                      // Preview the frame was compiled from (kept for re-baking)
+  uint8_t applied;                    // Budgeted brightness baked into the frame (0-255)
+  uint16_t currentMA;                 // Estimated current of the frame
+};
 
-  // Use cached data to render thumbnail
-  Sketch& tempSketch = info.sketchData;
+struct LEDPlaylist {
+  LEDPlaylistSlot* slots;             // count entries
+  CRGB* frames;                       // count × frameLeds: mapped, gamma-corrected, scaled
+  uint16_t count;                     // Frames allocated (0 = no playlist)
+  uint16_t frameLeds;                 // LEDs per frame (the layout's ledCount)
+  uint16_t ready;                     // Frames compiled so far
+  uint16_t frame;                     // Frame on the LEDs
+  unsigned long lastFrameMs;          // When that frame was due
+  bool playing;
+};
+LEDPlaylist ledPlaylist = {};
 
-  int cellSize = (tempSketch.gridSize == 8) ? 6 : 3;
-  int gridPixelSize = tempSketch.gridSize * cellSize;
-  int offsetX = (thumbSize - gridPixelSize) / 2;
-  int offsetY = (thumbSize - gridPixelSize) / 2;
+// Sketch files still to read, in playlist order ("" = preview was already cached)
+struct LEDPlaylistJob {
+  std::vector<String> filenames;
+};
 
-  for (int py = 0; py < tempSketch.gridSize; py++) {
-    for (int px = 0; px < tempSketch.gridSize; px++) {
-      uint8_t pixelIndex = tempSketch.pixels[py][px];
-      if (pixelIndex == 0) continue;
+uint8_t ledGamma[256];
+bool ledGammaReady = false;
 
-      uint16_t color = tempSketch.paletteColors[pixelIndex - 1];
-      memoryCanvas.fillRect(x + offsetX + (px * cellSize),
-                           y + offsetY + (py * cellSize),
-                           cellSize, cellSize, color);
+/**
+ * Compile one playlist frame from its slot's sketch
+ */
+void bakeLEDPlaylistFrame(uint16_t index) {
+    LEDPlaylistSlot& slot = ledPlaylist.slots[index];
+    CRGB* frame = ledPlaylist.frames + (uint32_t)index * ledPlaylist.frameLeds;
+    if (!mapSketchToLEDs(frame, slot.source.pixels, slot.source.gridSize, slot.source.paletteColors, -1, -1)) {
+        fill_solid(frame, ledPlaylist.frameLeds, CRGB::Black);
     }
-  }
 
-  // Cut corners
-  const int cutSize = 2;
-  uint16_t bgColor = currentTheme->background;
-  memoryCanvas.fillRect(x, y, cutSize, cutSize, bgColor);
-  memoryCanvas.fillRect(x + thumbSize - cutSize, y, cutSize, cutSize, bgColor);
-  memoryCanvas.fillRect(x, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
-  memoryCanvas.fillRect(x + thumbSize - cutSize, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
+    if (!ledGammaReady) {
+        for (int i = 0; i < 256; i++) {
+            ledGamma[i] = (uint8_t)(powf(i / 255.0f, LED_GAMMA) * 255.0f + 0.5f);
+        }
+        ledGammaReady = true;
+    }
+    uint8_t* bytes = (uint8_t*)frame;
+    uint32_t length = (uint32_t)ledPlaylist.frameLeds * 3;
+    for (uint32_t i = 0; i < length; i++) {
+        bytes[i] = ledGamma[bytes[i]];
+    }
+
+    // Bake in the brightness, dimmed to the power budget the way showLEDMatrix() does
+    uint8_t requested = (ledBrightness * 255) / 100;
+    uint32_t channelSum = sumLEDChannels(frame, ledPlaylist.frameLeds);
+    slot.applied = budgetLEDBrightness(channelSum, ledPlaylist.frameLeds, requested);
+    slot.currentMA = estimateLEDCurrentMA(channelSum, ledPlaylist.frameLeds, slot.applied);
+    if (slot.applied < 255) {
+        uint16_t scale = slot.applied + 1;  // Same rounding as FastLED's scale8
+        for (uint32_t i = 0; i < length; i++) {
+            bytes[i] = (bytes[i] * scale) >> 8;
+        }
+    }
+}
 
-  // Draw yellow border if this is the currently active sketch
-  if (info.filename == activeSketchFilename && !activeSketchIsNew) {
-    memoryCanvas.drawRect(x - 1, y - 1, thumbSize + 2, thumbSize + 2, TFT_YELLOW);
-  }
+/**
+ * Send one compiled frame to the matrix
+ */
+void showLEDPlaylistFrame(uint16_t index) {
+    memcpy(leds, ledPlaylist.frames + (uint32_t)index * ledPlaylist.frameLeds,
+           ledPlaylist.frameLeds * sizeof(CRGB));
+    ledAppliedBrightness = ledPlaylist.slots[index].applied;
+    ledEstimatedMA = ledPlaylist.slots[index].currentMA;
+    FastLED.show(255);  // The brightness is already in the frame
 }
 
-// Helper function to draw breathing cursor animation on selected item
-void drawMemoryViewCursor(int itemIndex, int x, int y, int thumbSize) {
-  if (memoryViewCursor != itemIndex) {
-    return;  // Not the selected item
-  }
+/**
+ * Re-bake the compiled frames (after a brightness change)
+ */
+void rebakeLEDPlaylist() {
+    for (uint16_t i = 0; i < ledPlaylist.ready; i++) {
+        bakeLEDPlaylistFrame(i);
+    }
+    if (ledPlaylist.playing) {
+        showLEDPlaylistFrame(ledPlaylist.frame);
+    }
+}
 
-  // Breathing cursor animation using corner icons
-  auto drawCorner = [&](int cornerX, int cornerY, bool flipH, bool flipV) {
-    for (int row = 0; row < ICON_SELECTOR_CORNER_HEIGHT; row++) {
-      for (int col = 0; col < ICON_SELECTOR_CORNER_WIDTH; col++) {
-        int pixelIndex = row * ICON_SELECTOR_CORNER_WIDTH + col;
-        int byteIndex = pixelIndex / 4;
-        int bitShift = (3 - (pixelIndex % 4)) * 2;
+/**
+ * Free the playlist. The canvas mirror takes the LEDs back.
+ */
+void stopLEDPlaylist() {
+    if (ledPlaylist.count == 0) {
+        return;
+    }
+    scopedFree(ledPlaylist.slots, ledPlaylist.count * sizeof(LEDPlaylistSlot));
+    scopedFree(ledPlaylist.frames, (size_t)ledPlaylist.count * ledPlaylist.frameLeds * sizeof(CRGB));
+    ledPlaylist = {};
+    LED_CANVAS_UPDATED();
+}
 
-        uint8_t byte = pgm_read_byte(&ICON_SELECTOR_CORNER[byteIndex]);
-        uint8_t value = (byte >> bitShift) & 0x03;
+/**
+ * Show the next frame when it's due. Called every loop() iteration.
+ */
+void stepLEDPlaylist() {
+    if (!ledPlaylist.playing) {
+        return;
+    }
+    unsigned long interval = 1000 / LED_PLAYLIST_FPS[ledPlaylistRate];
+    unsigned long late = millis() - ledPlaylist.lastFrameMs;
+    if (late < interval) {
+        return;
+    }
 
-        if (value != 0) {
-          int drawX = flipH ? (cornerX + ICON_SELECTOR_CORNER_WIDTH - 1 - col) : (cornerX + col);
-          int drawY = flipV ? (cornerY + ICON_SELECTOR_CORNER_HEIGHT - 1 - row) : (cornerY + row);
+    // Skip frames to keep time when the loop falls behind, but after a long
+    // stall (an SD write) just carry on from the next frame
+    uint32_t steps = late / interval;
+    if (steps > 4) {
+        steps = 1;
+        ledPlaylist.lastFrameMs = millis();
+    } else {
+        ledPlaylist.lastFrameMs += steps * interval;
+    }
+    ledPlaylist.frame = (ledPlaylist.frame + steps) % ledPlaylist.count;
+    showLEDPlaylistFrame(ledPlaylist.frame);
+}
 
-          uint16_t color = (value == 1) ? currentTheme->iconDark : currentTheme->iconLight;
-          memoryCanvas.drawPixel(drawX, drawY, color);
+/**
+ * Read and compile the next frame
+ */
+JobState ledPlaylistStep(Job& job) {
+    LEDPlaylistJob* pj = (LEDPlaylistJob*)job.context;
+    if (ledPlaylist.count == 0) {
+        return JOB_CANCELLED;  // Layout changed or the matrix was turned off
+    }
+    if (ledPlaylist.ready >= ledPlaylist.count) {
+        return JOB_DONE;
+    }
+
+    uint16_t index = ledPlaylist.ready;
+    const String& filename = pj->filenames[index];
+    if (filename.length() > 0) {
+        File file = SD.open(sketchPath(filename).c_str(), FILE_READ);
+        SketchFileIndex fileIndex;
+        bool ok = file && readSketchFileIndex(file, fileIndex) &&
+                  readSketchPreview(file, fileIndex, ledPlaylist.slots[index].source);
+        file.close();
+        if (!ok) {
+            return JOB_FAILED;
         }
-      }
     }
-  };
+    bakeLEDPlaylistFrame(index);
+    ledPlaylist.ready++;
+    job.progress = ledPlaylist.ready * 100 / ledPlaylist.count;
+    return JOB_RUNNING;
+}
 
-  // Animated breathing effect
-  float sineWave = sin(memoryCursorAnimPhase * 2.0f * PI);
-  float breathCycle = (sineWave + 1.0f) * 0.5f;
-  int offsetX = (int)(breathCycle * 4.0f + 0.5f);
-  int offsetY = (int)(breathCycle * 4.0f + 0.5f);
+void ledPlaylistFinish(Job& job, JobState state) {
+    delete (LEDPlaylistJob*)job.context;
+    if (state != JOB_DONE || ledPlaylist.count == 0) {
+        if (state == JOB_FAILED) {
+            setStatusMessage(StatusMsg::FAILED_TO_LOAD);
+        }
+        stopLEDPlaylist();
+        return;
+    }
 
-  // Clear corners for cursor animation
-  const int cutSize = 2;
-  uint16_t bgColor = currentTheme->background;
-  memoryCanvas.fillRect(x, y, cutSize, cutSize, bgColor);
-  memoryCanvas.fillRect(x + thumbSize - cutSize, y, cutSize, cutSize, bgColor);
-  memoryCanvas.fillRect(x, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
-  memoryCanvas.fillRect(x + thumbSize - cutSize, y + thumbSize - cutSize, cutSize, cutSize, bgColor);
+    ledPlaylist.playing = true;
+    ledPlaylist.frame = 0;
+    ledPlaylist.lastFrameMs = millis();
+    showLEDPlaylistFrame(0);
 
-  // Draw animated corners (closer to thumbnail - reduced from 14 to 6 pixels away)
-  const int cornerOffset = 6;  // Distance from thumbnail edge
-  drawCorner(x - cornerOffset + offsetX, y - cornerOffset + offsetY, false, false);
-  drawCorner(x + thumbSize + cornerOffset - 16 - offsetX, y - cornerOffset + offsetY, true, false);
-  drawCorner(x - cornerOffset + offsetX, y + thumbSize + cornerOffset - 16 - offsetY, false, true);
-  drawCorner(x + thumbSize + cornerOffset - 16 - offsetX, y + thumbSize + cornerOffset - 16 - offsetY, true, true);
+    char msg[32];
+    snprintf(msg, sizeof(msg), StatusMsg::LED_PLAYING_FMT, ledPlaylist.count);
+    setStatusMessage(msg);
 }
 
+/**
+ * Allocate an empty playlist for the active layout
+ * @return false if there's no room for it
+ */
+bool allocLEDPlaylist(uint16_t count) {
+    stopLEDPlaylist();
+    LEDPlaylistSlot* slots = (LEDPlaylistSlot*)scopedAlloc(count * sizeof(LEDPlaylistSlot));
+    CRGB* frames = (CRGB*)scopedAlloc((size_t)count * ledCount * sizeof(CRGB));
+    if (!slots || !frames) {
+        scopedFree(slots, count * sizeof(LEDPlaylistSlot));
+        scopedFree(frames, (size_t)count * ledCount * sizeof(CRGB));
+        return false;
+    }
+    ledPlaylist.slots = slots;
+    ledPlaylist.frames = frames;
+    ledPlaylist.count = count;
+    ledPlaylist.frameLeds = ledCount;
+    return true;
+}
 
+/**
+ * Compile sketches from the memory view list, starting at the focused one,
+ * as a background job (ESC cancels); they start playing once all are ready.
+ * As many as fit LED_PLAYLIST_BUDGET, up to LED_PLAYLIST_MAX_FRAMES.
+ * @return true if the job started
+ */
+bool startLEDPlaylist() {
+    if (!ledMatrixEnabled || !leds) {
+        setStatusMessage(StatusMsg::LED_OFF);
+        return false;
+    }
+    if (sketchList.empty()) {
+        setStatusMessage("No sketches to show");
+        return false;
+    }
+    if (jobActive) {
+        setStatusMessage(StatusMsg::JOB_BUSY);
+        return false;
+    }
+
+    uint32_t count = min((uint32_t)sketchList.size(), (uint32_t)LED_PLAYLIST_MAX_FRAMES);
+    count = min(count, (uint32_t)(LED_PLAYLIST_BUDGET / (ledCount * sizeof(CRGB))));
+    LEDPlaylistJob* pj = new LEDPlaylistJob();
+    if (count == 0 || !pj || !allocLEDPlaylist(count)) {
+        delete pj;
+        setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+        return false;
+    }
+
+    // Previews already loaded for the thumbnails are used as they are
+    size_t first = memoryViewCursor > 0 ? memoryViewCursor - 1 : 0;
+    for (uint16_t i = 0; i < count; i++) {
+        SketchInfo& info = sketchList[(first + i) % sketchList.size()];
+        if (info.dataLoaded) {
+            ledPlaylist.slots[i].source = info.sketchData;
+            pj->filenames.push_back("");
+        } else {
+            pj->filenames.push_back(info.filename);
+        }
+    }
 
-// ============================================================================
-// DRAW MEMORY VIEW 
-// ============================================================================
-void drawMemoryView(bool fullRedraw) {
-  drawMemoryViewGrid(fullRedraw);
+    if (!startJob("LEDs", ledPlaylistStep, ledPlaylistFinish, pj)) {
+        delete pj;
+        stopLEDPlaylist();
+        return false;
+    }
+    return true;
 }
 
 /**
- * Draw Hint Screen - displays all keyboard controls
+ * Update the LED matrix to mirror the current canvas.
+ * The LEDs are turned off if the LED matrix setting is OFF.
+ *
+ * @param showCursor If true, highlights cursor position (default). If false, shows clean canvas.
  */
-void drawHelpView() {
-  if (!helpCanvasAvailable) return;
-
-  helpCanvas.fillSprite(currentTheme->background);
-  helpCanvas.setTextSize(1);
+void updateLEDMatrix(bool showCursor) {
+    if (!ledMatrixEnabled) {
+        // LED matrix is disabled - turn off all LEDs
+        FastLED.clear();
+        FastLED.show();
+        return;
+    }
+    if (ledPlaylist.playing) return;  // The playlist has the LEDs
 
-  // Title
-  helpCanvas.setTextColor(currentTheme->text);
-  helpCanvas.setCursor(4, 4);
-  helpCanvas.print("HINTS");
+    renderSketchToLEDs(canvas, currentGridSize, activeSketch.paletteColors,
+                       showCursor ? cursorX : -1, showCursor ? cursorY : -1);
+}
 
-  struct HelpItem {
-    const char* label;
-    const char* key;
-    int group;
-  };
+/**
+ * Update the LED matrix to display a sketch (for preview mode).
+ * Used for both canvas preview and gallery preview modes.
+ */
+void updateLEDMatrixFromSketch(Sketch& sketch) {
+    if (!ledMatrixEnabled) {
+        // LED matrix is disabled - turn off all LEDs
+        FastLED.clear();
+        FastLED.show();
+        return;
+    }
+    if (ledPlaylist.playing) return;  // The playlist has the LEDs
 
-  const HelpItem helpItems[] = {
-    {"Move",        "Arrows",  0},
-    {"Draw",        "Ok",      0},
-    {"Erase",       "Del",     0},
-    {"Fill",        "F",       0},
-    {"Color 1-8",   "1-8",     0},
-    {"Color 9-16",  "Fn 1-8",  0},
-    {"Palette",     "P",       0},
-    {"Clear",       "G0",      0},
-    {"Preview",     "V",       0},
-    {"Grid size",   "G",       0},
-    {"Grid ruler",  "R",       0},
-    {"Open",        "O",       1},
-    {"Undo",        "Z",       1},
-    {"Save",        "S",       1},
-    {"Save as",     "Fn S",    1},
-    {"Settings",    "T",       1},
-    {"Export",      "X",       1},
-    {"Brightness",  "B +/-",   1},
-    {"Charge",      "Fn B",    1},
-#if ENABLE_LED_MATRIX
-    {"RGB on/off",  "L Ok",    2},
-    {"RGB Bright",  "L +/-",   2},
-#endif
-  };
+    renderSketchToLEDs(sketch.pixels, sketch.gridSize, sketch.paletteColors, -1, -1);
+}
 
-  const int totalItems = sizeof(helpItems) / sizeof(helpItems[0]);
-  const int startY = 18;
-  const int lineHeight = 14;
-  const int selectedLineHeight = 24;
-  const int groupGap = 8;
-  const int labelX = 12;
-  const int keyX = 156;
+/**
+ * Toggle LED matrix on/off with visual feedback.
+ * Shows brief status message on main display.
+ */
+void toggleLEDMatrix() {
+    ledMatrixEnabled = !ledMatrixEnabled;
 
-  // Auto-scroll to keep cursor visible
-  if (helpViewCursor < helpViewScrollOffset) {
-    helpViewScrollOffset = helpViewCursor;
-  }
-  while (helpViewScrollOffset < helpViewCursor) {
-    int y = startY;
-    for (int i = helpViewScrollOffset; i <= helpViewCursor && i < totalItems; i++) {
-      if (i > helpViewScrollOffset && helpItems[i].group != helpItems[i-1].group) y += groupGap;
-      y += (i == helpViewCursor) ? selectedLineHeight : lineHeight;
+    // Buffers are only held while the matrix is on
+    applyLEDLayout();
+    if (ledMatrixEnabled && !leds) {
+        ledMatrixEnabled = false;
+        setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+        return;
     }
-    if (y <= 135) break;
-    helpViewScrollOffset++;
-  }
 
-  // Draw visible rows
-  int y = startY;
-  for (int i = helpViewScrollOffset; i < totalItems; i++) {
-    if (i > helpViewScrollOffset && helpItems[i].group != helpItems[i-1].group) y += groupGap;
-    if (y >= 135) break;
+    // Save preference
+    preferences.begin("bitmap16dx", false);
+    preferences.putBool("ledEnabled", ledMatrixEnabled);
+    preferences.end();
 
-    bool isSelected = (i == helpViewCursor);
-    int rowH = isSelected ? selectedLineHeight : lineHeight;
-    int textY = isSelected ? y + 4 : y;
+    // Visual feedback
+    if (ledMatrixEnabled) {
+        // Show a brief "DX" pattern to confirm hardware is working
+        // Pattern displays as a simple checkmark/confirmation graphic
+        FastLED.clear();
 
-    uint16_t color = isSelected ? currentTheme->text : currentTheme->textSecondary;
+        // Set brightness to 10% for startup pattern
+        FastLED.setBrightness((10 * 255) / 100);
 
-    helpCanvas.setTextSize(isSelected ? 2 : 1);
-    helpCanvas.setTextColor(color);
-    helpCanvas.setCursor(labelX, textY);
-    helpCanvas.print(helpItems[i].label);
+        // Define the "DX" pattern LEDs (in non-rotated coordinates)
+        // Pattern:  . X X .   X . X .
+        //           . X . X   . X . .
+        //           . X X .   X . X .
+        const int dxPattern[] = {9, 10, 17, 19, 25, 26, 36, 38, 45, 52, 54};
+        const int patternSize = 11;
 
-    helpCanvas.setTextSize(isSelected ? 2 : 1);
-    helpCanvas.setTextColor(color);
-    helpCanvas.setCursor(keyX, textY);
-    helpCanvas.print(helpItems[i].key);
+        // Light up the pattern with white in the top-left 8×8 of the wall
+        // The layout table takes care of unit rotation
+        for (int i = 0; i < patternSize; i++) {
+            int index = dxPattern[i];
 
-    y += rowH;
-  }
+            // Convert linear index to x, y coordinates (8×8 grid)
+            uint8_t x = index % 8;
+            uint8_t y = index / 8;
 
-  helpCanvas.pushSprite(0, 0);
+            uint16_t ledIndex = ledIndexLUT[y * ledWallWidth + x];
+            if (ledIndex != LED_NO_INDEX) {
+                leds[ledIndex] = CRGB::White;
+            }
+        }
+        FastLED.show();
+        delay(1000);  // Hold pattern for 1 second
+
+        // Restore user's brightness setting
+        FastLED.setBrightness((ledBrightness * 255) / 100);
+
+        // Turn on: immediately update LEDs with current canvas
+        LED_CANVAS_UPDATED();
+        updateLEDMatrix();
+    }
+    // Turning off needs nothing more: applyLEDLayout() blanked the LEDs and freed the buffers
 }
 
 /**
- * Draw the grid with checkerboard pattern
- *
- * This function draws a 2×2 checkerboard pattern within each cell
- * to create a finer transparency grid, with cut corners.
+ * Adjust LED matrix brightness.
+ * @param delta: +1 to increase, -1 to decrease
  */
-void drawGrid() {
-  // Draw shadow behind the grid (with bottom-right cut corner)
-  drawShadow(GRID_X, GRID_Y, 128, 128, true);
+void adjustLEDBrightness(int8_t delta) {
+    if (!ledMatrixEnabled) return;  // No-op if disabled
 
-  // Draw each cell
-  for (int y = 0; y < currentGridSize; y++) {
-    for (int x = 0; x < currentGridSize; x++) {
-      drawCell(x, y);
+    // Adjust brightness in 1% steps while dim, 5% steps above 20%
+    int16_t step = (ledBrightness + delta > 20) ? 5 : 1;
+    int16_t newBrightness = ledBrightness + delta * step;
+
+    // Clamp to valid range
+    if (newBrightness < MIN_LED_BRIGHTNESS) {
+        newBrightness = MIN_LED_BRIGHTNESS;
+    } else if (newBrightness > MAX_LED_BRIGHTNESS) {
+        newBrightness = MAX_LED_BRIGHTNESS;
     }
-  }
 
-  // Cut the corners by drawing background color over them
-  // Canvas is 128×128, positioned at GRID_X, GRID_Y
-  // BR corner shows shadow color (reveals the shadow underneath)
-  M5Cardputer.Display.fillRect(GRID_X, GRID_Y, 2, 2, currentTheme->background);                          // Top-left
-  M5Cardputer.Display.fillRect(GRID_X + 128 - 2, GRID_Y, 2, 2, currentTheme->background);                // Top-right
-  M5Cardputer.Display.fillRect(GRID_X, GRID_Y + 128 - 2, 2, 2, currentTheme->background);                // Bottom-left
-  M5Cardputer.Display.fillRect(GRID_X + 128 - 2, GRID_Y + 128 - 2, 2, 2, currentTheme->shadow);                // Bottom-right (shadow color!)
+    ledBrightness = (uint8_t)newBrightness;
+
+    // Apply new brightness (FastLED uses 0-255 scale)
+    FastLED.setBrightness((ledBrightness * 255) / 100);
+    if (ledPlaylist.count) {
+        rebakeLEDPlaylist();  // Its frames carry the brightness
+    } else {
+        showLEDMatrix();  // Refresh LEDs with new brightness (within the power budget)
+    }
+
+    // Save preference
+    preferences.begin("bitmap16dx", false);
+    preferences.putUChar("ledBright", ledBrightness);
+    preferences.end();
 }
+#endif // ENABLE_LED_MATRIX
 
 // ============================================================================
-// SETUP AND LOOP
+// SESSION SNAPSHOT (resume where you left off)
 // ============================================================================
+// The editor state (canvas, active sketch, cursor, view, undo and where the
+// memory view and mural were) is kept in one small binary record. It's
+// rewritten once the device has been idle for SESSION_IDLE_MS and something
+// changed, and when charging mode starts. On boot a valid snapshot replaces
+// the boot screen and blank sketch, and the first frame is drawn from it.
+//
+// The record goes to SESSION_PATH, or to NVS when there's no SD card. Each
+// one has a sequence number and a CRC; boot takes the newest valid copy, so
+// a write cut short by power loss falls back to the one before.
+
+#define SESSION_PATH "/bitmap16dx/session.b16r"
+#define SESSION_TEMP_PATH "/bitmap16dx/session.tmp"
+#define SESSION_NVS_KEY "session"
+#define SESSION_MAGIC 0x52363142UL    // "B16R"
+#define SESSION_VERSION 1
+#define SESSION_IDLE_MS 2000          // Snapshot after this long without input
+#define SESSION_CHECK_MS 1000         // ...checking this often while it stays idle
+
+enum SessionView : uint8_t {
+  SESSION_CANVAS,                     // Also for the views opened over it (palette, settings, ...)
+  SESSION_MEMORY,
+  SESSION_MURAL
+};
+
+struct SessionSnapshot {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;                      // sizeof(SessionSnapshot) when written
+  uint32_t sequence;                  // Higher is newer
+  // Contents (compared to tell whether anything changed)
+  uint8_t view;                       // SessionView
+  uint8_t gridSize;
+  uint8_t cursorX;
+  uint8_t cursorY;
+  uint8_t selectedColor;
+  bool rulersVisible;
+  bool sketchIsNew;
+  bool undoAvailable;
+  uint8_t canvas[16][16];
+  Sketch sketch;                      // activeSketch (pixels as last saved or loaded)
+  char sketchFilename[32];
+  uint8_t undoCanvas[16][16];
+  uint8_t undoPaletteSize;
+  uint8_t undoGridSize;
+  uint16_t undoPaletteColors[16];
+  int32_t memoryCursor;
+  uint32_t memoryCursorId;            // Sketch under the memory view cursor (0 = "+")
+  int32_t memoryScrollOffset;
+  int16_t muralViewX;
+  int16_t muralViewY;
+  int16_t muralCursorX;
+  int16_t muralCursorY;
+  uint32_t crc;                       // Of everything above
+};
+
+uint32_t sessionSequence = 0;         // Of the last snapshot written or restored
+uint32_t sessionContentCrc = 0;       // Contents of that snapshot
+unsigned long sessionLastInputMs = 0;
+unsigned long sessionLastCheckMs = 0;
+unsigned long bootReadyMs = 0;        // millis() when setup() finished (time to interactive)
+bool bootResumed = false;             // setup() restored a snapshot
+SessionView sessionResumeView = SESSION_CANVAS;
+
+uint32_t sessionContentCrcOf(const SessionSnapshot& snap) {
+  const uint8_t* start = (const uint8_t*)&snap + offsetof(SessionSnapshot, view);
+  return crc32(0, start, offsetof(SessionSnapshot, crc) - offsetof(SessionSnapshot, view));
+}
 
 /**
- * Show boot screen with logo
- * Displays boot image from boot.png (240×135)
+ * Capture the current editor state (sequence and CRC are filled in when written)
  */
-void showBootScreen() {
-  // Fill screen with black background for boot screen
-  M5Cardputer.Display.fillScreen(TFT_BLACK);
+void buildSessionSnapshot(SessionSnapshot& snap) {
+  memset(&snap, 0, sizeof(snap));  // Padding too, so equal states have equal CRCs
+  snap.magic = SESSION_MAGIC;
+  snap.version = SESSION_VERSION;
+  snap.size = sizeof(SessionSnapshot);
+  snap.view = inMemoryView ? SESSION_MEMORY : inMuralView ? SESSION_MURAL : SESSION_CANVAS;
+  snap.gridSize = currentGridSize;
+  snap.cursorX = cursorX;
+  snap.cursorY = cursorY;
+  snap.selectedColor = selectedColor;
+  snap.rulersVisible = rulersVisible;
+  snap.sketchIsNew = activeSketchIsNew;
+  snap.undoAvailable = undoAvailable;
+  memcpy(snap.canvas, canvas, sizeof(snap.canvas));
+  snap.sketch = activeSketch;
+  strncpy(snap.sketchFilename, activeSketchFilename.c_str(), sizeof(snap.sketchFilename) - 1);
+  memcpy(snap.undoCanvas, undoCanvas, sizeof(snap.undoCanvas));
+  snap.undoPaletteSize = undoPaletteSize;
+  snap.undoGridSize = undoGridSize;
+  memcpy(snap.undoPaletteColors, undoPaletteColors, sizeof(snap.undoPaletteColors));
+
+  // In the memory view the cursor is live; elsewhere it's what exitMemoryView() remembered
+  snap.memoryCursor = inMemoryView ? memoryViewCursor : memoryViewCursorIndex;
+  snap.memoryCursorId = memoryViewCursorId;
+  if (inMemoryView) {
+    snap.memoryCursorId = 0;
+    if (memoryViewCursor > 0 && memoryViewCursor - 1 < (int)sketchList.size()) {
+      snap.memoryCursorId = sketchList[memoryViewCursor - 1].timestamp;
+    }
+  }
+  snap.memoryScrollOffset = memoryViewScrollOffset;
+  snap.muralViewX = muralViewX;
+  snap.muralViewY = muralViewY;
+  snap.muralCursorX = muralCursorX;
+  snap.muralCursorY = muralCursorY;
+}
 
-  // Display the indexed boot image with palette
-  // Convert indices to RGB565 colors on-the-fly
-  uint16_t* lineBuffer = (uint16_t*)malloc(240 * sizeof(uint16_t));
-  if (lineBuffer) {
-    for (int y = 0; y < 135; y++) {
-      for (int x = 0; x < 240; x++) {
-        uint8_t index = pgm_read_byte(&BOOT_IMAGE[y * 240 + x]);
-        lineBuffer[x] = pgm_read_word(&BOOT_PALETTE[index]);
-      }
-      M5Cardputer.Display.pushImage(0, y, 240, 1, lineBuffer, 0xF81F);
+/**
+ * Write a snapshot if the state changed since the last one
+ * @return true if it was written (or nothing had changed)
+ */
+bool saveSessionSnapshot() {
+  SessionSnapshot snap;
+  buildSessionSnapshot(snap);
+  uint32_t contentCrc = sessionContentCrcOf(snap);
+  if (contentCrc == sessionContentCrc && sessionSequence > 0) {
+    return true;
+  }
+  snap.sequence = sessionSequence + 1;
+  snap.crc = crc32(0, (const uint8_t*)&snap, offsetof(SessionSnapshot, crc));
+
+  bool ok = false;
+  if (sdCardAvailable) {
+    // Write beside the old one, then swap, so there's always a whole copy
+    File file = SD.open(SESSION_TEMP_PATH, FILE_WRITE);
+    if (file) {
+      ok = file.write((const uint8_t*)&snap, sizeof(snap)) == sizeof(snap);
+      file.close();
     }
-    free(lineBuffer);
+    ok = ok && (!SD.exists(SESSION_PATH) || SD.remove(SESSION_PATH)) && SD.rename(SESSION_TEMP_PATH, SESSION_PATH);
   }
+  if (!ok) {
+    preferences.begin("bitmap16dx", false);
+    ok = preferences.putBytes(SESSION_NVS_KEY, &snap, sizeof(snap)) == sizeof(snap);
+    preferences.end();
+  }
+  if (ok) {
+    sessionSequence = snap.sequence;
+    sessionContentCrc = contentCrc;
+  }
+  return ok;
+}
 
-  // Display version number in lower left corner
-  M5Cardputer.Display.setTextColor(TFT_WHITE);
-  M5Cardputer.Display.setTextSize(1);
-  M5Cardputer.Display.setCursor(4, 135 - 12);  // 4px from left, 12px from bottom
-  M5Cardputer.Display.print(FIRMWARE_VERSION);
-
-  // Wait for ESC key (`) press to continue, or timeout after 5 seconds
-  bool waiting = true;
-  unsigned long startTime = millis();
-  const unsigned long timeout = 2500; // 2.5 second timeout
-
-  while (waiting) {
-    M5Cardputer.update();
+/**
+ * Read a snapshot from a file on the SD card
+ * @return true if it's whole and from this firmware's layout
+ */
+bool readSessionFile(const char* path, SessionSnapshot& snap) {
+  File file = SD.open(path, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.size() == sizeof(snap) && file.read((uint8_t*)&snap, sizeof(snap)) == sizeof(snap);
+  file.close();
+  return ok;
+}
 
-    // Check for timeout
-    if (millis() - startTime > timeout) {
-      waiting = false;
-      break;
-    }
+bool sessionSnapshotValid(const SessionSnapshot& snap) {
+  return snap.magic == SESSION_MAGIC && snap.version == SESSION_VERSION && snap.size == sizeof(SessionSnapshot) &&
+         snap.crc == crc32(0, (const uint8_t*)&snap, offsetof(SessionSnapshot, crc)) &&
+         (snap.gridSize == 8 || snap.gridSize == 16) &&
+         (snap.sketch.paletteSize == 4 || snap.sketch.paletteSize == 8 || snap.sketch.paletteSize == 16);
+}
 
-    if (M5Cardputer.Keyboard.isChange() && M5Cardputer.Keyboard.isPressed()) {
-      // Check for backtick (ESC key)
-      for (auto i : M5Cardputer.Keyboard.keysState().word) {
-        if (i == '`') {
-          waiting = false;
-          break;
-        }
-      }
+/**
+ * Find the newest valid snapshot (SD file, its temp copy, NVS)
+ */
+bool loadSessionSnapshot(SessionSnapshot& best) {
+  SessionSnapshot snap;
+  bool found = false;
+  auto consider = [&]() {
+    if (sessionSnapshotValid(snap) && (!found || snap.sequence > best.sequence)) {
+      best = snap;
+      found = true;
     }
-    delay(10);  // Small delay to prevent busy-waiting
+  };
+  if (sdCardAvailable) {
+    if (readSessionFile(SESSION_PATH, snap)) consider();
+    if (readSessionFile(SESSION_TEMP_PATH, snap)) consider();
+  }
+  preferences.begin("bitmap16dx", true);  // Read-only
+  if (preferences.getBytesLength(SESSION_NVS_KEY) == sizeof(snap) &&
+      preferences.getBytes(SESSION_NVS_KEY, &snap, sizeof(snap)) == sizeof(snap)) {
+    consider();
   }
+  preferences.end();
+  return found;
 }
 
-// ============================================================================
-// PALETTE SYSTEM FUNCTIONS
-// ============================================================================
+/**
+ * Put the editor back the way the newest snapshot left it (boot only)
+ * @return false if there's no usable snapshot
+ */
+bool restoreSessionSnapshot() {
+  SessionSnapshot snap;
+  if (!loadSessionSnapshot(snap)) {
+    return false;
+  }
 
-// Initialize stock palettes into dynamic palette arrays
-void initStockPalettes() {
-  for (int i = 0; i < NUM_PALETTES; i++) {
-    allPalettes[i] = PALETTE_CATALOG[i];
-    allPaletteNames[i] = PALETTE_NAMES[i];
-    allPaletteSizes[i] = PALETTE_SIZES[i];
-    paletteIsUserLoaded[i] = false;
+  memcpy(canvas, snap.canvas, sizeof(canvas));
+  syncCanvasPlanes();
+  activeSketch = snap.sketch;
+  snap.sketchFilename[sizeof(snap.sketchFilename) - 1] = '\0';
+  activeSketchFilename = snap.sketchFilename;
+  activeSketchIsNew = snap.sketchIsNew;
+  if (!activeSketchIsNew && sdCardAvailable && !SD.exists(sketchPath(activeSketchFilename).c_str())) {
+    activeSketchIsNew = true;  // Deleted on another device: the next save makes a new file
   }
-}
 
-// Parse Lospec .hex file from SD card
-// Returns true if valid palette loaded
-bool loadPaletteFromHex(const char* filepath, uint16_t* colors, uint8_t* size) {
-  File file = SD.open(filepath);
-  if (!file) return false;
+  currentGridSize = snap.gridSize;
+  currentCellSize = (currentGridSize == 8) ? 16 : 8;
+  cursorX = min((int)snap.cursorX, currentGridSize - 1);
+  cursorY = min((int)snap.cursorY, currentGridSize - 1);
+  selectedColor = (snap.selectedColor >= 1 && snap.selectedColor <= activeSketch.paletteSize) ? snap.selectedColor : 1;
+  rulersVisible = snap.rulersVisible;
+
+  memcpy(undoCanvas, snap.undoCanvas, sizeof(undoCanvas));
+  undoAvailable = snap.undoAvailable;
+  undoPaletteSize = snap.undoPaletteSize;
+  undoGridSize = snap.undoGridSize;
+  memcpy(undoPaletteColors, snap.undoPaletteColors, sizeof(undoPaletteColors));
+
+  memoryViewCursor = memoryViewCursorIndex = max(0, (int)snap.memoryCursor);
+  memoryViewCursorId = snap.memoryCursorId;
+  memoryViewScrollOffset = max(0, (int)snap.memoryScrollOffset);
+  memoryViewScrollPos = memoryViewScrollOffset;
+  muralViewX = snap.muralViewX;
+  muralViewY = snap.muralViewY;
+  muralCursorX = snap.muralCursorX;
+  muralCursorY = snap.muralCursorY;
+
+  sessionResumeView = (SessionView)snap.view;
+  sessionSequence = snap.sequence;
+  sessionContentCrc = sessionContentCrcOf(snap);
+  LED_CANVAS_UPDATED();
+  return true;
+}
 
-  uint8_t colorCount = 0;
+/**
+ * Open the view the snapshot was taken in
+ * @return true if a view other than the canvas was entered (and drawn)
+ */
+bool enterSessionView() {
+  if (sessionResumeView == SESSION_MEMORY) {
+    enterMemoryView();
+    return true;
+  }
+  if (sessionResumeView == SESSION_MURAL) {
+    enterMuralView();
+    return inMuralView;
+  }
+  return false;
+}
 
-  while (file.available() && colorCount < 16) {
-    String line = file.readStringUntil('\n');
-    line.trim();
+/**
+ * Snapshot the session once input has stopped for a while (called every loop)
+ */
+void updateSessionSnapshot() {
+  unsigned long now = millis();
+  if (M5Cardputer.Keyboard.isPressed() || M5Cardputer.BtnA.isPressed()) {
+    sessionLastInputMs = now;
+    return;
+  }
+  // lastKeyTime also covers keys from a Bluetooth keyboard
+  if (jobActive || inChargingMode || now - sessionLastInputMs < SESSION_IDLE_MS ||
+      now - lastKeyTime < SESSION_IDLE_MS || now - sessionLastCheckMs < SESSION_CHECK_MS) {
+    return;
+  }
+  sessionLastCheckMs = now;
+  uint32_t sequence = sessionSequence;
+  saveSessionSnapshot();
+  if (inMuralView && sessionSequence != sequence) {
+    flushMural();  // Mural edits are in cached chunks until written back
+  }
+}
 
-    // Skip empty lines and comments
-    if (line.length() == 0 || line.startsWith("//")) continue;
+#if ENABLE_DEVICE_BENCH
+// ============================================================================
+// DEVICE BENCHMARK (hidden: Fn+B in settings)
+// ============================================================================
+// Runs a fixed suite on the real display, SD card and LED pin so boards and
+// cards can be compared. One benchmark runs per job step; each is timed over
+// a few iterations of the same code the views use. The report is written to
+// /bitmap16dx/bench/device_NNN.json with the firmware version and board name.
+// Screen contents are disturbed while it runs; settings redraw at the end.
+
+#define BENCH_SKETCH_PATH BENCH_DIR "/bench_sketch.dat"
+#define BENCH_SHEET_DIR BENCH_DIR "/sheet"
+#define BENCH_SHEET_SIZE 256
+#define BENCH_MURAL_PATH BENCH_DIR "/bench_mural.b16m"
+#define BENCH_ARCHIVE_SKETCHES 96
+#define BENCH_DEFLATE_WIDTH 256  // Bytes per row when the corpus is deflated as a grayscale PNG
+#define BENCH_PLANE_REPEAT 100   // Canvas operations per timed iteration
+
+enum DeviceBenchItem {
+  DBENCH_GRID_REDRAW,
+  DBENCH_MEMORY_FRAME,
+  DBENCH_SKETCH_SAVE,
+  DBENCH_SKETCH_LOAD,
+  DBENCH_PNG_EXPORT,
+  DBENCH_QOI_EXPORT,
+  DBENCH_BMP_EXPORT,
+  DBENCH_GIF_EXPORT,
+  DBENCH_PNG_512_1_CORE,
+  DBENCH_PNG_512_2_CORES,
+  DBENCH_LED_1_UNIT,
+  DBENCH_LED_4_UNITS,
+  DBENCH_LED_PLAYLIST_4_UNITS,
+  DBENCH_PALETTE_FRAME,
+  DBENCH_SHEET_IMPORT,
+  DBENCH_MURAL_PAN,
+  DBENCH_ARCHIVE_ENCODE,
+  DBENCH_ARCHIVE_DECODE,
+  DBENCH_DEFLATE_ENCODE,
+  DBENCH_DEFLATE_DECODE,
+  DBENCH_FILL_BYTES,
+  DBENCH_FILL_PLANES,
+  DBENCH_SELECT_BYTES,
+  DBENCH_SELECT_PLANES,
+  DBENCH_FLIP_BYTES,
+  DBENCH_FLIP_PLANES,
+  DBENCH_SHIFT_BYTES,
+  DBENCH_SHIFT_PLANES,
+  DBENCH_OUTLINE_BYTES,
+  DBENCH_OUTLINE_PLANES,
+  DBENCH_DIFF_BYTES,
+  DBENCH_DIFF_PLANES,
+  DBENCH_STROKE_UNBATCHED,
+  DBENCH_STROKE_BATCHED,
+  DBENCH_SHARED_PALETTE,
+  DBENCH_COUNT
+};
 
-    // Remove # prefix if present
-    if (line.startsWith("#")) line = line.substring(1);
+const char* DEVICE_BENCH_NAMES[DBENCH_COUNT] = {
+  "grid_redraw", "memory_view_frame", "sketch_save", "sketch_load",
+  "png_export", "qoi_export", "bmp_export", "gif_export", "png_512_1_core", "png_512_2_cores",
+  "led_refresh_1_unit", "led_refresh_4_units", "led_playlist_4_units", "palette_frame",
+  "sheet_import_256px", "mural_pan", "archive_encode", "archive_decode",
+  "deflate_encode", "deflate_decode", "canvas_fill_bytes", "canvas_fill_planes",
+  "canvas_select_bytes", "canvas_select_planes", "canvas_flip_bytes", "canvas_flip_planes",
+  "canvas_shift_bytes", "canvas_shift_planes", "canvas_outline_bytes", "canvas_outline_planes",
+  "canvas_diff_bytes", "canvas_diff_planes", "stroke_cell_unbatched", "stroke_cell_batched",
+  "shared_palette_2048"
+};
 
-    // Must be 6-char hex code
-    if (line.length() != 6) continue;
+struct BenchTiming {
+  uint16_t iterations;
+  uint32_t totalUs;
+  uint32_t maxUs;
+};
 
-    // Parse RGB hex
-    long rgb = strtol(line.c_str(), NULL, 16);
-    uint8_t r = (rgb >> 16) & 0xFF;
-    uint8_t g = (rgb >> 8) & 0xFF;
-    uint8_t b = rgb & 0xFF;
+struct DeviceBenchJob {
+  uint8_t next;                          // Next DeviceBenchItem to run
+  BenchTiming results[DBENCH_COUNT];     // iterations == 0 if skipped
+  uint16_t sketchCount;                  // Library size during the memory view frame
+  MuralStats mural;                      // Chunk cache counters during the mural pans
+  uint32_t archiveRawBytes;              // Sketch files in the archive benchmark corpus
+  uint32_t archiveBytes;                 // ...as a library archive
+  uint32_t deflateBytes;                 // ...deflated (PNG container included)
+};
 
-    // Convert to RGB565
-    colors[colorCount++] = RGB565(r, g, b);
+/**
+ * Run fn() iterations times, timing each call
+ */
+template <typename Fn>
+void benchTime(BenchTiming& result, uint16_t iterations, Fn fn) {
+  result = {0, 0, 0};
+  for (uint16_t i = 0; i < iterations; i++) {
+    unsigned long start = micros();
+    if (!fn()) {
+      return;  // Keep only the iterations that completed
+    }
+    uint32_t elapsed = micros() - start;
+    result.iterations++;
+    result.totalUs += elapsed;
+    if (elapsed > result.maxUs) {
+      result.maxUs = elapsed;
+    }
   }
+}
 
-  file.close();
-
-  // Validate size (must be exactly 4, 8, or 16)
-  if (colorCount != 4 && colorCount != 8 && colorCount != 16) {
+/**
+ * Encode the import benchmark's sheet: RGBA, 16×16 cells drawn from 24
+ * patterns, with an empty cell every 7th (so cells repeat like a real sheet)
+ */
+bool writeBenchSheet(const char* path) {
+  if (!SD.exists(BENCH_SHEET_DIR) && !SD.mkdir(BENCH_SHEET_DIR)) {
     return false;
   }
-
-  // Wrap remaining slots cyclically (for 4/8 color palettes)
-  // For 8-color palette: indices 9-16 map to colors 1-8
-  // For 4-color palette: indices 5-16 map to colors 1-4 repeated
-  for (uint8_t i = colorCount; i < 16; i++) {
-    colors[i] = colors[i % colorCount];
+  const size_t bufferSize = 65536;
+  uint8_t* buffer = (uint8_t*)scopedAlloc(bufferSize);
+  uint8_t* line = (uint8_t*)scopedAlloc(BENCH_SHEET_SIZE * 4);
+  PNGENC* encoder = new PNGENC();
+  bool ok = buffer && line && encoder && encoder->open(buffer, bufferSize) == PNG_SUCCESS &&
+            encoder->encodeBegin(BENCH_SHEET_SIZE, BENCH_SHEET_SIZE, PNG_PIXEL_TRUECOLOR_ALPHA, 32, NULL, 3) == PNG_SUCCESS;
+  for (int y = 0; y < BENCH_SHEET_SIZE && ok; y++) {
+    for (int x = 0; x < BENCH_SHEET_SIZE; x++) {
+      int cell = (y / 16) * (BENCH_SHEET_SIZE / 16) + x / 16;
+      int pattern = cell % 24;
+      uint8_t colorIndex = (cell % 7 == 0) ? 0 : (((x % 16) * (pattern + 1) + (y % 16) * 3) / 5) % 5;
+      exportPixelToRGBA(colorIndex, PALETTE_CATALOG[0], false, line + x * 4);
+    }
+    ok = encoder->addLine(line) == PNG_SUCCESS;
+  }
+  int size = ok ? encoder->close() : 0;
+  if (size > 0) {
+    File file = SD.open(path, FILE_WRITE);
+    ok = file && file.write(buffer, size) == (size_t)size;
+    file.close();
   }
-
-  *size = colorCount;
-  return true;
+  delete encoder;
+  scopedFree(line, BENCH_SHEET_SIZE * 4);
+  scopedFree(buffer, bufferSize);
+  return ok && size > 0;
 }
 
-// Load user palettes from SD card /bitmap16dx/palettes/ folder
-void loadUserPalettes() {
-  // Check if /bitmap16dx/palettes folder exists
-  File root = SD.open("/bitmap16dx/palettes");
-  if (!root || !root.isDirectory()) {
-    // Try to create the folder
-    if (SD.mkdir("/bitmap16dx/palettes")) {
-      // Try opening again
-      root = SD.open("/bitmap16dx/palettes");
-      if (!root || !root.isDirectory()) {
-        return;
+/**
+ * Sketch i of the archive benchmark corpus: mirrored blobs with an outline
+ * and some dithering on a transparent background, in runs of eight sharing a
+ * catalog palette, every fourth one on the 8×8 grid
+ */
+void benchArchiveSketch(int i, Sketch& sketch) {
+  uint32_t seed = 0x9E3779B9UL * (i + 1);
+  auto random = [&seed](int range) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (int)(seed % range);
+  };
+  int palette = (i / 8 * 5) % NUM_PALETTES;
+  memset(&sketch, 0, sizeof(sketch));
+  sketch.gridSize = (i % 4 == 3) ? 8 : 16;
+  sketch.paletteSize = PALETTE_SIZES[palette];
+  memcpy(sketch.paletteColors, PALETTE_CATALOG[palette], sketch.paletteSize * sizeof(uint16_t));
+
+  int n = sketch.gridSize;
+  int half = n / 2;
+  uint8_t body = 1 + random(sketch.paletteSize);
+  uint8_t shade = 1 + random(sketch.paletteSize);
+  uint8_t outline = 1 + random(sketch.paletteSize);
+  int rx = 2 + random(half - 2);
+  int ry = 2 + random(half - 1);
+  for (int y = 1; y < n - 1; y++) {
+    for (int x = 1; x < half; x++) {
+      // Ellipse in half-cell units, centered on the grid
+      int dx = 2 * (half - x) - 1;
+      int dy = 2 * (y - half) + 1;
+      if (dx * dx * ry * ry + dy * dy * rx * rx <= 4 * rx * rx * ry * ry) {
+        sketch.pixels[y][x] = (y > half && (x + y) % 2) ? shade : body;
       }
-    } else {
-      return;
     }
   }
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < half; x++) {
+      if (sketch.pixels[y][x] == 0 &&
+          ((x > 0 && sketch.pixels[y][x - 1] && sketch.pixels[y][x - 1] != outline) ||
+           (x < half - 1 && sketch.pixels[y][x + 1] && sketch.pixels[y][x + 1] != outline) ||
+           (y > 0 && sketch.pixels[y - 1][x] && sketch.pixels[y - 1][x] != outline) ||
+           (y < n - 1 && sketch.pixels[y + 1][x] && sketch.pixels[y + 1][x] != outline))) {
+        sketch.pixels[y][x] = outline;
+      }
+    }
+  }
+  sketch.pixels[half - 1 - random(2)][half - 1 - random(half / 2)] = outline;  // Eye
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < half; x++) {
+      sketch.pixels[y][n - 1 - x] = sketch.pixels[y][x];
+    }
+  }
+}
 
-  File file = root.openNextFile();
-  while (file && totalPaletteCount < 32) {
-    String filename = String(file.name());
-
-    // Only process .hex files
-    if (!file.isDirectory() && filename.endsWith(".hex")) {
-      // Allocate memory for this palette
-      uint16_t* colors = (uint16_t*)malloc(16 * sizeof(uint16_t));
-      char* name = (char*)malloc(32);
-      uint8_t size;
-
-      // Try to load palette
-      String filepath = String("/bitmap16dx/palettes/") + filename;
-      if (loadPaletteFromHex(filepath.c_str(), colors, &size)) {
-        // Extract name from filename (remove .hex, convert to uppercase)
-        String paletteName = filename.substring(0, filename.length() - 4);
-        paletteName.toUpperCase();
-        paletteName.replace("-", " ");
-        paletteName.replace("_", " ");
-        strncpy(name, paletteName.c_str(), 31);
-        name[31] = '\0';
+/**
+ * Time the library archive against plain deflate on a synthetic corpus held
+ * in memory (fills all four archive/deflate results). Deflate is PNGENC's
+ * (level 9) over the concatenated sketch files laid out as a grayscale image,
+ * decoded with the ROM inflater the sheet importer uses.
+ */
+void benchLibraryArchive(DeviceBenchJob* bench) {
+  const size_t rows = (BENCH_ARCHIVE_SKETCHES * SKETCH_FILE_MAX_SIZE + BENCH_DEFLATE_WIDTH - 1) / BENCH_DEFLATE_WIDTH;
+  const size_t rawCapacity = rows * (BENCH_DEFLATE_WIDTH + 1);  // Also holds the inflated rows
+  const size_t packedCapacity = rawCapacity / 2;
+  Sketch* corpus = (Sketch*)scopedAlloc(BENCH_ARCHIVE_SKETCHES * sizeof(Sketch));
+  uint8_t* raw = (uint8_t*)scopedAlloc(rawCapacity);
+  uint8_t* packed = (uint8_t*)scopedAlloc(packedCapacity);
+  ArchiveState* state = new ArchiveState();
+  if (state) {
+    state->palettes = (ArchivePalette*)scopedAlloc(ARCHIVE_MAX_PALETTES * sizeof(ArchivePalette));
+  }
+
+  if (corpus && raw && packed && state && state->palettes) {
+    uint32_t rawBytes = 0;
+    for (int i = 0; i < BENCH_ARCHIVE_SKETCHES; i++) {
+      benchArchiveSketch(i, corpus[i]);
+      rawBytes += buildSketchFile(corpus[i], raw + rawBytes);
+    }
+    bench->archiveRawBytes = rawBytes;
+
+    ArchiveEncoder enc;
+    benchTime(bench->results[DBENCH_ARCHIVE_ENCODE], 5, [&]() {
+      initArchiveState(*state);
+      initArchiveEncoder(enc, packed, packedCapacity);
+      for (int i = 0; i < BENCH_ARCHIVE_SKETCHES; i++) {
+        uint32_t id = i + 1;
+        codeBit(enc, state->model.more, 1);
+        codeArchiveSketch(enc, *state, id, corpus[i]);
+      }
+      codeBit(enc, state->model.more, 0);
+      finishArchiveEncoder(enc);
+      return enc.ok;
+    });
+    bench->archiveBytes = enc.bytes + sizeof(ARCHIVE_MAGIC) + 1;
+
+    // Decode and check every sketch comes back exactly
+    benchTime(bench->results[DBENCH_ARCHIVE_DECODE], 5, [&]() {
+      ArchiveDecoder dec;
+      initArchiveState(*state);
+      initArchiveDecoder(dec, packed, enc.bytes);
+      for (int i = 0; i < BENCH_ARCHIVE_SKETCHES; i++) {
+        uint32_t id = 0;
+        Sketch sketch;
+        if (!codeBit(dec, state->model.more, 0)) {
+          return false;
+        }
+        codeArchiveSketch(dec, *state, id, sketch);
+        if (id != (uint32_t)i + 1 || sketch.gridSize != corpus[i].gridSize ||
+            sketch.paletteSize != corpus[i].paletteSize ||
+            memcmp(sketch.paletteColors, corpus[i].paletteColors, sizeof(sketch.paletteColors)) != 0 ||
+            memcmp(sketch.pixels, corpus[i].pixels, sizeof(sketch.pixels)) != 0) {
+          return false;
+        }
+      }
+      return !codeBit(dec, state->model.more, 0) && dec.ok;
+    });
+
+    uint32_t imageRows = (rawBytes + BENCH_DEFLATE_WIDTH - 1) / BENCH_DEFLATE_WIDTH;
+    memset(raw + rawBytes, 0, imageRows * BENCH_DEFLATE_WIDTH - rawBytes);
+    PNGENC* encoder = new PNGENC();
+    int pngSize = 0;
+    if (encoder) {
+      benchTime(bench->results[DBENCH_DEFLATE_ENCODE], 3, [&]() {
+        pngSize = 0;
+        if (encoder->open(packed, packedCapacity) != PNG_SUCCESS ||
+            encoder->encodeBegin(BENCH_DEFLATE_WIDTH, imageRows, PNG_PIXEL_GRAYSCALE, 8, NULL, 9) != PNG_SUCCESS) {
+          return false;
+        }
+        for (uint32_t row = 0; row < imageRows; row++) {
+          if (encoder->addLine(raw + row * BENCH_DEFLATE_WIDTH) != PNG_SUCCESS) {
+            return false;
+          }
+        }
+        pngSize = encoder->close();
+        return pngSize > 0;
+      });
+      delete encoder;
+    }
+    bench->deflateBytes = pngSize;
+
+    // Join the IDAT payloads into one zlib stream (in place), then time inflating it
+    size_t zlibBytes = 0;
+    for (size_t pos = 8; pos + 12 <= (size_t)pngSize;) {
+      uint32_t length = readBE32(packed + pos);
+      if (pos + 12 + length > (size_t)pngSize) {
+        break;
+      }
+      if (memcmp(packed + pos + 4, "IDAT", 4) == 0) {
+        memmove(packed + zlibBytes, packed + pos + 8, length);
+        zlibBytes += length;
+      }
+      pos += 12 + length;
+    }
+    tinfl_decompressor* inflator = (tinfl_decompressor*)scopedAlloc(sizeof(tinfl_decompressor));
+    if (inflator && zlibBytes > 0) {
+      const size_t inflatedBytes = imageRows * (BENCH_DEFLATE_WIDTH + 1);
+      benchTime(bench->results[DBENCH_DEFLATE_DECODE], 5, [&]() {
+        size_t inBytes = zlibBytes;
+        size_t outBytes = inflatedBytes;
+        tinfl_init(inflator);
+        tinfl_status status = tinfl_decompress(inflator, packed, &inBytes, raw, raw, &outBytes,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+        return status == TINFL_STATUS_DONE && outBytes == inflatedBytes;
+      });
+    }
+    scopedFree(inflator, sizeof(tinfl_decompressor));
+  }
+
+  if (state) {
+    scopedFree(state->palettes, ARCHIVE_MAX_PALETTES * sizeof(ArchivePalette));
+    delete state;
+  }
+  scopedFree(packed, packedCapacity);
+  scopedFree(raw, rawCapacity);
+  scopedFree(corpus, BENCH_ARCHIVE_SKETCHES * sizeof(Sketch));
+}
 
-        // Add to catalog
-        allPalettes[totalPaletteCount] = colors;
-        allPaletteNames[totalPaletteCount] = name;
-        allPaletteSizes[totalPaletteCount] = size;
-        paletteIsUserLoaded[totalPaletteCount] = true;
+// Byte-at-a-time versions of the bit-plane operations (the canvas code before
+// CANVAS BIT PLANES), timed against them by benchCanvasPlanes()
 
-        totalPaletteCount++;
-      } else {
-        // Invalid palette - free memory and skip silently
-        free(colors);
-        free(name);
-      }
+void byteFillRegion(const uint8_t (&pixels)[16][16], int startX, int startY, int size, bool (&region)[16][16]) {
+  uint8_t original = pixels[startY][startX];
+  bool visited[16][16] = {false};
+  struct Point {
+    int x;
+    int y;
+  };
+  Point stack[256];
+  int stackSize = 0;
+  memset(region, 0, sizeof(region));
+  stack[stackSize++] = {startX, startY};
+  visited[startY][startX] = true;
+  while (stackSize > 0) {
+    Point p = stack[--stackSize];
+    if (pixels[p.y][p.x] != original) {
+      continue;
+    }
+    region[p.y][p.x] = true;
+    if (p.y > 0 && !visited[p.y - 1][p.x]) {
+      stack[stackSize++] = {p.x, p.y - 1};
+      visited[p.y - 1][p.x] = true;
+    }
+    if (p.y < size - 1 && !visited[p.y + 1][p.x]) {
+      stack[stackSize++] = {p.x, p.y + 1};
+      visited[p.y + 1][p.x] = true;
+    }
+    if (p.x > 0 && !visited[p.y][p.x - 1]) {
+      stack[stackSize++] = {p.x - 1, p.y};
+      visited[p.y][p.x - 1] = true;
+    }
+    if (p.x < size - 1 && !visited[p.y][p.x + 1]) {
+      stack[stackSize++] = {p.x + 1, p.y};
+      visited[p.y][p.x + 1] = true;
     }
-
-    file = root.openNextFile();
   }
-
-  root.close();
 }
 
-// Update the filtered palette list based on current filter settings
-void updatePaletteFilter() {
-  filteredPaletteCount = 0;
+void byteFlip(uint8_t (&pixels)[16][16], int size) {
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size / 2; x++) {
+      uint8_t t = pixels[y][x];
+      pixels[y][x] = pixels[y][size - 1 - x];
+      pixels[y][size - 1 - x] = t;
+    }
+  }
+}
 
-  for (uint8_t i = 0; i < totalPaletteCount; i++) {
-    bool matches = true;
+void byteShift(uint8_t (&pixels)[16][16], int dx, int dy, int size) {
+  uint8_t moved[16][16];
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      moved[(y + dy + size) % size][(x + dx + size) % size] = pixels[y][x];
+    }
+  }
+  for (int y = 0; y < size; y++) {
+    memcpy(pixels[y], moved[y], size);
+  }
+}
 
-    // Apply size filter
-    if (paletteFilterSize != 0 && allPaletteSizes[i] != paletteFilterSize) {
-      matches = false;
+void byteOutline(const uint8_t (&pixels)[16][16], int size, bool (&outline)[16][16]) {
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      outline[y][x] = pixels[y][x] == 0 &&
+                      ((x > 0 && pixels[y][x - 1]) || (x < size - 1 && pixels[y][x + 1]) ||
+                       (y > 0 && pixels[y - 1][x]) || (y < size - 1 && pixels[y + 1][x]));
     }
+  }
+}
 
-    // Apply user filter
-    if (paletteFilterUser && !paletteIsUserLoaded[i]) {
-      matches = false;
+bool byteDiff(const uint8_t (&a)[16][16], const uint8_t (&b)[16][16], bool (&diff)[16][16]) {
+  bool any = false;
+  for (int y = 0; y < 16; y++) {
+    for (int x = 0; x < 16; x++) {
+      diff[y][x] = a[y][x] != b[y][x];
+      any |= diff[y][x];
     }
+  }
+  return any;
+}
 
-    // Add to filtered list if matches
-    if (matches) {
-      filteredPaletteIndices[filteredPaletteCount++] = i;
+void byteSelect(const uint8_t (&pixels)[16][16], uint8_t index, int size, bool (&cells)[16][16]) {
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      cells[y][x] = pixels[y][x] == index;
     }
   }
 }
 
-#if ENABLE_LED_MATRIX
-// ============================================================================
-// LED MATRIX FUNCTIONS (8×8 WS2812 RGB LEDs)
-// ============================================================================
-
 /**
- * Convert 2D LED grid coordinates to linear LED index.
- * Supports both 1 unit (8×8) and 4 units (16×16) configurations.
- *
- * For 4 units, they're arranged in a 2×2 grid:
- *   [Unit 0] [Unit 1]    Each unit is 8×8 LEDs (64 LEDs each)
- *   [Unit 3] [Unit 2]    Total: 256 LEDs in 16×16 grid
- *
- * Physical layout: 0=top-left, 1=top-right, 2=bottom-right, 3=bottom-left
- * Units 0 and 3 are rotated 90° clockwise due to physical connector alignment
- */
-uint8_t getLEDIndex(uint8_t x, uint8_t y) {
-    if (rgbMatrixUnits == 1) {
-        // Single 8×8 unit: apply same 180° rotation as unit 0
-        uint8_t rotatedX = 7 - x;
-        uint8_t rotatedY = 7 - y;
-        return rotatedY * 8 + rotatedX;
-    } else {
-        // Four 8×8 units in 16×16 grid
-        // Determine which unit and position within that unit
-        uint8_t unitX = x / 8;  // 0 (left) or 1 (right)
-        uint8_t unitY = y / 8;  // 0 (top) or 1 (bottom)
-        uint8_t localX = x % 8; // Position within unit (0-7)
-        uint8_t localY = y % 8;
-
-        // Unit number based on physical layout:
-        // Top row: 0 (left), 1 (right)
-        // Bottom row: 3 (left), 2 (right)
-        uint8_t unit;
-        if (unitY == 0) {
-            // Top row: units 0 and 1
-            unit = unitX;  // 0 or 1
-        } else {
-            // Bottom row: units 3 and 2
-            unit = (unitX == 0) ? 3 : 2;
-        }
-
-        // Apply rotation corrections for units based on physical orientation
-        uint8_t rotatedX = localX;
-        uint8_t rotatedY = localY;
-
-        if (unit == 0 || unit == 3) {
-            // Units 0 and 3: 180° rotation (horizontal + vertical flip)
-            // Rotation formula: (x, y) → (7-x, 7-y)
-            rotatedX = 7 - localX;
-            rotatedY = 7 - localY;
-        }
-
-        // LED index = (unit offset) + (position within unit)
-        return (unit * 64) + (rotatedY * 8) + rotatedX;
+ * Time each canvas operation byte-wise and on bit planes, on a 16×16 corpus
+ * sketch (fills all the canvas_* results). Each timed iteration runs the
+ * operation BENCH_PLANE_REPEAT times.
+ */
+void benchCanvasPlanes(DeviceBenchJob* bench) {
+  Sketch sketch;
+  benchArchiveSketch(0, sketch);
+  uint8_t (&pixels)[16][16] = sketch.pixels;
+  uint8_t other[16][16];
+  memcpy(other, pixels, sizeof(other));
+  other[5][5] ^= 1;
+  CanvasPlanes planes;
+  CanvasPlanes otherPlanes;
+  buildPlanes(planes, pixels);
+  buildPlanes(otherPlanes, other);
+  static bool cells[16][16];
+  CanvasRow rows[16];
+  volatile uint32_t sink = 0;  // Keeps results observable
+
+  benchTime(bench->results[DBENCH_FILL_BYTES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      byteFillRegion(pixels, i % 16, 0, 16, cells);
+      sink = sink + cells[15][15];
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_FILL_PLANES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      planeFillRegion(planes, i % 16, 0, pixels[0][i % 16], 16, 16, rows);
+      sink = sink + rows[15];
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_SELECT_BYTES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      byteSelect(pixels, i % 4, 16, cells);
+      sink = sink + cells[8][8];
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_SELECT_PLANES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      for (int y = 0; y < 16; y++) {
+        rows[y] = planeSelect(planes, i % 4, y, 16);
+      }
+      sink = sink + rows[8];
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_FLIP_BYTES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      byteFlip(pixels, 16);
+    }
+    sink = sink + pixels[0][0];
+    return true;
+  });
+  benchTime(bench->results[DBENCH_FLIP_PLANES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      planeFlip(planes, 16, 16, false);
+    }
+    sink = sink + planes.occupied[0];
+    return true;
+  });
+  benchTime(bench->results[DBENCH_SHIFT_BYTES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      byteShift(pixels, 1, 1, 16);
+    }
+    sink = sink + pixels[0][0];
+    return true;
+  });
+  benchTime(bench->results[DBENCH_SHIFT_PLANES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      planeShift(planes, 1, 1, 16, 16);
+    }
+    sink = sink + planes.occupied[0];
+    return true;
+  });
+  benchTime(bench->results[DBENCH_OUTLINE_BYTES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      byteOutline(pixels, 16, cells);
+      sink = sink + cells[i % 16][0];
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_OUTLINE_PLANES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      planeOutline(planes, 16, 16, rows);
+      sink = sink + rows[i % 16];
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_DIFF_BYTES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      sink = sink + byteDiff(pixels, other, cells);
+    }
+    return true;
+  });
+  benchTime(bench->results[DBENCH_DIFF_PLANES], 10, [&]() {
+    for (int i = 0; i < BENCH_PLANE_REPEAT; i++) {
+      sink = sink + planeDiff(planes, otherPlanes, rows);
     }
+    return true;
+  });
 }
 
 /**
- * Convert RGB565 color to RGB888 for WS2812 LEDs.
- * RGB565: 5 bits red, 6 bits green, 5 bits blue (16-bit)
- * RGB888: 8 bits per channel (24-bit)
- * This expands the color depth from 65K to 16.7M colors.
+ * Time one cell of held-key drawing: a snake over the whole grid, one cell
+ * per iteration, the way the canvas view handled each cell before strokes
+ * (undo snapshot, cell redraw, LED refresh) and as a stroke (dirty cells,
+ * LED refresh capped at STROKE_LED_INTERVAL_MS). The canvas is put back.
  */
-CRGB rgb565ToRGB888(uint16_t rgb565) {
-    uint8_t r = ((rgb565 >> 11) & 0x1F) * 255 / 31;  // 5-bit → 8-bit
-    uint8_t g = ((rgb565 >> 5) & 0x3F) * 255 / 63;   // 6-bit → 8-bit
-    uint8_t b = (rgb565 & 0x1F) * 255 / 31;          // 5-bit → 8-bit
-    return CRGB(r, g, b);
+void benchStrokes(DeviceBenchJob* bench) {
+  uint8_t savedCanvas[16][16];
+  uint8_t savedUndo[16][16];
+  memcpy(savedCanvas, canvas, sizeof(canvas));
+  memcpy(savedUndo, undoCanvas, sizeof(undoCanvas));
+  bool savedUndoAvailable = undoAvailable;
+  int savedX = cursorX;
+  int savedY = cursorY;
+  uint16_t cells = currentGridSize * currentGridSize;
+  uint8_t value = selectedColor;
+
+  for (int pass = 0; pass < 2; pass++) {
+    CanvasRow grid[16] = {0};
+    for (int y = 0; y < currentGridSize; y++) {
+      grid[y] = planeRowMask<CanvasRow>(currentGridSize);
+    }
+    paintCanvasCells(grid, 0);
+    memset(canvasChanged, 0, sizeof(canvasChanged));
+    drawGrid();
+    if (pass == 1) {
+      beginStroke(value);
+    }
+
+    uint16_t cell = 0;
+    benchTime(bench->results[pass ? DBENCH_STROKE_BATCHED : DBENCH_STROKE_UNBATCHED], cells, [&]() {
+      cursorY = cell / currentGridSize;
+      cursorX = (cursorY & 1) ? currentGridSize - 1 - cell % currentGridSize : cell % currentGridSize;
+      cell++;
+      if (pass == 0) {
+        saveUndo();
+        setCanvasCell(cursorX, cursorY, value);
+        drawCell(cursorX, cursorY);
+        drawCursor();
+#if ENABLE_LED_MATRIX
+        updateLEDMatrix();
+#endif
+      } else {
+        strokeCell(cursorX, cursorY);
+        drawChangedCells();
+        drawCursor();
+#if ENABLE_LED_MATRIX
+        if (canvasNeedsUpdate && strokeLEDFlushDue()) {
+          updateLEDMatrix();
+          canvasNeedsUpdate = false;
+        }
+#endif
+      }
+      return true;
+    });
+    endStroke();
+  }
+
+  memcpy(canvas, savedCanvas, sizeof(canvas));
+  memcpy(undoCanvas, savedUndo, sizeof(undoCanvas));
+  syncCanvasPlanes();
+  undoAvailable = savedUndoAvailable;
+  cursorX = savedX;
+  cursorY = savedY;
+  LED_CANVAS_UPDATED();
 }
 
 /**
- * Update the LED matrix to mirror the current canvas.
- * Supports three display modes:
- *   1. 8×8 canvas + 1 unit → 1:1 mapping (8×8 LEDs)
- *   2. 8×8 canvas + 4 units → scaled 2× (16×16 LEDs, each pixel = 2×2 block)
- *   3. 16×16 canvas + 4 units → 1:1 mapping (16×16 LEDs)
- *
- * LED matrix is disabled when:
- *   - LED matrix setting is OFF
- *   - 16×16 canvas with only 1 unit (can't fit)
- *
- * @param showCursor If true, highlights cursor position (default). If false, shows clean canvas.
+ * Run one benchmark from the suite
  */
-void updateLEDMatrix(bool showCursor) {
-    if (!ledMatrixEnabled) {
-        // LED matrix is disabled - turn off all LEDs
-        FastLED.clear();
-        FastLED.show();
-        return;
-    }
+void runDeviceBenchItem(DeviceBenchJob* bench, uint8_t item) {
+  BenchTiming& result = bench->results[item];
+
+  switch (item) {
+    case DBENCH_GRID_REDRAW:
+      // Same full redraw as shake-to-undo
+      benchTime(result, 10, []() {
+        drawGrid();
+        for (int y = 0; y < currentGridSize; y++) {
+          for (int x = 0; x < currentGridSize; x++) {
+            if (canvas[y][x] != 0) {
+              drawCell(x, y);
+            }
+          }
+        }
+        drawCursor();
+        return true;
+      });
+      break;
 
-    // Check if current grid size fits on available LED matrix
-    if (currentGridSize == 16 && rgbMatrixUnits == 1) {
-        // Can't fit 16×16 canvas on 8×8 LED matrix (1 unit)
-        FastLED.clear();
-        FastLED.show();
-        return;
+    case DBENCH_MEMORY_FRAME: {
+      int savedCursor = memoryViewCursor;
+      int savedOffset = memoryViewScrollOffset;
+      float savedPos = memoryViewScrollPos;
+      loadSketchListFromSD();
+      bench->sketchCount = sketchList.size();
+      // Step through the first rows so thumbnails are loaded as in normal use
+      memoryViewCursor = 0;
+      benchTime(result, 10, []() {
+        memoryViewCursor = min(memoryViewCursor + 1, (int)sketchList.size());
+        drawMemoryViewGrid(false);
+        return true;
+      });
+      memoryViewCursor = savedCursor;
+      memoryViewScrollOffset = savedOffset;
+      memoryViewScrollPos = savedPos;
+      releaseSketchList();
+      break;
     }
 
-    // Mirror each canvas cell to the LED matrix
-    // Three display modes:
-    //   1. 8×8 canvas + 1 unit → 1:1 (8×8 LEDs)
-    //   2. 8×8 canvas + 4 units → scaled 2× (16×16 LEDs, each pixel = 2×2 block)
-    //   3. 16×16 canvas + 4 units → 1:1 (16×16 LEDs)
+    case DBENCH_SKETCH_SAVE:
+      benchTime(result, 10, []() {
+        return writeSketchFile(BENCH_SKETCH_PATH, activeSketch);
+      });
+      break;
 
-    uint8_t gridSize = currentGridSize;  // 8 or 16
+    case DBENCH_SKETCH_LOAD:
+      benchTime(result, 10, []() {
+        File file = SD.open(BENCH_SKETCH_PATH, FILE_READ);
+        if (!file) {
+          return false;
+        }
+        SketchFileIndex index;
+        Sketch sketch;
+        bool ok = readSketchFileIndex(file, index) && readSketchFull(file, index, sketch);
+        file.close();
+        return ok;
+      });
+      SD.remove(BENCH_SKETCH_PATH);
+      break;
 
-    for (uint8_t cy = 0; cy < gridSize; cy++) {
-        for (uint8_t cx = 0; cx < gridSize; cx++) {
-            uint8_t pixelValue = canvas[cy][cx];
-            bool isCursor = showCursor && (cx == cursorX && cy == cursorY);
+    case DBENCH_PNG_EXPORT:
+    case DBENCH_QOI_EXPORT:
+    case DBENCH_BMP_EXPORT:
+    case DBENCH_GIF_EXPORT: {
+      // Full 128×128 export through the image pipeline, run without the job queue
+      ImageFormat format = (ImageFormat)(IMAGE_PNG + (item - DBENCH_PNG_EXPORT));
+      static ImageNumbering benchNumbering = {BENCH_DIR, "dx_", StatusMsg::TOO_MANY_EXPORTS, -1};
+      benchTime(result, 3, [format]() {
+        benchNumbering.next = 0;
+        ImagePipeline* p = newCanvasImagePipeline(format, 128 / currentGridSize, benchNumbering);
+        if (!p || !runImagePipeline(p)) {
+          return false;
+        }
+        char path[48];
+        snprintf(path, sizeof(path), BENCH_DIR "/dx_0000.%s", IMAGE_FORMAT_EXT[format]);
+        SD.remove(path);
+        return true;
+      });
+      break;
+    }
 
-            // Determine color for this canvas pixel
-            CRGB color;
-            if (pixelValue == 0) {
-                // Empty cell: show dim white for cursor, black otherwise
-                color = isCursor ? CRGB(40, 40, 40) : CRGB::Black;
-            } else {
-                // Filled cell: use palette color (index 1-16)
-                uint16_t rgb565 = activeSketch.paletteColors[pixelValue - 1];
-                color = rgb565ToRGB888(rgb565);
+    case DBENCH_PNG_512_1_CORE:
+    case DBENCH_PNG_512_2_CORES: {
+      // 512×512 PNG (about 70 stripes): encoding on one core vs both
+      bool singleCore = (item == DBENCH_PNG_512_1_CORE);
+      static ImageNumbering benchNumbering = {BENCH_DIR, "big_", StatusMsg::TOO_MANY_EXPORTS, -1};
+      benchTime(result, 3, [singleCore]() {
+        benchNumbering.next = 0;
+        ImagePipeline* p = newCanvasImagePipeline(IMAGE_PNG, 512 / currentGridSize, benchNumbering);
+        if (!p) {
+          return false;
+        }
+        p->pngSingleCore = singleCore;
+        if (!runImagePipeline(p)) {
+          return false;
+        }
+        SD.remove(BENCH_DIR "/big_0000.png");
+        return true;
+      });
+      break;
+    }
 
-                // Brighten cursor position by adding white
-                if (isCursor) {
-                    color.r = min(255, color.r + 80);
-                    color.g = min(255, color.g + 80);
-                    color.b = min(255, color.b + 80);
-                }
-            }
+#if ENABLE_LED_MATRIX
+    case DBENCH_LED_1_UNIT:
+    case DBENCH_LED_4_UNITS: {
+      // Drive the real pin at full frame size; all-off output if the matrix is disabled
+      uint8_t savedBrightness = ledBrightness;
+      if (!ledMatrixEnabled) {
+        ledBrightness = 0;
+      }
+      bool compiled = (item == DBENCH_LED_1_UNIT)
+                        ? compileLEDLayout(LED_LAYOUT_SINGLE, 1, 1, 1)
+                        : compileLEDLayout(LED_LAYOUT_QUAD, 4, 2, 2);
+      if (compiled) {
+        benchTime(result, 20, []() {
+          renderSketchToLEDs(canvas, currentGridSize, activeSketch.paletteColors, -1, -1);
+          return true;
+        });
+      }
+      ledBrightness = savedBrightness;
+      applyLEDLayout();
+      updateLEDMatrix();
+      break;
+    }
 
-            // Map canvas pixel to LED(s)
-            if (gridSize == 16 && rgbMatrixUnits == 4) {
-                // Mode 3: 16×16 canvas → 16×16 LEDs (1:1 mapping)
-                uint8_t ledIndex = getLEDIndex(cx, cy);
-                leds[ledIndex] = color;
-            } else if (gridSize == 8 && rgbMatrixUnits == 1) {
-                // Mode 1: 8×8 canvas → 8×8 LEDs (1:1 mapping)
-                uint8_t ledIndex = getLEDIndex(cx, cy);
-                leds[ledIndex] = color;
-            } else if (gridSize == 8 && rgbMatrixUnits == 4) {
-                // Mode 2: 8×8 canvas → 16×16 LEDs (scale 2×)
-                // Each canvas pixel becomes a 2×2 block of LEDs
-                for (uint8_t dy = 0; dy < 2; dy++) {
-                    for (uint8_t dx = 0; dx < 2; dx++) {
-                        uint8_t ledX = cx * 2 + dx;
-                        uint8_t ledY = cy * 2 + dy;
-                        uint8_t ledIndex = getLEDIndex(ledX, ledY);
-                        leds[ledIndex] = color;
-                    }
-                }
+    case DBENCH_LED_PLAYLIST_4_UNITS: {
+      // Same wall and pin as led_refresh_4_units, from 8 frames compiled
+      // from the canvas (shifted a cell each), so the two can be compared
+      uint8_t savedBrightness = ledBrightness;
+      if (!ledMatrixEnabled) {
+        ledBrightness = 0;
+      }
+      stopLEDPlaylist();
+      if (compileLEDLayout(LED_LAYOUT_QUAD, 4, 2, 2) && allocLEDPlaylist(8)) {
+        for (uint16_t f = 0; f < ledPlaylist.count; f++) {
+          Sketch& source = ledPlaylist.slots[f].source;
+          source = activeSketch;
+          for (int y = 0; y < 16; y++) {
+            for (int x = 0; x < 16; x++) {
+              source.pixels[y][x] = canvas[y][(x + f) % currentGridSize];
             }
+          }
+          source.gridSize = currentGridSize;
+          bakeLEDPlaylistFrame(f);
         }
+        ledPlaylist.ready = ledPlaylist.count;
+        uint16_t frame = 0;
+        benchTime(result, 20, [&frame]() {
+          showLEDPlaylistFrame(frame++ % ledPlaylist.count);
+          return true;
+        });
+      }
+      ledBrightness = savedBrightness;
+      applyLEDLayout();  // Frees the playlist too
+      updateLEDMatrix();
+      break;
     }
+#endif
 
-    // Update the physical LEDs
-    FastLED.show();
-}
-
-/**
- * Update the LED matrix to display a sketch (for preview mode).
- * Supports three display modes:
- *   1. 8×8 sketch + 1 unit → 1:1 mapping (8×8 LEDs)
- *   2. 8×8 sketch + 4 units → scaled 2× (16×16 LEDs, each pixel = 2×2 block)
- *   3. 16×16 sketch + 4 units → 1:1 mapping (16×16 LEDs)
- *
- * LED matrix is disabled when:
- *   - LED matrix setting is OFF
- *   - 16×16 sketch with only 1 unit (can't fit)
- *
- * Used for both canvas preview and gallery preview modes.
- */
-void updateLEDMatrixFromSketch(Sketch& sketch) {
-    if (!ledMatrixEnabled) {
-        // LED matrix is disabled - turn off all LEDs
-        FastLED.clear();
-        FastLED.show();
-        return;
+    case DBENCH_PALETTE_FRAME: {
+      if (!paletteCanvas.createSprite(240, 135)) {
+        break;
+      }
+      paletteCanvasAvailable = true;
+      updatePaletteFilter();
+      int savedCursor = paletteViewCursor;
+      float savedPos = paletteViewScrollPos;
+      // Frames caught halfway through a carousel scroll
+      paletteViewCursor = 0;
+      benchTime(result, 10, []() {
+        paletteViewCursor = (paletteViewCursor + 1) % max(1, (int)filteredPaletteCount);
+        paletteViewScrollPos = paletteViewCursor - 0.5f;
+        drawPaletteView(false);
+        return true;
+      });
+      paletteViewCursor = savedCursor;
+      paletteViewScrollPos = savedPos;
+      paletteCanvas.deleteSprite();
+      paletteCanvasAvailable = false;
+      releaseCartridgeBuffer();
+      break;
     }
 
-    // Check if sketch grid size fits on available LED matrix
-    if (sketch.gridSize == 16 && rgbMatrixUnits == 1) {
-        // Can't fit 16×16 sketch on 8×8 LED matrix (1 unit)
-        FastLED.clear();
-        FastLED.show();
-        return;
+    case DBENCH_SHEET_IMPORT: {
+      // Whole-sheet import into a scratch library, driving the job's step directly
+      if (!writeBenchSheet(BENCH_SHEET_DIR "/bench@16.png")) {
+        break;
+      }
+      sketchRoot = BENCH_SHEET_DIR "/out";
+      SD.mkdir(sketchRoot);
+      unsigned long lastId = 0;
+      benchTime(result, 1, [&lastId]() {
+        SheetImportJob* im = new SheetImportJob();
+        im->dir = BENCH_SHEET_DIR;
+        im->scratch = true;
+        im->sheetCount = 1;
+        Job importJob = {"Import", sheetImportStep, sheetImportFinish, im, 0, false};
+        JobState state = JOB_RUNNING;
+        while (state == JOB_RUNNING) {
+          state = sheetImportStep(importJob);
+        }
+        lastId = im->lastId;
+        closeImportSheet(im);
+        delete im;
+        return state == JOB_DONE;
+      });
+      for (unsigned long id = 1; id <= lastId; id++) {
+        SD.remove(sketchPath("sketch_" + String(id) + ".dat").c_str());
+      }
+      for (unsigned long shard = 0; shard <= lastId / SKETCHES_PER_SHARD; shard++) {
+        SD.rmdir(sketchShardPath(shard * SKETCHES_PER_SHARD).c_str());
+      }
+      SD.rmdir(sketchRoot);
+      sketchRoot = SKETCH_DIR;
+      SD.remove(BENCH_SHEET_DIR "/bench@16.png");
+      SD.rmdir(BENCH_SHEET_DIR);
+      break;
     }
 
-    // Mirror each sketch cell to the LED matrix
-    // Three display modes:
-    //   1. 8×8 sketch + 1 unit → 1:1 (8×8 LEDs)
-    //   2. 8×8 sketch + 4 units → scaled 2× (16×16 LEDs, each pixel = 2×2 block)
-    //   3. 16×16 sketch + 4 units → 1:1 (16×16 LEDs)
+    case DBENCH_MURAL_PAN: {
+      // Serpentine pans over a fully painted 8×8-chunk corner of a scratch mural,
+      // so every cache miss reads a chunk from SD
+      SD.remove(BENCH_MURAL_PATH);
+      if (!openMural(BENCH_MURAL_PATH)) {
+        break;
+      }
+      int savedX = muralViewX;
+      int savedY = muralViewY;
+      const int area = 8 * MURAL_CHUNK_SIZE;
+      for (int y = 0; y < area; y++) {
+        for (int x = 0; x < area; x++) {
+          setMuralCell(x, y, 1 + (x / 3 + y / 5) % activeSketch.paletteSize);
+        }
+      }
+      bool ok = flushMural();
+      muralViewX = 0;
+      muralViewY = 0;
+      mural.stats = {};
+      int step = MURAL_PAN_STEP;
+      if (ok) {
+        benchTime(result, 60, [&step, area]() {
+          if (muralViewX + step < 0 || muralViewX + step > area - MURAL_VIEW) {
+            step = -step;
+            panMural(0, MURAL_PAN_STEP);
+          } else {
+            panMural(step, 0);
+          }
+          return true;
+        });
+      }
+      bench->mural = mural.stats;
+      releaseMural();
+      SD.remove(BENCH_MURAL_PATH);
+      muralViewX = savedX;
+      muralViewY = savedY;
+      break;
+    }
 
-    uint8_t gridSize = sketch.gridSize;  // 8 or 16
+    case DBENCH_ARCHIVE_ENCODE:
+      benchLibraryArchive(bench);  // Also fills the other three archive/deflate results
+      break;
 
-    for (uint8_t sy = 0; sy < gridSize; sy++) {
-        for (uint8_t sx = 0; sx < gridSize; sx++) {
-            uint8_t pixelValue = sketch.pixels[sy][sx];
+    case DBENCH_FILL_BYTES:
+      benchCanvasPlanes(bench);  // Fills all the canvas_* results
+      break;
 
-            // Determine color for this sketch pixel
-            CRGB color;
-            if (pixelValue == 0) {
-                // Empty cell: black (no cursor in preview mode)
-                color = CRGB::Black;
-            } else {
-                // Filled cell: use palette color (index 1-16)
-                uint16_t rgb565 = sketch.paletteColors[pixelValue - 1];
-                color = rgb565ToRGB888(rgb565);
-            }
+    case DBENCH_STROKE_UNBATCHED:
+      benchStrokes(bench);  // Also fills stroke_cell_batched
+      break;
 
-            // Map sketch pixel to LED(s)
-            if (gridSize == 16 && rgbMatrixUnits == 4) {
-                // Mode 3: 16×16 sketch → 16×16 LEDs (1:1 mapping)
-                uint8_t ledIndex = getLEDIndex(sx, sy);
-                leds[ledIndex] = color;
-            } else if (gridSize == 8 && rgbMatrixUnits == 1) {
-                // Mode 1: 8×8 sketch → 8×8 LEDs (1:1 mapping)
-                uint8_t ledIndex = getLEDIndex(sx, sy);
-                leds[ledIndex] = color;
-            } else if (gridSize == 8 && rgbMatrixUnits == 4) {
-                // Mode 2: 8×8 sketch → 16×16 LEDs (scale 2×)
-                // Each sketch pixel becomes a 2×2 block of LEDs
-                for (uint8_t dy = 0; dy < 2; dy++) {
-                    for (uint8_t dx = 0; dx < 2; dx++) {
-                        uint8_t ledX = sx * 2 + dx;
-                        uint8_t ledY = sy * 2 + dy;
-                        uint8_t ledIndex = getLEDIndex(ledX, ledY);
-                        leds[ledIndex] = color;
-                    }
-                }
+    case DBENCH_SHARED_PALETTE: {
+      // Counting and clustering for a 16-color shared palette over the
+      // archive corpus, in memory (reading the files is sketch_load's cost)
+      SharedPaletteJob* sp = new SharedPaletteJob();
+      sp->colors = (SharedColor*)scopedAlloc(SHARED_MAX_COLORS * sizeof(SharedColor));
+      if (sp->colors) {
+        benchTime(result, 1, [sp]() {
+          memset(sp->colors, 0, SHARED_MAX_COLORS * sizeof(SharedColor));
+          sp->colorCount = 0;
+          sp->size = 16;
+          for (int i = 0; i < 2048; i++) {
+            Sketch sketch;
+            benchArchiveSketch(i, sketch);
+            countSketchColors(sp, sketch);
+          }
+          packSharedColors(sp);
+          splitSharedColors(sp);
+          for (sp->iteration = 0; sp->iteration < SHARED_MAX_ITERATIONS; sp->iteration++) {
+            if (refineSharedColors(sp)) {
+              break;
             }
-        }
+          }
+          pickSharedPalette(sp);
+          return true;
+        });
+        scopedFree(sp->colors, SHARED_MAX_COLORS * sizeof(SharedColor));
+      }
+      delete sp;
+      break;
     }
-
-    // Update the physical LEDs
-    FastLED.show();
+  }
 }
 
 /**
- * Toggle LED matrix on/off with visual feedback.
- * Shows brief status message on main display.
+ * Write the JSON report to the first free device_NNN.json
  */
-void toggleLEDMatrix() {
-    ledMatrixEnabled = !ledMatrixEnabled;
-
-    // Save preference
-    preferences.begin("bitmap16dx", false);
-    preferences.putBool("ledEnabled", ledMatrixEnabled);
-    preferences.end();
-
-    // Visual feedback
-    if (ledMatrixEnabled) {
-        // Show a brief "DX" pattern to confirm hardware is working
-        // Pattern displays as a simple checkmark/confirmation graphic
-        FastLED.clear();
-
-        // Set brightness to 10% for startup pattern
-        FastLED.setBrightness((10 * 255) / 100);
-
-        // Define the "DX" pattern LEDs (in non-rotated coordinates)
-        // Pattern:  . X X .   X . X .
-        //           . X . X   . X . .
-        //           . X X .   X . X .
-        const int dxPattern[] = {9, 10, 17, 19, 25, 26, 36, 38, 45, 52, 54};
-        const int patternSize = 11;
-
-        // Light up the pattern with white
-        // Apply the same rotation used for unit 0 to keep pattern oriented correctly
-        for (int i = 0; i < patternSize; i++) {
-            int index = dxPattern[i];
-
-            // Convert linear index to x, y coordinates (8×8 grid)
-            uint8_t x = index % 8;
-            uint8_t y = index / 8;
-
-            // Apply 180° rotation (same as unit 0 in getLEDIndex)
-            uint8_t rotatedX = 7 - x;
-            uint8_t rotatedY = 7 - y;
+bool writeDeviceBenchReport(DeviceBenchJob* bench) {
+  char path[48];
+  int reportNum = 0;
+  do {
+    snprintf(path, sizeof(path), BENCH_DIR "/device_%03d.json", reportNum++);
+  } while (SD.exists(path) && reportNum < 1000);
 
-            // Convert back to linear index
-            int rotatedIndex = rotatedY * 8 + rotatedX;
+  File file = SD.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
 
-            leds[rotatedIndex] = CRGB::White;
-        }
-        FastLED.show();
-        delay(1000);  // Hold pattern for 1 second
+  char line[128];
+  file.print("{\n");
+  snprintf(line, sizeof(line), "  \"firmware\": \"%s\",\n  \"board\": \"%s\",\n", FIRMWARE_VERSION, detectedBoardName);
+  file.print(line);
+  snprintf(line, sizeof(line), "  \"cpu_mhz\": %lu,\n  \"sd_card_mb\": %lu,\n",
+           (unsigned long)ESP.getCpuFreqMHz(), (unsigned long)(SD.cardSize() / (1024 * 1024)));
+  file.print(line);
+  snprintf(line, sizeof(line), "  \"grid_size\": %d,\n  \"sketch_count\": %u,\n", currentGridSize, bench->sketchCount);
+  file.print(line);
+  // Time to interactive: millis() at the first frame, resumed from a snapshot or cold (boot screen included)
+  snprintf(line, sizeof(line), "  \"boot\": {\"ready_ms\": %lu, \"resumed\": %s},\n",
+           (unsigned long)bootReadyMs, bootResumed ? "true" : "false");
+  file.print(line);
+  snprintf(line, sizeof(line), "  \"heap\": {\"free\": %lu, \"min_free\": %lu, \"max_block\": %lu},\n",
+           (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(), (unsigned long)ESP.getMaxAllocHeap());
+  file.print(line);
+  snprintf(line, sizeof(line), "  \"scoped_buffers\": {\"held\": %lu, \"peak\": %lu},\n",
+           (unsigned long)scopedBufferBytes, (unsigned long)scopedBufferPeak);
+  file.print(line);
+
+  const char* readKinds[SKETCH_READ_KINDS] = {"index", "preview", "full"};
+  file.print("  \"sketch_reads\": {");
+  for (int k = 0; k < SKETCH_READ_KINDS; k++) {
+    snprintf(line, sizeof(line), "%s\"%s\": {\"reads\": %lu, \"bytes\": %lu}", k ? ", " : "", readKinds[k],
+             (unsigned long)sketchReadStats[k].reads, (unsigned long)sketchReadStats[k].bytes);
+    file.print(line);
+  }
+  file.print("},\n");
+
+  snprintf(line, sizeof(line), "  \"mural_cache\": {\"hits\": %lu, \"misses\": %lu, \"sd_reads\": %lu, \"pans\": %lu},\n",
+           (unsigned long)bench->mural.hits, (unsigned long)bench->mural.misses,
+           (unsigned long)bench->mural.reads, (unsigned long)bench->mural.pans);
+  file.print(line);
+  // Throughput is raw_bytes over the archive_/deflate_ timings
+  snprintf(line, sizeof(line), "  \"library_archive\": {\"sketches\": %d, \"raw_bytes\": %lu, \"archive_bytes\": %lu, \"deflate_bytes\": %lu},\n",
+           BENCH_ARCHIVE_SKETCHES, (unsigned long)bench->archiveRawBytes,
+           (unsigned long)bench->archiveBytes, (unsigned long)bench->deflateBytes);
+  file.print(line);
+
+  file.print("  \"results\": [\n");
+  bool first = true;
+  for (uint8_t i = 0; i < DBENCH_COUNT; i++) {
+    BenchTiming& r = bench->results[i];
+    if (r.iterations == 0) {
+      continue;  // Skipped (feature disabled or failed)
+    }
+    snprintf(line, sizeof(line), "%s    {\"name\": \"%s\", \"iterations\": %u, \"avg_us\": %lu, \"max_us\": %lu}",
+             first ? "" : ",\n", DEVICE_BENCH_NAMES[i], r.iterations,
+             (unsigned long)(r.totalUs / r.iterations), (unsigned long)r.maxUs);
+    file.print(line);
+    first = false;
+  }
+  file.print("\n  ]\n}\n");
+  file.close();
+  return true;
+}
 
-        // Restore user's brightness setting
-        FastLED.setBrightness((ledBrightness * 255) / 100);
+JobState deviceBenchStep(Job& job) {
+  DeviceBenchJob* bench = (DeviceBenchJob*)job.context;
+  if (bench->next >= DBENCH_COUNT) {
+    return writeDeviceBenchReport(bench) ? JOB_DONE : JOB_FAILED;
+  }
+  runDeviceBenchItem(bench, bench->next++);
+  job.progress = bench->next * 100 / (DBENCH_COUNT + 1);
+  return JOB_RUNNING;
+}
 
-        // Turn on: immediately update LEDs with current canvas
-        LED_CANVAS_UPDATED();
-        updateLEDMatrix();
-    } else {
-        // Turn off: clear all LEDs
-        FastLED.clear();
-        FastLED.show();
-    }
+void deviceBenchFinish(Job& job, JobState state) {
+  free(job.context);
+  if (state == JOB_DONE) {
+    setStatusMessage(StatusMsg::BENCH_DONE);
+  } else if (state == JOB_FAILED) {
+    setStatusMessage(StatusMsg::BENCH_FAIL);
+  }
+  // The suite draws over the screen
+  if (inSettingsView) {
+    drawSettingsView();
+  }
 }
 
 /**
- * Adjust LED matrix brightness.
- * @param delta: +1 to increase, -1 to decrease
+ * Start the device benchmark suite (ESC cancels)
  */
-void adjustLEDBrightness(int8_t delta) {
-    if (!ledMatrixEnabled) return;  // No-op if disabled
-
-    // Adjust brightness in 1% increments
-    int16_t newBrightness = ledBrightness + delta;
-
-    // Clamp to valid range
-    if (newBrightness < MIN_LED_BRIGHTNESS) {
-        newBrightness = MIN_LED_BRIGHTNESS;
-    } else if (newBrightness > MAX_LED_BRIGHTNESS) {
-        newBrightness = MAX_LED_BRIGHTNESS;
-    }
-
-    ledBrightness = (uint8_t)newBrightness;
-
-    // Apply new brightness (FastLED uses 0-255 scale)
-    FastLED.setBrightness((ledBrightness * 255) / 100);
-    FastLED.show();  // Refresh LEDs with new brightness
+bool startDeviceBench() {
+  if (!sdCardAvailable && !initSDCard()) {
+    setStatusMessage(StatusMsg::SD_NOT_READY);
+    return false;
+  }
+  if (!SD.exists(BENCH_DIR) && !SD.mkdir(BENCH_DIR)) {
+    setStatusMessage(StatusMsg::BENCH_FAIL);
+    return false;
+  }
 
-    // Save preference
-    preferences.begin("bitmap16dx", false);
-    preferences.putUChar("ledBright", ledBrightness);
-    preferences.end();
+  DeviceBenchJob* bench = (DeviceBenchJob*)calloc(1, sizeof(DeviceBenchJob));
+  if (!bench) {
+    setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+    return false;
+  }
+  if (!startJob("Bench", deviceBenchStep, deviceBenchFinish, bench)) {
+    free(bench);
+    return false;
+  }
+  return true;
 }
-#endif // ENABLE_LED_MATRIX
+#endif // ENABLE_DEVICE_BENCH
 
 // setup() runs once when the device boots
 void setup() {
@@ -4689,7 +12285,9 @@ void setup() {
   defaultGridSize = preferences.getUChar("defaultGrid", 8);      // Default: 8×8
   rgbMatrixUnits = preferences.getUChar("puzzleUnits", 1);       // Default: 1 unit (64 LEDs)
   exportRGB565 = preferences.getBool("exportRGB565", false);     // Default: RGB888
+  exportFormat = preferences.getUChar("exportType", 0) % IMAGE_FORMAT_COUNT;  // Default: PNG
   shakeUndoEnabled = preferences.getBool("shakeUndo", false);    // Default: disabled
+  preferences.getString("collection", activeCollection, sizeof(activeCollection));  // Default: all sketches
 
   preferences.end();
 
@@ -4703,13 +12301,17 @@ void setup() {
   preferences.begin("bitmap16dx", true);  // Read-only
   ledMatrixEnabled = preferences.getBool("ledEnabled", false);  // Default: OFF
   ledBrightness = preferences.getUChar("ledBright", DEFAULT_LED_BRIGHTNESS);
+  ledPlaylistRate = min((int)preferences.getUChar("ledFps", 1), (int)sizeof(LED_PLAYLIST_FPS) - 1);
   preferences.end();
 
   // Configure FastLED for WS2812 LEDs
   // WS2812E uses GRB color order
-  // Always initialize with maximum LED count (256)
-  // Active LEDs are controlled by rgbMatrixUnits setting
-  FastLED.addLeds<WS2812, LED_PIN, GRB>(leds, 256);
+  // The buffer is sized by the layout; a custom SD layout is applied once the card is up.
+  // With the matrix off no buffer is allocated until it's turned on.
+  if (rgbMatrixUnits != LED_LAYOUT_CUSTOM) {
+    applyLEDLayout();
+  }
+  ledController = &FastLED.addLeds<WS2812, LED_PIN, GRB>(leds, ledCount);
   FastLED.setBrightness((ledBrightness * 255) / 100);
   FastLED.clear();
   FastLED.show();
@@ -4722,12 +12324,15 @@ void setup() {
   btHasBondedDevice = preferences.getBool("btHasBonded", false);
   if (btHasBondedDevice) {
     preferences.getBytes("btBonded", btBondedAddr, 6);
+    btBondedType = preferences.getUChar("btBondedType", 0);
   }
   preferences.end();
 
-  // Note: BLE stack is only initialized when scanning to save memory
-  // Auto-reconnect would require async scanning which blocks
-  // For now, user must manually scan from Settings
+  // The BLE stack is only brought up while scanning or connected.
+  // Reconnect to a bonded keyboard in the background (see btUpdate).
+  if (btEnabled && btHasBondedDevice) {
+    btStartReconnect();
+  }
 #endif // ENABLE_BLUETOOTH
 
   // Initialize palette system
@@ -4738,8 +12343,12 @@ void setup() {
     loadUserPalettes();
   }
 
-  // Show boot screen with logo
-  showBootScreen();
+#if ENABLE_LED_MATRIX
+  // Custom LED wall layouts live on the SD card
+  if (rgbMatrixUnits == LED_LAYOUT_CUSTOM) {
+    applyLEDLayout();
+  }
+#endif
 
   // Note: Canvas sprites (palette, settings, memory) are created on-demand
   // when entering each view to conserve memory (~64KB each)
@@ -4749,8 +12358,20 @@ void setup() {
   // Initialize active sketch as blank
   initializeActiveSketch();
 
-  // Create new blank sketch (will use defaultGridSize from settings)
-  createNewSketch();
+  // Resume the last session if there's a snapshot; otherwise show the boot
+  // screen and start a new blank sketch (will use defaultGridSize from settings)
+  bootResumed = restoreSessionSnapshot();
+  if (!bootResumed) {
+    showBootScreen();
+    createNewSketch();
+  }
+  sessionLastInputMs = millis();
+
+  // The snapshot was taken in the memory view or mural: open it directly
+  if (bootResumed && enterSessionView()) {
+    bootReadyMs = millis();
+    return;
+  }
 
   // Clear the screen to background color
   M5Cardputer.Display.fillScreen(currentTheme->background);
@@ -4770,13 +12391,12 @@ void setup() {
   drawCursor();
 
   // Draw icons in upper left corner
-  drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-  drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-  drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
-  // drawIcon(3, 84, ICON_INFO, ICON_INFO_WIDTH, ICON_INFO_HEIGHT, ICON_INFO_IS_INDEXED);
+  drawToolIcons();
 
   // Draw initial battery indicator
   drawBatteryIndicator();
+
+  bootReadyMs = millis();
 }
 
 // ============================================================================
@@ -4800,7 +12420,7 @@ void handleChargingMode(Keyboard_Class::KeysState& status) {
   if (M5Cardputer.Keyboard.isPressed()) {
     chargeWaitingForRelease = true;
     exitChargingMode();
-    delay(200);
+    loopDelay(200);
     return;
   }
 
@@ -4922,9 +12542,9 @@ void handleChargingMode(Keyboard_Class::KeysState& status) {
  */
 void handleHelpView(Keyboard_Class::KeysState& status) {
 #if ENABLE_LED_MATRIX
-  const int totalHelpItems = 21;
+  const int totalHelpItems = 27;
 #else
-  const int totalHelpItems = 19;
+  const int totalHelpItems = 25;
 #endif
 
   static bool prevUp = false;
@@ -4940,7 +12560,7 @@ void handleHelpView(Keyboard_Class::KeysState& status) {
     for (auto i : status.word) {
       if (i == '`' || i == 'h' || i == 'H') {
         exitHelpView();
-        delay(200);
+        loopDelay(200);
         return;
       }
 #if ENABLE_SCREENSHOTS
@@ -5009,20 +12629,20 @@ void handleHelpView(Keyboard_Class::KeysState& status) {
   }
   btPrevEscHelp = btEscape;
 
-  if (btUp && !btPrevUpHelp && helpViewCursor > 0) {
+  if (btArrowUp && !btPrevUpHelp && helpViewCursor > 0) {
     helpViewCursor--;
     drawHelpView();
   }
-  btPrevUpHelp = btUp;
+  btPrevUpHelp = btArrowUp;
 
-  if (btDown && !btPrevDownHelp && helpViewCursor < totalHelpItems - 1) {
+  if (btArrowDown && !btPrevDownHelp && helpViewCursor < totalHelpItems - 1) {
     helpViewCursor++;
     drawHelpView();
   }
-  btPrevDownHelp = btDown;
+  btPrevDownHelp = btArrowDown;
 
   char btChar;
-  while ((btChar = btQueuePop()) != '\0') {
+  while (btQueuePop(btChar)) {
     if (btChar == 'h' || btChar == 'H') {
       exitHelpView();
       return;
@@ -5030,7 +12650,116 @@ void handleHelpView(Keyboard_Class::KeysState& status) {
   }
 #endif
 
-  delay(10);
+  loopDelay(10);
+}
+
+/**
+ * Open, move to or copy to the collection chosen in the picker
+ * @param name collection name, or "" for all sketches
+ */
+void applyCollectionPick(const char* name) {
+  if (collectionPicker.action == PICK_OPEN) {
+    if (strcmp(name, activeCollection) != 0) {
+      setActiveCollection(name);
+      memoryViewCursor = 0;
+      memoryViewScrollOffset = 0;
+      memoryViewScrollPos = 0;
+      rememberMemoryViewCursor();
+      startSketchScan(memoryScan, activeCollection);
+    }
+    return;
+  }
+
+  int sketchIndex = memoryViewCursor - 1;
+  if (sketchIndex < 0 || sketchIndex >= (int)sketchList.size()) {
+    return;
+  }
+  uint32_t id = sketchList[sketchIndex].timestamp;
+  bool leaving = collectionPicker.action == PICK_MOVE && activeCollection[0] != '\0' &&
+                 strcmp(name, activeCollection) != 0;
+
+  // Only the indexes change; the sketch file itself is never rewritten
+  bool ok = true;
+  if (name[0] != '\0') {
+    ok = addToCollection(name, id);
+  }
+  if (ok && leaving) {
+    ok = removeFromCollection(activeCollection, id);
+    if (ok) {
+      sketchList.erase(sketchList.begin() + sketchIndex);
+      memoryViewCursor = min(memoryViewCursor, (int)sketchList.size());
+      rememberMemoryViewCursor();
+    }
+  }
+  if (!ok) {
+    setStatusMessage(StatusMsg::WRITE_FAIL);
+  } else {
+    setStatusMessage(collectionPicker.action == PICK_MOVE ? StatusMsg::MOVED : StatusMsg::COPIED);
+  }
+}
+
+/**
+ * Handle keys while the collection picker is open
+ * @return true if the picker needs a redraw
+ */
+bool handleCollectionPicker(Keyboard_Class::KeysState& status) {
+  if (!M5Cardputer.Keyboard.isChange() || !M5Cardputer.Keyboard.isPressed()) {
+    return false;
+  }
+  CollectionPicker& picker = collectionPicker;
+  int newRow = picker.count + 1;
+
+  if (picker.naming) {
+    size_t len = strlen(picker.newName);
+    if (status.enter && len > 0) {
+      char name[COLLECTION_NAME_MAX + 1];
+      strcpy(name, picker.newName);
+      applyCollectionPick(name);
+      closeCollectionPicker();
+    } else if (status.del && len > 0) {
+      picker.newName[len - 1] = '\0';
+    } else {
+      for (auto i : status.word) {
+        if (i == '`') {
+          picker.naming = false;
+          picker.newName[0] = '\0';
+        } else if ((isalnum((unsigned char)i) || i == '-' || i == '_') && len < COLLECTION_NAME_MAX) {
+          picker.newName[len++] = i;  // Names become file names, so keep them plain
+          picker.newName[len] = '\0';
+        }
+      }
+    }
+    return true;
+  }
+
+  if (status.enter) {
+    if (picker.cursor == newRow) {
+      if (picker.count >= MAX_COLLECTIONS) {
+        setStatusMessage(StatusMsg::TOO_MANY_COLLECTIONS);
+      } else {
+        picker.naming = true;
+      }
+      return true;
+    }
+    char name[COLLECTION_NAME_MAX + 1] = "";
+    if (picker.cursor > 0) {
+      strcpy(name, picker.names[picker.cursor - 1]);
+    }
+    applyCollectionPick(name);
+    closeCollectionPicker();
+    return true;
+  }
+  for (auto i : status.word) {
+    if (i == '`' || i == 'k' || i == 'K') {
+      closeCollectionPicker();
+      return true;
+    } else if (i == ';' && picker.cursor > 0) {  // Up
+      picker.cursor--;
+    } else if (i == '.' && picker.cursor < newRow) {  // Down
+      picker.cursor++;
+    }
+  }
+  return true;
 }
 
 /**
@@ -5040,6 +12769,23 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
   // Handle memory view controls
   static bool memoryViewNeedsRedraw = true;
   static int lastMemoryViewCursor = -1;
+  static SharedPalettePrompt sharedPalettePrompt = SHARED_PROMPT_NONE;
+
+  // List more of the library (entries appear as they're found)
+  updateMemoryViewScan();
+  int cursorBeforeInput = memoryViewCursor;
+
+  // The collection picker takes all keys while it's open
+  if (collectionPicker.open) {
+    if (handleCollectionPicker(status)) {
+      drawMemoryView(true);
+      memoryViewNeedsRedraw = true;  // Back to the normal redraw once it closes
+      lastMemoryViewCursor = -1;
+      loopDelay(150);
+    }
+    loopDelay(10);
+    return;
+  }
 
   // Check if scroll animation is in progress
   bool isScrolling = fabs(memoryViewScrollPos - (float)memoryViewScrollOffset) > 0.5f;
@@ -5086,7 +12832,14 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
     int sketchIndex = memoryViewCursor - 1;
     if (sketchIndex < sketchList.size()) {
       // Save sketch to undo buffer before deleting (so we can restore with Z)
-      Sketch& sketchData = sketchList[sketchIndex].sketchData;
+      // The cached preview has no pixels outside the visible grid, so read the full sketch
+      String filename = sketchPath(sketchList[sketchIndex].filename);
+      Sketch sketchData = sketchList[sketchIndex].sketchData;
+      File file = SD.open(filename.c_str(), FILE_READ);
+      if (file) {
+        readSketchFull(file, sketchList[sketchIndex].fileIndex, sketchData);
+        file.close();
+      }
 
       // Copy pixel data to undo buffer
       for (int y = 0; y < 16; y++) {
@@ -5103,20 +12856,24 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
       undoGridSize = sketchData.gridSize;
       undoAvailable = true;
 
-      // Now delete the file
-      String filename = "/bitmap16dx/sketches/" + sketchList[sketchIndex].filename;
+      // Now delete the file and drop it from the list
+      // (other collections drop the ID the next time they're opened)
       SD.remove(filename.c_str());
-      loadSketchListFromSD();  // Refresh list (clears cached data)
+      if (activeCollection[0] != '\0') {
+        removeFromCollection(activeCollection, sketchList[sketchIndex].timestamp);
+      }
+      sketchList.erase(sketchList.begin() + sketchIndex);
 
       // Move cursor if we deleted the last item
       int totalItems = 1 + sketchList.size();
       if (memoryViewCursor >= totalItems) {
         memoryViewCursor = totalItems - 1;
       }
+      rememberMemoryViewCursor();
     }
     memoryViewNeedsRedraw = true;
     lastMemoryViewCursor = -1;
-    delay(200);  // Debounce
+    loopDelay(200);  // Debounce
   }
 
   if (M5Cardputer.Keyboard.isPressed()) {
@@ -5135,12 +12892,25 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
       exitMemoryView();
       memoryViewNeedsRedraw = true;
       lastMemoryViewCursor = -1;
-      delay(200);  // Debounce
+      loopDelay(200);  // Debounce
       return;
     }
 
     // Check for character keys
     for (auto i : status.word) {
+      // Palette size after P / Fn+P: 4, 8 or 1 (16); anything else cancels
+      if (sharedPalettePrompt) {
+        uint8_t size = (i == '4') ? 4 : (i == '8') ? 8 : (i == '1') ? 16 : 0;
+        if (size) {
+          startSharedPalette(size, sharedPalettePrompt == SHARED_PROMPT_REMAP);
+        } else {
+          statusMessageTime = millis() - STATUS_DISPLAY_DURATION;  // Drop the prompt
+        }
+        sharedPalettePrompt = SHARED_PROMPT_NONE;
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+        return;
+      }
       // Z key - Undo (restore last cleared sketch from memory view)
       if (i == 'z' || i == 'Z') {
         if (undoAvailable) {
@@ -5163,6 +12933,7 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
               canvas[y][x] = undoCanvas[y][x];
             }
           }
+          syncCanvasPlanes();
 
           // Restore palette information to active sketch
           activeSketch.paletteSize = undoPaletteSize;
@@ -5182,18 +12953,19 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
             }
           }
           activeSketch.gridSize = currentGridSize;
-          saveActiveSketchToSD();
-
-          // Reload sketch list to show the restored sketch
-          loadSketchListFromSD();
+          // Add the restored sketch to the list
+          if (saveActiveSketchToSD()) {
+            addSketchToList(activeSketchFilename);
+            syncMemoryViewCursor();  // Stay on the same sketch
+          }
 
           setStatusMessage(StatusMsg::RESTORED_SKETCH);
           memoryViewNeedsRedraw = true;
           lastMemoryViewCursor = -1;
-          delay(200);  // Debounce
+          loopDelay(200);  // Debounce
         } else {
           setStatusMessage(StatusMsg::NO_UNDO);
-          delay(200);  // Debounce
+          loopDelay(200);  // Debounce
         }
       }
       // ` key (ESC) or O key - exit memory view
@@ -5202,24 +12974,130 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
         exitMemoryView();
         memoryViewNeedsRedraw = true;
         lastMemoryViewCursor = -1;
-        delay(200);  // Debounce
+        loopDelay(200);  // Debounce
         return;
       }
       // I key - Open help view
       else if (i == 'h' || i == 'H') {
         enterHelpView();
-        delay(200);  // Debounce
+        loopDelay(200);  // Debounce
         return;  // Exit memory view loop to enter help view mode
       }
+      // Fn+I - Show how long the memory view took to open: first frame,
+      // whole library listed (0 while still scanning), and sketch count
+      else if ((i == 'i' || i == 'I') && status.fn) {
+        char scanMsg[32];
+        snprintf(scanMsg, sizeof(scanMsg), StatusMsg::SCAN_STATS_FMT,
+                 lastSketchScanStats.firstFrameMs, lastSketchScanStats.completeMs,
+                 (unsigned long)lastSketchScanStats.count);
+        setStatusMessage(scanMsg);
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+      // I key - Show average bytes read per sketch file operation
+      // (list index / thumbnail preview / full open) since boot
+      else if (i == 'i' || i == 'I') {
+        uint32_t avg[SKETCH_READ_KINDS];
+        for (int k = 0; k < SKETCH_READ_KINDS; k++) {
+          avg[k] = sketchReadStats[k].reads ? sketchReadStats[k].bytes / sketchReadStats[k].reads : 0;
+        }
+        char readMsg[32];
+        snprintf(readMsg, sizeof(readMsg), "Rd L%lu T%lu O%lu",
+                 (unsigned long)avg[SKETCH_READ_INDEX], (unsigned long)avg[SKETCH_READ_PREVIEW],
+                 (unsigned long)avg[SKETCH_READ_FULL]);
+        setStatusMessage(readMsg);
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+#if ENABLE_LIBRARY_BENCH
+      // Fn+G - Run the library scaling benchmark (hidden, results on SD)
+      else if ((i == 'g' || i == 'G') && status.fn) {
+        startLibraryBench();
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+#endif
+      // U key - Import sprite sheets from /bitmap16dx/import
+      else if (i == 'u' || i == 'U') {
+        startSheetImport();
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+      // A key - Archive the library to /bitmap16dx/backups (Fn+A restores the newest archive)
+      else if (i == 'a' || i == 'A') {
+        startLibraryArchive(status.fn);
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+      // P key - Shared palette for the listed sketches (Fn+P also remaps them); asks for the size
+      else if (i == 'p' || i == 'P') {
+        sharedPalettePrompt = status.fn ? SHARED_PROMPT_REMAP : SHARED_PROMPT_SAVE;
+        setStatusMessage(StatusMsg::SHARED_PROMPT);
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+#if ENABLE_LED_MATRIX
+      // Fn+L - Cycle the LED playlist speed
+      else if ((i == 'l' || i == 'L') && status.fn) {
+        ledPlaylistRate = (ledPlaylistRate + 1) % sizeof(LED_PLAYLIST_FPS);
+        preferences.begin("bitmap16dx", false);
+        preferences.putUChar("ledFps", ledPlaylistRate);
+        preferences.end();
+        char fpsMsg[32];
+        snprintf(fpsMsg, sizeof(fpsMsg), StatusMsg::LED_FPS_FMT, LED_PLAYLIST_FPS[ledPlaylistRate]);
+        setStatusMessage(fpsMsg);
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+      // L key - Play sketches on the LED matrix from the focused one (again to stop)
+      else if (i == 'l' || i == 'L') {
+        if (ledPlaylist.count) {
+          stopLEDPlaylist();
+          setStatusMessage(StatusMsg::LED_STOPPED);
+        } else {
+          startLEDPlaylist();
+        }
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+      }
+#endif
+      // K key - Pick the collection to browse
+      else if (i == 'k' || i == 'K') {
+        if (!openCollectionPicker(PICK_OPEN)) {
+          setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+        }
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+        return;
+      }
+      // M key - Move focused sketch to another collection (Fn+M copies it)
+      else if ((i == 'm' || i == 'M') && memoryViewCursor > 0) {
+        if (!openCollectionPicker(status.fn ? PICK_COPY : PICK_MOVE)) {
+          setStatusMessage(StatusMsg::OUT_OF_MEMORY);
+        }
+        memoryViewNeedsRedraw = true;
+        loopDelay(200);  // Debounce
+        return;
+      }
+      // G key - Toggle grouping sketches by palette
+      else if (i == 'g' || i == 'G') {
+        memoryGroupByPalette = !memoryGroupByPalette;
+        std::stable_sort(sketchList.begin(), sketchList.end(), sketchNewerThan);
+        syncMemoryViewCursor();  // Stay on the same sketch
+        setStatusMessage(memoryGroupByPalette ? StatusMsg::GROUP_BY_PALETTE : StatusMsg::GROUP_BY_DATE);
+        memoryViewNeedsRedraw = true;
+        lastMemoryViewCursor = -1;
+        loopDelay(200);  // Debounce
+      }
       // V key - View selected sketch in gallery preview
       else if (i == 'v' || i == 'V') {
         if (sketchList.size() > 0) {
           enterPreviewView();  // Will detect inMemoryView and set galleryMode
-          delay(200);
+          loopDelay(200);
           return;
         } else {
           setStatusMessage("No sketches to show");
-          delay(200);
+          loopDelay(200);
         }
       }
 #if ENABLE_SCREENSHOTS
@@ -5235,7 +13113,7 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
 
       if (i == ';' && memoryViewCursor >= COLS) {  // Up
         memoryViewCursor -= COLS;
-        delay(150);
+        loopDelay(150);
       }
       else if (i == '.') {  // Down
         int currentCol = memoryViewCursor % COLS;  // Which column are we in?
@@ -5255,15 +13133,15 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
           // Normal move down
           memoryViewCursor = nextRow;
         }
-        delay(150);
+        loopDelay(150);
       }
       else if (i == ',' && memoryViewCursor % COLS != 0) {  // Left
         memoryViewCursor--;
-        delay(150);
+        loopDelay(150);
       }
       else if (i == '/' && memoryViewCursor % COLS != (COLS - 1) && memoryViewCursor < totalItems - 1) {  // Right
         memoryViewCursor++;
-        delay(150);
+        loopDelay(150);
       }
     }
   }
@@ -5320,7 +13198,12 @@ void handleMemoryView(Keyboard_Class::KeysState& status) {
   btPrevEnterMem = btEnter; btPrevEscMem = btEscape;
 #endif
 
-  delay(10);
+  // Follow the sketch the user moved to as more entries are inserted
+  if (memoryViewCursor != cursorBeforeInput) {
+    rememberMemoryViewCursor();
+  }
+
+  loopDelay(10);
 }
 
 /**
@@ -5348,7 +13231,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
       // ` key (ESC) or V key - exit preview view
       if (i == '`' || i == 'v' || i == 'V') {
         exitPreviewView();
-        delay(200);  // Debounce
+        loopDelay(200);  // Debounce
         return;
       }
 
@@ -5362,7 +13245,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
           }
           galleryAutoAdvance = false;  // Pause autoplay on manual navigation
           loadGallerySketch(galleryCurrentIndex);
-          delay(150);
+          loopDelay(150);
         }
         // Right arrow (/) - next sketch
         else if (i == '/') {
@@ -5372,7 +13255,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
           }
           galleryAutoAdvance = false;  // Pause autoplay on manual navigation
           loadGallerySketch(galleryCurrentIndex);
-          delay(150);
+          loopDelay(150);
         }
         // Space - toggle auto-advance
         else if (i == ' ') {
@@ -5380,20 +13263,43 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
           if (galleryAutoAdvance) {
             galleryLastAdvanceTime = millis();
           }
-          delay(200);
+          loopDelay(200);
+        }
+      }
+
+      // T key - Toggle tiled preview (works in both modes)
+      if (i == 't' || i == 'T') {
+        previewTiled = !previewTiled;
+        if (galleryMode) {
+          loadGallerySketch(galleryCurrentIndex);
+        } else {
+          enterPreviewView();
+        }
+        loopDelay(200);  // Debounce
+      }
+      // O key - Toggle half-tile offset between rows of repeats
+      else if (i == 'o' || i == 'O') {
+        previewTileOffset = !previewTileOffset;
+        if (previewTiled) {
+          if (galleryMode) {
+            loadGallerySketch(galleryCurrentIndex);
+          } else {
+            enterPreviewView();
+          }
         }
+        loopDelay(200);  // Debounce
       }
 
       // Background changes (works in both modes)
       // 1 key - Black background
-      if (i == '1') {
+      else if (i == '1') {
         previewViewBackground = 0;
         if (galleryMode) {
           loadGallerySketch(galleryCurrentIndex);  // Redraw gallery sketch
         } else {
           enterPreviewView();  // Redraw canvas preview
         }
-        delay(150);  // Debounce
+        loopDelay(150);  // Debounce
       }
       // 2 key - White background
       else if (i == '2') {
@@ -5403,7 +13309,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
         } else {
           enterPreviewView();
         }
-        delay(150);  // Debounce
+        loopDelay(150);  // Debounce
       }
       // 3 key - Light gray background
       else if (i == '3') {
@@ -5413,7 +13319,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
         } else {
           enterPreviewView();
         }
-        delay(150);  // Debounce
+        loopDelay(150);  // Debounce
       }
       // 4 key - Dark gray background
       else if (i == '4') {
@@ -5423,7 +13329,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
         } else {
           enterPreviewView();
         }
-        delay(150);  // Debounce
+        loopDelay(150);  // Debounce
       }
       // Brightness control - B key + Plus/Minus
       // Hold B and press + to increase brightness
@@ -5471,7 +13377,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
         } else {
           enterPreviewView();  // Redraw preview
         }
-        delay(150);
+        loopDelay(150);
       }
 #if ENABLE_SCREENSHOTS
       // Y key - Take Screenshot
@@ -5514,7 +13420,7 @@ void handlePreviewView(Keyboard_Class::KeysState& status) {
   btPrevEscPrev = btEscape;
 #endif
 
-  delay(10);
+  loopDelay(10);
 }
 
 /**
@@ -5538,7 +13444,7 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
       drawPaletteView(false);
 
       // Hold the final frame longer so user can see the insertion
-      delay(500);
+      loopDelay(500);
 
       // Now exit
       paletteInsertionAnimating = false;
@@ -5598,7 +13504,7 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
         exitPaletteView();
         paletteViewNeedsRedraw = true;
         lastPaletteViewCursor = -1;
-        delay(200);  // Debounce
+        loopDelay(200);  // Debounce
         return;
       }
       // Filter keys
@@ -5613,9 +13519,9 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
         // Wait for key release to prevent multiple toggles
         while (M5Cardputer.Keyboard.isPressed()) {
           M5Cardputer.update();
-          delay(10);
+          loopDelay(10);
         }
-        delay(50);  // Extra debounce
+        loopDelay(50);  // Extra debounce
         break;
       }
       else if (i == '4') {
@@ -5630,9 +13536,9 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
         // Wait for key release to prevent multiple toggles
         while (M5Cardputer.Keyboard.isPressed()) {
           M5Cardputer.update();
-          delay(10);
+          loopDelay(10);
         }
-        delay(50);  // Extra debounce
+        loopDelay(50);  // Extra debounce
         break;
       }
       else if (i == '8') {
@@ -5647,9 +13553,9 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
         // Wait for key release to prevent multiple toggles
         while (M5Cardputer.Keyboard.isPressed()) {
           M5Cardputer.update();
-          delay(10);
+          loopDelay(10);
         }
-        delay(50);  // Extra debounce
+        loopDelay(50);  // Extra debounce
         break;
       }
       else if (i == '1') {
@@ -5664,9 +13570,9 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
         // Wait for key release to prevent multiple toggles
         while (M5Cardputer.Keyboard.isPressed()) {
           M5Cardputer.update();
-          delay(10);
+          loopDelay(10);
         }
-        delay(50);  // Extra debounce
+        loopDelay(50);  // Extra debounce
         break;
       }
       else if (i == 'u' || i == 'U') {
@@ -5681,20 +13587,20 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
         // Wait for key release to prevent multiple toggles
         while (M5Cardputer.Keyboard.isPressed()) {
           M5Cardputer.update();
-          delay(10);
+          loopDelay(10);
         }
-        delay(50);  // Extra debounce
+        loopDelay(50);  // Extra debounce
         break;
       }
       // Left arrow - previous palette
       else if (i == ',' && paletteViewCursor > 0) {
         paletteViewCursor--;
-        delay(150);
+        loopDelay(150);
       }
       // Right arrow - next palette
       else if (i == '/' && paletteViewCursor < filteredPaletteCount - 1) {
         paletteViewCursor++;
-        delay(150);
+        loopDelay(150);
       }
 #if ENABLE_SCREENSHOTS
       // Y key - Take Screenshot
@@ -5739,7 +13645,7 @@ void handlePaletteView(Keyboard_Class::KeysState& status) {
   btPrevEnterPal = btEnter; btPrevEscPal = btEscape;
 #endif
 
-  delay(10);
+  loopDelay(10);
 }
 
 /**
@@ -5752,17 +13658,72 @@ void handleCanvasView(Keyboard_Class::KeysState& status);
 // BLUETOOTH KEYBOARD SUPPORT FUNCTIONS
 // ============================================================================
 
-// NimBLE callback classes
-class BtClientCallbacks : public NimBLEClientCallbacks {
-  void onConnect(NimBLEClient* pClient) override {
-    btConnected = true;
-    btShowNotify("BT Connected");
+/**
+ * Push an event for the main loop (producer side: NimBLE host task or the
+ * simulator). If the main loop has fallen behind, the event is dropped and
+ * the main loop is asked to resync (see btResyncEvents).
+ */
+void btPushEvent(uint8_t type, const uint8_t* data = nullptr, uint8_t len = 0) {
+  uint8_t head = btEventHead.load(std::memory_order_relaxed);
+  uint8_t next = (head + 1) & (BT_EVENT_RING_SIZE - 1);
+  if (next == btEventTail.load(std::memory_order_acquire)) {
+    btEventsResync.store(true, std::memory_order_release);
+    return;
+  }
+  BtEvent& event = btEvents[head];
+  event.type = type;
+  event.len = min(len, (uint8_t)sizeof(event.data));
+  if (data) {
+    memcpy(event.data, data, event.len);
+  }
+  btEventHead.store(next, std::memory_order_release);
+}
+
+/**
+ * Peek at the oldest pending event (consumer side: main loop only)
+ * @return nullptr if the ring is empty
+ */
+const BtEvent* btPeekEvent() {
+  uint8_t tail = btEventTail.load(std::memory_order_relaxed);
+  if (tail == btEventHead.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return &btEvents[tail];
+}
+
+/**
+ * Release the event returned by btPeekEvent()
+ */
+void btPopEvent() {
+  uint8_t tail = btEventTail.load(std::memory_order_relaxed);
+  btEventTail.store((tail + 1) & (BT_EVENT_RING_SIZE - 1), std::memory_order_release);
+}
+
+/**
+ * Discard pending events (stale after the stack goes down)
+ */
+void btFlushEvents() {
+  while (btPeekEvent()) {
+    btPopEvent();
   }
+}
+
+#if !BT_SIM_HID
+// ----------------------------------------------------------------------------
+// NimBLE transport
+// ----------------------------------------------------------------------------
+// NimBLE 1.4 has no asynchronous connect: connect(), secureConnection() and
+// service discovery each block until the peer answers. They run in a short-
+// lived worker task, which reports through btConnectOutcome; the main loop
+// never touches btClient while it runs.
+
+NimBLEClient* btClient = nullptr;
+bool btStackInitialized = false;
+bool btConnectWorkerRunning = false;  // Main loop view: worker started, outcome not yet taken
 
+class BtClientCallbacks : public NimBLEClientCallbacks {
   void onDisconnect(NimBLEClient* pClient) override {
-    btConnected = false;
-    btClearInputState();
-    btShowNotify("BT Disconnected");
+    btPushEvent(BT_EV_DISCONNECTED);
   }
 };
 
@@ -5770,310 +13731,599 @@ static BtClientCallbacks btClientCallbacks;
 
 // Notification callback for HID reports
 void btNotifyCallback(NimBLERemoteCharacteristic* pChar, uint8_t* pData, size_t length, bool isNotify) {
-  btProcessHIDReport(pData, length);
+  btPushEvent(BT_EV_REPORT, pData, min(length, (size_t)8));
+}
+
+/**
+ * Whether an advertisement looks like a keyboard
+ * (HID service, keyboard appearance, or a keyboard-like name)
+ */
+bool btLooksLikeKeyboard(NimBLEAdvertisedDevice* device) {
+  if (device->isAdvertisingService(NimBLEUUID((uint16_t)0x1812))) {
+    return true;
+  }
+  if (device->getAppearance() == 961) {  // 0x03C1 = keyboard
+    return true;
+  }
+  if (device->haveName()) {
+    std::string name = device->getName();
+    for (auto& c : name) c = tolower(c);
+    const char* hints[] = {"keyboard", "kbd", "keychron", "k8", "k1", "k2", "k3", "k4", "k6", "logitech", "magic"};
+    for (const char* hint : hints) {
+      if (name.find(hint) != std::string::npos) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+class BtScanCallbacks : public NimBLEAdvertisedDeviceCallbacks {
+  void onResult(NimBLEAdvertisedDevice* device) override {
+    btAdvertsSeen++;
+    if (btLooksLikeKeyboard(device)) {
+      uint8_t data[7];
+      memcpy(data, device->getAddress().getNative(), 6);
+      data[6] = device->getAddress().getType();
+      btPushEvent(BT_EV_FOUND, data, sizeof(data));
+    }
+  }
+};
+
+static BtScanCallbacks btScanCallbacks;
+
+void btScanEnded(NimBLEScanResults results) {
+  btPushEvent(BT_EV_SCAN_END);
 }
 
-// Track if BLE stack is initialized
-static bool btStackInitialized = false;
+/**
+ * Subscribe to every notifying HID report characteristic
+ */
+bool btSubscribeReports(NimBLERemoteService* hidService) {
+  bool subscribed = false;
+
+  // Standard report characteristic (0x2A4D)
+  std::vector<NimBLERemoteCharacteristic*>* chars = hidService->getCharacteristics(true);
+  for (auto& chr : *chars) {
+    if (chr->getUUID() == NimBLEUUID((uint16_t)0x2A4D) && chr->canNotify()) {
+      chr->subscribe(true, btNotifyCallback);
+      subscribed = true;
+    }
+  }
+
+  // Boot keyboard input (0x2A22)
+  NimBLERemoteCharacteristic* bootChar = hidService->getCharacteristic(NimBLEUUID((uint16_t)0x2A22));
+  if (bootChar && bootChar->canNotify()) {
+    bootChar->subscribe(true, btNotifyCallback);
+    subscribed = true;
+  }
+  return subscribed;
+}
 
 /**
- * Initialize NimBLE stack
+ * Connect worker: the blocking connect sequence, off the main loop
  */
-void btInit() {
-  if (btStackInitialized) return;
-  NimBLEDevice::init("BitMap16 DX");
-  NimBLEDevice::setSecurityAuth(true, false, true);  // bonding, no MITM, secure conn
-  NimBLEDevice::setPower(ESP_PWR_LVL_P9);  // Max power for better range
-  btStackInitialized = true;
+void btConnectWorker(void* param) {
+  int8_t outcome = BT_CONNECT_OK;
+  NimBLEAddress addr(btTargetAddr, btTargetType);
+  if (!btClient->connect(addr)) {
+    outcome = BT_FAIL_CONNECT;
+  } else if (!btClient->secureConnection()) {
+    outcome = BT_FAIL_PAIRING;
+  } else {
+    NimBLERemoteService* hidService = btClient->getService(NimBLEUUID((uint16_t)0x1812));
+    if (!hidService) {
+      outcome = BT_FAIL_NO_HID;
+    } else if (!btSubscribeReports(hidService)) {
+      outcome = BT_FAIL_SUBSCRIBE;
+    }
+  }
+  if (outcome != BT_CONNECT_OK && btClient->isConnected()) {
+    btClient->disconnect();
+  }
+  btConnectOutcome.store(outcome, std::memory_order_release);
+  vTaskDelete(nullptr);
 }
 
 /**
- * Deinitialize NimBLE stack to free memory (~60-80KB)
+ * Bring up the NimBLE stack
  */
-void btDeinit() {
-  if (!btStackInitialized) return;
-  if (btConnected) return;  // Don't deinit while connected
+bool btTransportBegin() {
+  if (!btStackInitialized) {
+    NimBLEDevice::init("BitMap16 DX");
+    NimBLEDevice::setSecurityAuth(true, false, true);  // bonding, no MITM, secure conn
+    NimBLEDevice::setPower(ESP_PWR_LVL_P9);  // Max power for better range
+    btStackInitialized = true;
+  }
+  return true;
+}
 
+/**
+ * Take the NimBLE stack down and free its memory (~60-80KB)
+ * Only called with no connect worker running.
+ */
+void btTransportEnd() {
+  if (!btStackInitialized) return;
+  NimBLEScan* pScan = NimBLEDevice::getScan();
+  pScan->stop();
+  pScan->clearResults();
   if (btClient) {
     NimBLEDevice::deleteClient(btClient);
     btClient = nullptr;
   }
-  if (btAdvDevice) {
-    delete btAdvDevice;
-    btAdvDevice = nullptr;
-  }
-
   NimBLEDevice::deinit(true);  // true = release memory
   btStackInitialized = false;
 }
 
+bool btTransportStartScan() {
+  NimBLEScan* pScan = NimBLEDevice::getScan();
+  pScan->setAdvertisedDeviceCallbacks(&btScanCallbacks, false);
+  pScan->setActiveScan(true);
+  pScan->setInterval(100);
+  pScan->setWindow(99);
+  return pScan->start(BT_SCAN_SECONDS, btScanEnded, false);
+}
+
+void btTransportStopScan() {
+  NimBLEScan* pScan = NimBLEDevice::getScan();
+  pScan->stop();
+  pScan->clearResults();
+}
+
 /**
- * Start scanning for HID keyboards
+ * Start connecting to btTargetAddr; the outcome lands in btConnectOutcome
  */
-void btStartScan() {
-  if (btScanning) return;
+void btTransportConnect() {
+  if (!btClient) {
+    btClient = NimBLEDevice::createClient();
+    btClient->setClientCallbacks(&btClientCallbacks, false);
+    btClient->setConnectionParams(12, 12, 0, 150);
+    btClient->setConnectTimeout(BT_CONNECT_TIMEOUT_S);
+  }
+  btConnectOutcome.store(BT_CONNECT_PENDING, std::memory_order_relaxed);
+  if (xTaskCreate(btConnectWorker, "btconnect", 4096, nullptr, 1, nullptr) != pdPASS) {
+    btConnectOutcome.store(BT_FAIL_CONNECT, std::memory_order_relaxed);
+  }
+}
 
-  btScanning = true;
+void btTransportDisconnect() {
+  if (btClient && btClient->isConnected()) {
+    btClient->disconnect();
+  }
+}
 
-  // Initialize BLE stack if needed
-  btInit();
+bool btTransportLinkUp() {
+  return btClient && btClient->isConnected();
+}
+#endif // !BT_SIM_HID
+
+#if BT_SIM_HID
+// ----------------------------------------------------------------------------
+// BT SIMULATED KEYBOARD
+// ----------------------------------------------------------------------------
+// Stands in for the radio with a scripted keyboard that advertises, accepts
+// or refuses connections, sends HID reports and drops the link on a
+// timeline. It feeds the same event ring and connect outcome as NimBLE, so
+// the state machine, input handling and retry policy run unchanged,
+// including through connect/disconnect storms. The script restarts whenever
+// the stack comes up and loops when it ends.
+
+enum BtSimKind : uint8_t {
+  SIM_ADVERTISE,  // Advertise once (seen only while scanning)
+  SIM_ACCEPT,     // Accept connects from now on
+  SIM_REFUSE,     // Refuse connects from now on
+  SIM_REPORT,     // Send a HID report (lost if the link is down)
+  SIM_DROP        // Drop the link (if up)
+};
 
-  // Redraw settings view to show [SCANNING] before blocking
-  if (inSettingsView) {
-    drawSettingsView();
+struct BtSimStep {
+  uint16_t delayMs;    // After the previous step
+  uint8_t kind;
+  uint8_t report[8];
+};
+
+#define BT_SIM_CONNECT_MS 150  // Simulated connect + pair + discovery time
+
+const BtSimStep BT_SIM_SCRIPT[] = {
+  {500, SIM_ACCEPT, {0}},
+  {0, SIM_ADVERTISE, {0}},
+  // Move right twice and draw
+  {1500, SIM_REPORT, {0, 0, HID_KEY_RIGHT_ARROW}}, {80, SIM_REPORT, {0}},
+  {200, SIM_REPORT, {0, 0, HID_KEY_RIGHT_ARROW}}, {80, SIM_REPORT, {0}},
+  {200, SIM_REPORT, {0, 0, HID_KEY_SPACE}}, {80, SIM_REPORT, {0}},
+  // Type "c" with a second key rolled over, then Alt+2
+  {300, SIM_REPORT, {0, 0, 0x06}}, {40, SIM_REPORT, {0, 0, 0x06, 0x1F}}, {60, SIM_REPORT, {0}},
+  {300, SIM_REPORT, {0x04, 0, 0x1F}}, {80, SIM_REPORT, {0}},
+  // Storm: drops right after each reconnect, with some connects refused
+  {1000, SIM_DROP, {0}},
+  {1200, SIM_DROP, {0}},
+  {0, SIM_REFUSE, {0}},
+  {2500, SIM_ACCEPT, {0}},
+  {3000, SIM_DROP, {0}},
+  {200, SIM_REPORT, {0, 0, HID_KEY_DOWN_ARROW}},  // Sent into a dead link
+  {2500, SIM_DROP, {0}},
+  // Held arrow across a drop must not stay held
+  {4000, SIM_REPORT, {0, 0, HID_KEY_DOWN_ARROW}},
+  {300, SIM_DROP, {0}},
+  {5000, SIM_REPORT, {0}},
+};
+const uint8_t BT_SIM_STEP_COUNT = sizeof(BT_SIM_SCRIPT) / sizeof(BT_SIM_SCRIPT[0]);
+
+struct BtSimState {
+  bool up;                    // "Stack" brought up
+  bool scanning;
+  bool accepting;
+  bool linkUp;
+  bool connectPending;
+  unsigned long connectAt;    // When the pending connect resolves
+  uint8_t step;               // Next script step
+  unsigned long stepAt;       // When the previous step ran
+  unsigned long scanEndAt;
+} btSim = {};
+
+/**
+ * Advance the simulated keyboard (called from btUpdate)
+ */
+void btSimStep() {
+  if (!btSim.up) return;
+  unsigned long now = millis();
+
+  if (btSim.connectPending && now >= btSim.connectAt) {
+    btSim.connectPending = false;
+    btSim.linkUp = btSim.accepting;
+    btConnectOutcome.store(btSim.accepting ? BT_CONNECT_OK : BT_FAIL_CONNECT, std::memory_order_release);
+  }
+  if (btSim.scanning && now >= btSim.scanEndAt) {
+    btSim.scanning = false;
+    btPushEvent(BT_EV_SCAN_END);
   }
 
-  NimBLEScan* pScan = NimBLEDevice::getScan();
-  pScan->setActiveScan(true);
-  pScan->setInterval(100);
-  pScan->setWindow(99);
+  while (now - btSim.stepAt >= BT_SIM_SCRIPT[btSim.step].delayMs) {
+    const BtSimStep& step = BT_SIM_SCRIPT[btSim.step];
+    btSim.stepAt += step.delayMs;
+    btSim.step = (btSim.step + 1) % BT_SIM_STEP_COUNT;
 
-  // Scan with countdown display
-  const int SCAN_SECONDS = 15;
-  for (int remaining = SCAN_SECONDS; remaining > 0; remaining--) {
-    // Update countdown and redraw
-    btScanCountdown = remaining;
-    if (inSettingsView) {
-      drawSettingsView();
+    switch (step.kind) {
+      case SIM_ADVERTISE:
+        if (btSim.scanning) {
+          const uint8_t device[7] = {0xD0, 0x16, 0x00, 0x00, 0x00, 0x01, 1};
+          btAdvertsSeen++;
+          btPushEvent(BT_EV_FOUND, device, sizeof(device));
+        }
+        break;
+      case SIM_ACCEPT:
+        btSim.accepting = true;
+        break;
+      case SIM_REFUSE:
+        btSim.accepting = false;
+        break;
+      case SIM_REPORT:
+        if (btSim.linkUp) {
+          btPushEvent(BT_EV_REPORT, step.report, sizeof(step.report));
+        }
+        break;
+      case SIM_DROP:
+        if (btSim.linkUp) {
+          btSim.linkUp = false;
+          btPushEvent(BT_EV_DISCONNECTED);
+        }
+        break;
     }
+  }
+}
 
-    // Scan for 1 second
-    pScan->start(1, false);
+bool btTransportBegin() {
+  if (!btSim.up) {
+    btSim = {};
+    btSim.up = true;
+    btSim.stepAt = millis();
   }
-  btScanCountdown = 0;
+  return true;
+}
 
-  NimBLEScanResults results = pScan->getResults();
+void btTransportEnd() {
+  btSim.up = false;
+}
 
-  // Look for HID devices - try multiple detection methods
-  // Clean up previous device if any
-  if (btAdvDevice) {
-    delete btAdvDevice;
-    btAdvDevice = nullptr;
-  }
-  int deviceCount = results.getCount();
-  btLastScanCount = deviceCount;  // Store for settings UI
+bool btTransportStartScan() {
+  btSim.scanning = true;
+  btSim.scanEndAt = millis() + BT_SCAN_SECONDS * 1000UL;
+  return true;
+}
 
-  for (int i = 0; i < deviceCount; i++) {
-    NimBLEAdvertisedDevice device = results.getDevice(i);
+void btTransportStopScan() {
+  btSim.scanning = false;
+}
 
-    // Method 1: Check for HID service UUID
-    if (device.isAdvertisingService(NimBLEUUID((uint16_t)0x1812))) {
-      btAdvDevice = new NimBLEAdvertisedDevice(device);
-      break;
-    }
+void btTransportConnect() {
+  btConnectOutcome.store(BT_CONNECT_PENDING, std::memory_order_relaxed);
+  btSim.connectPending = true;
+  btSim.connectAt = millis() + BT_SIM_CONNECT_MS;
+}
 
-    // Method 2: Check device appearance (0x03C1 = 961 = keyboard)
-    if (device.getAppearance() == 961) {
-      btAdvDevice = new NimBLEAdvertisedDevice(device);
-      break;
-    }
+void btTransportDisconnect() {
+  btSim.linkUp = false;
+}
 
-    // Method 3: Check if name contains keyboard-related strings (case insensitive)
-    if (device.haveName()) {
-      std::string name = device.getName();
-      // Convert to lowercase for comparison
-      for (auto& c : name) c = tolower(c);
-      if (name.find("keyboard") != std::string::npos ||
-          name.find("kbd") != std::string::npos ||
-          name.find("keychron") != std::string::npos ||
-          name.find("k8") != std::string::npos ||
-          name.find("k1") != std::string::npos ||
-          name.find("k2") != std::string::npos ||
-          name.find("k3") != std::string::npos ||
-          name.find("k4") != std::string::npos ||
-          name.find("k6") != std::string::npos ||
-          name.find("logitech") != std::string::npos ||
-          name.find("magic") != std::string::npos) {
-        btAdvDevice = new NimBLEAdvertisedDevice(device);
-        break;
-      }
-    }
-  }
+bool btTransportLinkUp() {
+  return btSim.linkUp;
+}
+#endif // BT_SIM_HID
 
-  pScan->clearResults();
-  btScanning = false;
+// ----------------------------------------------------------------------------
+// State machine (main loop)
+// ----------------------------------------------------------------------------
 
-  if (btAdvDevice) {
-    btShowNotify("Found keyboard");
-  } else {
-    char msg[32];
-    snprintf(msg, sizeof(msg), "No kbd (%d found)", deviceCount);
-    btShowNotify(msg);
-  }
+void btSetState(BtState state) {
+  btState = state;
+  btStateTime = millis();
+  btStateVersion++;
 }
 
 /**
- * Connect to discovered HID keyboard
+ * Take the stack down and return to BT_OFF
  */
-bool btConnect() {
-  if (!btAdvDevice) return false;
-  if (btConnected) return true;
+void btShutdown() {
+  btTransportEnd();
+  btFlushEvents();
+  btClearInputState();
+  btRetryCount = 0;
+  btStopRequested = false;
+  btSetState(BT_OFF);
+}
 
-  btShowNotify("Connecting...");
+/**
+ * Forget the bonded keyboard
+ */
+void btForgetBondedDevice() {
+  btHasBondedDevice = false;
+  preferences.begin("bitmap16dx", false);
+  preferences.putBool("btHasBonded", false);
+  preferences.end();
+}
 
-  // Create client
-  btClient = NimBLEDevice::createClient();
-  btClient->setClientCallbacks(&btClientCallbacks, false);
-  btClient->setConnectionParams(12, 12, 0, 150);
-  btClient->setConnectTimeout(10);
+/**
+ * Start connecting to btTargetAddr
+ */
+void btBeginConnect() {
+  btDroppedWhileConnecting = false;
+  btTransportConnect();
+  btSetState(BT_CONNECTING);
+}
 
-  // Connect to device
-  if (!btClient->connect(btAdvDevice)) {
-    btShowNotify("Connect failed");
-    return false;
+/**
+ * Schedule another attempt after a backoff, or give up
+ */
+void btRetryOrGiveUp(const char* failMessage) {
+  btClearInputState();
+  if (btRetryCount >= BT_MAX_RETRIES) {
+    setStatusMessage(failMessage);
+    btShutdown();
+    return;
   }
+  btRetryCount++;
+  btSetState(BT_WAIT_RETRY);
+}
 
-  // Secure the connection
-  if (!btClient->secureConnection()) {
-    btClient->disconnect();
-    btShowNotify("Pairing failed");
-    return false;
-  }
+/**
+ * Time to wait in BT_WAIT_RETRY before the next attempt
+ */
+unsigned long btRetryDelay() {
+  return min((unsigned long)BT_RETRY_MAX_MS, (unsigned long)BT_RETRY_MIN_MS << (btRetryCount - 1));
+}
 
-  // Find HID service
-  NimBLERemoteService* hidService = btClient->getService(NimBLEUUID((uint16_t)0x1812));
-  if (!hidService) {
-    btClient->disconnect();
-    btShowNotify("No HID service");
-    return false;
+/**
+ * Start scanning for a keyboard (brings the stack up)
+ */
+void btStartScan() {
+  if (btState != BT_OFF) return;
+  if (!btTransportBegin()) {
+    setStatusMessage("BT init failed");
+    return;
   }
-
-  // Find and subscribe to HID report characteristics
-  // Try standard report characteristic first (0x2A4D)
-  std::vector<NimBLERemoteCharacteristic*>* chars = hidService->getCharacteristics(true);
-  bool subscribed = false;
-
-  for (auto& chr : *chars) {
-    if (chr->getUUID() == NimBLEUUID((uint16_t)0x2A4D)) {
-      if (chr->canNotify()) {
-        chr->subscribe(true, btNotifyCallback);
-        subscribed = true;
-      }
-    }
+  btAdvertsSeen = 0;
+  if (!btTransportStartScan()) {
+    setStatusMessage("BT scan failed");
+    btShutdown();
+    return;
   }
+  btSetState(BT_SCANNING);
+}
 
-  // Also try boot keyboard input (0x2A22)
-  NimBLERemoteCharacteristic* bootChar = hidService->getCharacteristic(NimBLEUUID((uint16_t)0x2A22));
-  if (bootChar && bootChar->canNotify()) {
-    bootChar->subscribe(true, btNotifyCallback);
-    subscribed = true;
+/**
+ * Reconnect to the bonded keyboard (no scan needed)
+ */
+void btStartReconnect() {
+  if (btState != BT_OFF || !btHasBondedDevice) return;
+  if (!btTransportBegin()) {
+    setStatusMessage("BT init failed");
+    return;
   }
+  memcpy(btTargetAddr, btBondedAddr, 6);
+  btTargetType = btBondedType;
+  btRetryCount = 0;
+  btBeginConnect();
+  setStatusMessage("Reconnecting...");
+}
 
-  if (!subscribed) {
-    btClient->disconnect();
-    btShowNotify("Subscribe failed");
-    return false;
+/**
+ * Disconnect / cancel and take the stack down.
+ * A connect in progress can't be interrupted; the stop happens when it ends.
+ */
+void btStop(bool forget) {
+  if (forget) {
+    btForgetBondedDevice();
   }
-
-  // Store bonded device address for auto-reconnect
-  memcpy(btBondedAddr, btAdvDevice->getAddress().getNative(), 6);
-  btHasBondedDevice = true;
-
-  // Clean up - we don't need the advertised device anymore
-  delete btAdvDevice;
-  btAdvDevice = nullptr;
-
-  return true;
+  if (btState == BT_CONNECTING) {
+    btStopRequested = true;
+    return;
+  }
+  if (btState == BT_SCANNING) {
+    btTransportStopScan();
+  }
+  btTransportDisconnect();
+  btShutdown();
 }
 
 /**
- * Reconnect to previously bonded keyboard (no scan needed)
+ * Handle the outcome of a finished connect attempt
  */
-bool btReconnect() {
-  if (!btHasBondedDevice) return false;
-  if (btConnected) return true;
-
-  // Initialize BLE stack if needed
-  btInit();
-
-  btShowNotify("Reconnecting...");
-
-  // Create client
-  btClient = NimBLEDevice::createClient();
-  btClient->setClientCallbacks(&btClientCallbacks, false);
-  btClient->setConnectionParams(12, 12, 0, 150);
-  btClient->setConnectTimeout(10);
-
-  // Connect directly to bonded address
-  NimBLEAddress addr(btBondedAddr);
-  if (!btClient->connect(addr)) {
-    btShowNotify("Reconnect failed");
-    NimBLEDevice::deleteClient(btClient);
-    btClient = nullptr;
-    btDeinit();
-    return false;
+void btFinishConnect(int8_t outcome) {
+  if (btStopRequested) {
+    btTransportDisconnect();
+    btShutdown();
+    return;
   }
-
-  // Secure the connection
-  if (!btClient->secureConnection()) {
-    btClient->disconnect();
-    NimBLEDevice::deleteClient(btClient);
-    btClient = nullptr;
-    btShowNotify("Pairing failed");
-    btDeinit();
-    return false;
+  if (outcome == BT_CONNECT_OK && (btDroppedWhileConnecting || !btTransportLinkUp())) {
+    // Connected, but the link went down again before we got here
+    btRetryOrGiveUp("BT Lost");
+    return;
   }
-
-  // Find HID service
-  NimBLERemoteService* hidService = btClient->getService(NimBLEUUID((uint16_t)0x1812));
-  if (!hidService) {
-    btClient->disconnect();
-    NimBLEDevice::deleteClient(btClient);
-    btClient = nullptr;
-    btShowNotify("No HID service");
-    btDeinit();
-    return false;
+  if (outcome == BT_CONNECT_OK) {
+    btClearInputState();
+    btSetState(BT_CONNECTED);
+    if (!btHasBondedDevice || memcmp(btBondedAddr, btTargetAddr, 6) != 0) {
+      // Remember the keyboard for reconnects
+      memcpy(btBondedAddr, btTargetAddr, 6);
+      btBondedType = btTargetType;
+      btHasBondedDevice = true;
+      preferences.begin("bitmap16dx", false);
+      preferences.putBytes("btBonded", btBondedAddr, 6);
+      preferences.putUChar("btBondedType", btBondedType);
+      preferences.putBool("btHasBonded", true);
+      preferences.end();
+    }
+    setStatusMessage("BT Connected!");
+    return;
   }
 
-  // Find and subscribe to HID report characteristics
-  std::vector<NimBLERemoteCharacteristic*>* chars = hidService->getCharacteristics(true);
-  bool subscribed = false;
+  const char* reasons[] = {"", "Connect failed", "Pairing failed", "No HID service", "Subscribe failed"};
+  btRetryOrGiveUp(reasons[outcome]);
+}
 
-  for (auto& chr : *chars) {
-    if (chr->getUUID() == NimBLEUUID((uint16_t)0x2A4D)) {
-      if (chr->canNotify()) {
-        chr->subscribe(true, btNotifyCallback);
-        subscribed = true;
-      }
-    }
+/**
+ * Recover from a full event ring. What was dropped is unknown, so the ring
+ * is cleared and the state is checked against the link instead: held keys
+ * are released, a lost link or an ended scan is handled as if its event had
+ * arrived, and any report after this starts from no keys down.
+ */
+void btResyncEvents() {
+  btEventsResync.store(false, std::memory_order_relaxed);
+  btFlushEvents();
+  btClearInputState();
+  // A connect in progress needs nothing: btFinishConnect checks the link
+  if (btState == BT_CONNECTED && !btTransportLinkUp()) {
+    setStatusMessage("BT Disconnected");
+    btRetryOrGiveUp("BT Lost");
+  } else if (btState == BT_SCANNING && btScanSecondsLeft() == 0) {
+    char msg[32];
+    snprintf(msg, sizeof(msg), "No kbd (%u found)", (unsigned)btAdvertsSeen);
+    setStatusMessage(msg);
+    btTransportStopScan();
+    btShutdown();
   }
+}
 
-  // Also try boot keyboard input
-  NimBLERemoteCharacteristic* bootChar = hidService->getCharacteristic(NimBLEUUID((uint16_t)0x2A22));
-  if (bootChar && bootChar->canNotify()) {
-    bootChar->subscribe(true, btNotifyCallback);
-    subscribed = true;
-  }
+/**
+ * Step Bluetooth: take events from the ring, advance the state machine.
+ * Called once per loop(). Reports are applied until one changes a held key,
+ * so a press and its release are never both seen in the same frame.
+ */
+void btUpdate() {
+  if (btState == BT_OFF) return;
 
-  if (!subscribed) {
-    btClient->disconnect();
-    NimBLEDevice::deleteClient(btClient);
-    btClient = nullptr;
-    btShowNotify("Subscribe failed");
-    btDeinit();
-    return false;
+#if BT_SIM_HID
+  btSimStep();
+#endif
+
+  if (btEventsResync.load(std::memory_order_acquire)) {
+    btResyncEvents();
+    if (btState == BT_OFF) return;
+  }
+
+  const BtEvent* event;
+  while ((event = btPeekEvent()) != nullptr) {
+    bool heldKeysChanged = false;
+    switch (event->type) {
+      case BT_EV_FOUND:
+        if (btState == BT_SCANNING) {
+          memcpy(btTargetAddr, event->data, 6);
+          btTargetType = event->data[6];
+          btTransportStopScan();
+          btRetryCount = 0;
+          btBeginConnect();
+          setStatusMessage("Found keyboard");
+        }
+        break;
+      case BT_EV_SCAN_END:
+        if (btState == BT_SCANNING) {
+          char msg[32];
+          snprintf(msg, sizeof(msg), "No kbd (%u found)", (unsigned)btAdvertsSeen);
+          setStatusMessage(msg);
+          btShutdown();
+        }
+        break;
+      case BT_EV_DISCONNECTED:
+        // A drop during a connect fails it once the outcome arrives. Otherwise
+        // only a live link can be lost; late drops from an old link are ignored
+        if (btState == BT_CONNECTING) {
+          btDroppedWhileConnecting = true;
+        } else if (btState == BT_CONNECTED && !btTransportLinkUp()) {
+          if (millis() - btStateTime >= BT_STABLE_LINK_MS) {
+            btRetryCount = 0;
+          }
+          setStatusMessage("BT Disconnected");
+          btRetryOrGiveUp("BT Lost");
+        }
+        break;
+      case BT_EV_REPORT:
+        if (btState == BT_CONNECTED) {
+          heldKeysChanged = btProcessHIDReport(event->data, event->len);
+        }
+        break;
+    }
+    btPopEvent();
+    if (heldKeysChanged || btState == BT_OFF) {
+      break;
+    }
   }
 
-  return true;
+  switch (btState) {
+    case BT_CONNECTING: {
+      int8_t outcome = btConnectOutcome.load(std::memory_order_acquire);
+      if (outcome != BT_CONNECT_PENDING) {
+        btFinishConnect(outcome);
+      }
+      break;
+    }
+    case BT_WAIT_RETRY:
+      if (btStopRequested) {
+        btShutdown();
+      } else if (millis() - btStateTime >= btRetryDelay()) {
+        btBeginConnect();
+      }
+      break;
+    case BT_SCANNING: {
+      // Countdown shown in settings
+      static unsigned long lastSecond = 0;
+      unsigned long second = (millis() - btStateTime) / 1000;
+      if (second != lastSecond) {
+        lastSecond = second;
+        btStateVersion++;
+      }
+      break;
+    }
+    default:
+      break;
+  }
 }
 
 /**
- * Disconnect from keyboard
+ * Seconds left in the current scan (for the settings row)
  */
-void btDisconnect() {
-  if (btClient) {
-    if (btClient->isConnected()) {
-      btClient->disconnect();
-    }
-    NimBLEDevice::deleteClient(btClient);
-    btClient = nullptr;
-  }
-  if (btAdvDevice) {
-    delete btAdvDevice;
-    btAdvDevice = nullptr;
-  }
-  btConnected = false;
-  btClearInputState();
+int btScanSecondsLeft() {
+  unsigned long elapsed = (millis() - btStateTime) / 1000;
+  return elapsed >= BT_SCAN_SECONDS ? 0 : BT_SCAN_SECONDS - elapsed;
 }
 
 /**
@@ -6082,14 +14332,19 @@ void btDisconnect() {
  * Byte 0: Modifier keys (Ctrl, Shift, Alt, GUI)
  * Byte 1: Reserved (always 0)
  * Bytes 2-7: Up to 6 simultaneous key codes
+ *
+ * @return true if a held key (arrows, enter, etc.) changed state
  */
-void btProcessHIDReport(uint8_t* data, size_t len) {
-  if (len < 3) return;
+bool btProcessHIDReport(const uint8_t* data, size_t len) {
+  if (len < 3) return false;
 
   // Normalize to 8-byte report
   uint8_t report[8] = {0};
   memcpy(report, data, min(len, (size_t)8));
 
+  bool wasHeld[9] = {btArrowUp, btArrowDown, btArrowLeft, btArrowRight, btEnter,
+                     btBackspace, btEscape, btSpace, btFnHeld};
+
   // Check modifier keys (byte 0)
   bool shift = (report[0] & 0x22) != 0;  // Left or right shift
   btFnHeld = (report[0] & 0x44) != 0;    // Left or right Alt = Fn
@@ -6142,6 +14397,10 @@ void btProcessHIDReport(uint8_t* data, size_t len) {
 
   // Save current report for next comparison
   memcpy(btPrevReport, report, 8);
+
+  bool isHeld[9] = {btArrowUp, btArrowDown, btArrowLeft, btArrowRight, btEnter,
+                    btBackspace, btEscape, btSpace, btFnHeld};
+  return memcmp(wasHeld, isHeld, sizeof(isHeld)) != 0;
 }
 
 /**
@@ -6215,25 +14474,6 @@ void btClearInputState() {
   btQueueHead = btQueueTail = 0;
   memset(btPrevReport, 0, 8);
 }
-
-/**
- * Show notification message (flashes briefly)
- */
-void btShowNotify(const char* msg) {
-  strncpy(btNotifyMsg, msg, sizeof(btNotifyMsg) - 1);
-  btNotifyMsg[sizeof(btNotifyMsg) - 1] = '\0';
-  btNotifyTime = millis();
-}
-
-/**
- * Update/clear notification display
- */
-void btUpdateNotify() {
-  if (btNotifyTime > 0 && millis() - btNotifyTime > BT_NOTIFY_DURATION) {
-    btNotifyTime = 0;
-    btNotifyMsg[0] = '\0';
-  }
-}
 #endif // ENABLE_BLUETOOTH
 
 // ============================================================================
@@ -6302,25 +14542,206 @@ bool detectShakeGesture() {
   return false;
 }
 
+#if ENABLE_FLIGHT_RECORDER
+// ============================================================================
+// STALL WATCHDOG / FLIGHT RECORDER
+// ============================================================================
+// Every loop() iteration is timestamped. Its deliberate waits (loopDelay: key
+// debounce, key release polling, frame pacing) are subtracted, and when the
+// rest still takes longer than STALL_THRESHOLD_MS, a record of the view, the recent key presses and the
+// recent frame times goes into a small RAM ring. Records are appended to the
+// SD log later, once the device has been idle for a while, so the logging
+// doesn't add to the stall it's describing.
+
+#define STALL_THRESHOLD_MS 100        // Loop iterations busy for longer than this are stalls
+#define FLIGHT_FRAME_HISTORY 16       // Recent frame times kept per record
+#define FLIGHT_INPUT_HISTORY 8        // Recent key presses kept per record
+#define FLIGHT_MAX_STALLS 8           // Stall records held in RAM until flushed
+#define FLIGHT_FLUSH_IDLE_MS 3000     // Flush after this long without input
+#define FLIGHT_LOG_PATH "/bitmap16dx/logs/stalls.txt"
+
+struct FlightInputEvent {
+  uint32_t timeMs;
+  char key;                           // Key character, '\r' = Enter, '\b' = Del
+};
+
+struct StallRecord {
+  uint32_t timeMs;                    // When the stalled iteration started
+  uint32_t durationMs;                // Busy time, without loopDelay() waits
+  uint32_t waitMs;                    // Time spent in loopDelay() on top
+  const char* view;                   // View active during the stall
+  FlightInputEvent inputs[FLIGHT_INPUT_HISTORY];  // Oldest first (timeMs 0 = unused)
+  uint16_t frameMs[FLIGHT_FRAME_HISTORY];         // Busy times, oldest first, stalled frame last
+};
+
+// Rolling history, copied into a record when a stall is detected
+FlightInputEvent flightInputs[FLIGHT_INPUT_HISTORY];
+uint8_t flightInputHead = 0;
+uint16_t flightFrames[FLIGHT_FRAME_HISTORY];
+uint8_t flightFrameHead = 0;
+
+StallRecord stallRecords[FLIGHT_MAX_STALLS];
+uint8_t stallRecordCount = 0;         // Records waiting to be flushed
+uint32_t stallRecordsDropped = 0;     // Stalls lost because the ring was full
+
+unsigned long flightFrameStartMs = 0;
+unsigned long flightLastInputMs = 0;
+const char* flightView = "boot";
+
+/**
+ * Name of the view loop() is currently dispatching to
+ */
+const char* currentViewName() {
+  if (inChargingMode) return "charging";
+  if (inHelpView) return "help";
+  if (inMemoryView) return "memory";
+  if (inPreviewView) return "preview";
+  if (inPaletteView) return "palette";
+  if (inSettingsView) return "settings";
+  if (inMuralView) return "mural";
+  return "canvas";
+}
+
+/**
+ * Mark the start of a loop() iteration and check how long the previous one took
+ */
+void flightRecorderFrameStart() {
+  unsigned long now = millis();
+  if (flightFrameStartMs != 0) {
+    uint32_t elapsedMs = now - flightFrameStartMs;
+    uint32_t frameMs = elapsedMs > loopWaitMs ? elapsedMs - loopWaitMs : 0;
+    flightFrames[flightFrameHead] = frameMs > 0xFFFF ? 0xFFFF : frameMs;
+    flightFrameHead = (flightFrameHead + 1) % FLIGHT_FRAME_HISTORY;
+
+    if (frameMs > STALL_THRESHOLD_MS) {
+      if (stallRecordCount < FLIGHT_MAX_STALLS) {
+        StallRecord& rec = stallRecords[stallRecordCount++];
+        rec.timeMs = flightFrameStartMs;
+        rec.durationMs = frameMs;
+        rec.waitMs = elapsedMs - frameMs;
+        rec.view = flightView;
+        // Unroll both rings oldest-first
+        for (uint8_t i = 0; i < FLIGHT_INPUT_HISTORY; i++) {
+          rec.inputs[i] = flightInputs[(flightInputHead + i) % FLIGHT_INPUT_HISTORY];
+        }
+        for (uint8_t i = 0; i < FLIGHT_FRAME_HISTORY; i++) {
+          rec.frameMs[i] = flightFrames[(flightFrameHead + i) % FLIGHT_FRAME_HISTORY];
+        }
+      } else {
+        stallRecordsDropped++;
+      }
+    }
+  }
+
+  flightFrameStartMs = now;
+  loopWaitMs = 0;
+  flightView = currentViewName();
+}
+
+/**
+ * Remember key presses so stall records show what the user just did
+ */
+void flightRecordInput(Keyboard_Class::KeysState& status) {
+  if (!M5Cardputer.Keyboard.isChange() || !M5Cardputer.Keyboard.isPressed()) {
+    return;
+  }
+
+  unsigned long now = millis();
+  flightLastInputMs = now;
+
+  auto push = [now](char key) {
+    flightInputs[flightInputHead] = {now, key};
+    flightInputHead = (flightInputHead + 1) % FLIGHT_INPUT_HISTORY;
+  };
+  for (auto key : status.word) {
+    push(key);
+  }
+  if (status.enter) push('\r');
+  if (status.del) push('\b');
+}
+
+/**
+ * Append pending stall records to the SD log once the device is idle.
+ * The write's own time is excluded from the next frame measurement.
+ */
+void flightRecorderFlush() {
+  if (stallRecordCount == 0 || jobActive || !sdCardAvailable ||
+      millis() - flightLastInputMs < FLIGHT_FLUSH_IDLE_MS) {
+    return;
+  }
+
+  if (!SD.exists("/bitmap16dx/logs")) {
+    SD.mkdir("/bitmap16dx/logs");
+  }
+
+  File file = SD.open(FLIGHT_LOG_PATH, FILE_APPEND);
+  if (file) {
+    char line[96];
+    for (uint8_t r = 0; r < stallRecordCount; r++) {
+      StallRecord& rec = stallRecords[r];
+      snprintf(line, sizeof(line), "stall t=%lu dur=%lu wait=%lu view=%s\n",
+               (unsigned long)rec.timeMs, (unsigned long)rec.durationMs,
+               (unsigned long)rec.waitMs, rec.view);
+      file.print(line);
+
+      file.print("  keys:");
+      for (uint8_t i = 0; i < FLIGHT_INPUT_HISTORY; i++) {
+        const FlightInputEvent& ev = rec.inputs[i];
+        if (ev.timeMs == 0) continue;
+        const char* name = (ev.key == '\r') ? "ent" : (ev.key == '\b') ? "del" : (ev.key == '`') ? "esc" : nullptr;
+        if (name) {
+          snprintf(line, sizeof(line), " %lu:%s", (unsigned long)ev.timeMs, name);
+        } else {
+          snprintf(line, sizeof(line), " %lu:%c", (unsigned long)ev.timeMs, ev.key);
+        }
+        file.print(line);
+      }
+
+      file.print("\n  frames:");
+      for (uint8_t i = 0; i < FLIGHT_FRAME_HISTORY; i++) {
+        snprintf(line, sizeof(line), " %u", rec.frameMs[i]);
+        file.print(line);
+      }
+      file.print("\n");
+    }
+    if (stallRecordsDropped > 0) {
+      snprintf(line, sizeof(line), "dropped %lu\n", (unsigned long)stallRecordsDropped);
+      file.print(line);
+    }
+    file.close();
+  }
+
+  stallRecordCount = 0;
+  stallRecordsDropped = 0;
+  flightFrameStartMs = millis();  // Don't count the flush as a stall
+  loopWaitMs = 0;
+}
+#endif // ENABLE_FLIGHT_RECORDER
+
 // ============================================================================
 // MAIN LOOP
 // ============================================================================
 
 // loop() runs over and over again forever
 void loop() {
+#if ENABLE_FLIGHT_RECORDER
+  // Time the previous iteration and log it if it stalled
+  flightRecorderFrameStart();
+#endif
+
   // Update the M5 hardware state (this checks for keyboard input)
   M5Cardputer.update();
 
 #if ENABLE_BLUETOOTH
-  // Update BT notification display timer
-  btUpdateNotify();
+  // Step BLE scan/connect and apply keyboard reports
+  btUpdate();
 #endif
 
   // ============================================================================
   // SHAKE-TO-UNDO DETECTION (IMU)
   // ============================================================================
   // Check for shake gesture ONLY in canvas view
-  if (!inHelpView && !inMemoryView && !inPreviewView && !inPaletteView && !inSettingsView) {
+  if (!inHelpView && !inMemoryView && !inPreviewView && !inPaletteView && !inSettingsView && !inMuralView) {
     if (shakeUndoEnabled && detectShakeGesture() && undoAvailable) {
       // Shake detected and undo is available!
       restoreUndo();  // Perform the undo operation
@@ -6342,6 +14763,35 @@ void loop() {
   // Get current keyboard state
   Keyboard_Class::KeysState status = M5Cardputer.Keyboard.keysState();
 
+#if ENABLE_FLIGHT_RECORDER
+  flightRecordInput(status);
+  flightRecorderFlush();
+#endif
+
+  // Keep the session snapshot current while the device sits idle
+  updateSessionSnapshot();
+
+  // ============================================================================
+  // BACKGROUND JOBS
+  // ============================================================================
+  // Step any running job (export etc.) before the active view draws this frame
+  if (jobActive) {
+    // ESC cancels the running job instead of going to the view
+    if (M5Cardputer.Keyboard.isChange() &&
+        std::find(status.word.begin(), status.word.end(), '`') != status.word.end()) {
+      cancelJob();
+      runJobSlice();
+      loopDelay(200);  // Debounce
+      return;
+    }
+    runJobSlice();
+  }
+
+#if ENABLE_LED_MATRIX
+  // The LED playlist plays on in every view
+  stepLEDPlaylist();
+#endif
+
   // ============================================================================
   // CHARGING MODE
   // ============================================================================
@@ -6390,6 +14840,14 @@ void loop() {
     return;
   }
 
+  // ============================================================================
+  // MURAL VIEW
+  // ============================================================================
+  if (inMuralView) {
+    handleMuralView(status);
+    return;
+  }
+
   // ============================================================================
   // CANVAS VIEW (Default)
   // ============================================================================
@@ -6431,7 +14889,14 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
   // btSpace also acts as draw (BT only feature)
   enterHeld = enterHeld || btEnter || btSpace;
   deleteHeld = deleteHeld || btBackspace;
+#endif
+
+  // The stroke ends when its key is released
+  if (canvasStroke.open && !(canvasStroke.value ? enterHeld : deleteHeld)) {
+    endStroke();
+  }
 
+#if ENABLE_BLUETOOTH
   // Check for BT Fn modifier (Alt key)
   bool fnHeld = status.fn || btFnHeld;
 
@@ -6469,17 +14934,14 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
 
   // Process BT Enter/Space/Backspace for pixel operations
   // Space on BT keyboard also draws (BT-only feature)
+  // Held keys are reported every frame; they only open a stroke once
   if ((btEnter || btSpace) && !status.enter) {
-    saveUndo();
-    canvas[cursorY][cursorX] = selectedColor;
-    pixelPlaced = true;
-    LED_CANVAS_UPDATED();
+    beginStroke(selectedColor);
+    pixelPlaced |= strokeCell(cursorX, cursorY);
   }
   if (btBackspace && !status.del) {
-    saveUndo();
-    canvas[cursorY][cursorX] = 0;
-    pixelPlaced = true;
-    LED_CANVAS_UPDATED();
+    beginStroke(0);
+    pixelPlaced |= strokeCell(cursorX, cursorY);
   }
 
   // Process BT character queue
@@ -6525,19 +14987,19 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
     // O key - Memory view
     else if (btChar == 'o' || btChar == 'O') {
       enterMemoryView();
-      delay(200);
+      loopDelay(200);
       return;
     }
     // P key - Palette view
     else if (btChar == 'p' || btChar == 'P') {
       enterPaletteView();
-      delay(200);
+      loopDelay(200);
       return;
     }
     // I key - Help view
     else if (btChar == 'h' || btChar == 'H') {
       enterHelpView();
-      delay(200);
+      loopDelay(200);
       return;
     }
     // S key - Save sketch (or Alt+S to save as new)
@@ -6555,16 +15017,20 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
         saveActiveSketchToSD();
       }
     }
+    // Fn+V - Live tile strip
+    else if ((btChar == 'v' || btChar == 'V') && fnHeld) {
+      toggleCanvasTileStrip();
+    }
     // V key - Preview view
     else if (btChar == 'v' || btChar == 'V') {
       enterPreviewView();
-      delay(200);
+      loopDelay(200);
       return;
     }
     // T key - Settings view
     else if (btChar == 't' || btChar == 'T') {
       enterSettingsView();
-      delay(200);
+      loopDelay(200);
       return;
     }
     // F key - Flood fill
@@ -6578,7 +15044,7 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
     // B key (with Fn/Alt) - Charging mode
     else if ((btChar == 'b' || btChar == 'B') && fnHeld) {
       enterChargingMode();
-      delay(200);
+      loopDelay(200);
       return;
     }
   }
@@ -6595,18 +15061,16 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
       // Check for special keys first (Enter, Backspace, etc.)
       // These are in status.enter, status.del, etc., not in status.word
       if (status.enter) {
-        // Enter/Return key (OK button) - place pixel with selected color
-        saveUndo();  // Save state before placing pixel
-        canvas[cursorY][cursorX] = selectedColor;
+        // Enter/Return key (OK button) - start a stroke with the selected color
+        beginStroke(selectedColor);
+        strokeCell(cursorX, cursorY);
         pixelPlaced = true;
-        LED_CANVAS_UPDATED();  // Update LED matrix
       }
       else if (status.del) {
-        // Backspace/Delete key - erase pixel
-        saveUndo();  // Save state before erasing
-        canvas[cursorY][cursorX] = 0;
+        // Backspace/Delete key - start an erasing stroke
+        beginStroke(0);
+        strokeCell(cursorX, cursorY);
         pixelPlaced = true;
-        LED_CANVAS_UPDATED();  // Update LED matrix
       }
 
       // Check for non-arrow keys (number keys, commands, etc.)
@@ -6658,7 +15122,7 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
         // O key - Open Memory View
         else if (i == 'o' || i == 'O') {
           enterMemoryView();
-          delay(200);  // Debounce to prevent immediate close
+          loopDelay(200);  // Debounce to prevent immediate close
         }
         // S key - Save sketch (or Fn+S to save as new)
         else if (i == 's' || i == 'S') {
@@ -6689,24 +15153,48 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
         // I key or ESC (`) - Enter Hint Screen
         else if (i == 'h' || i == 'H' || i == '`') {
           enterHelpView();
-          delay(200);  // Debounce to prevent immediate close
+          loopDelay(200);  // Debounce to prevent immediate close
         }
         // T key - Open Settings Menu
         else if (i == 't' || i == 'T') {
           enterSettingsView();
-          delay(200);  // Debounce to prevent immediate close
+          loopDelay(200);  // Debounce to prevent immediate close
+        }
+        // Fn+V - Toggle the live tile strip beside the canvas
+        else if ((i == 'v' || i == 'V') && fnHeld) {
+          toggleCanvasTileStrip();
+          loopDelay(200);  // Debounce
         }
         // V key - Enter View Mode
         else if (i == 'v' || i == 'V') {
           enterPreviewView();
-          delay(200);  // Debounce to prevent immediate close
+          loopDelay(200);  // Debounce to prevent immediate close
         }
-        // X key - Export PNG
+        // M key - Open the mural (large canvas on SD)
+        else if (i == 'm' || i == 'M') {
+          enterMuralView();
+          loopDelay(200);  // Debounce to prevent immediate close
+        }
+        // X key - Export image (format from settings)
         // X alone = 128×128 scaled export
         // Fn+X (or BT Alt+X) = logical size export (8×8 or 16×16)
         else if (i == 'x' || i == 'X') {
           bool scaleToFull = !fnHeld;  // Scale unless Fn/Alt is held
-          exportCanvasToPNG(scaleToFull);
+          exportCanvasImage(scaleToFull);
+        }
+#if ENABLE_SD_TRACE
+        // Fn+I - Write SD I/O trace (per call site) to the SD card
+        else if ((i == 'i' || i == 'I') && fnHeld) {
+          setStatusMessage(writeSDTraceReport() ? StatusMsg::TRACE_SAVED : StatusMsg::FILE_OPEN_FAIL);
+        }
+#endif
+        // Fn+J - Show UI frame times measured during the last background job
+        else if ((i == 'j' || i == 'J') && fnHeld) {
+          char statsMsg[32];
+          unsigned long avgMs = lastJobStats.frames ? lastJobStats.totalFrameUs / lastJobStats.frames / 1000 : 0;
+          snprintf(statsMsg, sizeof(statsMsg), StatusMsg::JOB_STATS_FMT, (unsigned long)lastJobStats.frames,
+                   (unsigned long)(lastJobStats.maxFrameUs / 1000), avgMs);
+          setStatusMessage(statsMsg);
         }
 #if ENABLE_SCREENSHOTS
         // Y key - Take Screenshot (full 240×135 display)
@@ -6717,12 +15205,12 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
         // P key - Open Palette Menu
         else if (i == 'p' || i == 'P') {
           enterPaletteView();
-          delay(200);  // Debounce to prevent immediate close
+          loopDelay(200);  // Debounce to prevent immediate close
         }
         // Fn+B - Enter Charging Mode (screensaver)
         else if ((i == 'b' || i == 'B') && fnHeld) {
           enterChargingMode();
-          delay(200);
+          loopDelay(200);
           return;
         }
         // B key + Plus/Minus - Brightness control
@@ -6780,8 +15268,14 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
           adjustLEDBrightness((i == '-') ? -1 : +1);
 
           // Show LED matrix brightness level
+          // When the power budget is dimming the frame, show the effective level too
           char ledBrightMsg[30];
-          snprintf(ledBrightMsg, sizeof(ledBrightMsg), "LED: %d%%", ledBrightness);
+          uint8_t appliedPercent = (ledAppliedBrightness * 100 + 127) / 255;
+          if (appliedPercent < ledBrightness) {
+            snprintf(ledBrightMsg, sizeof(ledBrightMsg), "LED: %d%% (%d%%)", ledBrightness, appliedPercent);
+          } else {
+            snprintf(ledBrightMsg, sizeof(ledBrightMsg), "LED: %d%%", ledBrightness);
+          }
           setStatusMessage(ledBrightMsg);
         }
 #endif // ENABLE_LED_MATRIX
@@ -6808,17 +15302,11 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
             moved = true;
           }
 
-          // If enter or delete is held, paint/erase at the new position
-          if (moved && enterHeld) {
-            canvas[cursorY][cursorX] = selectedColor;
-            pixelPlaced = true;
-            LED_CANVAS_UPDATED();  // Update LED matrix
-              }
-          else if (moved && deleteHeld) {
-            canvas[cursorY][cursorX] = 0;
-            pixelPlaced = true;
-            LED_CANVAS_UPDATED();  // Update LED matrix
-              }
+          // If enter or delete is held, the stroke continues at the new position
+          if (moved && (enterHeld || deleteHeld)) {
+            beginStroke(enterHeld ? selectedColor : 0);
+            pixelPlaced |= strokeCell(cursorX, cursorY);
+          }
         }
       }
     }
@@ -6878,16 +15366,10 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
         moved = true;
       }
 
-      // If enter or delete is held, paint/erase at the new position
-      if (moved && enterHeld) {
-        canvas[cursorY][cursorX] = selectedColor;
-        pixelPlaced = true;
-        LED_CANVAS_UPDATED();  // Update LED matrix
-      }
-      else if (moved && deleteHeld) {
-        canvas[cursorY][cursorX] = 0;
-        pixelPlaced = true;
-        LED_CANVAS_UPDATED();  // Update LED matrix
+      // If enter or delete is held, the stroke continues at the new position
+      if (moved && (enterHeld || deleteHeld)) {
+        beginStroke(enterHeld ? selectedColor : 0);
+        pixelPlaced |= strokeCell(cursorX, cursorY);
       }
     }
   } else {
@@ -6902,14 +15384,15 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
   }
 
   // Redraw based on what changed
-  if (canvasCleared || undoPerformed || gridToggled || rulersToggled || floodFilled || themeToggled) {
+  if (undoPerformed || gridToggled || rulersToggled || themeToggled) {
     // Update LED matrix for any canvas change
     LED_CANVAS_UPDATED();
+    memset(canvasChanged, 0, sizeof(canvasChanged));
 
     // Redraw the entire canvas
     // (gridToggled needs full redraw because cell size changed)
     // (rulersToggled needs full redraw to show/hide rulers)
-    // (floodFilled needs full redraw because many cells may have changed)
+    // (undoPerformed may have changed the grid size)
     // (themeToggled needs full redraw with new background color)
 
     // If theme changed, clear entire screen with new background
@@ -6922,9 +15405,7 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
       drawCursor();
 
       // Redraw icons
-      drawIcon(3, 3, ICON_DRAW, ICON_DRAW_WIDTH, ICON_DRAW_HEIGHT, ICON_DRAW_IS_INDEXED);
-      drawIcon(3, 30, ICON_ERASE, ICON_ERASE_WIDTH, ICON_ERASE_HEIGHT, ICON_ERASE_IS_INDEXED);
-      drawIcon(3, 57, ICON_FILL, ICON_FILL_WIDTH, ICON_FILL_HEIGHT, ICON_FILL_IS_INDEXED);
+      drawToolIcons();
 
       // Reset battery indicator for redraw
       lastBatteryPercent = -1;
@@ -6943,16 +15424,26 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
       drawCursor();
     }
   }
+  else if (canvasCleared || floodFilled) {
+    // Clear and fill only redraw the cells they changed
+    LED_CANVAS_UPDATED();
+    drawChangedCells();
+    if (moved) {
+      drawCell(oldX, oldY);
+    }
+    drawCursor();
+  }
   else if (moved) {
-    // Erase the old cursor by redrawing that cell
+    // Erase the old cursor by redrawing that cell (and any the stroke painted)
+    drawChangedCells();
     drawCell(oldX, oldY);
 
     // Draw the new cursor
     drawCursor();
   }
   else if (pixelPlaced) {
-    // Redraw the current cell and cursor
-    drawCell(cursorX, cursorY);
+    // Redraw the cells the stroke painted and the cursor
+    drawChangedCells();
     drawCursor();
   }
   else if (colorChanged) {
@@ -6962,6 +15453,11 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
     drawCursor();
   }
 
+  // Keep the live tile strip in step with the canvas (theme redraws it with the icons)
+  if (canvasTileStrip && !themeToggled && (pixelPlaced || canvasCleared || undoPerformed || gridToggled || floodFilled)) {
+    drawCanvasTileStrip();
+  }
+
   // Check if status message needs to be cleared (independent of other redraws)
   if (statusMessageJustCleared) {
     // Status message starts at x=3, y=124 and can extend ~110px
@@ -7016,13 +15512,13 @@ void handleCanvasView(Keyboard_Class::KeysState& status) {
   }
 
 #if ENABLE_LED_MATRIX
-  // Update LED matrix if canvas has changed
-  if (canvasNeedsUpdate) {
+  // Update LED matrix if canvas has changed (rate-capped during a stroke)
+  if (canvasNeedsUpdate && strokeLEDFlushDue()) {
     updateLEDMatrix();
     canvasNeedsUpdate = false;  // Clear flag
   }
 #endif // ENABLE_LED_MATRIX
 
   // Small delay to prevent the loop from running too fast
-  delay(10);
+  loopDelay(10);
 }
@@ -0,0 +1,161 @@
+/**
+ * On-device tests for InflateWindow against the ROM tinfl decoder
+ * (pio test -e m5stack-cardputer). The real tinfl rejects a wrapping window
+ * unless each call fills the rest of it, which a host zlib stand-in can't show.
+ * Streams are compressed on the device with the zlib that PNGENC builds.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <PNGENC.h>
+#include <zlib.h>
+#include "../../../src/inflate_window.h"
+
+#define TEST_BYTES 100000             // Over three windows of output
+
+uint8_t* compressed = nullptr;
+size_t compressedLen = 0;
+
+static uint8_t hashByte(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return (uint8_t)x;
+}
+
+// Test data in 4 KB blocks: a pattern repeating every 1531 bytes (matches
+// that reach back across the window's wrap point), noise (literals only),
+// and mostly-zero runs
+static uint8_t sampleByte(uint32_t i) {
+  switch ((i / 4096) % 3) {
+    case 0: return hashByte(i % 1531);
+    case 1: return hashByte(i);
+    default: return (i % 4096) < 3000 ? 0 : hashByte(i * 7);
+  }
+}
+
+static void compressSample() {
+  z_stream zs = {};
+  TEST_ASSERT_EQUAL_INT(Z_OK, deflateInit2(&zs, 6, Z_DEFLATED, 14, 7, Z_DEFAULT_STRATEGY));
+  size_t capacity = deflateBound(&zs, TEST_BYTES);
+  compressed = (uint8_t*)malloc(capacity);
+  TEST_ASSERT_NOT_NULL(compressed);
+  zs.next_out = compressed;
+  zs.avail_out = capacity;
+
+  uint8_t chunk[1024];
+  int rc = Z_OK;
+  for (uint32_t i = 0; i < TEST_BYTES && rc == Z_OK; i += sizeof(chunk)) {
+    uint32_t n = min((uint32_t)sizeof(chunk), (uint32_t)(TEST_BYTES - i));
+    for (uint32_t k = 0; k < n; k++) {
+      chunk[k] = sampleByte(i + k);
+    }
+    zs.next_in = chunk;
+    zs.avail_in = n;
+    rc = deflate(&zs, i + n < TEST_BYTES ? Z_NO_FLUSH : Z_FINISH);
+  }
+  TEST_ASSERT_EQUAL_INT(Z_STREAM_END, rc);
+  compressedLen = zs.total_out;
+  deflateEnd(&zs);
+}
+
+/**
+ * Inflate the sample, feeding chunkSize compressed bytes at a time and
+ * reading readSize bytes per call, the way pngStreamNextRow reads scanlines.
+ * Stops after inputLimit compressed bytes (to test truncated streams).
+ * @return status of the last read
+ */
+static tinfl_status inflateSample(size_t chunkSize, size_t readSize, size_t inputLimit, size_t& total, bool& matches) {
+  InflateWindow w;
+  w.inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+  w.window = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+  uint8_t* out = (uint8_t*)malloc(readSize);
+  TEST_ASSERT_NOT_NULL(w.inflator);
+  TEST_ASSERT_NOT_NULL(w.window);
+  TEST_ASSERT_NOT_NULL(out);
+  inflateWindowBegin(w);
+
+  total = 0;
+  matches = true;
+  size_t inPos = 0;
+  size_t inEnd = 0;
+  tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  while (true) {
+    if (inPos == inEnd) {
+      inEnd = min(inPos + chunkSize, inputLimit);
+    }
+    size_t inBytes = inEnd - inPos;
+    size_t outBytes = readSize;
+    status = inflateWindowRead(w, compressed + inPos, inBytes, out, outBytes, inEnd < inputLimit);
+    inPos += inBytes;
+    for (size_t k = 0; k < outBytes && matches; k++) {
+      matches = out[k] == sampleByte(total + k);
+    }
+    total += outBytes;
+    if (status < 0 || (status == TINFL_STATUS_DONE && outBytes < readSize) ||
+        (inEnd == inputLimit && inBytes == 0 && outBytes == 0)) {
+      break;
+    }
+  }
+
+  free(out);
+  free(w.window);
+  free(w.inflator);
+  return status;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Odd-sized scanlines from 512-byte reads, as the sheet importer does
+void test_rows_from_small_chunks() {
+  size_t total;
+  bool matches;
+  TEST_ASSERT_EQUAL_INT(TINFL_STATUS_DONE, inflateSample(512, 97, compressedLen, total, matches));
+  TEST_ASSERT_EQUAL_UINT32(TEST_BYTES, total);
+  TEST_ASSERT_TRUE(matches);
+}
+
+// One compressed byte at a time
+void test_byte_by_byte_input() {
+  size_t total;
+  bool matches;
+  TEST_ASSERT_EQUAL_INT(TINFL_STATUS_DONE, inflateSample(1, 4000, compressedLen, total, matches));
+  TEST_ASSERT_EQUAL_UINT32(TEST_BYTES, total);
+  TEST_ASSERT_TRUE(matches);
+}
+
+// Reads larger than the window span several tinfl calls
+void test_reads_larger_than_window() {
+  size_t total;
+  bool matches;
+  TEST_ASSERT_EQUAL_INT(TINFL_STATUS_DONE, inflateSample(4096, 40000, compressedLen, total, matches));
+  TEST_ASSERT_EQUAL_UINT32(TEST_BYTES, total);
+  TEST_ASSERT_TRUE(matches);
+}
+
+// A cut-off stream fails instead of ending short
+void test_truncated_stream() {
+  size_t total;
+  bool matches;
+  tinfl_status status = inflateSample(512, 97, compressedLen / 2, total, matches);
+  TEST_ASSERT_TRUE(status < 0);
+  TEST_ASSERT_TRUE(total < TEST_BYTES);
+  TEST_ASSERT_TRUE(matches);
+}
+
+void setup() {
+  delay(2000);  // Let the serial monitor attach
+  UNITY_BEGIN();
+  compressSample();
+  RUN_TEST(test_rows_from_small_chunks);
+  RUN_TEST(test_byte_by_byte_input);
+  RUN_TEST(test_reads_larger_than_window);
+  RUN_TEST(test_truncated_stream);
+  free(compressed);
+  UNITY_END();
+}
+
+void loop() {}
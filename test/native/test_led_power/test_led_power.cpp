@@ -0,0 +1,90 @@
+/**
+ * Host tests for the LED power model (pio test -e native)
+ * Expected currents come from the WS2812E figures in led_power.h:
+ * 12 mA per channel at full duty plus 0.6 mA idle per LED.
+ */
+
+#include <unity.h>
+#include "../../../src/led_power.h"
+
+// Fill count LEDs (3 bytes each) with one color
+static void fillFrame(uint8_t* frame, uint16_t count, uint8_t r, uint8_t g, uint8_t b) {
+  for (uint16_t i = 0; i < count; i++) {
+    frame[i * 3] = r;
+    frame[i * 3 + 1] = g;
+    frame[i * 3 + 2] = b;
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+// One 8×8 unit, all white: 64 × 36 mA lit + 64 × 0.6 mA idle
+void test_full_white_unit() {
+  uint8_t frame[64 * 3];
+  fillFrame(frame, 64, 255, 255, 255);
+  uint32_t sum = sumLEDChannels(frame, 64);
+  TEST_ASSERT_EQUAL_UINT32(64 * 3 * 255, sum);
+  TEST_ASSERT_EQUAL_UINT32(2342, estimateLEDCurrentMA(sum, 64, 255));
+
+  // Dimmed to the highest brightness that fits 500 mA, and no higher
+  uint8_t applied = budgetLEDBrightness(sum, 64, 255);
+  TEST_ASSERT_EQUAL_UINT8(51, applied);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(LED_POWER_BUDGET_MA, estimateLEDCurrentMA(sum, 64, applied));
+  TEST_ASSERT_GREATER_THAN_UINT32(LED_POWER_BUDGET_MA, estimateLEDCurrentMA(sum, 64, applied + 1));
+}
+
+// 2×2 wall, half the LEDs red and half black: sums across the SWAR flush
+void test_mixed_quad() {
+  uint8_t frame[256 * 3];
+  fillFrame(frame, 256, 0, 0, 0);
+  fillFrame(frame, 128, 255, 0, 0);
+  uint32_t sum = sumLEDChannels(frame, 256);
+  TEST_ASSERT_EQUAL_UINT32(128 * 255, sum);
+
+  // A dim request fits the budget and passes through unchanged
+  TEST_ASSERT_EQUAL_UINT8(40, budgetLEDBrightness(sum, 256, 40));
+  TEST_ASSERT_EQUAL_UINT32(394, estimateLEDCurrentMA(sum, 256, 40));
+
+  // Full brightness would draw 1689 mA, so it is capped
+  TEST_ASSERT_EQUAL_UINT32(1689, estimateLEDCurrentMA(sum, 256, 255));
+  uint8_t applied = budgetLEDBrightness(sum, 256, 255);
+  TEST_ASSERT_EQUAL_UINT8(57, applied);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(LED_POWER_BUDGET_MA, estimateLEDCurrentMA(sum, 256, applied));
+}
+
+// Counts whose byte length is not a multiple of 4 still add every channel
+void test_sum_leftover_bytes() {
+  uint8_t frame[5 * 3];
+  fillFrame(frame, 5, 1, 2, 3);
+  TEST_ASSERT_EQUAL_UINT32(5 * 6, sumLEDChannels(frame, 5));
+}
+
+// Black frames keep the requested brightness and draw only idle current
+void test_black_frame() {
+  uint8_t frame[64 * 3];
+  fillFrame(frame, 64, 0, 0, 0);
+  uint32_t sum = sumLEDChannels(frame, 64);
+  TEST_ASSERT_EQUAL_UINT8(255, budgetLEDBrightness(sum, 64, 255));
+  TEST_ASSERT_EQUAL_UINT32(38, estimateLEDCurrentMA(sum, 64, 255));
+}
+
+// A chain whose idle draw alone exceeds the budget is clamped to off
+void test_idle_over_budget() {
+  const uint16_t count = 900;  // 540 mA idle
+  uint8_t frame[count * 3];
+  fillFrame(frame, count, 10, 10, 10);
+  uint32_t sum = sumLEDChannels(frame, count);
+  TEST_ASSERT_EQUAL_UINT8(0, budgetLEDBrightness(sum, count, 255));
+  TEST_ASSERT_EQUAL_UINT32(540, estimateLEDCurrentMA(sum, count, 0));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_white_unit);
+  RUN_TEST(test_mixed_quad);
+  RUN_TEST(test_sum_leftover_bytes);
+  RUN_TEST(test_black_frame);
+  RUN_TEST(test_idle_over_budget);
+  return UNITY_END();
+}